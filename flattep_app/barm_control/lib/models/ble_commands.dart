@@ -1,5 +1,11 @@
+import 'dart:convert';
 import 'dart:typed_data';
 
+import 'arm_position.dart';
+import 'cartesian_pose.dart';
+import 'joint_calibration.dart';
+import 'waypoint_codec.dart';
+
 enum BleCommand {
   setSingleJoint(0x01),
   setAllJoints(0x02),
@@ -9,12 +15,44 @@ enum BleCommand {
   stopSequence(0x06),
   getStatus(0x07),
   homePosition(0x08),
-  setTorque(0x09);
+  setTorque(0x09),
+  subscribeTelemetry(0x0A),
+  getExtendedStatus(0x0B),
+  playProgram(0x0C),
+  uploadSlots(0x0D),
+  xferBegin(0x0E),
+  xferData(0x0F),
+  xferEnd(0x10),
+  xferAck(0x11),
+  moveAndWait(0x12),
+  setArrival(0x13),
+  runScript(0x14),
+  setFeed(0x15),
+  queueSegments(0x16),
+  cartMove(0x17),
+  cartJog(0x18),
+  getPose(0x19),
+  moveLinear(0x1A),
+  moveCircular(0x1B),
+  setCalibration(0x1C),
+  getCalibration(0x1D),
+  teachStart(0x1E),
+  teachStop(0x1F);
   
   final int value;
   const BleCommand(this.value);
 }
 
+/// Where CMD 0x03 takes the saved positions from (and CMD 0x19 the pose)
+enum SaveSource {
+  measured(0),   // One bulk read of the servos
+  commanded(1),  // Current setpoint, no bus traffic
+  explicit(2);   // Positions given in the command
+  
+  final int value;
+  const SaveSource(this.value);
+}
+
 class BleCommandBuilder {
   // CMD 0x01: Set single joint
   static Uint8List setSingleJoint(int jointId, int position, int speed, int time) {
@@ -44,16 +82,25 @@ class BleCommandBuilder {
     return buffer.buffer.asUint8List();
   }
   
-  // CMD 0x03: Save position
-  static Uint8List savePosition(int slot, List<int> positions) {
+  // CMD 0x03: Save position. positions are only sent with SaveSource.explicit;
+  // timesMs/speeds are per joint (a single value applies to all joints)
+  static Uint8List savePosition(int slot, {SaveSource source = SaveSource.commanded,
+                                List<int>? positions, List<int> timesMs = const [1000],
+                                List<int> speeds = const [1000], int delayMs = 0}) {
     assert(slot >= 0 && slot < 16);
-    assert(positions.length == 6);
+    assert(source != SaveSource.explicit || (positions != null && positions.length == 6));
+    assert(timesMs.length == 1 || timesMs.length == 6);
+    assert(speeds.length == 1 || speeds.length == 6);
     
-    final buffer = ByteData(14);
+    final buffer = ByteData(43);
     buffer.setUint8(0, BleCommand.savePosition.value);
     buffer.setUint8(1, slot);
+    buffer.setUint32(2, delayMs, Endian.little);
+    buffer.setUint8(6, source.value);
     for (int i = 0; i < 6; i++) {
-      buffer.setUint16(2 + i * 2, positions[i], Endian.little);
+      buffer.setUint16(7 + i * 6, positions != null ? positions[i] : 0, Endian.little);
+      buffer.setUint16(9 + i * 6, timesMs[timesMs.length == 1 ? 0 : i], Endian.little);
+      buffer.setUint16(11 + i * 6, speeds[speeds.length == 1 ? 0 : i], Endian.little);
     }
     return buffer.buffer.asUint8List();
   }
@@ -115,4 +162,261 @@ class BleCommandBuilder {
     buffer[1] = enable ? 1 : 0;
     return buffer;
   }
+  
+  // CMD 0x0A: Subscribe to streamed telemetry (rateHz 10-100, 0 = stop)
+  static Uint8List subscribeTelemetry(int rateHz, int fields, int samplesPerNotify) {
+    assert(rateHz == 0 || (rateHz >= 10 && rateHz <= 100));
+    
+    final buffer = Uint8List(4);
+    buffer[0] = BleCommand.subscribeTelemetry.value;
+    buffer[1] = rateHz;
+    buffer[2] = fields;
+    buffer[3] = samplesPerNotify;
+    return buffer;
+  }
+  
+  // CMD 0x0B: Get extended status (answered with a tag 0x81 notification)
+  static Uint8List getExtendedStatus() {
+    final buffer = Uint8List(1);
+    buffer[0] = BleCommand.getExtendedStatus.value;
+    return buffer;
+  }
+  
+  // CMD 0x0C: Play a named program from the trajectory store
+  static Uint8List playProgram(String name, bool loop) {
+    final nameBytes = ascii.encode(name);
+    assert(nameBytes.isNotEmpty && nameBytes.length <= 15, 'name must be 1-15 ASCII characters');
+    
+    final buffer = Uint8List(2 + nameBytes.length);
+    buffer[0] = BleCommand.playProgram.value;
+    buffer[1] = loop ? 1 : 0;
+    buffer.setRange(2, buffer.length, nameBytes);
+    return buffer;
+  }
+  
+  // CMD 0x0D: Save consecutive slots from firstSlot in one write
+  static Uint8List uploadSlots(int firstSlot, List<Waypoint> waypoints) {
+    assert(firstSlot >= 0 && firstSlot + waypoints.length <= 16);
+    assert(waypoints.isNotEmpty);
+    
+    final encoded = WaypointCodec.encodeList(waypoints);
+    final buffer = Uint8List(2 + encoded.length);
+    buffer[0] = BleCommand.uploadSlots.value;
+    buffer[1] = firstSlot;
+    buffer.setRange(2, buffer.length, encoded);
+    return buffer;
+  }
+  
+  // CMD 0x0E: Begin a program upload (totalLength/crc32 of the chain) or download (from offset)
+  static Uint8List xferBegin(int dir, String name, {int totalLength = 0, int crc32 = 0, int offset = 0}) {
+    final nameBytes = ascii.encode(name);
+    assert(nameBytes.isNotEmpty && nameBytes.length <= 15, 'name must be 1-15 ASCII characters');
+    
+    final buffer = ByteData(14 + nameBytes.length);
+    buffer.setUint8(0, BleCommand.xferBegin.value);
+    buffer.setUint8(1, dir);
+    buffer.setUint32(2, totalLength, Endian.little);
+    buffer.setUint32(6, crc32, Endian.little);
+    buffer.setUint32(10, offset, Endian.little);
+    final bytes = buffer.buffer.asUint8List();
+    bytes.setRange(14, bytes.length, nameBytes);
+    return bytes;
+  }
+  
+  // CMD 0x0F: One upload chunk
+  static Uint8List xferData(int seq, int offset, Uint8List chunk) {
+    final buffer = ByteData(6 + chunk.length);
+    buffer.setUint8(0, BleCommand.xferData.value);
+    buffer.setUint8(1, seq & 0xFF);
+    buffer.setUint32(2, offset, Endian.little);
+    final bytes = buffer.buffer.asUint8List();
+    bytes.setRange(6, bytes.length, chunk);
+    return bytes;
+  }
+  
+  // CMD 0x10: Finish an upload, or abort either direction
+  static Uint8List xferEnd({bool abort = false}) {
+    return Uint8List.fromList([BleCommand.xferEnd.value, abort ? 1 : 0]);
+  }
+  
+  // CMD 0x11: Download ack; resend asks the device to go back to offset
+  static Uint8List xferAck(int offset, {bool resend = false}) {
+    final buffer = ByteData(6);
+    buffer.setUint8(0, BleCommand.xferAck.value);
+    buffer.setUint8(1, resend ? 1 : 0);
+    buffer.setUint32(2, offset, Endian.little);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x12: Move all joints; the device answers with a tag 0x84 notification.
+  // timeoutMs is allowed on top of timeMs (0 = device default)
+  static Uint8List moveAndWait(int moveId, List<int> positions, int timeMs, int speed, {int timeoutMs = 0}) {
+    assert(positions.length == 6);
+    
+    final buffer = ByteData(20);
+    buffer.setUint8(0, BleCommand.moveAndWait.value);
+    buffer.setUint8(1, moveId & 0xFF);
+    for (int i = 0; i < 6; i++) {
+      buffer.setUint16(2 + i * 2, positions[i], Endian.little);
+    }
+    buffer.setUint16(14, timeMs, Endian.little);
+    buffer.setUint16(16, speed, Endian.little);
+    buffer.setUint16(18, timeoutMs, Endian.little);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x13: Arrival tolerance (steps) and timeout past the planned move time
+  static Uint8List setArrival(int tolerance, int timeoutMs) {
+    final buffer = ByteData(5);
+    buffer.setUint8(0, BleCommand.setArrival.value);
+    buffer.setUint16(1, tolerance, Endian.little);
+    buffer.setUint16(3, timeoutMs, Endian.little);
+    return buffer.buffer.asUint8List();
+  }  
+  // CMD 0x14: Run a stored sequence script
+  static Uint8List runScript(String name) {
+    final nameBytes = ascii.encode(name);
+    assert(nameBytes.isNotEmpty && nameBytes.length <= 15, 'name must be 1-15 ASCII characters');
+    
+    final buffer = Uint8List(1 + nameBytes.length);
+    buffer[0] = BleCommand.runScript.value;
+    buffer.setRange(1, buffer.length, nameBytes);
+    return buffer;
+  }
+  
+  // CMD 0x15: Feed override, 0-150% of planned speed (0 holds the arm)
+  static Uint8List setFeed(int percent) {
+    assert(percent >= 0 && percent <= 150);
+    return Uint8List.fromList([BleCommand.setFeed.value, percent]);
+  }
+  
+  // CMD 0x16: Queue motion segments; [timesMs] are durations, or client
+  // timestamps with [timestamps]. [replace] drops what is still queued.
+  static const int queueFlagTimestamps = 1 << 0;
+  static const int queueFlagReplace = 1 << 1;
+  static const int queueHeaderSize = 3;
+  static const int queueSegmentSize = 14;
+  
+  static Uint8List queueSegments(List<ArmPosition> positions, List<int> timesMs,
+                                 {bool timestamps = false, bool replace = false}) {
+    assert(positions.length == timesMs.length && positions.length <= 255);
+    
+    final buffer = ByteData(queueHeaderSize + positions.length * queueSegmentSize);
+    buffer.setUint8(0, BleCommand.queueSegments.value);
+    buffer.setUint8(1, (timestamps ? queueFlagTimestamps : 0) | (replace ? queueFlagReplace : 0));
+    buffer.setUint8(2, positions.length);
+    for (int s = 0; s < positions.length; s++) {
+      final offset = queueHeaderSize + s * queueSegmentSize;
+      for (int i = 0; i < 6; i++) {
+        buffer.setUint16(offset + i * 2, positions[s].jointPositions[i], Endian.little);
+      }
+      buffer.setUint16(offset + 12, timesMs[s] & 0xFFFF, Endian.little);
+    }
+    return buffer.buffer.asUint8List();
+  }
+  
+  static int _clampInt16(num value) => value.round().clamp(-32768, 32767);
+  
+  // Tool pose as sent: 0.1 mm and mrad
+  static void _setPose(ByteData buffer, int offset, CartesianPose pose) {
+    buffer.setInt16(offset, _clampInt16(pose.x * 10), Endian.little);
+    buffer.setInt16(offset + 2, _clampInt16(pose.y * 10), Endian.little);
+    buffer.setInt16(offset + 4, _clampInt16(pose.z * 10), Endian.little);
+    buffer.setInt16(offset + 6, _clampInt16(pose.pitch * 1000), Endian.little);
+    buffer.setInt16(offset + 8, _clampInt16(pose.roll * 1000), Endian.little);
+  }
+  
+  // CMD 0x17: Move the tool to [pose] in a joint move; the gripper stays put
+  static Uint8List cartMove(CartesianPose pose, int timeMs, int speed) {
+    final buffer = ByteData(15);
+    buffer.setUint8(0, BleCommand.cartMove.value);
+    _setPose(buffer, 1, pose);
+    buffer.setUint16(11, timeMs, Endian.little);
+    buffer.setUint16(13, speed, Endian.little);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x18: Jog the tool, mm/s and rad/s. Resend at least every 300 ms
+  // while jogging; all zero (or silence) ramps to a stop.
+  static Uint8List cartJog(double vx, double vy, double vz, {double vPitch = 0, double vRoll = 0}) {
+    final buffer = ByteData(11);
+    buffer.setUint8(0, BleCommand.cartJog.value);
+    buffer.setInt16(1, _clampInt16(vx), Endian.little);
+    buffer.setInt16(3, _clampInt16(vy), Endian.little);
+    buffer.setInt16(5, _clampInt16(vz), Endian.little);
+    buffer.setInt16(7, _clampInt16(vPitch * 1000), Endian.little);
+    buffer.setInt16(9, _clampInt16(vRoll * 1000), Endian.little);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x19: Tool pose of the measured or commanded positions (tag 0x85 notification)
+  static Uint8List getPose({SaveSource source = SaveSource.measured}) {
+    assert(source != SaveSource.explicit);
+    return Uint8List.fromList([BleCommand.getPose.value, source.value]);
+  }
+  
+  // CMD 0x1A: Straight line to [pose]; timeMs 0 = device default speed
+  static Uint8List moveLinear(CartesianPose pose, int timeMs) {
+    final buffer = ByteData(13);
+    buffer.setUint8(0, BleCommand.moveLinear.value);
+    _setPose(buffer, 1, pose);
+    buffer.setUint16(11, timeMs, Endian.little);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x1B: Arc through [via] (orientation ignored) to [pose]
+  static Uint8List moveCircular(CartesianPose via, CartesianPose pose, int timeMs) {
+    final buffer = ByteData(19);
+    buffer.setUint8(0, BleCommand.moveCircular.value);
+    buffer.setInt16(1, _clampInt16(via.x * 10), Endian.little);
+    buffer.setInt16(3, _clampInt16(via.y * 10), Endian.little);
+    buffer.setInt16(5, _clampInt16(via.z * 10), Endian.little);
+    _setPose(buffer, 7, pose);
+    buffer.setUint16(17, timeMs, Endian.little);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x1C: Replace a joint's calibration (answered with a tag 0x86 notification)
+  static Uint8List setCalibration(JointCalibration calibration) {
+    final buffer = ByteData(2 + JointCalibration.recordSize);
+    buffer.setUint8(0, BleCommand.setCalibration.value);
+    buffer.setUint8(1, calibration.joint);
+    calibration.write(buffer, 2);
+    return buffer.buffer.asUint8List();
+  }
+  
+  // CMD 0x1C without a record: restore a joint's default calibration
+  static Uint8List resetCalibration(int joint) {
+    return Uint8List.fromList([BleCommand.setCalibration.value, joint]);
+  }
+  
+  // CMD 0x1D: One joint's calibration, or every joint's when [joint] is null
+  static Uint8List getCalibration({int? joint}) {
+    return Uint8List.fromList([BleCommand.getCalibration.value, if (joint != null) joint]);
+  }
+  
+  static const int teachFlagStream = 1 << 0;
+  
+  // CMD 0x1E: Switch torque off and record a program by hand; 0 picks the
+  // device defaults for rate (Hz) and tolerance (steps)
+  static Uint8List teachStart(String name, {int rateHz = 0, int tolerance = 0, bool stream = false}) {
+    final nameBytes = ascii.encode(name);
+    assert(nameBytes.isNotEmpty && nameBytes.length <= 15, 'name must be 1-15 ASCII characters');
+    assert(rateHz == 0 || (rateHz >= 20 && rateHz <= 50));
+    assert(tolerance >= 0 && tolerance <= 255);
+    
+    final buffer = Uint8List(4 + nameBytes.length);
+    buffer[0] = BleCommand.teachStart.value;
+    buffer[1] = rateHz;
+    buffer[2] = tolerance;
+    buffer[3] = stream ? teachFlagStream : 0;
+    buffer.setRange(4, buffer.length, nameBytes);
+    return buffer;
+  }
+  
+  // CMD 0x1F: End the recording, storing the program or discarding it
+  static Uint8List teachStop({bool save = true}) {
+    return Uint8List.fromList([BleCommand.teachStop.value, save ? 1 : 0]);
+  }
+
 }
@@ -0,0 +1,35 @@
+import 'dart:typed_data';
+
+/// Tool pose in the arm's base frame, see main/kinematics.h
+///
+/// x forward, z up from the base plate, in millimetres; [pitch] is the tool
+/// above the horizontal and [roll] its rotation, in radians.
+class CartesianPose {
+  static const int tag = 0x85;
+  static const int size = 13;
+
+  final double x;
+  final double y;
+  final double z;
+  final double pitch;
+  final double roll;
+
+  const CartesianPose(this.x, this.y, this.z, {this.pitch = 0, this.roll = 0});
+
+  /// Pose notification; null when malformed or a measured joint did not answer
+  static CartesianPose? parse(List<int> data) {
+    if (data.length < size || data[0] != tag || data[2] == 0) return null;
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    return CartesianPose(
+      bytes.getInt16(3, Endian.little) / 10.0,
+      bytes.getInt16(5, Endian.little) / 10.0,
+      bytes.getInt16(7, Endian.little) / 10.0,
+      pitch: bytes.getInt16(9, Endian.little) / 1000.0,
+      roll: bytes.getInt16(11, Endian.little) / 1000.0,
+    );
+  }
+
+  @override
+  String toString() => 'CartesianPose(${x.toStringAsFixed(1)}, ${y.toStringAsFixed(1)}, '
+      '${z.toStringAsFixed(1)} mm, pitch ${pitch.toStringAsFixed(3)}, roll ${roll.toStringAsFixed(3)})';
+}
@@ -0,0 +1,87 @@
+import 'dart:typed_data';
+
+/// Per-joint part of an extended status record
+class JointStatus {
+  final int position;
+  final int speed;
+  final int load;
+  final int voltage;        // 0.1 V units
+  final int temperature;    // Degrees C
+  final bool moving;
+  final int errorFlags;     // Servo status byte
+  final int readErrors;     // Reads missed since boot
+
+  const JointStatus({
+    required this.position,
+    required this.speed,
+    required this.load,
+    required this.voltage,
+    required this.temperature,
+    required this.moving,
+    required this.errorFlags,
+    required this.readErrors,
+  });
+}
+
+/// Extended status notification (tag 0x81) sent in reply to getExtendedStatus
+class ExtendedStatus {
+  static const int tag = 0x81;
+  static const int supportedVersion = 2;
+  static const int numJoints = 6;
+  static const int headerSize = 9;
+  static const int jointSize = 12;
+  static const int noSlot = 0xFF;
+  static const int feedOffset = headerSize + numJoints * jointSize;
+
+  final int version;
+  final int validMask;      // Bit i set when joint i answered
+  final int playerState;    // 0 idle, 1 running, 2 paused
+  final int currentSlot;    // noSlot when nothing is playing
+  final int timestampMs;
+  final List<JointStatus> joints;
+  final int feedPercent;    // Feed override, 100 before version 2
+
+  ExtendedStatus({
+    required this.version,
+    required this.validMask,
+    required this.playerState,
+    required this.currentSlot,
+    required this.timestampMs,
+    required this.joints,
+    this.feedPercent = 100,
+  });
+
+  bool isValid(int joint) => (validMask & (1 << joint)) != 0;
+
+  /// Parse a tag 0x81 notification; null if it is short or a newer version
+  static ExtendedStatus? parse(List<int> data) {
+    if (data.length < headerSize + numJoints * jointSize || data[0] != tag) return null;
+    if (data[1] > supportedVersion) return null;
+
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    final joints = <JointStatus>[];
+    for (int j = 0; j < numJoints; j++) {
+      final p = headerSize + j * jointSize;
+      joints.add(JointStatus(
+        position: bytes.getUint16(p, Endian.little),
+        speed: bytes.getInt16(p + 2, Endian.little),
+        load: bytes.getInt16(p + 4, Endian.little),
+        voltage: data[p + 6],
+        temperature: data[p + 7],
+        moving: data[p + 8] != 0,
+        errorFlags: data[p + 9],
+        readErrors: bytes.getUint16(p + 10, Endian.little),
+      ));
+    }
+
+    return ExtendedStatus(
+      version: data[1],
+      validMask: data[2],
+      playerState: data[3],
+      currentSlot: data[4],
+      timestampMs: bytes.getUint32(5, Endian.little),
+      joints: joints,
+      feedPercent: data[1] >= 2 && data.length > feedOffset ? data[feedOffset] : 100,
+    );
+  }
+}
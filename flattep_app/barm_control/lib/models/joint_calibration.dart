@@ -0,0 +1,74 @@
+import 'dart:typed_data';
+
+/// Per-joint calibration record, see main/joint_calib.h
+///
+/// Positions the app sends and receives are joint steps: 2048 is the
+/// calibrated zero. The device maps them to servo steps with [zeroOffset]
+/// and [sign] and keeps them within [min]..[max].
+class JointCalibration {
+  static const int tag = 0x86;
+  static const int recordSize = 13;
+
+  final int joint;
+  final int zeroOffset;    // Servo step of the joint zero minus 2048
+  final int sign;          // 1, or -1 when the servo turns against the joint
+  final int min;           // Soft limits in joint steps
+  final int max;
+  final int vmax;          // steps/s, 0 = servo maximum
+  final int amax;          // steps/s^2, 0 = servo maximum
+  final int stepsPerRev;   // 0 = 4096
+
+  const JointCalibration(this.joint, {
+    this.zeroOffset = 0,
+    this.sign = 1,
+    this.min = 0,
+    this.max = 4095,
+    this.vmax = 0,
+    this.amax = 0,
+    this.stepsPerRev = 0,
+  });
+
+  /// Calibration notification; null when malformed
+  static JointCalibration? parse(List<int> data) {
+    if (data.length < 2 + recordSize || data[0] != tag) return null;
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    return JointCalibration(
+      data[1],
+      zeroOffset: bytes.getInt16(2, Endian.little),
+      sign: bytes.getInt8(4),
+      min: bytes.getUint16(5, Endian.little),
+      max: bytes.getUint16(7, Endian.little),
+      vmax: bytes.getUint16(9, Endian.little),
+      amax: bytes.getUint16(11, Endian.little),
+      stepsPerRev: bytes.getUint16(13, Endian.little),
+    );
+  }
+
+  /// The same calibration with the zero moved to [position], a reading in
+  /// the current joint steps
+  JointCalibration withZeroAt(int position) => JointCalibration(
+        joint,
+        zeroOffset: zeroOffset + sign * (position - 2048),
+        sign: sign,
+        min: min,
+        max: max,
+        vmax: vmax,
+        amax: amax,
+        stepsPerRev: stepsPerRev,
+      );
+
+  /// Record as sent after the command and joint bytes
+  void write(ByteData buffer, int offset) {
+    buffer.setInt16(offset, zeroOffset, Endian.little);
+    buffer.setInt8(offset + 2, sign);
+    buffer.setUint16(offset + 3, min, Endian.little);
+    buffer.setUint16(offset + 5, max, Endian.little);
+    buffer.setUint16(offset + 7, vmax, Endian.little);
+    buffer.setUint16(offset + 9, amax, Endian.little);
+    buffer.setUint16(offset + 11, stepsPerRev, Endian.little);
+  }
+
+  @override
+  String toString() => 'JointCalibration($joint: offset $zeroOffset, sign $sign, '
+      'limits $min..$max, vmax $vmax, amax $amax, $stepsPerRev steps/rev)';
+}
@@ -0,0 +1,40 @@
+import 'dart:typed_data';
+
+/// Move-and-wait completion (tag 0x84), see main/motion_monitor.h
+class MotionDone {
+  static const int tag = 0x84;
+  static const int size = 18;
+  static const int numJoints = 6;
+
+  static const int arrived = 0x00;
+  static const int timeout = 0x01;
+  static const int preempted = 0x02;    // A newer move or a direct command replaced it
+
+  final int moveId;
+  final int result;
+  final int arrivedMask;    // Bit i set when joint i is within tolerance and stopped
+  final int elapsedMs;
+  final List<int> positions;    // Last measured positions, 0 if never read
+
+  const MotionDone({
+    required this.moveId,
+    required this.result,
+    required this.arrivedMask,
+    required this.elapsedMs,
+    required this.positions,
+  });
+
+  bool get hasArrived => result == arrived;
+
+  static MotionDone? parse(List<int> data) {
+    if (data.length < size || data[0] != tag) return null;
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    return MotionDone(
+      moveId: data[1],
+      result: data[2],
+      arrivedMask: data[3],
+      elapsedMs: bytes.getUint16(4, Endian.little),
+      positions: List.generate(numJoints, (i) => bytes.getUint16(6 + i * 2, Endian.little)),
+    );
+  }
+}
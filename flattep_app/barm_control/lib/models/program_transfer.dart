@@ -0,0 +1,93 @@
+import 'dart:typed_data';
+
+/// Constants and notifications of the program transfer protocol (main/program_xfer.h)
+class ProgramTransfer {
+  static const int tagAck = 0x82;
+  static const int tagData = 0x83;
+  static const int chunkHeaderSize = 6;   // tag/cmd, seq, offset u32
+
+  static const int dirUpload = 0;
+  static const int dirDownload = 1;
+  static const int flagScript = 0x10;   // Or'd into the direction for sequence scripts
+
+  static const int statusOk = 0x00;
+  static const int statusResend = 0x01;
+  static const int statusDone = 0x02;
+  static const int statusCrcError = 0x03;
+  static const int statusBadData = 0x04;
+  static const int statusNotFound = 0x05;
+  static const int statusNoSpace = 0x06;
+  static const int statusIdle = 0x07;
+  static const int statusError = 0x08;
+
+  static final List<int> _crcTable = List<int>.generate(256, (n) {
+    int c = n;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    return c;
+  });
+
+  /// CRC-32 (IEEE), the same as the device's esp_rom_crc32_le(0, ...)
+  static int crc32(Uint8List data) {
+    int crc = 0xFFFFFFFF;
+    for (final byte in data) {
+      crc = _crcTable[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFF;
+  }
+}
+
+/// Transfer ack notification (tag 0x82)
+class XferAck {
+  static const int size = 17;
+
+  final int status;
+  final int dir;
+  final int seq;          // Upload: next expected sequence number
+  final int window;       // Chunks allowed in flight
+  final int offset;
+  final int totalLength;
+  final int crc32;
+
+  XferAck({
+    required this.status,
+    required this.dir,
+    required this.seq,
+    required this.window,
+    required this.offset,
+    required this.totalLength,
+    required this.crc32,
+  });
+
+  static XferAck? parse(List<int> data) {
+    if (data.length < size || data[0] != ProgramTransfer.tagAck) return null;
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    return XferAck(
+      status: bytes.getUint8(1),
+      dir: bytes.getUint8(2),
+      seq: bytes.getUint8(3),
+      window: bytes.getUint8(4),
+      offset: bytes.getUint32(5, Endian.little),
+      totalLength: bytes.getUint32(9, Endian.little),
+      crc32: bytes.getUint32(13, Endian.little),
+    );
+  }
+}
+
+/// Download chunk notification (tag 0x83)
+class XferChunk {
+  final int seq;
+  final int offset;
+  final Uint8List data;
+
+  XferChunk(this.seq, this.offset, this.data);
+
+  static XferChunk? parse(List<int> data) {
+    if (data.length <= ProgramTransfer.chunkHeaderSize || data[0] != ProgramTransfer.tagData) return null;
+    final bytes = Uint8List.fromList(data);
+    final view = ByteData.sublistView(bytes);
+    return XferChunk(view.getUint8(1), view.getUint32(2, Endian.little),
+                     bytes.sublist(ProgramTransfer.chunkHeaderSize));
+  }
+}
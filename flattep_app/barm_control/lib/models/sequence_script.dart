@@ -0,0 +1,162 @@
+import 'dart:convert';
+import 'dart:typed_data';
+
+import 'arm_position.dart';
+
+/// Comparison used by [SequenceScript.jumpIf] and [SequenceScript.waitFor]
+enum ScriptCompare { eq, ne, lt, gt, le, ge }
+
+/// Servo reading used by [SequenceScript.waitFor] and [SequenceScript.read]
+enum ScriptSensor { position, speed, load }
+
+/// Assembler for the firmware's sequence scripts (main/seq_vm.h)
+///
+/// Jumps and calls name a [label]; addresses are filled in by [build].
+/// Variables are 0-15 and hold 32-bit integers on the device.
+class SequenceScript {
+  static const int magic = 0x5153;
+  static const int version = 1;
+  static const int numVars = 16;
+  static const int varNone = 0xFF;
+
+  static const int opEnd = 0x00;
+  static const int opMoveSlot = 0x01;
+  static const int opMove = 0x02;
+  static const int opDwell = 0x03;
+  static const int opSpeed = 0x04;
+  static const int opRepeat = 0x05;
+  static const int opNext = 0x06;
+  static const int opJump = 0x07;
+  static const int opJcmp = 0x08;
+  static const int opSet = 0x09;
+  static const int opAdd = 0x0A;
+  static const int opCall = 0x0B;
+  static const int opCallProg = 0x0C;
+  static const int opWait = 0x0D;
+  static const int opRead = 0x0E;
+
+  final List<int> _code = [magic & 0xFF, magic >> 8, version, 0];
+  final Map<String, int> _labels = {};
+  final Map<int, String> _fixups = {};   // Code offset of an address -> label
+
+  void _u16(int value) {
+    _code.add(value & 0xFF);
+    _code.add((value >> 8) & 0xFF);
+  }
+
+  void _address(String label) {
+    _fixups[_code.length] = label;
+    _u16(0);
+  }
+
+  int _source(ScriptSensor sensor, int joint) {
+    assert(joint >= 0 && joint < ArmPosition.numJoints);
+    return sensor.index << 4 | joint;
+  }
+
+  /// Mark the next instruction as a jump or call target
+  void label(String name) {
+    assert(!_labels.containsKey(name), 'label $name defined twice');
+    _labels[name] = _code.length;
+  }
+
+  void end() => _code.add(opEnd);
+
+  /// Move to a stored slot with its own timing and delay
+  void moveSlot(int slot) => _code..add(opMoveSlot)..add(slot);
+
+  /// Move to [position] in [timeMs] (0 = as fast as the limits allow)
+  void move(ArmPosition position, {int timeMs = 0}) {
+    _code.add(opMove);
+    for (final p in position.jointPositions) {
+      _u16(p);
+    }
+    _u16(timeMs);
+  }
+
+  void dwell(int ms) {
+    _code.add(opDwell);
+    _u16(ms);
+  }
+
+  /// Run the following moves at [percent] (1-100) of their speed
+  void speed(int percent) {
+    assert(percent >= 1 && percent <= 100);
+    _code..add(opSpeed)..add(percent);
+  }
+
+  /// Repeat up to the matching [next]; 0 repeats forever
+  void repeat(int count) {
+    _code.add(opRepeat);
+    _u16(count);
+  }
+
+  void next() => _code.add(opNext);
+
+  void jump(String label) {
+    _code.add(opJump);
+    _address(label);
+  }
+
+  /// Jump to [label] when variable [variable] compares true against [value]
+  void jumpIf(int variable, ScriptCompare compare, int value, String label) {
+    assert(variable >= 0 && variable < numVars);
+    _code..add(opJcmp)..add(variable)..add(compare.index);
+    _u16(value);
+    _address(label);
+  }
+
+  void set(int variable, int value) {
+    assert(variable >= 0 && variable < numVars);
+    _code..add(opSet)..add(variable);
+    _u16(value);
+  }
+
+  void add(int variable, int value) {
+    assert(variable >= 0 && variable < numVars);
+    _code..add(opAdd)..add(variable);
+    _u16(value);
+  }
+
+  /// Call a subroutine at [label]; it returns with [end]
+  void call(String label) {
+    _code.add(opCall);
+    _address(label);
+  }
+
+  /// Run another stored script, then carry on here
+  void callScript(String name) {
+    final nameBytes = ascii.encode(name);
+    assert(nameBytes.isNotEmpty && nameBytes.length <= 15, 'name must be 1-15 ASCII characters');
+    _code..add(opCallProg)..add(nameBytes.length)..addAll(nameBytes);
+  }
+
+  /// Let the arm settle, then wait until a reading of [joint] compares true against [value]
+  ///
+  /// [resultVar] is set to 1 when it did, 0 when [timeoutMs] (0 = never) ran out.
+  void waitFor(ScriptSensor sensor, int joint, ScriptCompare compare, int value,
+               {int timeoutMs = 0, int resultVar = varNone}) {
+    _code..add(opWait)..add(_source(sensor, joint))..add(compare.index);
+    _u16(value);
+    _u16(timeoutMs);
+    _code.add(resultVar);
+  }
+
+  /// Let the arm settle, then store a reading of [joint] in [variable]
+  void read(ScriptSensor sensor, int joint, int variable) {
+    assert(variable >= 0 && variable < numVars);
+    _code..add(opRead)..add(_source(sensor, joint))..add(variable);
+  }
+
+  /// The script as it is uploaded; throws if a label is missing
+  Uint8List build() {
+    final out = Uint8List.fromList(_code);
+    _fixups.forEach((offset, label) {
+      final address = _labels[label];
+      if (address == null) throw StateError('Undefined label $label');
+      out[offset] = address & 0xFF;
+      out[offset + 1] = address >> 8;
+    });
+    return out;
+  }
+}
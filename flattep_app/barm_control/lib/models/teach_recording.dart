@@ -0,0 +1,69 @@
+import 'dart:typed_data';
+
+/// Stored point of a teach-in recording (tag 0x87), see main/teach_recorder.h
+class TeachPoint {
+  static const int tag = 0x87;
+  static const int size = 19;
+  static const int numJoints = 6;
+
+  final int index;            // Point number in the program
+  final List<int> positions;
+  final int durationMs;       // Travel time from the previous point
+  final int dwellMs;          // Rest after arriving
+
+  const TeachPoint({
+    required this.index,
+    required this.positions,
+    required this.durationMs,
+    required this.dwellMs,
+  });
+
+  static TeachPoint? parse(List<int> data) {
+    if (data.length < size || data[0] != tag) return null;
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    return TeachPoint(
+      index: bytes.getUint16(1, Endian.little),
+      positions: List.generate(numJoints, (i) => bytes.getUint16(3 + i * 2, Endian.little)),
+      durationMs: bytes.getUint16(15, Endian.little),
+      dwellMs: bytes.getUint16(17, Endian.little),
+    );
+  }
+}
+
+/// End of a teach-in recording (tag 0x88)
+class TeachDone {
+  static const int tag = 0x88;
+  static const int size = 14;
+
+  static const int saved = 0x00;
+  static const int discarded = 0x01;
+  static const int failed = 0x02;     // Nothing recorded, or the store refused a write
+
+  final int result;
+  final int points;           // Stored in the program
+  final int samples;          // Read from the servos
+  final int missed;           // Ticks lost to incomplete reads
+  final int durationMs;
+
+  const TeachDone({
+    required this.result,
+    required this.points,
+    required this.samples,
+    required this.missed,
+    required this.durationMs,
+  });
+
+  bool get isSaved => result == saved;
+
+  static TeachDone? parse(List<int> data) {
+    if (data.length < size || data[0] != tag) return null;
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    return TeachDone(
+      result: data[1],
+      points: bytes.getUint16(2, Endian.little),
+      samples: bytes.getUint32(4, Endian.little),
+      missed: bytes.getUint16(8, Endian.little),
+      durationMs: bytes.getUint32(10, Endian.little),
+    );
+  }
+}
@@ -0,0 +1,128 @@
+import 'dart:typed_data';
+
+/// Field selection bits for telemetry subscriptions (match STS_FB_* in firmware)
+class TelemetryFields {
+  static const int position = 1 << 0;
+  static const int speed = 1 << 1;
+  static const int load = 1 << 2;
+  static const int voltage = 1 << 3;
+  static const int temperature = 1 << 4;
+  static const int moving = 1 << 5;
+  static const int error = 1 << 6;
+  static const int all = 0x7F;
+  static const int queue = 1 << 7;    // Motion queue level, not a servo field
+}
+
+/// One timestamped snapshot of all joints from a telemetry notification
+class TelemetrySample {
+  static const int numJoints = 6;
+
+  final int timestampMs;      // Device uptime in ms
+  final int validMask;        // Bit i set when joint i answered
+  final int fields;           // TelemetryFields present in this sample
+  final List<int> positions;
+  final List<int> speeds;
+  final List<int> loads;
+  final List<int> voltages;   // 0.1 V units
+  final List<int> temperatures;
+  final List<bool> moving;
+  final List<int> errors;     // Servo status byte per joint
+  final int queueDepth;       // Queued segments not reached yet (TelemetryFields.queue)
+  final int queueFree;        // Segments the queue can still take
+
+  TelemetrySample({
+    required this.timestampMs,
+    required this.validMask,
+    required this.fields,
+    required this.positions,
+    required this.speeds,
+    required this.loads,
+    required this.voltages,
+    required this.temperatures,
+    required this.moving,
+    required this.errors,
+    this.queueDepth = 0,
+    this.queueFree = 0,
+  });
+
+  bool isValid(int joint) => (validMask & (1 << joint)) != 0;
+
+  /// Bytes per joint for a field selection
+  static int jointBytes(int fields) {
+    int bytes = 0;
+    if (fields & TelemetryFields.position != 0) bytes += 2;
+    if (fields & TelemetryFields.speed != 0) bytes += 2;
+    if (fields & TelemetryFields.load != 0) bytes += 2;
+    if (fields & TelemetryFields.voltage != 0) bytes += 1;
+    if (fields & TelemetryFields.temperature != 0) bytes += 1;
+    if (fields & TelemetryFields.moving != 0) bytes += 1;
+    if (fields & TelemetryFields.error != 0) bytes += 1;
+    return bytes;
+  }
+
+  /// Parse a telemetry notification: tag, fields, count, sequence, then samples
+  static List<TelemetrySample> parseNotification(List<int> data) {
+    final samples = <TelemetrySample>[];
+    if (data.length < 4) return samples;
+
+    final bytes = ByteData.sublistView(Uint8List.fromList(data));
+    final fields = data[1];
+    final count = data[2];
+    final hasQueue = fields & TelemetryFields.queue != 0;
+    final sampleSize = 5 + (hasQueue ? 2 : 0) + numJoints * jointBytes(fields);
+    int offset = 4;
+
+    for (int s = 0; s < count && offset + sampleSize <= data.length; s++) {
+      final timestamp = bytes.getUint32(offset, Endian.little);
+      final validMask = data[offset + 4];
+      int p = offset + 5;
+      final queueDepth = hasQueue ? data[p] : 0;
+      final queueFree = hasQueue ? data[p + 1] : 0;
+      if (hasQueue) p += 2;
+
+      final positions = List<int>.filled(numJoints, 0);
+      final speeds = List<int>.filled(numJoints, 0);
+      final loads = List<int>.filled(numJoints, 0);
+      final voltages = List<int>.filled(numJoints, 0);
+      final temperatures = List<int>.filled(numJoints, 0);
+      final moving = List<bool>.filled(numJoints, false);
+      final errors = List<int>.filled(numJoints, 0);
+
+      for (int j = 0; j < numJoints; j++) {
+        if (fields & TelemetryFields.position != 0) {
+          positions[j] = bytes.getUint16(p, Endian.little);
+          p += 2;
+        }
+        if (fields & TelemetryFields.speed != 0) {
+          speeds[j] = bytes.getInt16(p, Endian.little);
+          p += 2;
+        }
+        if (fields & TelemetryFields.load != 0) {
+          loads[j] = bytes.getInt16(p, Endian.little);
+          p += 2;
+        }
+        if (fields & TelemetryFields.voltage != 0) voltages[j] = data[p++];
+        if (fields & TelemetryFields.temperature != 0) temperatures[j] = data[p++];
+        if (fields & TelemetryFields.moving != 0) moving[j] = data[p++] != 0;
+        if (fields & TelemetryFields.error != 0) errors[j] = data[p++];
+      }
+
+      samples.add(TelemetrySample(
+        timestampMs: timestamp,
+        validMask: validMask,
+        fields: fields,
+        positions: positions,
+        speeds: speeds,
+        loads: loads,
+        voltages: voltages,
+        temperatures: temperatures,
+        moving: moving,
+        errors: errors,
+        queueDepth: queueDepth,
+        queueFree: queueFree,
+      ));
+      offset += sampleSize;
+    }
+    return samples;
+  }
+}
@@ -0,0 +1,142 @@
+import 'dart:typed_data';
+
+import 'arm_position.dart';
+
+/// One waypoint with shared timing, as sent to the device
+class Waypoint {
+  final ArmPosition position;
+  final int timeMs;
+  final int speed;
+  final int delayMs;
+
+  const Waypoint(this.position, {this.timeMs = 1000, this.speed = 1000, this.delayMs = 0});
+}
+
+/// Encoder for the firmware's compact waypoint format (main/waypoint_codec.h)
+///
+/// Each waypoint is a keyframe with 12-bit packed positions or a zigzag
+/// varint delta against the previous one, whichever is shorter. Timing is
+/// only repeated when it changes.
+class WaypointCodec {
+  static const int ctrlTiming = 0x40;
+  static const int ctrlKey = 0x80;
+  static const int maxDelayMs = 0x7FFFFFFF;
+
+  static void _putVarint(BytesBuilder out, int value) {
+    while (value >= 0x80) {
+      out.addByte((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    out.addByte(value);
+  }
+
+  static Uint8List _timing(Waypoint point) {
+    assert(point.delayMs >= 0 && point.delayMs <= maxDelayMs);
+    final out = BytesBuilder();
+    _putVarint(out, point.delayMs << 1); // Shared timing for every joint
+    _putVarint(out, point.timeMs);
+    _putVarint(out, point.speed);
+    return out.toBytes();
+  }
+
+  /// Encode one waypoint against [prev] (null for a keyframe)
+  static Uint8List encode(Waypoint? prev, Waypoint point) {
+    final timing = _timing(point);
+
+    final delta = BytesBuilder();
+    int ctrl = 0;
+    int deltaTotal = 1 << 30;
+    if (prev != null) {
+      for (int j = 0; j < ArmPosition.numJoints; j++) {
+        final d = point.position.jointPositions[j] - prev.position.jointPositions[j];
+        if (d != 0) {
+          ctrl |= 1 << j;
+          _putVarint(delta, d >= 0 ? d << 1 : ((-d) << 1) - 1);
+        }
+      }
+      if (prev.timeMs != point.timeMs || prev.speed != point.speed || prev.delayMs != point.delayMs) {
+        ctrl |= ctrlTiming;
+      }
+      deltaTotal = 1 + delta.length + ((ctrl & ctrlTiming) != 0 ? timing.length : 0);
+    }
+
+    final out = BytesBuilder();
+    if (deltaTotal <= 1 + 9 + timing.length) {
+      out.addByte(ctrl);
+      out.add(delta.toBytes());
+    } else {
+      ctrl = ctrlKey | ctrlTiming;
+      out.addByte(ctrl);
+      final p = point.position.jointPositions;
+      for (int j = 0; j < ArmPosition.numJoints; j += 2) {
+        out.addByte(p[j] & 0xFF);
+        out.addByte((p[j] >> 8) | ((p[j + 1] & 0x0F) << 4));
+        out.addByte(p[j + 1] >> 4);
+      }
+    }
+    if ((ctrl & ctrlTiming) != 0) {
+      out.add(timing);
+    }
+    return out.toBytes();
+  }
+
+  static int _getVarint(Uint8List data, List<int> pos) {
+    int result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      if (pos[0] >= data.length) throw const FormatException('Truncated varint');
+      final byte = data[pos[0]++];
+      result |= (byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return result;
+    }
+    throw const FormatException('Varint too long');
+  }
+
+  /// Decode a chain written by the device; per-joint timing is reduced to the slowest joint
+  static List<Waypoint> decodeList(Uint8List data) {
+    final points = <Waypoint>[];
+    final positions = List<int>.filled(ArmPosition.numJoints, 0);
+    int timeMs = 0, speed = 0, delayMs = 0;
+    final pos = [0];
+    while (pos[0] < data.length) {
+      final ctrl = data[pos[0]++];
+      if ((ctrl & ctrlKey) != 0) {
+        if (pos[0] + 9 > data.length) throw const FormatException('Truncated keyframe');
+        for (int j = 0; j < ArmPosition.numJoints; j += 2) {
+          final p = pos[0];
+          positions[j] = data[p] | ((data[p + 1] & 0x0F) << 8);
+          positions[j + 1] = (data[p + 1] >> 4) | (data[p + 2] << 4);
+          pos[0] += 3;
+        }
+      } else {
+        for (int j = 0; j < ArmPosition.numJoints; j++) {
+          if ((ctrl & (1 << j)) == 0) continue;
+          final zz = _getVarint(data, pos);
+          positions[j] += (zz & 1) != 0 ? -((zz + 1) >> 1) : zz >> 1;
+        }
+      }
+      if ((ctrl & ctrlTiming) != 0) {
+        final head = _getVarint(data, pos);
+        delayMs = head >> 1;
+        final joints = (head & 1) != 0 ? ArmPosition.numJoints : 1;
+        timeMs = 0;
+        for (int j = 0; j < joints; j++) {
+          final t = _getVarint(data, pos);
+          final s = _getVarint(data, pos);
+          if (t > timeMs) timeMs = t;
+          if (j == 0) speed = s;
+        }
+      }
+      points.add(Waypoint(ArmPosition(List.of(positions)), timeMs: timeMs, speed: speed, delayMs: delayMs));
+    }
+    return points;
+  }
+
+  /// Encode a chain, each waypoint against the one before
+  static Uint8List encodeList(List<Waypoint> points) {
+    final out = BytesBuilder();
+    for (int i = 0; i < points.length; i++) {
+      out.add(encode(i > 0 ? points[i - 1] : null, points[i]));
+    }
+    return out.toBytes();
+  }
+}
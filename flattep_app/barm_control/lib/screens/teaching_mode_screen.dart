@@ -5,6 +5,7 @@ import 'package:shared_preferences/shared_preferences.dart';
 import 'package:uuid/uuid.dart';
 import '../services/arm_ble_service.dart';
 import '../models/teaching_position.dart';
+import '../models/teach_recording.dart';
 
 class TeachingModeScreen extends StatefulWidget {
   const TeachingModeScreen({super.key});
@@ -22,12 +23,25 @@ class _TeachingModeScreenState extends State<TeachingModeScreen> {
   bool _loopPlayback = false;
   final _uuid = const Uuid();
   
+  // Device-side recording of a continuous motion
+  bool _isRecording = false;
+  String? _recordingName;
+  String? _lastRecording;
+  int _recordedPoints = 0;
+  StreamSubscription<TeachPoint>? _teachSubscription;
+  
   @override
   void initState() {
     super.initState();
     _loadSessions();
   }
   
+  @override
+  void dispose() {
+    _teachSubscription?.cancel();
+    super.dispose();
+  }
+  
   Future<void> _loadSessions() async {
     final prefs = await SharedPreferences.getInstance();
     final jsonString = prefs.getString('teaching_sessions');
@@ -206,6 +220,101 @@ class _TeachingModeScreenState extends State<TeachingModeScreen> {
     }
   }
   
+  /// Record a continuous motion on the device: torque goes off, the arm is
+  /// sampled at 50 Hz and the simplified path is stored as a program
+  Future<void> _startRecording() async {
+    final bleService = Provider.of<ArmBleService>(context, listen: false);
+    final TextEditingController nameController = TextEditingController(
+      text: 'teach${DateTime.now().millisecondsSinceEpoch % 10000}',
+    );
+    
+    final name = await showDialog<String>(
+      context: context,
+      builder: (context) => AlertDialog(
+        title: const Text('Record Motion'),
+        content: TextField(
+          controller: nameController,
+          decoration: const InputDecoration(
+            labelText: 'Program Name',
+            hintText: 'Up to 15 characters',
+          ),
+          maxLength: 15,
+          autofocus: true,
+        ),
+        actions: [
+          TextButton(
+            onPressed: () => Navigator.pop(context),
+            child: const Text('Cancel'),
+          ),
+          ElevatedButton(
+            onPressed: () => Navigator.pop(context, nameController.text),
+            child: const Text('Record'),
+          ),
+        ],
+      ),
+    );
+    if (name == null || name.isEmpty) return;
+    
+    _teachSubscription?.cancel();
+    _teachSubscription = bleService.teachPointStream.listen((point) {
+      setState(() {
+        _recordedPoints = point.index + 1;
+      });
+    });
+    
+    final success = await bleService.startRecording(name, stream: true);
+    if (!success) {
+      _teachSubscription?.cancel();
+      _teachSubscription = null;
+      ScaffoldMessenger.of(context).showSnackBar(
+        const SnackBar(content: Text('Failed to start recording')),
+      );
+      return;
+    }
+    setState(() {
+      _isRecording = true;
+      _recordingName = name;
+      _recordedPoints = 0;
+      _torqueEnabled = false;
+    });
+  }
+  
+  Future<void> _stopRecording({bool save = true}) async {
+    final bleService = Provider.of<ArmBleService>(context, listen: false);
+    final done = await bleService.stopRecording(save: save);
+    _teachSubscription?.cancel();
+    _teachSubscription = null;
+    
+    setState(() {
+      _isRecording = false;
+      _torqueEnabled = true;    // The device holds the arm where it was left
+      if (done != null && done.isSaved) _lastRecording = _recordingName;
+    });
+    
+    final String message;
+    if (done == null) {
+      message = 'No answer from the device';
+    } else if (done.isSaved) {
+      message = 'Saved $_recordingName: ${done.points} points from ${done.samples} samples '
+          'in ${(done.durationMs / 1000).toStringAsFixed(1)} s';
+    } else if (done.result == TeachDone.discarded) {
+      message = 'Recording discarded';
+    } else {
+      message = 'Recording failed';
+    }
+    ScaffoldMessenger.of(context).showSnackBar(SnackBar(content: Text(message)));
+  }
+  
+  Future<void> _playRecording() async {
+    final bleService = Provider.of<ArmBleService>(context, listen: false);
+    final success = await bleService.playProgram(_lastRecording!, loop: _loopPlayback);
+    if (!success) {
+      ScaffoldMessenger.of(context).showSnackBar(
+        const SnackBar(content: Text('Failed to play recording')),
+      );
+    }
+  }
+  
   Future<void> _saveCurrentPosition() async {
     final bleService = Provider.of<ArmBleService>(context, listen: false);
     
@@ -565,7 +674,7 @@ class _TeachingModeScreenState extends State<TeachingModeScreen> {
                       ),
                       Switch(
                         value: _torqueEnabled,
-                        onChanged: (_) => _toggleTorque(),
+                        onChanged: _isRecording ? null : (_) => _toggleTorque(),
                       ),
                     ],
                   ),
@@ -583,13 +692,64 @@ class _TeachingModeScreenState extends State<TeachingModeScreen> {
                   
                   // Save Position Button
                   ElevatedButton.icon(
-                    onPressed: _torqueEnabled ? null : _saveCurrentPosition,
+                    onPressed: _torqueEnabled || _isRecording ? null : _saveCurrentPosition,
                     icon: const Icon(Icons.add_circle),
                     label: const Text('Save Current Position'),
                     style: ElevatedButton.styleFrom(
                       minimumSize: const Size(double.infinity, 48),
                     ),
                   ),
+                  const SizedBox(height: 8),
+                  
+                  // Continuous recording on the device
+                  if (_isRecording)
+                    Row(
+                      children: [
+                        Expanded(
+                          child: ElevatedButton.icon(
+                            onPressed: () => _stopRecording(),
+                            icon: const Icon(Icons.stop),
+                            label: Text('Stop Recording ($_recordedPoints points)'),
+                            style: ElevatedButton.styleFrom(
+                              backgroundColor: Colors.red,
+                              minimumSize: const Size(0, 48),
+                            ),
+                          ),
+                        ),
+                        const SizedBox(width: 8),
+                        IconButton(
+                          icon: const Icon(Icons.delete),
+                          onPressed: () => _stopRecording(save: false),
+                          tooltip: 'Discard recording',
+                        ),
+                      ],
+                    )
+                  else
+                    Row(
+                      children: [
+                        Expanded(
+                          child: ElevatedButton.icon(
+                            onPressed: _isPlaying ? null : _startRecording,
+                            icon: const Icon(Icons.fiber_manual_record),
+                            label: const Text('Record Motion'),
+                            style: ElevatedButton.styleFrom(
+                              minimumSize: const Size(0, 48),
+                            ),
+                          ),
+                        ),
+                        if (_lastRecording != null) ...[
+                          const SizedBox(width: 8),
+                          ElevatedButton.icon(
+                            onPressed: _isPlaying ? null : _playRecording,
+                            icon: const Icon(Icons.play_arrow),
+                            label: Text(_lastRecording!),
+                            style: ElevatedButton.styleFrom(
+                              minimumSize: const Size(0, 48),
+                            ),
+                          ),
+                        ],
+                      ],
+                    ),
                 ],
               ),
             ),
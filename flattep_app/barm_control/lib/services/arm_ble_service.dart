@@ -4,6 +4,15 @@ import 'package:flutter_blue_plus/flutter_blue_plus.dart';
 import 'package:permission_handler/permission_handler.dart';
 import '../models/arm_position.dart';
 import '../models/ble_commands.dart';
+import '../models/telemetry_sample.dart';
+import '../models/extended_status.dart';
+import '../models/waypoint_codec.dart';
+import '../models/program_transfer.dart';
+import '../models/motion_done.dart';
+import '../models/sequence_script.dart';
+import '../models/cartesian_pose.dart';
+import '../models/joint_calibration.dart';
+import '../models/teach_recording.dart';
 
 class ArmBleService extends ChangeNotifier {
   static const String targetDeviceName = "ARM100_ESP32";
@@ -11,6 +20,10 @@ class ArmBleService extends ChangeNotifier {
   static const String rxCharacteristicUuid = "12345678-1234-1234-1234-123456789abd";
   static const String txCharacteristicUuid = "12345678-1234-1234-1234-123456789abe";
   
+  // Notifications starting with a byte >= 0x80 are tagged; others are status
+  static const int notifyTagTelemetry = 0x80;
+  static const int notifyTagExtStatus = 0x81;
+  
   BluetoothDevice? _device;
   BluetoothCharacteristic? _rxCharacteristic;
   BluetoothCharacteristic? _txCharacteristic;
@@ -23,12 +36,27 @@ class ArmBleService extends ChangeNotifier {
   bool _isConnected = false;
   String _statusMessage = "Not connected";
   ArmPosition _currentPosition = ArmPosition.center();
+  final StreamController<List<TelemetrySample>> _telemetryController =
+      StreamController<List<TelemetrySample>>.broadcast();
+  ExtendedStatus? _extendedStatus;
+  final StreamController<Object> _xferController = StreamController<Object>.broadcast();
+  final StreamController<MotionDone> _motionController = StreamController<MotionDone>.broadcast();
+  final StreamController<CartesianPose?> _poseController = StreamController<CartesianPose?>.broadcast();
+  final StreamController<JointCalibration> _calibController =
+      StreamController<JointCalibration>.broadcast();
+  final StreamController<TeachPoint> _teachPointController = StreamController<TeachPoint>.broadcast();
+  final StreamController<TeachDone> _teachDoneController = StreamController<TeachDone>.broadcast();
+  int _nextMoveId = 0;
   
   bool get isConnected => _isConnected;
   bool get isScanning => _isScanning;
   String get statusMessage => _statusMessage;
   ArmPosition get currentPosition => _currentPosition;
   BluetoothDevice? get device => _device;
+  Stream<List<TelemetrySample>> get telemetryStream => _telemetryController.stream;
+  ExtendedStatus? get extendedStatus => _extendedStatus;
+  /// Points of a recording started with stream: true, as the device stores them
+  Stream<TeachPoint> get teachPointStream => _teachPointController.stream;
   
   ArmBleService() {
     _init();
@@ -182,7 +210,7 @@ class ArmBleService extends ChangeNotifier {
               // Listen to notifications (status updates from ESP32)
               _notificationSubscription = characteristic.onValueReceived.listen((value) {
                 debugPrint('Received notification: ${value.length} bytes');
-                _handleStatusUpdate(value);
+                _handleNotification(value);
               });
             }
           }
@@ -235,6 +263,61 @@ class ArmBleService extends ChangeNotifier {
     _updateStatus("Disconnected");
   }
   
+  void _handleNotification(List<int> data) {
+    if (data.isNotEmpty && data[0] == notifyTagTelemetry) {
+      _handleTelemetry(data);
+    } else if (data.isNotEmpty && data[0] == notifyTagExtStatus) {
+      final status = ExtendedStatus.parse(data);
+      if (status != null) {
+        _extendedStatus = status;
+        notifyListeners();
+      }
+    } else if (data.isNotEmpty && data[0] == ProgramTransfer.tagAck) {
+      final ack = XferAck.parse(data);
+      if (ack != null) _xferController.add(ack);
+    } else if (data.isNotEmpty && data[0] == ProgramTransfer.tagData) {
+      final chunk = XferChunk.parse(data);
+      if (chunk != null) _xferController.add(chunk);
+    } else if (data.isNotEmpty && data[0] == MotionDone.tag) {
+      final done = MotionDone.parse(data);
+      if (done != null) _motionController.add(done);
+    } else if (data.isNotEmpty && data[0] == CartesianPose.tag) {
+      _poseController.add(CartesianPose.parse(data));
+    } else if (data.isNotEmpty && data[0] == JointCalibration.tag) {
+      final calibration = JointCalibration.parse(data);
+      if (calibration != null) _calibController.add(calibration);
+    } else if (data.isNotEmpty && data[0] == TeachPoint.tag) {
+      final point = TeachPoint.parse(data);
+      if (point != null) _teachPointController.add(point);
+    } else if (data.isNotEmpty && data[0] == TeachDone.tag) {
+      final done = TeachDone.parse(data);
+      if (done != null) _teachDoneController.add(done);
+    } else if (data.isNotEmpty && data[0] >= 0x80) {
+      debugPrint('Ignoring notification with unknown tag 0x${data[0].toRadixString(16)}');
+    } else {
+      _handleStatusUpdate(data);
+    }
+  }
+  
+  void _handleTelemetry(List<int> data) {
+    final samples = TelemetrySample.parseNotification(data);
+    if (samples.isEmpty) return;
+    
+    // Keep the live position in step with the newest sample
+    final latest = samples.last;
+    if (latest.fields & TelemetryFields.position != 0) {
+      final positions = List<int>.from(_currentPosition.jointPositions);
+      for (int i = 0; i < positions.length; i++) {
+        if (latest.isValid(i) && latest.positions[i] <= ArmPosition.maxPosition) {
+          positions[i] = latest.positions[i];
+        }
+      }
+      _currentPosition = ArmPosition(positions);
+      notifyListeners();
+    }
+    _telemetryController.add(samples);
+  }
+  
   void _handleStatusUpdate(List<int> data) {
     // Parse status data from ESP32
     // Format: is_moving (1 byte), current_slot (1 byte), positions (6 x 2 bytes = 12 bytes)
@@ -321,11 +404,57 @@ class ArmBleService extends ChangeNotifier {
     return success;
   }
   
-  Future<bool> savePosition(int slot, ArmPosition position) async {
-    final command = BleCommandBuilder.savePosition(slot, position.jointPositions);
+  /// Store [position] in a device slot
+  Future<bool> savePosition(int slot, ArmPosition position,
+                            {int timeMs = 1000, int speed = 1000, int delayMs = 0}) async {
+    final command = BleCommandBuilder.savePosition(slot, source: SaveSource.explicit,
+        positions: position.jointPositions, timesMs: [timeMs], speeds: [speed], delayMs: delayMs);
     return await _sendCommand(command);
   }
   
+  /// Store where the arm is commanded (or, with measured, where it actually is)
+  Future<bool> saveCurrentPosition(int slot, {SaveSource source = SaveSource.commanded,
+                                   int timeMs = 1000, int speed = 1000, int delayMs = 0}) async {
+    final command = BleCommandBuilder.savePosition(slot, source: source,
+        timesMs: [timeMs], speeds: [speed], delayMs: delayMs);
+    return await _sendCommand(command);
+  }
+  
+  /// Save several slots in one write; the payload must fit the negotiated MTU
+  Future<bool> uploadSlots(int firstSlot, List<Waypoint> waypoints) async {
+    final command = BleCommandBuilder.uploadSlots(firstSlot, waypoints);
+    return await _sendCommand(command);
+  }
+  
+  /// Move all joints and wait until the servos report arrival.
+  ///
+  /// Returns null if the command could not be sent or no answer came.
+  Future<MotionDone?> moveAndWait(ArmPosition position, {int time = 1000, int speed = 1000,
+                                  int timeoutMs = 0}) async {
+    final moveId = _nextMoveId;
+    _nextMoveId = (_nextMoveId + 1) & 0xFF;
+    final done = _motionController.stream.firstWhere((event) => event.moveId == moveId);
+    
+    final command = BleCommandBuilder.moveAndWait(moveId, position.jointPositions, time, speed,
+        timeoutMs: timeoutMs);
+    if (!await _sendCommand(command)) return null;
+    _currentPosition = position;
+    notifyListeners();
+    
+    // The device gives up after time + timeout; allow for the default and the link
+    final limit = Duration(milliseconds: time + (timeoutMs != 0 ? timeoutMs : 2000) + 1000);
+    try {
+      return await done.timeout(limit);
+    } on TimeoutException {
+      return null;
+    }
+  }
+  
+  /// Position tolerance (steps) and timeout used for arrival detection
+  Future<bool> setArrival({int tolerance = 8, int timeoutMs = 2000}) async {
+    return await _sendCommand(BleCommandBuilder.setArrival(tolerance, timeoutMs));
+  }
+  
   Future<bool> loadPosition(int slot, {int speed = 1000, int time = 1000}) async {
     final command = BleCommandBuilder.loadPosition(slot, speed, time);
     return await _sendCommand(command);
@@ -336,6 +465,139 @@ class ArmBleService extends ChangeNotifier {
     return await _sendCommand(command);
   }
   
+  /// Play a named program from the device's trajectory store
+  Future<bool> playProgram(String name, {bool loop = false}) async {
+    final command = BleCommandBuilder.playProgram(name, loop);
+    return await _sendCommand(command);
+  }
+  
+  /// Run a stored sequence script, see [uploadScript]
+  Future<bool> runScript(String name) async {
+    return await _sendCommand(BleCommandBuilder.runScript(name));
+  }
+  
+  /// Queue [positions] for buffered motion, each reached after its entry in
+  /// [timesMs] (a duration, or a timestamp on our clock with [timestamps]).
+  /// Split into as many writes as the MTU needs. Subscribe telemetry with
+  /// [TelemetryFields.queue] to see how much the device can still take.
+  Future<bool> queueSegments(List<ArmPosition> positions, List<int> timesMs,
+                             {bool timestamps = false, bool replace = false}) async {
+    final mtu = _device?.mtuNow ?? 23;
+    final perWrite = (mtu - 3 - BleCommandBuilder.queueHeaderSize) ~/ BleCommandBuilder.queueSegmentSize;
+    for (int start = 0; start < positions.length; start += perWrite) {
+      final end = start + perWrite < positions.length ? start + perWrite : positions.length;
+      final command = BleCommandBuilder.queueSegments(
+          positions.sublist(start, end), timesMs.sublist(start, end),
+          timestamps: timestamps, replace: replace && start == 0);
+      if (!await _sendCommand(command)) return false;
+    }
+    return true;
+  }
+  
+  /// Stop queued motion where it is and drop the rest
+  Future<bool> clearQueue() async {
+    return await _sendCommand(BleCommandBuilder.queueSegments([], [], replace: true));
+  }
+  
+  /// Scale playback and direct moves to [percent] of planned speed; the
+  /// device ramps to the new value, 0 brings the arm to a smooth stop
+  Future<bool> setFeed(int percent) async {
+    return await _sendCommand(BleCommandBuilder.setFeed(percent));
+  }
+  
+  /// Move the tool to [pose]; the device refuses poses it cannot reach
+  Future<bool> cartMove(CartesianPose pose, {int time = 1000, int speed = 0}) async {
+    return await _sendCommand(BleCommandBuilder.cartMove(pose, time, speed));
+  }
+  
+  /// Move the tool along a straight line to [pose]. [time] 0 lets the
+  /// device pick it; either way it is stretched if a joint would be too fast.
+  Future<bool> moveLinear(CartesianPose pose, {int time = 0}) async {
+    return await _sendCommand(BleCommandBuilder.moveLinear(pose, time));
+  }
+  
+  /// Move the tool along the arc through [via] to [pose]
+  Future<bool> moveCircular(CartesianPose via, CartesianPose pose, {int time = 0}) async {
+    return await _sendCommand(BleCommandBuilder.moveCircular(via, pose, time));
+  }
+  
+  /// Jog the tool at mm/s and rad/s. Call again at least every 300 ms to
+  /// keep going; [stopJog] or silence ramps to a stop.
+  Future<bool> cartJog(double vx, double vy, double vz, {double vPitch = 0, double vRoll = 0}) async {
+    return await _sendCommand(BleCommandBuilder.cartJog(vx, vy, vz, vPitch: vPitch, vRoll: vRoll));
+  }
+  
+  Future<bool> stopJog() async {
+    return await _sendCommand(BleCommandBuilder.cartJog(0, 0, 0));
+  }
+  
+  /// Tool pose of the arm as measured, or of the setpoint with [commanded];
+  /// null on timeout or when a joint did not answer
+  Future<CartesianPose?> getPose({bool commanded = false,
+                                  Duration timeout = const Duration(seconds: 1)}) async {
+    final pose = _poseController.stream.first;
+    final command = BleCommandBuilder.getPose(
+        source: commanded ? SaveSource.commanded : SaveSource.measured);
+    if (!await _sendCommand(command)) return null;
+    try {
+      return await pose.timeout(timeout);
+    } on TimeoutException {
+      return null;
+    }
+  }
+  
+  /// Calibration of [joint] as stored on the device; null on timeout
+  Future<JointCalibration?> getCalibration(int joint,
+                                           {Duration timeout = const Duration(seconds: 1)}) async {
+    final calibration = _calibController.stream.firstWhere((c) => c.joint == joint);
+    if (!await _sendCommand(BleCommandBuilder.getCalibration(joint: joint))) return null;
+    try {
+      return await calibration.timeout(timeout);
+    } on TimeoutException {
+      return null;
+    }
+  }
+  
+  /// Store a joint's calibration; the device keeps the arm where it is and
+  /// answers with the stored record, null when it was refused
+  Future<JointCalibration?> setCalibration(JointCalibration calibration,
+                                           {Duration timeout = const Duration(seconds: 1)}) async {
+    final stored = _calibController.stream.firstWhere((c) => c.joint == calibration.joint);
+    if (!await _sendCommand(BleCommandBuilder.setCalibration(calibration))) return null;
+    try {
+      return await stored.timeout(timeout);
+    } on TimeoutException {
+      return null;
+    }
+  }
+  
+  Future<bool> resetCalibration(int joint) async {
+    return await _sendCommand(BleCommandBuilder.resetCalibration(joint));
+  }
+  
+  /// Record a program on the device while the arm is guided by hand. Torque
+  /// goes off until [stopRecording]; with [stream] the stored points also
+  /// arrive on [teachPointStream].
+  Future<bool> startRecording(String name, {int rateHz = 0, int tolerance = 0,
+                                            bool stream = false}) async {
+    final command = BleCommandBuilder.teachStart(name, rateHz: rateHz, tolerance: tolerance,
+                                                 stream: stream);
+    return await _sendCommand(command);
+  }
+  
+  /// End the recording; the device stores the program (or discards it) and
+  /// holds the arm where it was left. Null on timeout.
+  Future<TeachDone?> stopRecording({bool save = true,
+                                    Duration timeout = const Duration(seconds: 3)}) async {
+    final done = _teachDoneController.stream.first;
+    if (!await _sendCommand(BleCommandBuilder.teachStop(save: save))) return null;
+    try {
+      return await done.timeout(timeout);
+    } on TimeoutException {
+      return null;
+    }
+  }
+  
   Future<bool> stopSequence() async {
     final command = BleCommandBuilder.stopSequence();
     return await _sendCommand(command);
@@ -356,12 +618,198 @@ class ArmBleService extends ChangeNotifier {
     return await _sendCommand(command);
   }
   
+  /// Start streamed telemetry; samplesPerNotify 0 lets the device batch up to the MTU
+  Future<bool> subscribeTelemetry({int rateHz = 20, int fields = TelemetryFields.position,
+                                   int samplesPerNotify = 0}) async {
+    final command = BleCommandBuilder.subscribeTelemetry(rateHz, fields, samplesPerNotify);
+    return await _sendCommand(command);
+  }
+  
+  Future<bool> unsubscribeTelemetry() async {
+    final command = BleCommandBuilder.subscribeTelemetry(0, 0, 0);
+    return await _sendCommand(command);
+  }
+  
+  /// Request an extended status record; the reply updates [extendedStatus]
+  Future<bool> requestExtendedStatus() async {
+    return await _sendCommand(BleCommandBuilder.getExtendedStatus());
+  }
+  
+  /// Chunk payload that fits one write at the current MTU
+  int get _xferChunkSize {
+    final mtu = _device?.mtuNow ?? 23;
+    return mtu - 3 - ProgramTransfer.chunkHeaderSize;
+  }
+  
+  Future<XferAck?> _nextXferAck(int dir, Duration timeout) async {
+    try {
+      return await _xferController.stream
+          .where((event) => event is XferAck && event.dir == dir)
+          .cast<XferAck>()
+          .first
+          .timeout(timeout);
+    } on TimeoutException {
+      return null;
+    }
+  }
+  
+  /// Store a program on the device, streamed in MTU-sized chunks.
+  ///
+  /// Calling it again with the same program after a dropped connection
+  /// resumes where the device left off.
+  Future<bool> uploadProgram(String name, List<Waypoint> waypoints,
+                             {void Function(int sent, int total)? onProgress}) async {
+    return _upload(0, name, WaypointCodec.encodeList(waypoints), onProgress);
+  }
+  
+  /// Store a sequence script on the device; it is checked before it is kept
+  Future<bool> uploadScript(String name, SequenceScript script,
+                            {void Function(int sent, int total)? onProgress}) async {
+    return _upload(ProgramTransfer.flagScript, name, script.build(), onProgress);
+  }
+  
+  Future<bool> _upload(int flags, String name, Uint8List chain,
+                       void Function(int sent, int total)? onProgress) async {
+    final crc = ProgramTransfer.crc32(chain);
+    const timeout = Duration(seconds: 2);
+    
+    // Listen before sending so no ack is missed
+    final acks = <XferAck>[];
+    final sub = _xferController.stream
+        .where((event) => event is XferAck && event.dir == ProgramTransfer.dirUpload)
+        .listen((event) => acks.add(event as XferAck));
+    try {
+      final begin = _nextXferAck(ProgramTransfer.dirUpload, timeout);
+      if (!await _sendCommand(BleCommandBuilder.xferBegin(ProgramTransfer.dirUpload | flags, name,
+                                                          totalLength: chain.length, crc32: crc))) {
+        return false;
+      }
+      var ack = await begin;
+      if (ack == null || ack.status != ProgramTransfer.statusOk) return false;
+      acks.clear();
+      
+      final chunkSize = _xferChunkSize;
+      int acked = ack.offset, ackedSeq = ack.seq, window = ack.window;
+      int offset = acked, seq = ackedSeq;
+      int retries = 0;
+      while (acked < chain.length) {
+        while (offset < chain.length && offset < acked + window * chunkSize) {
+          final end = offset + chunkSize < chain.length ? offset + chunkSize : chain.length;
+          if (!await _sendCommand(BleCommandBuilder.xferData(seq, offset, chain.sublist(offset, end)))) {
+            return false;
+          }
+          offset = end;
+          seq = (seq + 1) & 0xFF;
+        }
+        
+        final next = acks.isNotEmpty ? acks.last : await _nextXferAck(ProgramTransfer.dirUpload, timeout);
+        acks.clear();
+        if (next == null) {
+          // Nothing heard: go back to the last acknowledged chunk
+          if (++retries > 5) return false;
+          offset = acked;
+          seq = ackedSeq;
+          continue;
+        }
+        retries = 0;
+        if (next.status == ProgramTransfer.statusResend) {
+          offset = next.offset;
+          seq = next.seq;
+        } else if (next.status != ProgramTransfer.statusOk) {
+          return false;
+        }
+        acked = next.offset;
+        ackedSeq = next.seq;
+        onProgress?.call(acked, chain.length);
+      }
+      
+      final done = _nextXferAck(ProgramTransfer.dirUpload, timeout);
+      await _sendCommand(BleCommandBuilder.xferEnd());
+      ack = await done;
+      return ack != null && ack.status == ProgramTransfer.statusDone;
+    } finally {
+      await sub.cancel();
+    }
+  }
+  
+  /// Read a stored program back from the device; null if missing or corrupted
+  Future<List<Waypoint>?> downloadProgram(String name,
+                                          {void Function(int received, int total)? onProgress}) async {
+    const timeout = Duration(seconds: 2);
+    final received = BytesBuilder(copy: false);
+    int expected = 0, total = -1, crc = 0, sinceAck = 0, retries = 0;
+    final done = Completer<bool>();
+    
+    late StreamSubscription sub;
+    sub = _xferController.stream.timeout(timeout, onTimeout: (sink) {
+      // Stalled: ask for everything after what arrived
+      if (total < 0 || ++retries > 5) {
+        if (!done.isCompleted) done.complete(false);
+        return;
+      }
+      _sendCommand(BleCommandBuilder.xferAck(expected, resend: true));
+    }).listen((event) {
+      if (event is XferAck && event.dir == ProgramTransfer.dirDownload) {
+        if (event.status != ProgramTransfer.statusOk) {
+          if (!done.isCompleted) done.complete(false);
+          return;
+        }
+        total = event.totalLength;
+        crc = event.crc32;
+        if (total == 0 && !done.isCompleted) done.complete(true);
+      } else if (event is XferChunk && total >= 0) {
+        retries = 0;
+        if (event.offset != expected) {
+          if (event.offset > expected && sinceAck >= 0) {
+            sinceAck = -1;   // One resend request per gap
+            _sendCommand(BleCommandBuilder.xferAck(expected, resend: true));
+          }
+          return;
+        }
+        received.add(event.data);
+        expected += event.data.length;
+        onProgress?.call(expected, total);
+        if (sinceAck < 0) sinceAck = 0;
+        if (++sinceAck >= 4 || expected >= total) {
+          sinceAck = 0;
+          _sendCommand(BleCommandBuilder.xferAck(expected));
+        }
+        if (expected >= total && !done.isCompleted) done.complete(true);
+      }
+    });
+    
+    try {
+      if (!await _sendCommand(BleCommandBuilder.xferBegin(ProgramTransfer.dirDownload, name))) {
+        return null;
+      }
+      if (!await done.future) return null;
+      final chain = received.takeBytes();
+      if (ProgramTransfer.crc32(chain) != crc) {
+        debugPrint('Program download CRC mismatch');
+        return null;
+      }
+      return WaypointCodec.decodeList(chain);
+    } on FormatException catch (e) {
+      debugPrint('Program download malformed: $e');
+      return null;
+    } finally {
+      await sub.cancel();
+    }
+  }
+  
   @override
   void dispose() {
     _scanSubscription?.cancel();
     _stateSubscription?.cancel();
     _connectionSubscription?.cancel();
     _notificationSubscription?.cancel();
+    _telemetryController.close();
+    _xferController.close();
+    _motionController.close();
+    _poseController.close();
+    _calibController.close();
+    _teachPointController.close();
+    _teachDoneController.close();
     disconnect();
     super.dispose();
   }
@@ -0,0 +1,81 @@
+// Host benchmark runner: firmware against the simulated servo bus.
+//
+//   barm_bench [iterations] [scenario]
+//
+// Prints one JSON object per line prefixed with "BENCH " on stdout; logs go
+// to stderr (quiet by default, override with BARM_LOG_LEVEL).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include "host_ble.h"
+#include "sim_servo_bus.h"
+#include "sts_servo.h"
+#include "joint_calib.h"
+#include "control_loop.h"
+#include "position_storage.h"
+#include "traj_store.h"
+#include "sequence_player.h"
+#include "ble_arm_control.h"
+#include "telemetry.h"
+#include "motion_monitor.h"
+#include "motion_queue.h"
+#include "teach_recorder.h"
+#include "benchmark.h"
+
+static const char *TAG = "HOST_BENCH";
+
+int main(int argc, char **argv) {
+    if (getenv("BARM_LOG_LEVEL") == NULL) {
+        esp_log_level_set("*", ESP_LOG_ERROR);
+    }
+
+    uint16_t iterations = argc > 1 ? (uint16_t)atoi(argv[1]) : BENCH_DEFAULT_ITERATIONS;
+    const char *only = argc > 2 ? argv[2] : NULL;
+
+    sim_bus_config_t bus_config = {
+        .num_servos = ARM_NUM_JOINTS,
+        .first_id = ARM_SERVO_ID_BASE,
+        .baud_rate = UART_BAUD_RATE,
+        .echo = getenv("BARM_SIM_ECHO") != NULL,
+    };
+    sim_bus_init(&bus_config);
+
+    if (nvs_flash_init() != ESP_OK ||
+        sts_servo_init() != ESP_OK ||
+        joint_calib_init() != ESP_OK ||
+        control_loop_init() != ESP_OK ||
+        position_storage_init() != ESP_OK ||
+        traj_store_init() != ESP_OK ||
+        sequence_player_init() != ESP_OK ||
+        telemetry_init() != ESP_OK ||
+        motion_monitor_init() != ESP_OK ||
+        motion_queue_init() != ESP_OK ||
+        teach_recorder_init() != ESP_OK ||
+        ble_arm_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Firmware init failed");
+        return 1;
+    }
+    host_ble_connect(BLE_MAX_MTU);
+    host_ble_drain();
+
+    if (only == NULL) {
+        return benchmark_run_all(iterations) == ESP_OK ? 0 : 1;
+    }
+
+    for (int s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+        if (strcmp(only, benchmark_name(s)) == 0) {
+            bench_result_t result;
+            if (benchmark_run(s, iterations, &result) != ESP_OK) {
+                return 1;
+            }
+            benchmark_print(&result);
+            // The kinematics run doubles as the solver's round trip check
+            return s == BENCH_KINEMATICS && result.lost > 0 ? 1 : 0;
+        }
+    }
+    fprintf(stderr, "Unknown scenario: %s\n", only);
+    return 1;
+}
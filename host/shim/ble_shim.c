@@ -0,0 +1,257 @@
+/*
+ * Minimal Bluedroid stand-in. GATT server calls are answered with synthetic
+ * events posted to a single dispatcher thread, mirroring the BTC task.
+ */
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+#include "host_ble.h"
+#include "shim_time.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BTC_QUEUE_LEN     256
+#define BTC_MAX_PAYLOAD   512
+#define SHIM_GATTS_IF     3
+
+typedef struct {
+    bool is_gap;
+    int event;
+    esp_ble_gatts_cb_param_t param;
+    esp_ble_gap_cb_param_t gap_param;
+    uint16_t len;
+    uint8_t payload[BTC_MAX_PAYLOAD];
+} btc_msg_t;
+
+static esp_gatts_cb_t gatts_cb = NULL;
+static esp_gap_ble_cb_t gap_cb = NULL;
+static host_ble_notify_cb_t notify_cb = NULL;
+static void *notify_ctx = NULL;
+
+static btc_msg_t btc_queue[BTC_QUEUE_LEN];
+static unsigned btc_head = 0;
+static unsigned btc_count = 0;
+static bool btc_busy = false;
+static pthread_mutex_t btc_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t btc_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t btc_idle = PTHREAD_COND_INITIALIZER;
+static uint16_t next_handle = 40;
+static uint32_t next_trans_id = 1;
+
+static void btc_post(const btc_msg_t *msg) {
+    pthread_mutex_lock(&btc_lock);
+    while (btc_count == BTC_QUEUE_LEN) {
+        pthread_cond_wait(&btc_idle, &btc_lock);
+    }
+    btc_msg_t *slot = &btc_queue[(btc_head + btc_count) % BTC_QUEUE_LEN];
+    *slot = *msg;
+    if (slot->event == ESP_GATTS_WRITE_EVT && !slot->is_gap) {
+        slot->param.write.value = slot->payload;
+    }
+    btc_count++;
+    pthread_cond_signal(&btc_cond);
+    pthread_mutex_unlock(&btc_lock);
+}
+
+static void post_gatts(esp_gatts_cb_event_t event, const esp_ble_gatts_cb_param_t *param) {
+    btc_msg_t msg = { .is_gap = false, .event = event, .param = *param };
+    btc_post(&msg);
+}
+
+static void *btc_thread(void *arg) {
+    (void)arg;
+    static btc_msg_t msg;
+    pthread_mutex_lock(&btc_lock);
+    for (;;) {
+        while (btc_count == 0) {
+            btc_busy = false;
+            pthread_cond_broadcast(&btc_idle);
+            pthread_cond_wait(&btc_cond, &btc_lock);
+        }
+        btc_busy = true;
+        msg = btc_queue[btc_head];
+        btc_head = (btc_head + 1) % BTC_QUEUE_LEN;
+        btc_count--;
+        pthread_cond_broadcast(&btc_idle);
+        pthread_mutex_unlock(&btc_lock);
+        if (msg.is_gap) {
+            if (gap_cb) {
+                gap_cb((esp_gap_ble_cb_event_t)msg.event, &msg.gap_param);
+            }
+        } else if (gatts_cb) {
+            if (msg.event == ESP_GATTS_WRITE_EVT) {
+                msg.param.write.value = msg.payload;
+            }
+            gatts_cb((esp_gatts_cb_event_t)msg.event, SHIM_GATTS_IF, &msg.param);
+        }
+        pthread_mutex_lock(&btc_lock);
+    }
+    return NULL;
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) {
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg) {
+    (void)cfg;
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) {
+    (void)mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_enable(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, btc_thread, NULL) != 0) {
+        return ESP_FAIL;
+    }
+    pthread_detach(thread);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatt_set_local_mtu(uint16_t mtu) {
+    (void)mtu;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+    gap_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name) {
+    (void)name;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data) {
+    if (!adv_data->set_scan_rsp) {
+        btc_msg_t msg = { .is_gap = true, .event = ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT };
+        btc_post(&msg);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params) {
+    (void)adv_params;
+    btc_msg_t msg = { .is_gap = true, .event = ESP_GAP_BLE_ADV_START_COMPLETE_EVT };
+    msg.gap_param.adv_start_cmpl.status = ESP_BT_STATUS_SUCCESS;
+    btc_post(&msg);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback) {
+    gatts_cb = callback;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id) {
+    esp_ble_gatts_cb_param_t param = { .reg = { .status = 0, .app_id = app_id } };
+    post_gatts(ESP_GATTS_REG_EVT, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_create_service(esp_gatt_if_t gatts_if, esp_gatt_srvc_id_t *service_id,
+                                       uint16_t num_handle) {
+    (void)gatts_if;
+    (void)service_id;
+    (void)num_handle;
+    esp_ble_gatts_cb_param_t param = { .create = { .status = 0, .service_handle = next_handle } };
+    next_handle += 1;
+    post_gatts(ESP_GATTS_CREATE_EVT, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle) {
+    (void)service_handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_add_char(uint16_t service_handle, esp_bt_uuid_t *char_uuid,
+                                 esp_gatt_perm_t perm, esp_gatt_char_prop_t property,
+                                 void *char_val, void *control) {
+    (void)char_uuid;
+    (void)perm;
+    (void)property;
+    (void)char_val;
+    (void)control;
+    esp_ble_gatts_cb_param_t param = {
+        .add_char = { .status = 0, .attr_handle = (uint16_t)(next_handle + 1),
+                      .service_handle = service_handle }
+    };
+    next_handle += 2;
+    post_gatts(ESP_GATTS_ADD_CHAR_EVT, &param);
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint16_t attr_handle, uint16_t value_len,
+                                      uint8_t *value, bool need_confirm) {
+    (void)gatts_if;
+    (void)conn_id;
+    (void)attr_handle;
+    (void)need_confirm;
+    if (notify_cb) {
+        notify_cb(value, value_len, notify_ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint32_t trans_id, esp_gatt_status_t status, void *rsp) {
+    (void)gatts_if;
+    (void)conn_id;
+    (void)trans_id;
+    (void)status;
+    (void)rsp;
+    return ESP_OK;
+}
+
+void host_ble_set_notify_handler(host_ble_notify_cb_t cb, void *ctx) {
+    notify_cb = cb;
+    notify_ctx = ctx;
+}
+
+void host_ble_connect(uint16_t mtu) {
+    esp_ble_gatts_cb_param_t param = { .connect = { .conn_id = 0 } };
+    post_gatts(ESP_GATTS_CONNECT_EVT, &param);
+    esp_ble_gatts_cb_param_t mtu_param = { .mtu = { .conn_id = 0, .mtu = mtu } };
+    post_gatts(ESP_GATTS_MTU_EVT, &mtu_param);
+}
+
+void host_ble_disconnect(void) {
+    esp_ble_gatts_cb_param_t param = { .disconnect = { .conn_id = 0, .reason = 0x13 } };
+    post_gatts(ESP_GATTS_DISCONNECT_EVT, &param);
+}
+
+void host_ble_write(const uint8_t *data, uint16_t len) {
+    btc_msg_t msg = { .is_gap = false, .event = ESP_GATTS_WRITE_EVT };
+    if (len > BTC_MAX_PAYLOAD) {
+        len = BTC_MAX_PAYLOAD;
+    }
+    msg.param.write.conn_id = 0;
+    msg.param.write.trans_id = next_trans_id++;
+    msg.param.write.need_rsp = false;
+    msg.param.write.len = len;
+    msg.len = len;
+    memcpy(msg.payload, data, len);
+    btc_post(&msg);
+}
+
+void host_ble_drain(void) {
+    pthread_mutex_lock(&btc_lock);
+    while (btc_count != 0 || btc_busy) {
+        pthread_cond_wait(&btc_idle, &btc_lock);
+    }
+    pthread_mutex_unlock(&btc_lock);
+}
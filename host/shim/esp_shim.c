@@ -0,0 +1,206 @@
+/*
+ * esp_err, esp_log and esp_timer replacements for the host build.
+ */
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "shim_time.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t start_ns = 0;
+static esp_log_level_t log_level = ESP_LOG_INFO;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+__attribute__((constructor)) static void shim_clock_init(void) {
+    start_ns = monotonic_ns();
+    const char *level = getenv("BARM_LOG_LEVEL");
+    if (level != NULL) {
+        log_level = (esp_log_level_t)atoi(level);
+    }
+}
+
+uint64_t shim_now_us(void) {
+    return (monotonic_ns() - start_ns) / 1000;
+}
+
+struct timespec shim_deadline_us(uint64_t from_now_us) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + from_now_us * 1000;
+    ts.tv_sec += (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    return ts;
+}
+
+void shim_sleep_until_us(uint64_t deadline_us) {
+    uint64_t abs_ns = start_ns + deadline_us * 1000;
+    struct timespec ts = {
+        .tv_sec = (time_t)(abs_ns / 1000000000ull),
+        .tv_nsec = (long)(abs_ns % 1000000000ull),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+void shim_sleep_us(uint64_t us) {
+    shim_sleep_until_us(shim_now_us() + us);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default: return "UNKNOWN_ERROR";
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    (void)tag;
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    static const char letters[] = "NEWIDV";
+    if (level > log_level) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&log_lock);
+    fprintf(stderr, "%c (%llu) %s: ", letters[level],
+            (unsigned long long)(shim_now_us() / 1000), tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&log_lock);
+    va_end(args);
+}
+
+// ---------------------------------------------------------------------------
+// esp_timer: one thread per timer, absolute-deadline sleeps
+
+struct shim_timer {
+    esp_timer_create_args_t args;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t period_us;
+    uint64_t next_us;
+    bool armed;
+    bool periodic;
+    bool deleted;
+};
+
+int64_t esp_timer_get_time(void) {
+    return (int64_t)shim_now_us();
+}
+
+static void *timer_thread(void *arg) {
+    struct shim_timer *timer = arg;
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->deleted) {
+        if (!timer->armed) {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+        uint64_t due = timer->next_us;
+        pthread_mutex_unlock(&timer->lock);
+        shim_sleep_until_us(due);
+        pthread_mutex_lock(&timer->lock);
+        if (!timer->armed || timer->next_us != due) {
+            continue;
+        }
+        if (timer->periodic) {
+            timer->next_us += timer->period_us;
+            uint64_t now = shim_now_us();
+            if (timer->args.skip_unhandled_events && timer->next_us < now) {
+                timer->next_us = now + timer->period_us;
+            }
+        } else {
+            timer->armed = false;
+        }
+        pthread_mutex_unlock(&timer->lock);
+        timer->args.callback(timer->args.arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    free(timer);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+    struct shim_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *args;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_cond_init(&timer->cond, NULL);
+    if (pthread_create(&timer->thread, NULL, timer_thread, timer) != 0) {
+        free(timer);
+        return ESP_FAIL;
+    }
+    pthread_detach(timer->thread);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t timer, uint64_t us, bool periodic) {
+    pthread_mutex_lock(&timer->lock);
+    if (timer->armed) {
+        pthread_mutex_unlock(&timer->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->period_us = us;
+    timer->next_us = shim_now_us() + us;
+    timer->periodic = periodic;
+    timer->armed = true;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return timer_arm(timer, period_us, true);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer_arm(timer, timeout_us, false);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&timer->lock);
+    esp_err_t ret = timer->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    pthread_mutex_unlock(&timer->lock);
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&timer->lock);
+    timer->armed = false;
+    timer->deleted = true;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return ESP_OK;
+}
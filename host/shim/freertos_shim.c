@@ -0,0 +1,427 @@
+/*
+ * FreeRTOS API subset on top of POSIX threads.
+ *
+ * Only what the firmware uses is provided. Priorities and core affinity are
+ * accepted and ignored; the host scheduler decides who runs. Ticks are 1 ms.
+ */
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "shim_time.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct shim_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *param;
+    char name[16];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+struct shim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct shim_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    EventBits_t bits;
+};
+
+static __thread struct shim_task *current_task = NULL;
+
+void shim_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * Wait on a condition for at most `ticks`; returns false on timeout
+ */
+bool shim_cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    struct timespec deadline = shim_deadline_us((uint64_t)pdTICKS_TO_MS(ticks) * 1000);
+    return pthread_cond_timedwait(cond, lock, &deadline) != ETIMEDOUT;
+}
+
+static struct shim_task *task_alloc(const char *name) {
+    struct shim_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        abort();
+    }
+    strncpy(task->name, name ? name : "task", sizeof(task->name) - 1);
+    pthread_mutex_init(&task->lock, NULL);
+    shim_cond_init(&task->cond);
+    return task;
+}
+
+static struct shim_task *task_self(void) {
+    if (current_task == NULL) {
+        // Threads not created through xTaskCreate (main, timers) get a task lazily
+        current_task = task_alloc("main");
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+static void *task_trampoline(void *arg) {
+    struct shim_task *task = arg;
+    current_task = task;
+    task->fn(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *param, UBaseType_t priority, TaskHandle_t *out_handle,
+                                   BaseType_t core_id) {
+    (void)stack_depth;
+    (void)priority;
+    (void)core_id;
+    struct shim_task *task = task_alloc(name);
+    task->fn = fn;
+    task->param = param;
+    if (out_handle) {
+        *out_handle = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_trampoline, task) != 0) {
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *param, UBaseType_t priority, TaskHandle_t *out_handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, param, priority, out_handle,
+                                   tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    shim_sleep_us((uint64_t)pdTICKS_TO_MS(ticks) * 1000);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(shim_now_us() / (1000000 / configTICK_RATE_HZ));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    TickType_t wake = *previous_wake + increment;
+    TickType_t now = xTaskGetTickCount();
+    *previous_wake = wake;
+    if ((int32_t)(wake - now) <= 0) {
+        return pdFALSE;
+    }
+    vTaskDelay(wake - now);
+    return pdTRUE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return task_self();
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t ret = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch (action) {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending) {
+                ret = pdFAIL;
+            } else {
+                task->notify_value = value;
+            }
+            break;
+        case eNoAction:
+        default:
+            break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t *value, TickType_t ticks) {
+    struct shim_task *task = task_self();
+    BaseType_t ret = pdTRUE;
+    pthread_mutex_lock(&task->lock);
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+    }
+    while (!task->notify_pending) {
+        if (ticks == 0 || !shim_cond_wait_ticks(&task->cond, &task->lock, ticks)) {
+            break;
+        }
+    }
+    if (!task->notify_pending) {
+        ret = pdFALSE;
+    }
+    if (value) {
+        *value = task->notify_value;
+    }
+    if (ret == pdTRUE) {
+        task->notify_value &= ~clear_on_exit;
+        task->notify_pending = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct shim_task *task = task_self();
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_value == 0) {
+        if (ticks == 0 || !shim_cond_wait_ticks(&task->cond, &task->lock, ticks)) {
+            break;
+        }
+    }
+    uint32_t value = task->notify_value;
+    if (value != 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+// ---------------------------------------------------------------------------
+// Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct shim_queue *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->storage = calloc(length, item_size ? item_size : 1);
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    shim_cond_init(&queue->not_empty);
+    shim_cond_init(&queue->not_full);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    free(queue->storage);
+    free(queue);
+}
+
+static BaseType_t queue_put(QueueHandle_t queue, const void *item, TickType_t ticks,
+                            bool front, bool overwrite) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && !overwrite) {
+        if (ticks == 0 || !shim_cond_wait_ticks(&queue->not_full, &queue->lock, ticks)) {
+            pthread_mutex_unlock(&queue->lock);
+            return errQUEUE_FULL;
+        }
+    }
+    UBaseType_t slot;
+    if (overwrite && queue->count == queue->length) {
+        slot = (queue->head + queue->count - 1) % queue->length;
+    } else if (front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+        queue->count++;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+        queue->count++;
+    }
+    memcpy(queue->storage + slot * queue->item_size, item, queue->item_size);
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return queue_put(queue, item, ticks, false, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return queue_put(queue, item, ticks, true, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    return queue_put(queue, item, 0, false, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (ticks == 0 || !shim_cond_wait_ticks(&queue->not_empty, &queue->lock, ticks)) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    return queue->length - uxQueueMessagesWaiting(queue);
+}
+
+// ---------------------------------------------------------------------------
+// Semaphores
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial,
+                                                 StaticSemaphore_t *buffer) {
+    pthread_mutex_init(&buffer->lock, NULL);
+    shim_cond_init(&buffer->cond);
+    buffer->count = initial;
+    buffer->max_count = max_count;
+    return buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial) {
+    StaticSemaphore_t *sem = malloc(sizeof(*sem));
+    if (sem == NULL) {
+        return NULL;
+    }
+    return xSemaphoreCreateCountingStatic(max_count, initial, sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0) {
+        if (ticks == 0 || !shim_cond_wait_ticks(&sem->cond, &sem->lock, ticks)) {
+            pthread_mutex_unlock(&sem->lock);
+            return pdFALSE;
+        }
+    }
+    sem->count--;
+    pthread_mutex_unlock(&sem->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        ret = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    free(sem);
+}
+
+// ---------------------------------------------------------------------------
+// Event groups
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct shim_event_group *group = calloc(1, sizeof(*group));
+    if (group == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&group->lock, NULL);
+    shim_cond_init(&group->cond);
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits,
+                                BaseType_t clear_on_exit, BaseType_t wait_for_all,
+                                TickType_t ticks) {
+    pthread_mutex_lock(&group->lock);
+    for (;;) {
+        EventBits_t match = group->bits & bits;
+        bool done = wait_for_all ? (match == bits) : (match != 0);
+        if (done) {
+            EventBits_t result = group->bits;
+            if (clear_on_exit) {
+                group->bits &= ~bits;
+            }
+            pthread_mutex_unlock(&group->lock);
+            return result;
+        }
+        if (ticks == 0 || !shim_cond_wait_ticks(&group->cond, &group->lock, ticks)) {
+            break;
+        }
+    }
+    EventBits_t result = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
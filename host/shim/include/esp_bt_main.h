@@ -0,0 +1,9 @@
+#ifndef HOST_SHIM_ESP_BT_MAIN_H
+#define HOST_SHIM_ESP_BT_MAIN_H
+
+#include "esp_err.h"
+
+esp_err_t esp_bluedroid_init(void);
+esp_err_t esp_bluedroid_enable(void);
+
+#endif // HOST_SHIM_ESP_BT_MAIN_H
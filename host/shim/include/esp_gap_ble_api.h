@@ -0,0 +1,74 @@
+#ifndef HOST_SHIM_ESP_GAP_BLE_API_H
+#define HOST_SHIM_ESP_GAP_BLE_API_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define ESP_BLE_ADV_FLAG_GEN_DISC        (0x01 << 1)
+#define ESP_BLE_ADV_FLAG_BREDR_NOT_SPT   (0x01 << 2)
+#define ESP_BT_STATUS_SUCCESS            0
+
+typedef enum {
+    ADV_TYPE_IND = 0x00,
+} esp_ble_adv_type_t;
+
+typedef enum {
+    BLE_ADDR_TYPE_PUBLIC = 0x00,
+} esp_ble_addr_type_t;
+
+typedef enum {
+    ADV_CHNL_ALL = 0x07,
+} esp_ble_adv_channel_t;
+
+typedef enum {
+    ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY = 0x00,
+} esp_ble_adv_filter_t;
+
+typedef struct {
+    bool set_scan_rsp;
+    bool include_name;
+    bool include_txpower;
+    int min_interval;
+    int max_interval;
+    int appearance;
+    uint16_t manufacturer_len;
+    uint8_t *p_manufacturer_data;
+    uint16_t service_data_len;
+    uint8_t *p_service_data;
+    uint16_t service_uuid_len;
+    uint8_t *p_service_uuid;
+    uint8_t flag;
+} esp_ble_adv_data_t;
+
+typedef struct {
+    uint16_t adv_int_min;
+    uint16_t adv_int_max;
+    esp_ble_adv_type_t adv_type;
+    esp_ble_addr_type_t own_addr_type;
+    esp_ble_adv_channel_t channel_map;
+    esp_ble_adv_filter_t adv_filter_policy;
+} esp_ble_adv_params_t;
+
+typedef enum {
+    ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT = 0,
+    ESP_GAP_BLE_ADV_START_COMPLETE_EVT = 6,
+} esp_gap_ble_cb_event_t;
+
+typedef union {
+    struct {
+        int status;
+    } adv_data_cmpl;
+    struct {
+        int status;
+    } adv_start_cmpl;
+} esp_ble_gap_cb_param_t;
+
+typedef void (*esp_gap_ble_cb_t)(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback);
+esp_err_t esp_ble_gap_set_device_name(const char *name);
+esp_err_t esp_ble_gap_config_adv_data(esp_ble_adv_data_t *adv_data);
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params);
+
+#endif // HOST_SHIM_ESP_GAP_BLE_API_H
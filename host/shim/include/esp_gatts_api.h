@@ -0,0 +1,112 @@
+#ifndef HOST_SHIM_ESP_GATTS_API_H
+#define HOST_SHIM_ESP_GATTS_API_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define ESP_UUID_LEN_16                 2
+#define ESP_UUID_LEN_32                 4
+#define ESP_UUID_LEN_128                16
+#define ESP_GATT_IF_NONE                0xff
+#define ESP_GATT_DEF_BLE_MTU_SIZE       23
+
+#define ESP_GATT_PERM_READ              (1 << 0)
+#define ESP_GATT_PERM_WRITE             (1 << 4)
+#define ESP_GATT_CHAR_PROP_BIT_READ     (1 << 1)
+#define ESP_GATT_CHAR_PROP_BIT_WRITE_NR (1 << 2)
+#define ESP_GATT_CHAR_PROP_BIT_WRITE    (1 << 3)
+#define ESP_GATT_CHAR_PROP_BIT_NOTIFY   (1 << 4)
+
+typedef uint8_t esp_gatt_if_t;
+typedef uint16_t esp_gatt_perm_t;
+typedef uint8_t esp_gatt_char_prop_t;
+
+typedef enum {
+    ESP_GATT_OK = 0,
+} esp_gatt_status_t;
+
+typedef struct {
+    uint16_t len;
+    union {
+        uint16_t uuid16;
+        uint32_t uuid32;
+        uint8_t uuid128[ESP_UUID_LEN_128];
+    } uuid;
+} esp_bt_uuid_t;
+
+typedef struct {
+    esp_bt_uuid_t uuid;
+    uint8_t inst_id;
+} esp_gatt_id_t;
+
+typedef struct {
+    esp_gatt_id_t id;
+    bool is_primary;
+} esp_gatt_srvc_id_t;
+
+typedef enum {
+    ESP_GATTS_REG_EVT = 0,
+    ESP_GATTS_WRITE_EVT = 2,
+    ESP_GATTS_MTU_EVT = 4,
+    ESP_GATTS_CREATE_EVT = 7,
+    ESP_GATTS_ADD_CHAR_EVT = 9,
+    ESP_GATTS_CONNECT_EVT = 14,
+    ESP_GATTS_DISCONNECT_EVT = 15,
+} esp_gatts_cb_event_t;
+
+typedef union {
+    struct {
+        int status;
+        uint16_t app_id;
+    } reg;
+    struct {
+        uint16_t conn_id;
+        uint32_t trans_id;
+        uint16_t handle;
+        uint16_t offset;
+        bool need_rsp;
+        bool is_prep;
+        uint16_t len;
+        uint8_t *value;
+    } write;
+    struct {
+        uint16_t conn_id;
+        uint16_t mtu;
+    } mtu;
+    struct {
+        int status;
+        uint16_t service_handle;
+    } create;
+    struct {
+        int status;
+        uint16_t attr_handle;
+        uint16_t service_handle;
+    } add_char;
+    struct {
+        uint16_t conn_id;
+    } connect;
+    struct {
+        uint16_t conn_id;
+        int reason;
+    } disconnect;
+} esp_ble_gatts_cb_param_t;
+
+typedef void (*esp_gatts_cb_t)(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
+                               esp_ble_gatts_cb_param_t *param);
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback);
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id);
+esp_err_t esp_ble_gatts_create_service(esp_gatt_if_t gatts_if, esp_gatt_srvc_id_t *service_id,
+                                       uint16_t num_handle);
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle);
+esp_err_t esp_ble_gatts_add_char(uint16_t service_handle, esp_bt_uuid_t *char_uuid,
+                                 esp_gatt_perm_t perm, esp_gatt_char_prop_t property,
+                                 void *char_val, void *control);
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint16_t attr_handle, uint16_t value_len,
+                                      uint8_t *value, bool need_confirm);
+esp_err_t esp_ble_gatts_send_response(esp_gatt_if_t gatts_if, uint16_t conn_id,
+                                      uint32_t trans_id, esp_gatt_status_t status, void *rsp);
+
+#endif // HOST_SHIM_ESP_GATTS_API_H
@@ -0,0 +1,10 @@
+#ifndef HOST_SHIM_ESP_ROM_CRC_H
+#define HOST_SHIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE, reflected) with the ROM's chaining convention: pass the
+// previous result as `crc` to continue over more data.
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_SHIM_ESP_ROM_CRC_H
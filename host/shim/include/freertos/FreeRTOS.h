@@ -0,0 +1,41 @@
+#ifndef HOST_SHIM_FREERTOS_H
+#define HOST_SHIM_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+
+#define pdTRUE                    1
+#define pdFALSE                   0
+#define pdPASS                    pdTRUE
+#define pdFAIL                    pdFALSE
+#define errQUEUE_FULL             pdFALSE
+
+#define portMAX_DELAY             ((TickType_t)0xFFFFFFFFu)
+#define configTICK_RATE_HZ        1000
+#define configMAX_PRIORITIES      25
+#define portTICK_PERIOD_MS        (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)         ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(t)          ((uint32_t)(((uint64_t)(t) * 1000) / configTICK_RATE_HZ))
+#define tskNO_AFFINITY            0x7FFFFFFF
+
+// Critical sections map onto a recursive mutex; there are no interrupts on the host.
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED   PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+#define portENTER_CRITICAL(mux)        pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)         pthread_mutex_unlock(mux)
+#define taskENTER_CRITICAL(mux)        pthread_mutex_lock(mux)
+#define taskEXIT_CRITICAL(mux)         pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_ISR(mux)    pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_ISR(mux)     pthread_mutex_unlock(mux)
+#define portYIELD_FROM_ISR(x)          ((void)(x))
+
+#define IRAM_ATTR
+
+#endif // HOST_SHIM_FREERTOS_H
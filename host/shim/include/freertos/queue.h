@@ -0,0 +1,20 @@
+#ifndef HOST_SHIM_QUEUE_H
+#define HOST_SHIM_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+#define xQueueSendToBack(q, item, ticks) xQueueSend((q), (item), (ticks))
+#define xQueueSendFromISR(q, item, woken) xQueueSend((q), (item), 0)
+
+#endif // HOST_SHIM_QUEUE_H
@@ -0,0 +1,28 @@
+#ifndef HOST_SHIM_SEMPHR_H
+#define HOST_SHIM_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct shim_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max_count, UBaseType_t initial,
+                                                 StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#define xSemaphoreCreateMutex()            xSemaphoreCreateCounting(1, 1)
+#define xSemaphoreCreateBinary()           xSemaphoreCreateCounting(1, 0)
+#define xSemaphoreCreateMutexStatic(buf)   xSemaphoreCreateCountingStatic(1, 1, (buf))
+#define xSemaphoreCreateBinaryStatic(buf)  xSemaphoreCreateCountingStatic(1, 0, (buf))
+#define xSemaphoreGiveFromISR(sem, woken)  xSemaphoreGive(sem)
+
+#endif // HOST_SHIM_SEMPHR_H
@@ -0,0 +1,21 @@
+#ifndef HOST_BLE_H
+#define HOST_BLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host-side driver for the Bluedroid shim. Events are delivered to the
+// registered GATT/GAP callbacks from a dedicated "btc" thread, the same way
+// Bluedroid runs them in its BTC task on the device.
+
+typedef void (*host_ble_notify_cb_t)(const uint8_t *data, uint16_t len, void *ctx);
+
+void host_ble_set_notify_handler(host_ble_notify_cb_t cb, void *ctx);
+void host_ble_connect(uint16_t mtu);
+void host_ble_disconnect(void);
+// Queue a GATT write to the RX characteristic; returns once it is queued
+void host_ble_write(const uint8_t *data, uint16_t len);
+// Block until the BTC thread has dispatched every queued event
+void host_ble_drain(void);
+
+#endif // HOST_BLE_H
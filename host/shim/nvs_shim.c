@@ -0,0 +1,146 @@
+/*
+ * Volatile NVS: blobs live in a fixed table for the lifetime of the process.
+ */
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHIM_NVS_MAX_ENTRIES      128
+#define SHIM_NVS_MAX_NAMESPACES   8
+#define SHIM_NVS_KEY_LEN          16
+
+typedef struct {
+    bool used;
+    nvs_handle_t ns;
+    char key[SHIM_NVS_KEY_LEN];
+    void *data;
+    size_t length;
+} nvs_entry_t;
+
+static nvs_entry_t entries[SHIM_NVS_MAX_ENTRIES];
+static char namespaces[SHIM_NVS_MAX_NAMESPACES][SHIM_NVS_KEY_LEN];
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t commit_count = 0;
+
+uint32_t shim_nvs_commit_count(void) {
+    return commit_count;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < SHIM_NVS_MAX_ENTRIES; i++) {
+        free(entries[i].data);
+        memset(&entries[i], 0, sizeof(entries[i]));
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    (void)open_mode;
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < SHIM_NVS_MAX_NAMESPACES; i++) {
+        if (namespaces[i][0] == '\0') {
+            strncpy(namespaces[i], name_space, SHIM_NVS_KEY_LEN - 1);
+        }
+        if (strncmp(namespaces[i], name_space, SHIM_NVS_KEY_LEN - 1) == 0) {
+            *out_handle = (nvs_handle_t)(i + 1);
+            pthread_mutex_unlock(&nvs_lock);
+            return ESP_OK;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    (void)handle;
+}
+
+static nvs_entry_t *find_entry(nvs_handle_t handle, const char *key) {
+    for (int i = 0; i < SHIM_NVS_MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].ns == handle &&
+            strncmp(entries[i].key, key, SHIM_NVS_KEY_LEN - 1) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *entry = find_entry(handle, key);
+    for (int i = 0; entry == NULL && i < SHIM_NVS_MAX_ENTRIES; i++) {
+        if (!entries[i].used) {
+            entry = &entries[i];
+            entry->used = true;
+            entry->ns = handle;
+            strncpy(entry->key, key, SHIM_NVS_KEY_LEN - 1);
+        }
+    }
+    if (entry == NULL) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+    free(entry->data);
+    entry->data = malloc(length);
+    memcpy(entry->data, value, length);
+    entry->length = length;
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *entry = find_entry(handle, key);
+    esp_err_t ret = ESP_OK;
+    if (entry == NULL) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else if (out_value == NULL) {
+        *length = entry->length;
+    } else if (*length < entry->length) {
+        ret = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(out_value, entry->data, entry->length);
+        *length = entry->length;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ret;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *entry = find_entry(handle, key);
+    if (entry == NULL) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    free(entry->data);
+    memset(entry, 0, sizeof(*entry));
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < SHIM_NVS_MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].ns == handle) {
+            free(entries[i].data);
+            memset(&entries[i], 0, sizeof(entries[i]));
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    (void)handle;
+    __atomic_add_fetch(&commit_count, 1, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
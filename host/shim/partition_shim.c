@@ -0,0 +1,144 @@
+/*
+ * The "traj" data partition in host memory. With BARM_SIM_FLASH set the
+ * partition is a file mapped MAP_SHARED, so programs survive between runs.
+ */
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define HOST_TRAJ_PARTITION_SIZE     (1024 * 1024)
+
+static esp_partition_t traj_partition = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = 0x40,
+    .address = 0x200000,
+    .size = HOST_TRAJ_PARTITION_SIZE,
+    .erase_size = HOST_PARTITION_SECTOR_SIZE,
+    .label = "traj",
+};
+
+static uint8_t *flash = NULL;
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_partition_stats_t stats;
+
+/**
+ * Back the partition with a file or anonymous memory, erased on first use
+ */
+static uint8_t *flash_map(void) {
+    if (flash != NULL) {
+        return flash;
+    }
+
+    const char *path = getenv("BARM_SIM_FLASH");
+    if (path != NULL) {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        off_t old_size = fd >= 0 ? lseek(fd, 0, SEEK_END) : -1;
+        if (old_size >= 0 && (old_size >= HOST_TRAJ_PARTITION_SIZE ||
+                              ftruncate(fd, HOST_TRAJ_PARTITION_SIZE) == 0)) {
+            void *p = mmap(NULL, HOST_TRAJ_PARTITION_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                flash = p;
+                if (old_size < HOST_TRAJ_PARTITION_SIZE) {
+                    memset(flash + old_size, 0xFF, HOST_TRAJ_PARTITION_SIZE - old_size);  // New file: erased
+                }
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    if (flash == NULL) {
+        flash = malloc(HOST_TRAJ_PARTITION_SIZE);
+        memset(flash, 0xFF, HOST_TRAJ_PARTITION_SIZE);
+    }
+    return flash;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    if ((type != ESP_PARTITION_TYPE_ANY && type != traj_partition.type) ||
+        (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != traj_partition.subtype) ||
+        (label != NULL && strcmp(label, traj_partition.label) != 0)) {
+        return NULL;
+    }
+    flash_map();
+    return &traj_partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size) {
+    if (src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&flash_lock);
+    memcpy(dst, flash_map() + src_offset, size);
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size) {
+    if (dst_offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&flash_lock);
+    uint8_t *p = flash_map() + dst_offset;
+    const uint8_t *s = src;
+    for (size_t i = 0; i < size; i++) {
+        p[i] &= s[i];  // Programming can only clear bits
+    }
+    stats.writes++;
+    stats.bytes_written += size;
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    if (offset % HOST_PARTITION_SECTOR_SIZE != 0 || size % HOST_PARTITION_SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&flash_lock);
+    memset(flash_map() + offset, 0xFF, size);
+    stats.erases += size / HOST_PARTITION_SECTOR_SIZE;
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+    (void)memory;
+    if (offset + size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_ptr = flash_map() + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+    (void)handle;
+}
+
+void host_partition_get_stats(host_partition_stats_t *out) {
+    pthread_mutex_lock(&flash_lock);
+    *out = stats;
+    pthread_mutex_unlock(&flash_lock);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,19 @@
+#ifndef HOST_SHIM_TIME_H
+#define HOST_SHIM_TIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+
+// Microseconds since the process started (CLOCK_MONOTONIC)
+uint64_t shim_now_us(void);
+void shim_sleep_us(uint64_t us);
+void shim_sleep_until_us(uint64_t deadline_us);
+struct timespec shim_deadline_us(uint64_t from_now_us);
+
+void shim_cond_init(pthread_cond_t *cond);
+bool shim_cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks);
+
+#endif // HOST_SHIM_TIME_H
@@ -0,0 +1,10 @@
+#ifndef HOST_SHIM_UART_INTERNAL_H
+#define HOST_SHIM_UART_INTERNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Called by the bus simulator when reply bytes finish arriving on RX
+void shim_uart_rx_push(const uint8_t *data, size_t len);
+
+#endif // HOST_SHIM_UART_INTERNAL_H
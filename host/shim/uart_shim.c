@@ -0,0 +1,139 @@
+/*
+ * UART driver shim. TX goes to the simulated servo bus; RX is a byte ring
+ * filled by the simulator, with UART_DATA events posted like the IDF driver.
+ */
+#include "driver/uart.h"
+#include "sim_servo_bus.h"
+#include "shim_time.h"
+#include "shim_uart.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t *rx_ring = NULL;
+static size_t rx_size = 0;
+static size_t rx_head = 0;
+static size_t rx_count = 0;
+static QueueHandle_t event_queue = NULL;
+static pthread_mutex_t rx_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rx_cond;
+static size_t tx_capacity = 0;      // Driver TX ring + hardware FIFO
+
+#define UART_HW_FIFO_LEN 128
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *config) {
+    (void)port;
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts) {
+    (void)port;
+    (void)tx;
+    (void)rx;
+    (void)rts;
+    (void)cts;
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size,
+                              int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags) {
+    (void)port;
+    (void)intr_alloc_flags;
+    tx_capacity = (size_t)tx_buffer_size + UART_HW_FIFO_LEN;
+    rx_size = (size_t)rx_buffer_size;
+    rx_ring = calloc(1, rx_size);
+    shim_cond_init(&rx_cond);
+    if (queue_size > 0 && uart_queue != NULL) {
+        event_queue = xQueueCreate((UBaseType_t)queue_size, sizeof(uart_event_t));
+        *uart_queue = event_queue;
+    }
+    return rx_ring ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t port, uint8_t tout_thresh) {
+    (void)port;
+    (void)tout_thresh;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t port, int threshold) {
+    (void)port;
+    (void)threshold;
+    return ESP_OK;
+}
+
+void shim_uart_rx_push(const uint8_t *data, size_t len) {
+    size_t accepted = 0;
+    pthread_mutex_lock(&rx_lock);
+    for (size_t i = 0; i < len && rx_count < rx_size; i++) {
+        rx_ring[(rx_head + rx_count) % rx_size] = data[i];
+        rx_count++;
+        accepted++;
+    }
+    pthread_cond_broadcast(&rx_cond);
+    pthread_mutex_unlock(&rx_lock);
+
+    if (event_queue != NULL) {
+        uart_event_t event = {
+            .type = accepted == len ? UART_DATA : UART_BUFFER_FULL,
+            .size = accepted,
+            .timeout_flag = true,
+        };
+        xQueueSend(event_queue, &event, 0);
+    }
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size) {
+    (void)port;
+    // Like the IDF driver, block until the frame fits behind what is still queued for the wire
+    uint64_t room_us = sim_bus_wire_time_us(tx_capacity > size ? tx_capacity - size : 0);
+    uint64_t done_us = sim_bus_tx_done_us();
+    if (done_us > room_us) {
+        shim_sleep_until_us(done_us - room_us);
+    }
+    sim_bus_transmit(src, size);
+    return (int)size;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks_to_wait) {
+    (void)port;
+    uint8_t *out = buf;
+    size_t copied = 0;
+    pthread_mutex_lock(&rx_lock);
+    while (rx_count < length) {
+        if (ticks_to_wait == 0 || !shim_cond_wait_ticks(&rx_cond, &rx_lock, ticks_to_wait)) {
+            break;
+        }
+    }
+    while (copied < length && rx_count > 0) {
+        out[copied++] = rx_ring[rx_head];
+        rx_head = (rx_head + 1) % rx_size;
+        rx_count--;
+    }
+    pthread_mutex_unlock(&rx_lock);
+    return (int)copied;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size) {
+    (void)port;
+    pthread_mutex_lock(&rx_lock);
+    *size = rx_count;
+    pthread_mutex_unlock(&rx_lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks_to_wait) {
+    (void)port;
+    (void)ticks_to_wait;
+    shim_sleep_until_us(sim_bus_tx_done_us());
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t port) {
+    (void)port;
+    pthread_mutex_lock(&rx_lock);
+    rx_head = 0;
+    rx_count = 0;
+    pthread_mutex_unlock(&rx_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,507 @@
+/*
+ * Virtual STS3214 servo bus for the host build.
+ */
+#include "sim_servo_bus.h"
+#include "shim_time.h"
+#include "shim_uart.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REG_ID                  0x05
+#define REG_BAUD_RATE           0x06
+#define REG_RETURN_DELAY        0x07
+#define REG_MIN_ANGLE           0x09
+#define REG_MAX_ANGLE           0x0B
+#define REG_TORQUE_ENABLE       0x28
+#define REG_ACC                 0x29
+#define REG_GOAL_POSITION       0x2A
+#define REG_GOAL_TIME           0x2C
+#define REG_GOAL_SPEED          0x2E
+#define REG_TORQUE_LIMIT        0x30
+#define REG_PRESENT_POSITION    0x38
+#define REG_PRESENT_SPEED       0x3A
+#define REG_PRESENT_LOAD        0x3C
+#define REG_PRESENT_VOLTAGE     0x3E
+#define REG_PRESENT_TEMPERATURE 0x3F
+#define REG_STATUS              0x41
+#define REG_MOVING              0x42
+#define REG_PRESENT_CURRENT     0x45
+
+#define INST_PING               0x01
+#define INST_READ               0x02
+#define INST_WRITE              0x03
+#define INST_REG_WRITE          0x04
+#define INST_ACTION             0x05
+#define INST_SYNC_READ          0x82
+#define INST_SYNC_WRITE         0x83
+#define BROADCAST_ID            0xFE
+
+#define MAX_FRAME               256
+#define MAX_PENDING             64
+
+typedef struct {
+    bool present;
+    bool online;
+    uint8_t regs[SIM_REG_COUNT];
+    uint8_t pending_write[MAX_FRAME];   // REG_WRITE payload waiting for ACTION
+    uint8_t pending_len;
+    float position;
+    float velocity;                     // Signed, steps/s
+    float cruise_speed;                 // Magnitude chosen when the goal was written
+    uint64_t last_update_us;
+    int16_t load_offset;
+} sim_servo_t;
+
+typedef struct {
+    uint64_t due_us;
+    size_t len;
+    uint8_t data[MAX_FRAME];
+} sim_chunk_t;
+
+static sim_bus_config_t bus_config;
+static sim_servo_t servos[256];
+static sim_bus_stats_t stats;
+static uint64_t wire_free_us = 0;
+static uint32_t corrupt_one_in = 0;
+
+static uint8_t tx_frame[MAX_FRAME];
+static size_t tx_len = 0;
+
+static sim_chunk_t pending[MAX_PENDING];
+static unsigned pending_head = 0;
+static unsigned pending_count = 0;
+
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bus_cond;
+
+static uint64_t byte_time_us(size_t bytes) {
+    // 8N1 framing: 10 bit times per byte
+    return ((uint64_t)bytes * 10ull * 1000000ull + bus_config.baud_rate - 1) / bus_config.baud_rate;
+}
+
+static uint16_t reg16(const sim_servo_t *servo, uint8_t addr) {
+    return (uint16_t)(servo->regs[addr] | (servo->regs[addr + 1] << 8));
+}
+
+static void set_reg16(sim_servo_t *servo, uint8_t addr, uint16_t value) {
+    servo->regs[addr] = value & 0xFF;
+    servo->regs[addr + 1] = (value >> 8) & 0xFF;
+}
+
+// STS sign-magnitude encoding: bit 15 is the sign
+static uint16_t encode_signed(float value) {
+    int magnitude = (int)lroundf(fabsf(value));
+    if (magnitude > 0x7FFF) {
+        magnitude = 0x7FFF;
+    }
+    return (uint16_t)(magnitude | (value < 0 ? 0x8000 : 0));
+}
+
+static void servo_update(sim_servo_t *servo, uint64_t now_us) {
+    float dt = 0.0f;
+    if (now_us > servo->last_update_us) {
+        dt = (float)(now_us - servo->last_update_us) / 1e6f;
+        servo->last_update_us = now_us;
+    }
+
+    float goal = (float)reg16(servo, REG_GOAL_POSITION);
+    bool torque = servo->regs[REG_TORQUE_ENABLE] != 0;
+    float error = goal - servo->position;
+
+    if (!torque || fabsf(error) < 0.5f || dt <= 0.0f) {
+        if (!torque || fabsf(error) < 0.5f) {
+            servo->velocity = 0.0f;
+        }
+    } else {
+        float step = servo->cruise_speed * dt;
+        if (step >= fabsf(error)) {
+            servo->position = goal;
+            servo->velocity = 0.0f;
+        } else {
+            servo->velocity = error > 0 ? servo->cruise_speed : -servo->cruise_speed;
+            servo->position += error > 0 ? step : -step;
+        }
+    }
+
+    uint16_t present = (uint16_t)lroundf(servo->position);
+    set_reg16(servo, REG_PRESENT_POSITION, present);
+    set_reg16(servo, REG_PRESENT_SPEED, encode_signed(servo->velocity));
+    // Load in 0.1% units: proportional to speed plus an injectable external load
+    float load = servo->velocity / SIM_MAX_SPEED_STEPS * 300.0f + (float)servo->load_offset;
+    int load_mag = (int)lroundf(fabsf(load));
+    if (load_mag > 1000) {
+        load_mag = 1000;
+    }
+    // Load uses bit 10 as its direction flag
+    set_reg16(servo, REG_PRESENT_LOAD, (uint16_t)(load_mag | (load < 0 ? 0x400 : 0)));
+    servo->regs[REG_PRESENT_VOLTAGE] = 120;
+    servo->regs[REG_PRESENT_TEMPERATURE] = (uint8_t)(30 + (uint8_t)(fabsf(load) / 100.0f));
+    servo->regs[REG_MOVING] = servo->velocity != 0.0f ? 1 : 0;
+    set_reg16(servo, REG_PRESENT_CURRENT, (uint16_t)(fabsf(load) / 4.0f));
+}
+
+static void servo_goal_changed(sim_servo_t *servo) {
+    float distance = fabsf((float)reg16(servo, REG_GOAL_POSITION) - servo->position);
+    uint16_t time_ms = reg16(servo, REG_GOAL_TIME);
+    uint16_t speed = reg16(servo, REG_GOAL_SPEED);
+    float velocity = SIM_MAX_SPEED_STEPS;
+    if (time_ms > 0) {
+        velocity = distance * 1000.0f / (float)time_ms;
+    }
+    if (speed > 0 && (float)speed < velocity) {
+        velocity = (float)speed;
+    }
+    if (velocity > SIM_MAX_SPEED_STEPS) {
+        velocity = SIM_MAX_SPEED_STEPS;
+    }
+    servo->cruise_speed = velocity < 1.0f ? 1.0f : velocity;
+}
+
+static void servo_write(sim_servo_t *servo, uint8_t addr, const uint8_t *data, size_t len,
+                        uint64_t now_us) {
+    servo_update(servo, now_us);
+    bool goal_touched = false;
+    for (size_t i = 0; i < len && addr + i < SIM_REG_COUNT; i++) {
+        uint8_t reg = (uint8_t)(addr + i);
+        if (reg >= REG_PRESENT_POSITION && reg <= REG_PRESENT_CURRENT + 1) {
+            continue;  // Read-only feedback area
+        }
+        if (reg == REG_TORQUE_ENABLE && data[i] && !servo->regs[REG_TORQUE_ENABLE]) {
+            // Enabling torque holds the current position
+            set_reg16(servo, REG_GOAL_POSITION, (uint16_t)lroundf(servo->position));
+        }
+        servo->regs[reg] = data[i];
+        if (reg >= REG_GOAL_POSITION && reg <= REG_GOAL_SPEED + 1) {
+            goal_touched = true;
+        }
+    }
+    if (goal_touched) {
+        uint16_t goal = reg16(servo, REG_GOAL_POSITION);
+        if (goal > 4095) {
+            set_reg16(servo, REG_GOAL_POSITION, 4095);
+        }
+        servo_goal_changed(servo);
+    }
+}
+
+static uint8_t checksum(const uint8_t *frame, size_t len) {
+    uint8_t sum = 0;
+    for (size_t i = 2; i < len; i++) {
+        sum += frame[i];
+    }
+    return (uint8_t)~sum;
+}
+
+static void schedule_chunk(uint64_t due_us, const uint8_t *data, size_t len) {
+    if (pending_count == MAX_PENDING) {
+        stats.dropped_frames++;
+        return;
+    }
+    sim_chunk_t *chunk = &pending[(pending_head + pending_count) % MAX_PENDING];
+    chunk->due_us = due_us;
+    chunk->len = len;
+    memcpy(chunk->data, data, len);
+    pending_count++;
+    pthread_cond_signal(&bus_cond);
+}
+
+// Queue a status packet from `servo_id` on the wire after `after_us`
+static uint64_t send_reply(uint8_t servo_id, const uint8_t *params, size_t nparams,
+                           uint64_t after_us) {
+    uint8_t frame[MAX_FRAME];
+    size_t n = 0;
+    frame[n++] = 0xFF;
+    frame[n++] = 0xFF;
+    frame[n++] = servo_id;
+    frame[n++] = (uint8_t)(nparams + 2);
+    frame[n++] = servos[servo_id].regs[REG_STATUS];
+    if (nparams > 0) {
+        memcpy(&frame[n], params, nparams);
+        n += nparams;
+    }
+    frame[n] = checksum(frame, n);
+    n++;
+
+    if (corrupt_one_in && (uint32_t)rand() % corrupt_one_in == 0) {
+        frame[(size_t)rand() % n] ^= (uint8_t)(1u << (rand() % 8));
+    }
+
+    uint64_t start = after_us + SIM_RETURN_DELAY_US;
+    uint64_t end = start + byte_time_us(n);
+    stats.rx_bytes += n;
+    stats.rx_frames++;
+    stats.busy_us += end - start;
+    schedule_chunk(end, frame, n);
+    return end;
+}
+
+static bool servo_reachable(uint8_t id) {
+    return servos[id].present && servos[id].online;
+}
+
+static void read_registers(sim_servo_t *servo, uint8_t addr, uint8_t len, uint8_t *out,
+                           uint64_t now_us) {
+    servo_update(servo, now_us);
+    for (uint8_t i = 0; i < len; i++) {
+        out[i] = (addr + i < SIM_REG_COUNT) ? servo->regs[addr + i] : 0;
+    }
+}
+
+static void process_frame(const uint8_t *frame, size_t len, uint64_t end_us) {
+    uint8_t id = frame[2];
+    uint8_t inst = frame[4];
+    const uint8_t *params = &frame[5];
+    size_t nparams = len - 6;
+    uint64_t reply_end = end_us;
+    uint8_t data[MAX_FRAME];
+
+    if (checksum(frame, len - 1) != frame[len - 1]) {
+        stats.dropped_frames++;
+        return;
+    }
+
+    switch (inst) {
+        case INST_PING:
+        case INST_READ:
+        case INST_WRITE:
+        case INST_REG_WRITE:
+            if (id == BROADCAST_ID) {
+                for (int i = 0; i < 256; i++) {
+                    if (servo_reachable((uint8_t)i) && inst == INST_WRITE && nparams >= 1) {
+                        servo_write(&servos[i], params[0], params + 1, nparams - 1, end_us);
+                    }
+                }
+                break;
+            }
+            if (!servo_reachable(id)) {
+                stats.dropped_frames++;
+                break;
+            }
+            if (inst == INST_PING) {
+                reply_end = send_reply(id, NULL, 0, end_us);
+            } else if (inst == INST_READ && nparams >= 2) {
+                read_registers(&servos[id], params[0], params[1], data, end_us);
+                reply_end = send_reply(id, data, params[1], end_us);
+            } else if (inst == INST_WRITE && nparams >= 1) {
+                servo_write(&servos[id], params[0], params + 1, nparams - 1, end_us);
+                reply_end = send_reply(id, NULL, 0, end_us);
+            } else if (inst == INST_REG_WRITE && nparams >= 1) {
+                memcpy(servos[id].pending_write, params, nparams);
+                servos[id].pending_len = (uint8_t)nparams;
+                reply_end = send_reply(id, NULL, 0, end_us);
+            }
+            break;
+
+        case INST_ACTION:
+            for (int i = 0; i < 256; i++) {
+                sim_servo_t *servo = &servos[i];
+                if ((id == BROADCAST_ID || id == i) && servo_reachable((uint8_t)i) &&
+                    servo->pending_len > 0) {
+                    servo_write(servo, servo->pending_write[0], servo->pending_write + 1,
+                                servo->pending_len - 1u, end_us);
+                    servo->pending_len = 0;
+                }
+            }
+            break;
+
+        case INST_SYNC_WRITE: {
+            if (nparams < 2) {
+                break;
+            }
+            uint8_t addr = params[0];
+            uint8_t data_len = params[1];
+            for (size_t off = 2; off + 1 + data_len <= nparams; off += 1u + data_len) {
+                uint8_t target = params[off];
+                if (servo_reachable(target)) {
+                    servo_write(&servos[target], addr, &params[off + 1], data_len, end_us);
+                }
+            }
+            break;
+        }
+
+        case INST_SYNC_READ: {
+            if (nparams < 2) {
+                break;
+            }
+            uint8_t addr = params[0];
+            uint8_t data_len = params[1];
+            // Servos answer in the order they are listed, each after the previous reply
+            for (size_t off = 2; off < nparams; off++) {
+                uint8_t target = params[off];
+                if (!servo_reachable(target)) {
+                    stats.dropped_frames++;
+                    continue;
+                }
+                read_registers(&servos[target], addr, data_len, data, end_us);
+                reply_end = send_reply(target, data, data_len, reply_end);
+            }
+            break;
+        }
+
+        default:
+            stats.dropped_frames++;
+            break;
+    }
+
+    if (reply_end > wire_free_us) {
+        wire_free_us = reply_end;
+    }
+}
+
+void sim_bus_transmit(const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&bus_lock);
+    uint64_t now = shim_now_us();
+    uint64_t start = wire_free_us > now ? wire_free_us : now;
+    uint64_t end = start + byte_time_us(len);
+    wire_free_us = end;
+    stats.tx_bytes += len;
+    stats.busy_us += end - start;
+    stats.last_tx_end_us = end;
+
+    if (bus_config.echo) {
+        schedule_chunk(end, data, len);
+    }
+
+    // Reassemble frames; garbage before a header is ignored like a real servo would
+    for (size_t i = 0; i < len; i++) {
+        if (tx_len < 2 && data[i] != 0xFF) {
+            tx_len = 0;
+            continue;
+        }
+        if (tx_len == 2 && data[i] == 0xFF) {
+            continue;  // Extra header byte, stay in sync
+        }
+        tx_frame[tx_len++] = data[i];
+        if (tx_len >= 4 && tx_len == (size_t)tx_frame[3] + 4u) {
+            stats.tx_frames++;
+            process_frame(tx_frame, tx_len, end);
+            tx_len = 0;
+        } else if (tx_len >= MAX_FRAME) {
+            tx_len = 0;
+        }
+    }
+    pthread_mutex_unlock(&bus_lock);
+}
+
+uint64_t sim_bus_tx_done_us(void) {
+    pthread_mutex_lock(&bus_lock);
+    uint64_t done = stats.last_tx_end_us;
+    pthread_mutex_unlock(&bus_lock);
+    return done;
+}
+
+uint64_t sim_bus_wire_time_us(size_t bytes) {
+    return byte_time_us(bytes);
+}
+
+static void *bus_thread(void *arg) {
+    (void)arg;
+    sim_chunk_t chunk;
+    pthread_mutex_lock(&bus_lock);
+    for (;;) {
+        while (pending_count == 0) {
+            pthread_cond_wait(&bus_cond, &bus_lock);
+        }
+        uint64_t due = pending[pending_head].due_us;
+        if (shim_now_us() < due) {
+            pthread_mutex_unlock(&bus_lock);
+            shim_sleep_until_us(due);
+            pthread_mutex_lock(&bus_lock);
+            continue;
+        }
+        chunk = pending[pending_head];
+        pending_head = (pending_head + 1) % MAX_PENDING;
+        pending_count--;
+        pthread_mutex_unlock(&bus_lock);
+        shim_uart_rx_push(chunk.data, chunk.len);
+        pthread_mutex_lock(&bus_lock);
+    }
+    return NULL;
+}
+
+void sim_bus_init(const sim_bus_config_t *config) {
+    pthread_mutex_lock(&bus_lock);
+    bus_config = *config;
+    if (bus_config.baud_rate == 0) {
+        bus_config.baud_rate = 1000000;
+    }
+    uint64_t now = shim_now_us();
+    for (int i = 0; i < config->num_servos; i++) {
+        uint8_t id = (uint8_t)(config->first_id + i);
+        sim_servo_t *servo = &servos[id];
+        memset(servo, 0, sizeof(*servo));
+        servo->present = true;
+        servo->online = true;
+        servo->regs[REG_ID] = id;
+        servo->regs[REG_TORQUE_ENABLE] = 1;
+        servo->regs[REG_ACC] = 0;
+        set_reg16(servo, REG_MAX_ANGLE, 4095);
+        set_reg16(servo, REG_TORQUE_LIMIT, 1000);
+        // Power up slightly off centre so reads are distinguishable from defaults
+        servo->position = 2048.0f + (float)(i * 10);
+        set_reg16(servo, REG_GOAL_POSITION, (uint16_t)servo->position);
+        servo->cruise_speed = SIM_MAX_SPEED_STEPS;
+        servo->last_update_us = now;
+        servo_update(servo, now);
+    }
+    shim_cond_init(&bus_cond);
+    pthread_mutex_unlock(&bus_lock);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, bus_thread, NULL);
+    pthread_detach(thread);
+}
+
+void sim_bus_get_stats(sim_bus_stats_t *out) {
+    pthread_mutex_lock(&bus_lock);
+    *out = stats;
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void sim_bus_reset_stats(void) {
+    pthread_mutex_lock(&bus_lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void sim_bus_set_online(uint8_t servo_id, bool online) {
+    pthread_mutex_lock(&bus_lock);
+    servos[servo_id].online = online;
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void sim_bus_set_corruption(uint32_t one_in_n) {
+    pthread_mutex_lock(&bus_lock);
+    corrupt_one_in = one_in_n;
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void sim_bus_move_by_hand(uint8_t servo_id, uint16_t position) {
+    pthread_mutex_lock(&bus_lock);
+    sim_servo_t *servo = &servos[servo_id];
+    servo_update(servo, shim_now_us());
+    if (!servo->regs[REG_TORQUE_ENABLE]) {
+        servo->position = (float)position;
+        servo_update(servo, shim_now_us());
+    }
+    pthread_mutex_unlock(&bus_lock);
+}
+
+void sim_bus_set_load_offset(uint8_t servo_id, int16_t load) {
+    pthread_mutex_lock(&bus_lock);
+    servos[servo_id].load_offset = load;
+    pthread_mutex_unlock(&bus_lock);
+}
+
+bool sim_bus_read_registers(uint8_t servo_id, uint8_t regs[SIM_REG_COUNT]) {
+    pthread_mutex_lock(&bus_lock);
+    sim_servo_t *servo = &servos[servo_id];
+    bool ok = servo->present;
+    if (ok) {
+        servo_update(servo, shim_now_us());
+        memcpy(regs, servo->regs, SIM_REG_COUNT);
+    }
+    pthread_mutex_unlock(&bus_lock);
+    return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef SIM_SERVO_BUS_H
+#define SIM_SERVO_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Virtual STS3214 bus behind the host UART shim.
+//
+// Frames written with uart_write_bytes() occupy the wire for 10 bit times per
+// byte at the configured baud rate. Each addressed servo decodes the frame
+// once its last byte has landed, waits its return delay, and its reply is
+// delivered to the UART RX buffer (and event queue) when the reply's last
+// byte would have arrived. Servo positions follow the goal position using
+// the goal time/speed registers, so reads observe real motion.
+
+#define SIM_MAX_SERVOS            16
+#define SIM_REG_COUNT             0x50
+#define SIM_RETURN_DELAY_US       20
+#define SIM_MAX_SPEED_STEPS       3400.0f
+
+typedef struct {
+    uint8_t num_servos;        // Servos with consecutive IDs
+    uint8_t first_id;
+    uint32_t baud_rate;
+    bool echo;                 // Deliver our own TX bytes back to RX (half-duplex adapters)
+} sim_bus_config_t;
+
+typedef struct {
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t tx_frames;
+    uint32_t rx_frames;
+    uint32_t dropped_frames;   // Addressed to an offline or unknown servo
+    uint64_t busy_us;          // Wire time spent transmitting in either direction
+    uint64_t last_tx_end_us;   // When the most recent TX frame finished on the wire
+} sim_bus_stats_t;
+
+void sim_bus_init(const sim_bus_config_t *config);
+void sim_bus_get_stats(sim_bus_stats_t *stats);
+void sim_bus_reset_stats(void);
+
+// Fault injection and manual manipulation
+void sim_bus_set_online(uint8_t servo_id, bool online);
+void sim_bus_set_corruption(uint32_t one_in_n);
+void sim_bus_move_by_hand(uint8_t servo_id, uint16_t position);
+void sim_bus_set_load_offset(uint8_t servo_id, int16_t load);
+
+// Snapshot of a servo's register table with dynamics applied
+bool sim_bus_read_registers(uint8_t servo_id, uint8_t regs[SIM_REG_COUNT]);
+
+// Hooks used by the UART shim
+void sim_bus_transmit(const uint8_t *data, size_t len);
+uint64_t sim_bus_tx_done_us(void);
+uint64_t sim_bus_wire_time_us(size_t bytes);
+
+#endif // SIM_SERVO_BUS_H
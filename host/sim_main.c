@@ -0,0 +1,335 @@
+// Host simulation entry point.
+//
+// Brings the firmware up the same way app_main() does, but against the
+// simulated servo bus and the Bluedroid shim, then replays a command script
+// as if it came from a BLE central:
+//
+//   barm_sim [script]        (reads stdin when script is "-", built-in demo when omitted)
+//
+// Script lines (# starts a comment):
+//   connect <mtu>            connect and negotiate MTU
+//   disconnect
+//   write <hex bytes>        GATT write to the RX characteristic, e.g. "write 08"
+//   wait <ms>
+//   offline <id> / online <id>
+//   hand <id> <position>     move a servo by hand (only sticks with torque off)
+//   corrupt <one_in_n>       corrupt one reply byte in N (0 = off)
+//   positions                print simulated servo positions
+//   stats                    print bus and control loop statistics
+//   program <name> <points> <ms>  store a synthetic sweep in the trajectory store
+//   programs                 list stored programs and scripts
+//   script <name> <hex bytes>     store a sequence script (seq_vm.h)
+//   load <id> <load>         add a constant load reading to a servo
+//
+// Set BARM_SIM_FLASH=<file> to keep the trajectory partition between runs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_ble.h"
+#include "sim_servo_bus.h"
+#include "sts_servo.h"
+#include "joint_calib.h"
+#include "control_loop.h"
+#include "position_storage.h"
+#include "traj_store.h"
+#include "sequence_player.h"
+#include "ble_arm_control.h"
+#include "telemetry.h"
+#include "motion_monitor.h"
+#include "motion_queue.h"
+#include "teach_recorder.h"
+#include "seq_vm.h"
+
+static const char *TAG = "HOST_SIM";
+
+static const char *demo_script[] = {
+    "connect 185",
+    "write 08",                                 // Home
+    "wait 2200",
+    "positions",
+    "write 01 00 00 0c c8 00 00 00",           // Joint 0 -> 3072 in 200 ms
+    "wait 400",
+    "positions",
+    "write 03 00 00 00 00 00",                  // Save slot 0
+    "write 08",
+    "wait 2200",
+    "write 03 01 00 00 00 00",                  // Save slot 1
+    "write 05 00 01 00",                        // Play slots 0-1
+    "wait 3000",
+    "write 07",                                 // Status
+    "positions",
+    "stats",
+    "disconnect",
+    NULL,
+};
+
+/**
+ * Print notifications sent by the firmware
+ */
+static void on_notify(const uint8_t *data, uint16_t len, void *ctx) {
+    printf("notify (%u):", len);
+    for (int i = 0; i < len; i++) {
+        printf(" %02x", data[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * Print simulated servo positions
+ */
+static void print_positions(void) {
+    uint8_t regs[SIM_REG_COUNT];
+    printf("positions:");
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (sim_bus_read_registers(ARM_SERVO_ID_BASE + i, regs)) {
+            printf(" %d", regs[STS_ADDR_PRESENT_POSITION_L] | (regs[STS_ADDR_PRESENT_POSITION_H] << 8));
+        } else {
+            printf(" -");
+        }
+    }
+    printf("\n");
+}
+
+/**
+ * Print bus and control loop statistics
+ */
+static void print_stats(void) {
+    sim_bus_stats_t bus;
+    sts_bus_stats_t fw;
+    control_loop_stats_t loop;
+    position_storage_stats_t storage;
+    sim_bus_get_stats(&bus);
+    sts_bus_get_stats(&fw);
+    control_loop_get_stats(&loop);
+    position_storage_get_stats(&storage);
+
+    uint64_t elapsed = esp_timer_get_time();
+    printf("bus: tx %" PRIu64 " B / %" PRIu32 " frames, rx %" PRIu64 " B / %" PRIu32 " frames, "
+           "utilisation %.1f%%\n",
+           bus.tx_bytes, bus.tx_frames, bus.rx_bytes, bus.rx_frames,
+           elapsed > 0 ? 100.0 * bus.busy_us / elapsed : 0.0);
+    printf("firmware: transactions %" PRIu32 ", timeouts %" PRIu32 ", checksum errors %" PRIu32 ", "
+           "framing errors %" PRIu32 ", echoes %" PRIu32 "\n",
+           fw.transactions, fw.timeouts, fw.parser.checksum_errors, fw.parser.framing_errors, fw.echo_frames);
+    printf("control loop: %" PRIu32 " ticks, %" PRIu32 " writes, %" PRIu32 " overruns, "
+           "max jitter %" PRId32 " us\n",
+           loop.ticks, loop.writes, loop.overruns, loop.max_jitter_us);
+    printf("storage: %" PRIu32 " commits, %" PRIu32 " slots written (%" PRIu32 " B), pending 0x%04x\n",
+           storage.commits, storage.slots_written, storage.bytes_written, storage.pending);
+
+    motion_queue_stats_t queue;
+    uint8_t depth, free_slots;
+    motion_queue_get_stats(&queue);
+    motion_queue_get_level(&depth, &free_slots);
+    printf("motion queue: %" PRIu32 " pushed, %" PRIu32 " dropped, %" PRIu32 " windows, %" PRIu32 " underruns, "
+           "depth %d, free %d\n", queue.pushed, queue.dropped, queue.windows, queue.underruns, depth, free_slots);
+
+    seq_vm_stats_t vm;
+    seq_vm_get_stats(&vm);
+    printf("script cache: %" PRIu32 " hits, %" PRIu32 " misses\n", vm.cache_hits, vm.cache_misses);
+    for (int op = 0; op < SEQ_OP_COUNT; op++) {
+        if (vm.ops[op].count > 0) {
+            printf("  op 0x%02x: %" PRIu32 " runs, mean %.1f us, max %" PRIu32 " us\n", op, vm.ops[op].count,
+                   (double)vm.ops[op].total_us / vm.ops[op].count, vm.ops[op].max_us);
+        }
+    }
+}
+
+/**
+ * Store a program of `points` points, `period_ms` apart: every joint swings out from home and back
+ */
+static void store_program(const char *name, int points, int period_ms) {
+    static traj_store_writer_t writer;
+    esp_err_t ret = traj_store_begin(&writer, name);
+    for (int k = 0; k < points && ret == ESP_OK; k++) {
+        traj_store_point_t point = { .duration_ms = period_ms };
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            float swing = (j % 2 ? 1.0f : -1.0f) * (300 + 50 * j);
+            point.position[j] = STS_POSITION_CENTER +
+                                (int)(swing * (1.0f - cosf(2.0f * (float)M_PI * (k + 1) / points)));
+        }
+        ret = traj_store_append(&writer, &point);
+    }
+    if (ret == ESP_OK) {
+        ret = traj_store_commit(&writer);
+    } else {
+        traj_store_abort(&writer);
+    }
+    printf("program %s: %s\n", name, esp_err_to_name(ret));
+}
+
+/**
+ * Check and store a script given as hex tokens
+ */
+static void store_script(const char *name, char **hex, int count) {
+    static traj_store_writer_t writer;
+    uint8_t code[BLE_MAX_MTU];
+    uint32_t len = 0;
+    for (int i = 0; i < count; i++) {
+        code[len++] = (uint8_t)strtoul(hex[i], NULL, 16);
+    }
+
+    esp_err_t ret = seq_vm_verify(code, len);
+    if (ret == ESP_OK) {
+        ret = traj_store_begin_script(&writer, name);
+    }
+    if (ret == ESP_OK) {
+        ret = traj_store_write(&writer, code, len);
+        if (ret == ESP_OK) {
+            ret = traj_store_commit(&writer);
+        } else {
+            traj_store_abort(&writer);
+        }
+    }
+    printf("script %s: %s\n", name, esp_err_to_name(ret));
+}
+
+/**
+ * Print the trajectory store index
+ */
+static void print_programs(void) {
+    int count = traj_store_count();
+    printf("programs: %d, %" PRIu32 " KB free\n", count, traj_store_free_bytes() / 1024);
+    for (int i = 0; i < count; i++) {
+        traj_store_info_t info;
+        if (traj_store_get_info(i, &info) == ESP_OK) {
+            if (info.kind == TRAJ_STORE_KIND_SCRIPT) {
+                printf("  %-15s script %7" PRIu32 " bytes\n", info.name, info.data_len);
+            } else {
+                printf("  %-15s %6" PRIu32 " points %7" PRIu32 " bytes (%.1f B/point)\n",
+                       info.name, info.num_points, info.data_len, (double)info.data_len / info.num_points);
+            }
+        }
+    }
+}
+
+/**
+ * Execute one script line
+ */
+static void run_line(char *line) {
+    char *comment = strchr(line, '#');
+    if (comment != NULL) {
+        *comment = '\0';
+    }
+
+    char *tokens[BLE_MAX_MTU + 1];
+    int count = 0;
+    for (char *tok = strtok(line, " \t\r\n"); tok != NULL && count < BLE_MAX_MTU + 1;
+         tok = strtok(NULL, " \t\r\n")) {
+        tokens[count++] = tok;
+    }
+    if (count == 0) {
+        return;
+    }
+    const char *cmd = tokens[0];
+    const char *arg1 = count > 1 ? tokens[1] : NULL;
+    const char *arg2 = count > 2 ? tokens[2] : NULL;
+
+    if (strcmp(cmd, "connect") == 0) {
+        host_ble_connect(arg1 != NULL ? atoi(arg1) : 23);
+        host_ble_drain();
+    } else if (strcmp(cmd, "disconnect") == 0) {
+        host_ble_disconnect();
+    } else if (strcmp(cmd, "write") == 0) {
+        uint8_t data[BLE_MAX_MTU];
+        uint16_t len = 0;
+        for (int i = 1; i < count; i++) {
+            data[len++] = (uint8_t)strtoul(tokens[i], NULL, 16);
+        }
+        host_ble_write(data, len);
+        host_ble_drain();  // Keep the script deterministic: the command has been handled
+    } else if (strcmp(cmd, "wait") == 0) {
+        vTaskDelay(pdMS_TO_TICKS(arg1 != NULL ? atoi(arg1) : 0));
+    } else if (strcmp(cmd, "offline") == 0 && arg1 != NULL) {
+        sim_bus_set_online(atoi(arg1), false);
+    } else if (strcmp(cmd, "online") == 0 && arg1 != NULL) {
+        sim_bus_set_online(atoi(arg1), true);
+    } else if (strcmp(cmd, "hand") == 0 && arg1 != NULL && arg2 != NULL) {
+        sim_bus_move_by_hand(atoi(arg1), atoi(arg2));
+    } else if (strcmp(cmd, "corrupt") == 0 && arg1 != NULL) {
+        sim_bus_set_corruption(atoi(arg1));
+    } else if (strcmp(cmd, "positions") == 0) {
+        print_positions();
+    } else if (strcmp(cmd, "stats") == 0) {
+        print_stats();
+    } else if (strcmp(cmd, "program") == 0 && count >= 4) {
+        store_program(arg1, atoi(arg2), atoi(tokens[3]));
+    } else if (strcmp(cmd, "programs") == 0) {
+        print_programs();
+    } else if (strcmp(cmd, "script") == 0 && count >= 3) {
+        store_script(arg1, &tokens[2], count - 2);
+    } else if (strcmp(cmd, "load") == 0 && arg1 != NULL && arg2 != NULL) {
+        sim_bus_set_load_offset(atoi(arg1), atoi(arg2));
+    } else {
+        ESP_LOGW(TAG, "Unknown script command: %s", cmd);
+    }
+}
+
+/**
+ * Bring the firmware up in app_main() order
+ */
+static int firmware_init(void) {
+    if (nvs_flash_init() != ESP_OK ||
+        sts_servo_init() != ESP_OK ||
+        joint_calib_init() != ESP_OK ||
+        control_loop_init() != ESP_OK ||
+        position_storage_init() != ESP_OK ||
+        traj_store_init() != ESP_OK ||
+        sequence_player_init() != ESP_OK ||
+        telemetry_init() != ESP_OK ||
+        motion_monitor_init() != ESP_OK ||
+        motion_queue_init() != ESP_OK ||
+        teach_recorder_init() != ESP_OK ||
+        ble_arm_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Firmware init failed");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    sim_bus_config_t bus_config = {
+        .num_servos = ARM_NUM_JOINTS,
+        .first_id = ARM_SERVO_ID_BASE,
+        .baud_rate = UART_BAUD_RATE,
+        .echo = getenv("BARM_SIM_ECHO") != NULL,
+    };
+    sim_bus_init(&bus_config);
+    host_ble_set_notify_handler(on_notify, NULL);
+
+    if (firmware_init() != 0) {
+        return 1;
+    }
+
+    if (argc < 2) {
+        char line[1024];
+        for (int i = 0; demo_script[i] != NULL; i++) {
+            snprintf(line, sizeof(line), "%s", demo_script[i]);
+            run_line(line);
+        }
+    } else {
+        FILE *script = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "r");
+        if (script == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+        char line[1024];
+        while (fgets(line, sizeof(line), script) != NULL) {
+            run_line(line);
+        }
+        if (script != stdin) {
+            fclose(script);
+        }
+    }
+
+    host_ble_drain();
+    return 0;
+}
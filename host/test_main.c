@@ -0,0 +1,683 @@
+// Host unit tests for the plain-C cores: reply parser, trajectory generator,
+// setpoint limiter, waypoint codec, script verifier and kinematics, plus the
+// trajectory store on the simulated flash partition.
+//
+//   barm_tests               (run by ctest)
+//
+// Prints one line per failed check and a summary; exits non-zero on any
+// failure. Logs go to stderr (quiet by default, override with BARM_LOG_LEVEL).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "sts_parser.h"
+#include "trajectory.h"
+#include "joint_limiter.h"
+#include "waypoint_codec.h"
+#include "seq_vm.h"
+#include "kinematics.h"
+#include "traj_store.h"
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(cond, ...) do {                                       \
+        checks++;                                                   \
+        if (!(cond)) {                                              \
+            failures++;                                             \
+            printf("FAIL %s:%d: ", __func__, __LINE__);             \
+            printf(__VA_ARGS__);                                    \
+            printf("\n");                                           \
+        }                                                           \
+    } while (0)
+
+#define SAMPLE_DT_S     0.001f
+#define TICK_S          0.005f      // Control loop period at 200 Hz
+
+static const float home[TRAJ_NUM_JOINTS] = { 2048, 2048, 2048, 2048, 2048, 2048 };
+
+// Packets collected by parser_collect
+typedef struct {
+    sts_reply_t packets[8];
+    int count;
+} parser_sink_t;
+
+static void parser_collect(const sts_reply_t *packet, void *ctx) {
+    parser_sink_t *sink = ctx;
+    if (sink->count < 8) {
+        sink->packets[sink->count] = *packet;
+    }
+    sink->count++;
+}
+
+// Position reply from servo 3: 2048
+static const uint8_t reply_pos[] = { 0xFF, 0xFF, 0x03, 0x04, 0x00, 0x00, 0x08, 0xF0 };
+
+/**
+ * A packet split over any number of feeds comes out whole, once
+ */
+static void test_parser_split(void) {
+    for (size_t cut = 1; cut < sizeof(reply_pos); cut++) {
+        sts_parser_t parser;
+        parser_sink_t sink = {0};
+        sts_parser_init(&parser);
+        sts_parser_feed(&parser, reply_pos, cut, parser_collect, &sink);
+        CHECK(sink.count == 0, "cut %zu: packet before its last byte", cut);
+        sts_parser_feed(&parser, &reply_pos[cut], sizeof(reply_pos) - cut, parser_collect, &sink);
+        CHECK(sink.count == 1 && sink.packets[0].id == 3 && sink.packets[0].length == 2 &&
+              sink.packets[0].params[0] == 0x00 && sink.packets[0].params[1] == 0x08,
+              "cut %zu: %d packets", cut, sink.count);
+    }
+
+    sts_parser_t parser;
+    parser_sink_t sink = {0};
+    sts_parser_init(&parser);
+    for (size_t i = 0; i < sizeof(reply_pos); i++) {
+        sts_parser_feed(&parser, &reply_pos[i], 1, parser_collect, &sink);
+    }
+    CHECK(sink.count == 1 && sts_parser_idle(&parser), "byte by byte: %d packets", sink.count);
+}
+
+/**
+ * Noise, stray headers and a false start do not hide the packet behind them
+ */
+static void test_parser_resync(void) {
+    // Garbage, an extra header byte, then a header with an impossible length
+    uint8_t stream[32];
+    const uint8_t noise[] = { 0x12, 0x00, 0xFF, 0x55, 0xFF, 0xFF, 0xFF, 0x07, 0x40 };
+    memcpy(stream, noise, sizeof(noise));
+    memcpy(&stream[sizeof(noise)], reply_pos, sizeof(reply_pos));
+
+    sts_parser_t parser;
+    parser_sink_t sink = {0};
+    sts_parser_init(&parser);
+    sts_parser_feed(&parser, stream, sizeof(noise) + sizeof(reply_pos), parser_collect, &sink);
+    CHECK(sink.count == 1 && sink.packets[0].id == 3, "%d packets after noise", sink.count);
+    CHECK(parser.stats.framing_errors == 1, "%u framing errors", (unsigned)parser.stats.framing_errors);
+    CHECK(parser.stats.discarded_bytes > 0, "nothing discarded");
+    CHECK(sts_parser_idle(&parser), "parser left mid-packet");
+}
+
+/**
+ * A bad checksum drops the packet; the next good one still parses
+ */
+static void test_parser_checksum(void) {
+    uint8_t stream[2 * sizeof(reply_pos)];
+    memcpy(stream, reply_pos, sizeof(reply_pos));
+    stream[sizeof(reply_pos) - 1] ^= 0x01;
+    memcpy(&stream[sizeof(reply_pos)], reply_pos, sizeof(reply_pos));
+
+    sts_parser_t parser;
+    parser_sink_t sink = {0};
+    sts_parser_init(&parser);
+    sts_parser_feed(&parser, stream, sizeof(stream), parser_collect, &sink);
+    CHECK(sink.count == 1, "%d packets", sink.count);
+    CHECK(parser.stats.checksum_errors == 1, "%u checksum errors", (unsigned)parser.stats.checksum_errors);
+    CHECK(parser.stats.packets == 1, "%u packets counted", (unsigned)parser.stats.packets);
+}
+
+/**
+ * Our own sync write and ping read back as echo, not errors; only the first copy
+ */
+static void test_parser_echo(void) {
+    // SYNC WRITE of goal position to servos 1 and 2
+    uint8_t sync[] = { 0xFF, 0xFF, 0xFE, 0x0A, 0x83, 0x2A, 0x02, 0x01, 0x00, 0x08, 0x02, 0x00, 0x08, 0x00 };
+    uint8_t sum = 0;
+    for (size_t i = 2; i < sizeof(sync) - 1; i++) {
+        sum += sync[i];
+    }
+    sync[sizeof(sync) - 1] = ~sum;
+
+    sts_parser_t parser;
+    parser_sink_t sink = {0};
+    sts_parser_init(&parser);
+    for (int i = 0; i < 100; i++) {
+        sts_parser_expect_echo(&parser, sync, sizeof(sync));
+        sts_parser_feed(&parser, sync, sizeof(sync), parser_collect, &sink);
+    }
+    CHECK(parser.stats.echo_frames == 100 && parser.stats.echo_bytes == 100 * sizeof(sync),
+          "%u echoes, %u bytes", (unsigned)parser.stats.echo_frames, (unsigned)parser.stats.echo_bytes);
+    CHECK(parser.stats.framing_errors == 0 && parser.stats.discarded_bytes == 0,
+          "%u framing errors, %u discarded", (unsigned)parser.stats.framing_errors,
+          (unsigned)parser.stats.discarded_bytes);
+    CHECK(sink.count == 0, "%d packets from echoes", sink.count);
+
+    // PING servo 1, answered with the input-voltage flag: the same bytes twice
+    const uint8_t ping[] = { 0xFF, 0xFF, 0x01, 0x02, 0x01, 0xFB };
+    sts_parser_expect_echo(&parser, ping, sizeof(ping));
+    sts_parser_feed(&parser, ping, sizeof(ping), parser_collect, &sink);
+    sts_parser_feed(&parser, ping, sizeof(ping), parser_collect, &sink);
+    CHECK(sink.count == 1 && sink.packets[0].id == 1 && sink.packets[0].error == STS_ERR_VOLTAGE,
+          "ping reply after its echo: %d packets", sink.count);
+
+    // No echo on the line: the reply that shares the frame's header still parses
+    sts_parser_expect_echo(&parser, sync, sizeof(sync));
+    sts_parser_feed(&parser, reply_pos, sizeof(reply_pos), parser_collect, &sink);
+    CHECK(sink.count == 2 && sink.packets[1].id == 3, "reply without echo: %d packets", sink.count);
+}
+
+/**
+ * Largest |velocity| and |acceleration| of any joint, sampled every millisecond
+ */
+static void plan_extremes(traj_plan_t *plan, float *v_peak, float *a_peak) {
+    float q[TRAJ_NUM_JOINTS];
+    float v[TRAJ_NUM_JOINTS];
+    float v_prev[TRAJ_NUM_JOINTS];
+    *v_peak = 0.0f;
+    *a_peak = 0.0f;
+    traj_sample(plan, 0.0f, q, v_prev);
+    for (float t = SAMPLE_DT_S; t <= plan->total_s; t += SAMPLE_DT_S) {
+        traj_sample(plan, t, q, v);
+        for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+            *v_peak = fmaxf(*v_peak, fabsf(v[j]));
+            *a_peak = fmaxf(*a_peak, fabsf(v[j] - v_prev[j]) / SAMPLE_DT_S);
+            v_prev[j] = v[j];
+        }
+    }
+}
+
+/**
+ * All joints share the segment time: they start, move in proportion and arrive together
+ */
+static void test_traj_timing(void) {
+    traj_config_t config;
+    traj_config_default(&config);
+
+    traj_waypoint_t wp = {
+        .q = { 3072, 2048, 1500, 2100, 2048, 2500 },
+        .duration_s = 1.5f,
+    };
+    traj_plan_t plan;
+    CHECK(traj_plan(&plan, &config, home, &wp, 1), "plan failed");
+    CHECK(fabsf(plan.total_s - 1.5f) < 1e-3f, "total %.4f s, asked for 1.5 s", plan.total_s);
+
+    float q[TRAJ_NUM_JOINTS];
+    CHECK(traj_sample(&plan, 0.0f, q, NULL), "finished at t=0");
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        CHECK(fabsf(q[j] - home[j]) < 1e-3f, "joint %d starts at %.3f", j, q[j]);
+    }
+
+    traj_sample(&plan, 0.6f, q, NULL);
+    float progress = (q[0] - home[0]) / (wp.q[0] - home[0]);
+    CHECK(progress > 0.0f && progress < 1.0f, "joint 0 progress %.3f mid-move", progress);
+    for (int j = 1; j < TRAJ_NUM_JOINTS; j++) {
+        if (wp.q[j] != home[j]) {
+            float p = (q[j] - home[j]) / (wp.q[j] - home[j]);
+            CHECK(fabsf(p - progress) < 1e-3f, "joint %d at %.4f of its move, joint 0 at %.4f", j, p, progress);
+        }
+    }
+
+    CHECK(!traj_sample(&plan, plan.total_s, q, NULL), "still running at the end");
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        CHECK(fabsf(q[j] - wp.q[j]) < 1e-2f, "joint %d ends at %.3f, expected %.0f", j, q[j], wp.q[j]);
+    }
+}
+
+/**
+ * A move asked to be too quick is stretched until every profile stays within vmax and amax
+ */
+static void test_traj_limits(void) {
+    for (int profile = 0; profile < TRAJ_PROFILE_COUNT; profile++) {
+        traj_config_t config;
+        traj_config_default(&config);
+        config.profile = (traj_profile_t)profile;
+
+        traj_waypoint_t wp = {
+            .q = { 4000, 100, 2048, 3000, 2048, 2048 },
+            .duration_s = 0.2f,
+        };
+        traj_plan_t plan;
+        CHECK(traj_plan(&plan, &config, home, &wp, 1), "profile %d: plan failed", profile);
+        CHECK(plan.total_s >= traj_min_duration(&config, 1952.0f) - 1e-3f,
+              "profile %d: %.3f s is quicker than the limits allow", profile, plan.total_s);
+
+        float v_peak;
+        float a_peak;
+        plan_extremes(&plan, &v_peak, &a_peak);
+        CHECK(v_peak <= config.vmax * 1.01f, "profile %d: peak velocity %.0f > %.0f", profile, v_peak, config.vmax);
+        CHECK(a_peak <= config.amax * 1.05f, "profile %d: peak acceleration %.0f > %.0f", profile, a_peak, config.amax);
+    }
+}
+
+/**
+ * Blended waypoints are passed through without stopping, with continuous position and velocity
+ */
+static void test_traj_blend(void) {
+    for (int profile = TRAJ_PROFILE_CUBIC; profile <= TRAJ_PROFILE_QUINTIC; profile++) {
+        traj_config_t config;
+        traj_config_default(&config);
+        config.profile = (traj_profile_t)profile;
+
+        traj_waypoint_t wps[3] = {
+            { .q = { 2600, 2200, 2048, 2048, 2048, 2048 } },
+            { .q = { 3200, 2400, 2100, 2048, 2048, 2048 } },
+            { .q = { 3600, 2500, 2300, 2048, 2048, 2048 } },
+        };
+        traj_plan_t plan;
+        CHECK(traj_plan(&plan, &config, home, wps, 3), "profile %d: plan failed", profile);
+
+        for (int s = 1; s < plan.num_segments; s++) {
+            float t = plan.segments[s].t_start;
+            float q0[TRAJ_NUM_JOINTS], v0[TRAJ_NUM_JOINTS];
+            float q1[TRAJ_NUM_JOINTS], v1[TRAJ_NUM_JOINTS];
+            traj_sample_at(&plan, t - 1e-4f, q0, v0);
+            traj_sample_at(&plan, t + 1e-4f, q1, v1);
+            for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+                CHECK(fabsf(q1[j] - q0[j]) < 1.0f, "profile %d: joint %d jumps %.2f at segment %d",
+                      profile, j, q1[j] - q0[j], s);
+                CHECK(fabsf(v1[j] - v0[j]) < 0.01f * config.vmax, "profile %d: joint %d velocity jumps %.1f at segment %d",
+                      profile, j, v1[j] - v0[j], s);
+            }
+            CHECK(v0[0] > 0.0f, "profile %d: joint 0 stops at waypoint %d", profile, plan.segments[s - 1].waypoint);
+        }
+    }
+}
+
+/**
+ * Consecutive windows join at the first window's end velocity
+ */
+static void test_traj_windows(void) {
+    traj_config_t config;
+    traj_config_default(&config);
+
+    traj_waypoint_t path[4] = {
+        { .q = { 2400, 2048, 2048, 2048, 2048, 2048 } },
+        { .q = { 2800, 2100, 2048, 2048, 2048, 2048 } },
+        { .q = { 3200, 2200, 2048, 2048, 2048, 2048 } },
+        { .q = { 3400, 2300, 2048, 2048, 2048, 2048 } },
+    };
+    float rest[TRAJ_NUM_JOINTS] = {0};
+    traj_plan_t first;
+    traj_plan_t second;
+    CHECK(traj_plan_window(&first, &config, home, rest, path, 2, &path[2]), "first window failed");
+    CHECK(first.end_vel[0] > 0.0f, "first window stops at its end");
+    CHECK(traj_plan_window(&second, &config, path[1].q, first.end_vel, &path[2], 2, NULL), "second window failed");
+
+    float q0[TRAJ_NUM_JOINTS], v0[TRAJ_NUM_JOINTS];
+    float q1[TRAJ_NUM_JOINTS], v1[TRAJ_NUM_JOINTS];
+    // Sampled just before the end; a finished plan reports rest
+    traj_sample_at(&first, first.total_s - 1e-4f, q0, v0);
+    traj_sample_at(&second, 0.0f, q1, v1);
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        CHECK(fabsf(q1[j] - q0[j]) < 0.5f, "joint %d jumps %.2f between windows", j, q1[j] - q0[j]);
+        CHECK(fabsf(v1[j] - v0[j]) < 0.01f * config.vmax, "joint %d velocity jumps %.1f between windows", j, v1[j] - v0[j]);
+    }
+}
+
+static const joint_limits_t test_limits = {
+    .vmax = 3000.0f,
+    .amax = 20000.0f,
+    .jmax = 20000.0f / 0.05f,
+};
+
+/**
+ * A jump of the goal comes out within the limits and lands without overshooting
+ */
+static void test_limiter_step_response(void) {
+    joint_limiter_t jl;
+    joint_limiter_reset(&jl, 0.0f);
+    joint_limiter_set_goal(&jl, 2000.0f, 0.0f, 0.0f);
+
+    float p_max = 0.0f;
+    float v_max = 0.0f;
+    float a_max = 0.0f;
+    int steps = 0;
+    while (joint_limiter_step(&jl, &test_limits, TICK_S) && steps < 1000) {
+        p_max = fmaxf(p_max, jl.p);
+        v_max = fmaxf(v_max, fabsf(jl.v));
+        a_max = fmaxf(a_max, fabsf(jl.a));
+        steps++;
+    }
+    CHECK(steps < 1000, "never settled, at %.2f", jl.p);
+    CHECK(jl.p == 2000.0f && jl.v == 0.0f, "settled at %.2f moving %.2f", jl.p, jl.v);
+    CHECK(p_max <= 2000.0f + JOINT_LIMITER_SETTLE_STEPS, "overshot to %.2f", p_max);
+    CHECK(v_max <= test_limits.vmax * 1.001f, "velocity %.0f over the limit", v_max);
+    CHECK(a_max <= test_limits.amax * 1.001f, "acceleration %.0f over the limit", a_max);
+}
+
+/**
+ * Track a goal streamed at a constant velocity for a second
+ */
+static void limiter_track(joint_limiter_t *jl, float velocity) {
+    joint_limiter_reset(jl, 0.0f);
+    float goal = 0.0f;
+    for (int i = 0; i < 200; i++) {
+        goal += velocity * TICK_S;
+        joint_limiter_set_goal(jl, goal, velocity, 0.0f);
+        joint_limiter_step(jl, &test_limits, TICK_S);
+    }
+}
+
+/**
+ * A stream stopped at speed brakes to rest within the stopping distance and stays there
+ */
+static void test_limiter_stop(void) {
+    joint_limiter_t jl;
+    limiter_track(&jl, 2000.0f);
+    float p0 = jl.p;
+    float v0 = jl.v;
+    CHECK(fabsf(v0 - 2000.0f) < 1.0f, "tracking at %.1f, streamed at 2000", v0);
+
+    // Jerk-limited braking: ramp out the acceleration left from tracking, then brake at amax
+    float a0 = fmaxf(jl.a, 0.0f);
+    float t_out = a0 / test_limits.jmax;
+    float v1 = v0 + a0 * t_out / 2.0f;
+    float stopping = v0 * t_out + a0 * t_out * t_out / 3.0f +
+                     v1 * v1 / (2.0f * test_limits.amax) + v1 * test_limits.amax / (2.0f * test_limits.jmax);
+    joint_limiter_stop(&jl, &test_limits, 0.0f, 4095.0f);
+    CHECK(jl.goal_v == 0.0f, "goal still moving at %.1f", jl.goal_v);
+
+    float p_prev = jl.p;
+    bool reversed = false;
+    int steps = 0;
+    while (joint_limiter_step(&jl, &test_limits, TICK_S) && steps < 1000) {
+        reversed |= jl.p < p_prev - 1e-3f;
+        p_prev = jl.p;
+        steps++;
+    }
+    CHECK(steps < 1000, "never came to rest, at %.2f moving %.2f", jl.p, jl.v);
+    CHECK(!reversed, "turned back while braking");
+    CHECK(jl.p >= p0 && jl.p <= p0 + stopping + 1.0f, "rested %.2f past the stop, stopping distance %.2f",
+          jl.p - p0, stopping);
+
+    // No creep once at rest
+    float rest = jl.p;
+    for (int i = 0; i < 5000; i++) {
+        joint_limiter_step(&jl, &test_limits, TICK_S);
+    }
+    CHECK(jl.p == rest, "crept from %.2f to %.2f", rest, jl.p);
+}
+
+/**
+ * Stopping near the end of the range comes back to rest inside it
+ */
+static void test_limiter_stop_clamped(void) {
+    joint_limiter_t jl;
+    limiter_track(&jl, 2000.0f);
+    float hi = jl.p + 20.0f;
+    joint_limiter_stop(&jl, &test_limits, 0.0f, hi);
+
+    int steps = 0;
+    while (joint_limiter_step(&jl, &test_limits, TICK_S) && steps < 1000) {
+        steps++;
+    }
+    CHECK(jl.p == hi && jl.v == 0.0f, "rested at %.2f, range ends at %.2f", jl.p, hi);
+}
+
+/**
+ * The end of a stream still lands on its last point, however slow the last sample was
+ */
+static void test_limiter_stream_end(void) {
+    joint_limiter_t jl;
+    joint_limiter_reset(&jl, 3000.0f);
+    float goal = 3000.0f;
+    for (int i = 0; i < 20; i++) {
+        goal += 0.3f * TICK_S * 50.0f;
+        joint_limiter_set_goal(&jl, goal, 0.3f * 50.0f, 0.0f);
+        joint_limiter_step(&jl, &test_limits, TICK_S);
+    }
+    float last = jl.goal;
+    joint_limiter_stop(&jl, &test_limits, 0.0f, 4095.0f);
+    CHECK(fabsf(jl.goal - last) < 0.5f, "moved the goal from %.2f to %.2f", last, jl.goal);
+    for (int i = 0; i < 5000; i++) {
+        joint_limiter_step(&jl, &test_limits, TICK_S);
+    }
+    CHECK(jl.p == jl.goal && jl.v == 0.0f, "rests at %.2f, goal %.2f", jl.p, jl.goal);
+}
+
+/**
+ * Encoded points decode to the same positions and timing
+ */
+static void test_waypoint_codec(void) {
+    arm_position_t points[3] = {0};
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        points[0].joints[j] = (joint_position_t){ .position = 2048, .time_ms = 500, .speed = 0 };
+        points[1].joints[j] = (joint_position_t){ .position = (uint16_t)(2048 + 37 * j), .time_ms = 500, .speed = 0 };
+        points[2].joints[j] = (joint_position_t){ .position = (uint16_t)(4095 - 300 * j), .time_ms = (uint16_t)(100 * j), .speed = 800 };
+    }
+    points[1].delay_after_ms = 250;
+
+    uint8_t buf[3 * WP_ENCODED_MAX_LEN];
+    size_t len = waypoint_encode_list(points, 3, buf, sizeof(buf));
+    CHECK(len > 0 && len < sizeof(points), "encoded to %zu bytes", len);
+
+    arm_position_t decoded[3];
+    int count = waypoint_decode_list(buf, len, decoded, 3);
+    CHECK(count == 3, "decoded %d points", count);
+    for (int i = 0; i < count; i++) {
+        CHECK(decoded[i].delay_after_ms == points[i].delay_after_ms, "point %d delay %u", i, (unsigned)decoded[i].delay_after_ms);
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            CHECK(memcmp(&decoded[i].joints[j], &points[i].joints[j], sizeof(joint_position_t)) == 0,
+                  "point %d joint %d decoded as %u/%u/%u", i, j, decoded[i].joints[j].position,
+                  decoded[i].joints[j].time_ms, decoded[i].joints[j].speed);
+        }
+    }
+}
+
+/**
+ * Jumps and calls must land on an instruction; offset 0 is inside the header
+ */
+static void test_seq_vm_verify(void) {
+    // MOVE_SLOT 0; JUMP 4
+    uint8_t loop[] = { 0x53, 0x51, SEQ_VM_VERSION, 0, SEQ_OP_MOVE_SLOT, 0, SEQ_OP_JUMP, 4, 0 };
+    CHECK(seq_vm_verify(loop, sizeof(loop)) == ESP_OK, "valid loop rejected");
+
+    uint8_t jump0[] = { 0x53, 0x51, SEQ_VM_VERSION, 0, SEQ_OP_JUMP, 0, 0 };
+    CHECK(seq_vm_verify(jump0, sizeof(jump0)) != ESP_OK, "JUMP 0 accepted");
+
+    uint8_t call0[] = { 0x53, 0x51, SEQ_VM_VERSION, 0, SEQ_OP_CALL, 0, 0 };
+    CHECK(seq_vm_verify(call0, sizeof(call0)) != ESP_OK, "CALL 0 accepted");
+
+    // JCMP v0 == 0 -> 0
+    uint8_t jcmp0[] = { 0x53, 0x51, SEQ_VM_VERSION, 0, SEQ_OP_JCMP, 0, SEQ_CMP_EQ, 0, 0, 0, 0 };
+    CHECK(seq_vm_verify(jcmp0, sizeof(jcmp0)) != ESP_OK, "JCMP to 0 accepted");
+
+    uint8_t header[] = { 0x53, 0x51, SEQ_VM_VERSION, 0, SEQ_OP_JUMP, 2, 0 };
+    CHECK(seq_vm_verify(header, sizeof(header)) != ESP_OK, "jump into the header accepted");
+
+    // JUMP into the operand of MOVE_SLOT
+    uint8_t middle[] = { 0x53, 0x51, SEQ_VM_VERSION, 0, SEQ_OP_MOVE_SLOT, 0, SEQ_OP_JUMP, 5, 0 };
+    CHECK(seq_vm_verify(middle, sizeof(middle)) != ESP_OK, "jump into an operand accepted");
+}
+
+/**
+ * Solving a pose reached by forward kinematics gives back the joints it came from
+ */
+static void test_kinematics_round_trip(void) {
+    static const float poses[][TRAJ_NUM_JOINTS] = {
+        { 2348, 2448, 2548, 1748, 2248, 2048 },
+        { 1500, 1800, 2600, 2300, 1900, 3000 },
+        { 2900, 2200, 2900, 1800, 2048, 1000 },
+    };
+    for (size_t i = 0; i < sizeof(poses) / sizeof(poses[0]); i++) {
+        kin_pose_t pose;
+        kin_forward(poses[i], &pose);
+
+        float q[TRAJ_NUM_JOINTS];
+        bool solved = kin_inverse(&pose, poses[i], q);
+        CHECK(solved, "pose %zu: no solution", i);
+        if (!solved) {
+            continue;
+        }
+        for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+            CHECK(fabsf(q[j] - poses[i][j]) < 0.5f, "pose %zu: joint %d solved as %.2f, was %.0f",
+                  i, j, q[j], poses[i][j]);
+        }
+    }
+}
+
+/**
+ * At the kinematic zero the arm stands straight up with the tool pointing up
+ */
+static void test_kinematics_zero(void) {
+    float q[TRAJ_NUM_JOINTS];
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        q[j] = KIN_STEP_ZERO;
+    }
+    kin_pose_t pose;
+    kin_forward(q, &pose);
+    float height = KIN_BASE_HEIGHT_MM + KIN_UPPER_ARM_MM + KIN_FOREARM_MM + KIN_TOOL_MM;
+    CHECK(fabsf(pose.x) < 0.01f && fabsf(pose.y) < 0.01f && fabsf(pose.z - height) < 0.01f,
+          "tool at %.2f, %.2f, %.2f", pose.x, pose.y, pose.z);
+    CHECK(fabsf(pose.pitch - (float)M_PI_2) < 1e-4f, "pitch %.4f", pose.pitch);
+}
+
+/**
+ * Poses out of reach have no solution and leave nothing half-solved to act on
+ */
+static void test_kinematics_unreachable(void) {
+    float seed[TRAJ_NUM_JOINTS];
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        seed[j] = KIN_STEP_ZERO;
+    }
+    float q[TRAJ_NUM_JOINTS];
+    kin_pose_t far = { .x = 1000.0f, .y = 0.0f, .z = 100.0f, .pitch = 0.0f, .roll = 0.0f };
+    CHECK(!kin_inverse(&far, seed, q), "solved a pose 1 m away");
+}
+
+/**
+ * Of the elbow-up and elbow-down solutions, the one nearer the seed is kept
+ */
+static void test_kinematics_branch(void) {
+    // Elbow bent one way, then the mirror pose of the same tool point
+    static const float up[TRAJ_NUM_JOINTS] = { 2048, 1748, 2548, 2048, 2048, 2048 };
+    kin_pose_t pose;
+    kin_forward(up, &pose);
+
+    float q[TRAJ_NUM_JOINTS];
+    CHECK(kin_inverse(&pose, up, q), "no solution near the seed");
+    CHECK(fabsf(q[KIN_JOINT_ELBOW] - up[KIN_JOINT_ELBOW]) < 0.5f, "elbow %.2f with the seed on its branch",
+          q[KIN_JOINT_ELBOW]);
+
+    float seed[TRAJ_NUM_JOINTS];
+    memcpy(seed, up, sizeof(seed));
+    seed[KIN_JOINT_ELBOW] = 2 * KIN_STEP_ZERO - up[KIN_JOINT_ELBOW];
+    CHECK(kin_inverse(&pose, seed, q), "no solution near the mirrored seed");
+    CHECK((q[KIN_JOINT_ELBOW] - KIN_STEP_ZERO) * (up[KIN_JOINT_ELBOW] - KIN_STEP_ZERO) < 0.0f,
+          "elbow %.2f stayed on the seed's far branch", q[KIN_JOINT_ELBOW]);
+
+    kin_pose_t check;
+    kin_forward(q, &check);
+    CHECK(fabsf(check.x - pose.x) < 0.1f && fabsf(check.y - pose.y) < 0.1f && fabsf(check.z - pose.z) < 0.1f,
+          "other branch reaches %.2f, %.2f, %.2f", check.x, check.y, check.z);
+}
+
+/**
+ * Store a one-point program under `name`
+ */
+static esp_err_t store_program(const char *name, uint16_t position) {
+    traj_store_writer_t writer;
+    esp_err_t ret = traj_store_begin(&writer, name);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    traj_store_point_t point = { .duration_ms = 100 };
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        point.position[j] = position;
+    }
+    ret = traj_store_append(&writer, &point);
+    if (ret != ESP_OK) {
+        traj_store_abort(&writer);
+        return ret;
+    }
+    return traj_store_commit(&writer);
+}
+
+/**
+ * First joint position of a stored program, 0 if it cannot be read
+ */
+static uint16_t stored_position(const char *name) {
+    traj_store_reader_t reader;
+    traj_store_point_t point = {0};
+    if (traj_store_open(name, &reader) != ESP_OK) {
+        return 0;
+    }
+    traj_store_read(&reader, &point);
+    traj_store_close(&reader);
+    return point.position[0];
+}
+
+/**
+ * Positions past the servo range are refused at append, never stored wrapped
+ */
+static void test_traj_store_range(void) {
+    CHECK(traj_store_init() == ESP_OK, "store did not mount");
+
+    traj_store_writer_t writer;
+    traj_store_point_t point = { .position = { 2048, 2048, 2048, 2048, 2048, 2048 }, .duration_ms = 100 };
+    CHECK(traj_store_begin(&writer, "range") == ESP_OK, "begin failed");
+    CHECK(traj_store_append(&writer, &point) == ESP_OK, "in-range point refused");
+    point.position[2] = STS_POSITION_MAX + 1;
+    CHECK(traj_store_append(&writer, &point) == ESP_ERR_INVALID_ARG, "out-of-range point accepted");
+    CHECK(writer.num_points == 1, "%u points written", (unsigned)writer.num_points);
+    traj_store_abort(&writer);
+}
+
+/**
+ * With the index full, replacing an open program fails and leaves the old one in place
+ */
+static void test_traj_store_full_index(void) {
+    CHECK(traj_store_init() == ESP_OK, "store did not mount");
+
+    char name[TRAJ_STORE_NAME_LEN];
+    for (int i = 0; i < TRAJ_STORE_MAX_PROGRAMS; i++) {
+        snprintf(name, sizeof(name), "p%d", i);
+        CHECK(store_program(name, 1000) == ESP_OK, "program %d not stored", i);
+    }
+    CHECK(traj_store_count() == TRAJ_STORE_MAX_PROGRAMS, "%d programs", traj_store_count());
+    CHECK(store_program("extra", 1000) == ESP_ERR_NO_MEM, "stored past a full index");
+
+    // Replacing a closed program reuses its slot
+    CHECK(store_program("p0", 2000) == ESP_OK, "replace refused");
+    CHECK(stored_position("p0") == 2000, "p0 reads %u", stored_position("p0"));
+
+    // Open at begin: no slot to take
+    traj_store_reader_t reader;
+    CHECK(traj_store_open("p0", &reader) == ESP_OK, "p0 did not open");
+    CHECK(store_program("p0", 3000) == ESP_ERR_NO_MEM, "replaced an open program with no free slot");
+    traj_store_close(&reader);
+    CHECK(stored_position("p0") == 2000, "p0 reads %u after the refused replace", stored_position("p0"));
+
+    // Opened between begin and commit
+    traj_store_writer_t writer;
+    traj_store_point_t point = { .position = { 4000, 4000, 4000, 4000, 4000, 4000 }, .duration_ms = 100 };
+    CHECK(traj_store_begin(&writer, "p1") == ESP_OK, "p1 replace refused at begin");
+    CHECK(traj_store_append(&writer, &point) == ESP_OK, "append failed");
+    CHECK(traj_store_open("p1", &reader) == ESP_OK, "p1 did not open");
+    CHECK(traj_store_commit(&writer) == ESP_ERR_NO_MEM, "committed with no free slot");
+    traj_store_close(&reader);
+    CHECK(stored_position("p1") == 1000, "p1 reads %u after the refused commit", stored_position("p1"));
+    CHECK(traj_store_count() == TRAJ_STORE_MAX_PROGRAMS, "%d programs", traj_store_count());
+}
+
+int main(void) {
+    if (getenv("BARM_LOG_LEVEL") == NULL) {
+        esp_log_level_set("*", ESP_LOG_NONE);
+    }
+
+    test_parser_split();
+    test_parser_resync();
+    test_parser_checksum();
+    test_parser_echo();
+    test_traj_timing();
+    test_traj_limits();
+    test_traj_blend();
+    test_traj_windows();
+    test_limiter_step_response();
+    test_limiter_stop();
+    test_limiter_stop_clamped();
+    test_limiter_stream_end();
+    test_waypoint_codec();
+    test_seq_vm_verify();
+    test_kinematics_round_trip();
+    test_kinematics_zero();
+    test_kinematics_unreachable();
+    test_kinematics_branch();
+    test_traj_store_range();
+    test_traj_store_full_index();
+
+    printf("%d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
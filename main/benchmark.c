@@ -0,0 +1,453 @@
+#include "benchmark.h"
+#include "ble_arm_control.h"
+#include "control_loop.h"
+#include "position_storage.h"
+#include "sequence_player.h"
+#include "kinematics.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+static const char *TAG = "BENCH";
+
+static const char *const scenario_names[BENCH_SCENARIO_COUNT] = {
+    "set_joint", "set_all", "save", "save_commanded", "sequence", "sync_write_burst", "kinematics",
+};
+
+// Motion frame capture, armed by the benchmark task and fired from the bus task
+static SemaphoreHandle_t tx_sem = NULL;
+static volatile bool tx_armed = false;
+static volatile int64_t tx_seen_us = 0;
+
+static uint32_t latencies[BENCH_MAX_ITERATIONS];
+static uint32_t pace_seed = 1;
+static uint32_t injected = 0;      // Commands injected during the current run
+
+/**
+ * Bus TX observer: record the first motion frame after arming
+ */
+static void bench_tx_hook(const uint8_t *frame, uint8_t len, int64_t tx_us) {
+    if (!tx_armed || len < 6) {
+        return;
+    }
+
+    uint8_t inst = frame[4];
+    bool motion = inst == STS_CMD_SYNC_WRITE ||
+                  (inst == STS_CMD_WRITE && frame[5] == STS_ADDR_GOAL_POSITION_L);
+    if (!motion) {
+        return;
+    }
+
+    tx_armed = false;
+    tx_seen_us = tx_us;
+    xSemaphoreGive(tx_sem);
+}
+
+/**
+ * Deliver a command as a GATT write event; returns time spent in the handler
+ */
+static uint32_t bench_inject(void *data, uint16_t len) {
+    esp_ble_gatts_cb_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.write.len = len;
+    param.write.value = data;
+    param.write.need_rsp = false;
+
+    injected++;
+    int64_t start = esp_timer_get_time();
+    ble_gatts_event_handler(ESP_GATTS_WRITE_EVT, ESP_GATT_IF_NONE, &param);
+    return (uint32_t)(esp_timer_get_time() - start);
+}
+
+/**
+ * Wait until the command worker has executed `count` commands
+ */
+static bool bench_wait_executed(uint32_t count) {
+    int64_t deadline = esp_timer_get_time() + BENCH_TX_TIMEOUT_MS * 1000LL;
+    ble_cmd_stats_t stats;
+    do {
+        ble_get_command_stats(&stats);
+        if (stats.executed + stats.coalesced >= count) {
+            return true;
+        }
+        vTaskDelay(1);
+    } while (esp_timer_get_time() < deadline);
+    return false;
+}
+
+/**
+ * Inject a command and wait for the motion frame it causes
+ */
+static bool bench_measure(void *data, uint16_t len, uint32_t *latency_us, uint32_t *cpu_us) {
+    xSemaphoreTake(tx_sem, 0);  // Drop a stale capture
+    tx_armed = true;
+
+    int64_t start = esp_timer_get_time();
+    *cpu_us = bench_inject(data, len);
+    bool seen = xSemaphoreTake(tx_sem, pdMS_TO_TICKS(BENCH_TX_TIMEOUT_MS)) == pdTRUE;
+    tx_armed = false;
+
+    if (seen) {
+        *latency_us = (uint32_t)(tx_seen_us - start);
+    }
+    return seen;
+}
+
+/**
+ * Pseudo-random number, repeatable from run to run
+ */
+static uint32_t bench_random(void) {
+    pace_seed = pace_seed * 1103515245u + 12345u;
+    return pace_seed >> 8;
+}
+
+/**
+ * Wait between commands; the pseudo-random tail spreads injections across the loop period
+ */
+static void bench_pace(void) {
+    vTaskDelay(pdMS_TO_TICKS(BENCH_PACE_MS));
+
+    int64_t until = esp_timer_get_time() + bench_random() % BENCH_PACE_SPREAD_US;
+    while (esp_timer_get_time() < until) {
+    }
+}
+
+/**
+ * Comparison for qsort
+ */
+static int bench_compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Offset used to wiggle around the starting pose
+ */
+static uint16_t bench_jog(uint16_t base, int iteration) {
+    int pos = base + ((iteration & 1) ? BENCH_JOG_STEPS : -BENCH_JOG_STEPS);
+    if (pos < STS_POSITION_MIN) {
+        pos = STS_POSITION_MIN;
+    } else if (pos > STS_POSITION_MAX) {
+        pos = STS_POSITION_MAX;
+    }
+    return (uint16_t)pos;
+}
+
+/**
+ * Angle difference wrapped to -pi..pi
+ */
+static float bench_angle_error(float a, float b) {
+    return fabsf(atan2f(sinf(a - b), cosf(a - b)));
+}
+
+/**
+ * One batch of IK solves from random joint positions; returns solver time, counts misses
+ *
+ * Targets come from FK of the random positions and seeds sit a few steps
+ * off, like a warm start from the previous control tick.
+ */
+static uint32_t bench_kinematics(uint16_t *misses) {
+    static kin_pose_t targets[BENCH_KIN_BATCH];
+    static float seeds[BENCH_KIN_BATCH][TRAJ_NUM_JOINTS];
+    static float solutions[BENCH_KIN_BATCH][TRAJ_NUM_JOINTS];
+    static bool solved[BENCH_KIN_BATCH];
+
+    for (int n = 0; n < BENCH_KIN_BATCH; n++) {
+        float q[TRAJ_NUM_JOINTS];
+        for (int i = 0; i < TRAJ_NUM_JOINTS; i++) {
+            q[i] = STS_POSITION_CENTER - BENCH_KIN_RANGE + (float)(bench_random() % (2 * BENCH_KIN_RANGE + 1));
+            seeds[n][i] = q[i] - BENCH_KIN_SEED_STEPS + (float)(bench_random() % (2 * BENCH_KIN_SEED_STEPS + 1));
+        }
+        kin_forward(q, &targets[n]);
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (int n = 0; n < BENCH_KIN_BATCH; n++) {
+        solved[n] = kin_inverse(&targets[n], seeds[n], solutions[n]);
+    }
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    for (int n = 0; n < BENCH_KIN_BATCH; n++) {
+        kin_pose_t reached;
+        kin_forward(solutions[n], &reached);
+        float error_mm = sqrtf((reached.x - targets[n].x) * (reached.x - targets[n].x) +
+                               (reached.y - targets[n].y) * (reached.y - targets[n].y) +
+                               (reached.z - targets[n].z) * (reached.z - targets[n].z));
+        float error_mrad = 1000.0f * fmaxf(bench_angle_error(reached.pitch, targets[n].pitch),
+                                           bench_angle_error(reached.roll, targets[n].roll));
+        if (!solved[n] || error_mm > BENCH_KIN_TOLERANCE_MM || error_mrad > BENCH_KIN_TOLERANCE_MM) {
+            if (*misses < UINT16_MAX) {
+                (*misses)++;
+            }
+        }
+    }
+    return elapsed;
+}
+
+/**
+ * Get printable scenario name
+ */
+const char *benchmark_name(bench_scenario_t scenario) {
+    return scenario < BENCH_SCENARIO_COUNT ? scenario_names[scenario] : "unknown";
+}
+
+/**
+ * Run one scenario and fill in its result
+ */
+esp_err_t benchmark_run(bench_scenario_t scenario, uint16_t iterations, bench_result_t *result) {
+    if (scenario >= BENCH_SCENARIO_COUNT || iterations == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (iterations > BENCH_MAX_ITERATIONS) {
+        iterations = BENCH_MAX_ITERATIONS;
+    }
+    if (tx_sem == NULL) {
+        tx_sem = xSemaphoreCreateBinary();
+        if (tx_sem == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (sequence_player_is_running()) {
+        ESP_LOGE(TAG, "Sequence playing, not benchmarking");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(result, 0, sizeof(*result));
+    result->scenario = scenario;
+
+    arm_position_t base;
+    control_loop_get_target(&base);
+
+    if (scenario == BENCH_SEQUENCE) {
+        // Two scratch slots either side of the current pose
+        for (int s = 0; s < 2; s++) {
+            arm_position_t slot = base;
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                slot.joints[i].position = bench_jog(base.joints[i].position, s);
+                slot.joints[i].time_ms = 100;
+            }
+            slot.delay_after_ms = 0;
+            position_storage_save(s == 0 ? BENCH_SLOT_A : BENCH_SLOT_B, &slot);
+        }
+    }
+
+    sts_bus_set_tx_hook(bench_tx_hook);
+    ble_cmd_stats_t cmd_before;
+    ble_get_command_stats(&cmd_before);
+    injected = 0;
+    sts_bus_stats_t before;
+    sts_bus_get_stats(&before);
+    int64_t run_start = esp_timer_get_time();
+
+    uint16_t measured = 0;
+    uint64_t cpu_total = 0;
+
+    if (scenario == BENCH_SYNC_WRITE_BURST) {
+        // Bus throughput: full sync writes back to back from this task
+        while (measured < BENCH_MAX_ITERATIONS &&
+               esp_timer_get_time() - run_start < BENCH_BURST_MS * 1000LL) {
+            int64_t start = esp_timer_get_time();
+            esp_err_t ret = sts_servo_sync_write_position(&base);
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+            if (ret != ESP_OK) {
+                result->lost++;
+                continue;
+            }
+            latencies[measured++] = elapsed;
+            cpu_total += elapsed;
+        }
+        result->iterations = measured + result->lost;
+    } else if (scenario == BENCH_KINEMATICS) {
+        // Solver throughput; latency is per batch of BENCH_KIN_BATCH solves
+        uint64_t solve_us = 0;
+        for (int n = 0; n < iterations; n++) {
+            uint32_t elapsed = bench_kinematics(&result->lost);
+            latencies[measured++] = elapsed;
+            solve_us += elapsed;
+        }
+        cpu_total = solve_us;
+        result->iterations = iterations;
+        if (solve_us > 0) {
+            result->ops_per_s = (float)iterations * BENCH_KIN_BATCH * 1e6f / solve_us;
+        }
+    } else {
+        for (int n = 0; n < iterations; n++) {
+            uint32_t latency = 0;
+            uint32_t cpu = 0;
+            bool seen = false;
+
+            switch (scenario) {
+                case BENCH_SET_JOINT: {
+                    uint8_t joint = n % ARM_NUM_JOINTS;
+                    ble_joint_cmd_t cmd = {
+                        .cmd = CMD_SET_JOINT,
+                        .joint_id = joint,
+                        .position = bench_jog(base.joints[joint].position, n / ARM_NUM_JOINTS),
+                        .time_ms = 50,
+                        .speed = 0,
+                    };
+                    seen = bench_measure(&cmd, sizeof(cmd), &latency, &cpu);
+                    break;
+                }
+                case BENCH_SET_ALL: {
+                    ble_all_joints_cmd_t cmd = {
+                        .cmd = CMD_SET_ALL_JOINTS,
+                        .time_ms = 50,
+                        .speed = 0,
+                    };
+                    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                        cmd.positions[i] = bench_jog(base.joints[i].position, n);
+                    }
+                    seen = bench_measure(&cmd, sizeof(cmd), &latency, &cpu);
+                    break;
+                }
+                case BENCH_SAVE:
+                case BENCH_SAVE_COMMANDED: {
+                    // No motion frame; latency runs until the worker has finished the save
+                    ble_save_cmd_t cmd = {
+                        .cmd = CMD_SAVE_POSITION,
+                        .slot_id = BENCH_SLOT_A,
+                        .delay_ms = 0,
+                        .source = scenario == BENCH_SAVE ? SAVE_SOURCE_MEASURED : SAVE_SOURCE_COMMANDED,
+                    };
+                    int64_t start = esp_timer_get_time();
+                    cpu = bench_inject(&cmd, offsetof(ble_save_cmd_t, joints));   // Default timing
+                    seen = bench_wait_executed(cmd_before.executed + cmd_before.coalesced + injected);
+                    latency = (uint32_t)(esp_timer_get_time() - start);
+                    break;
+                }
+                case BENCH_SEQUENCE: {
+                    ble_sequence_cmd_t cmd = {
+                        .cmd = CMD_START_SEQUENCE,
+                        .start_slot = BENCH_SLOT_A,
+                        .end_slot = BENCH_SLOT_B,
+                        .loop = 0,
+                    };
+                    seen = bench_measure(&cmd, sizeof(cmd), &latency, &cpu);
+                    uint8_t stop = CMD_STOP_SEQUENCE;
+                    bench_inject(&stop, 1);
+                    // Let the player notice the stop before the next start
+                    vTaskDelay(pdMS_TO_TICKS(150));
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            cpu_total += cpu;
+            if (seen) {
+                latencies[measured++] = latency;
+            } else {
+                result->lost++;
+            }
+            bench_pace();
+        }
+        result->iterations = iterations;
+    }
+
+    // Bytes are counted when handed to the driver; let them reach the wire
+    // so the run's duration covers the bus time they take
+    uart_wait_tx_done(UART_PORT, pdMS_TO_TICKS(100));
+    int64_t run_end = esp_timer_get_time();
+    sts_bus_stats_t after;
+    sts_bus_get_stats(&after);
+    sts_bus_set_tx_hook(NULL);
+
+    // Handler time = GATT callback plus the worker's execution of the command
+    bench_wait_executed(cmd_before.executed + cmd_before.coalesced + injected);
+    ble_cmd_stats_t cmd_after;
+    ble_get_command_stats(&cmd_after);
+    cpu_total += cmd_after.exec_us_total - cmd_before.exec_us_total;
+
+    // Put the arm back where it started and drop the scratch slots
+    control_loop_set_target(&base);
+    if (scenario == BENCH_SAVE || scenario == BENCH_SAVE_COMMANDED || scenario == BENCH_SEQUENCE) {
+        position_storage_clear(BENCH_SLOT_A);
+        position_storage_clear(BENCH_SLOT_B);
+    }
+
+    if (measured > 0) {
+        qsort(latencies, measured, sizeof(latencies[0]), bench_compare);
+        result->lat_p50_us = latencies[(measured - 1) * 50 / 100];
+        result->lat_p99_us = latencies[(measured - 1) * 99 / 100];
+        result->lat_max_us = latencies[measured - 1];
+    }
+    if (result->iterations > 0) {
+        result->cpu_us = (uint32_t)(cpu_total / result->iterations);
+    }
+
+    result->duration_us = (uint32_t)(run_end - run_start);
+    float seconds = result->duration_us / 1e6f;
+    uint32_t frames = (after.tx_frames - before.tx_frames) +
+                      (after.parser.packets - before.parser.packets);
+    // Echoed frames are our own TX read back, not extra traffic on the line
+    uint32_t bytes = (after.tx_bytes - before.tx_bytes) + (after.rx_bytes - before.rx_bytes) -
+                     (after.echo_bytes - before.echo_bytes);
+    if (seconds > 0.0f) {
+        result->frames_per_s = frames / seconds;
+        result->bytes_per_s = bytes / seconds;
+        // 10 bit times per byte (start + 8 data + stop)
+        result->bus_utilisation = (bytes * 10.0f / UART_BAUD_RATE) / seconds;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * Print a result as one JSON line
+ */
+void benchmark_print(const bench_result_t *result) {
+    printf("BENCH {\"bench\":\"%s\",\"n\":%u,\"lost\":%u,"
+           "\"lat_p50_us\":%" PRIu32 ",\"lat_p99_us\":%" PRIu32 ",\"lat_max_us\":%" PRIu32 ","
+           "\"cpu_us\":%" PRIu32 ",\"duration_us\":%" PRIu32 ","
+           "\"frames_per_s\":%.1f,\"bytes_per_s\":%.1f,\"bus_util\":%.4f,\"ops_per_s\":%.0f}\n",
+           benchmark_name(result->scenario), result->iterations, result->lost,
+           result->lat_p50_us, result->lat_p99_us, result->lat_max_us,
+           result->cpu_us, result->duration_us,
+           result->frames_per_s, result->bytes_per_s, result->bus_utilisation, result->ops_per_s);
+}
+
+/**
+ * Run every scenario and print the results
+ *
+ * Fails if a scenario could not run or the kinematics round trip missed a pose.
+ */
+esp_err_t benchmark_run_all(uint16_t iterations) {
+    control_loop_stats_t loop;
+    control_loop_get_stats(&loop);
+    printf("BENCH {\"bench\":\"meta\",\"baud\":%d,\"loop_period_us\":%" PRIu32 ",\"iterations\":%u}\n",
+           UART_BAUD_RATE, loop.period_us, iterations);
+
+    esp_err_t first_error = ESP_OK;
+    for (int s = 0; s < BENCH_SCENARIO_COUNT; s++) {
+        // Sequence starts are slow (player poll + stop handshake), keep that run short
+        uint16_t n = s == BENCH_SEQUENCE ? (iterations / 10 > 5 ? iterations / 10 : 5) : iterations;
+        bench_result_t result;
+        esp_err_t ret = benchmark_run((bench_scenario_t)s, n, &result);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Scenario %s failed: %s", benchmark_name(s), esp_err_to_name(ret));
+            if (first_error == ESP_OK) {
+                first_error = ret;
+            }
+            continue;
+        }
+        benchmark_print(&result);
+        // The kinematics run doubles as the solver's round trip check
+        if (s == BENCH_KINEMATICS && result.lost > 0) {
+            ESP_LOGE(TAG, "IK missed %u of %u poses", result.lost, result.iterations);
+            if (first_error == ESP_OK) {
+                first_error = ESP_FAIL;
+            }
+        }
+    }
+    return first_error;
+}
@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "sts_servo.h"
+
+// Command-to-wire latency and bus throughput benchmarks.
+//
+// Commands are injected as GATT write events into ble_gatts_event_handler(),
+// so they take the same path as a phone write from the dispatcher onwards.
+// Latency runs from the injection to the first motion frame handed to the
+// UART. Results are printed as one JSON object per line (prefix "BENCH ").
+//
+// The kinematics scenario stays off the bus: it times batches of IK solves
+// and checks each against FK, counting misses as lost.
+
+#define BENCH_RUN_AT_BOOT         0       // Set to 1 to run all scenarios from app_main
+#define BENCH_DEFAULT_ITERATIONS  200
+#define BENCH_MAX_ITERATIONS      1000
+#define BENCH_TX_TIMEOUT_MS       200     // Give up waiting for a motion frame after this
+#define BENCH_PACE_MS             20      // Gap between injected commands
+#define BENCH_PACE_SPREAD_US      5000    // Extra spin so injections sample every control loop phase
+#define BENCH_BURST_MS            1000    // Duration of the sync write burst
+#define BENCH_SLOT_A              14      // Scratch slots for the save/sequence scenarios
+#define BENCH_SLOT_B              15
+#define BENCH_JOG_STEPS           8       // Motion scenarios wiggle around the current pose
+#define BENCH_KIN_BATCH           100     // IK solves per kinematics iteration
+#define BENCH_KIN_RANGE           1000    // Random joints within this many steps of center
+#define BENCH_KIN_SEED_STEPS      20      // Seeds are this far off the true solution at most
+#define BENCH_KIN_TOLERANCE_MM    0.5f    // Round trip error allowed, mm and mrad
+
+typedef enum {
+    BENCH_SET_JOINT = 0,          // CMD_SET_JOINT
+    BENCH_SET_ALL,                // CMD_SET_ALL_JOINTS
+    BENCH_SAVE,                   // CMD_SAVE_POSITION (sync read + NVS, no motion frame)
+    BENCH_SAVE_COMMANDED,         // CMD_SAVE_POSITION from the setpoint, no bus traffic
+    BENCH_SEQUENCE,               // CMD_START_SEQUENCE / CMD_STOP_SEQUENCE
+    BENCH_SYNC_WRITE_BURST,       // Back-to-back sync writes, bus throughput
+    BENCH_KINEMATICS,             // IK solves per second with a FK round trip check
+    BENCH_SCENARIO_COUNT
+} bench_scenario_t;
+
+typedef struct {
+    bench_scenario_t scenario;
+    uint16_t iterations;
+    uint16_t lost;                // Commands that produced no frame within BENCH_TX_TIMEOUT_MS
+                                  // (kinematics: solves that failed the round trip)
+    uint32_t lat_p50_us;
+    uint32_t lat_p99_us;
+    uint32_t lat_max_us;
+    uint32_t cpu_us;              // Mean time in the command handler (per transfer for the burst)
+    uint32_t duration_us;
+    float frames_per_s;           // Frames on the bus (both directions) over the run
+    float bytes_per_s;
+    float bus_utilisation;        // Wire time / run time at UART_BAUD_RATE
+    float ops_per_s;              // Kinematics: IK solves per second of solver time
+} bench_result_t;
+
+// Function prototypes
+esp_err_t benchmark_run(bench_scenario_t scenario, uint16_t iterations, bench_result_t *result);
+esp_err_t benchmark_run_all(uint16_t iterations);
+void benchmark_print(const bench_result_t *result);
+const char *benchmark_name(bench_scenario_t scenario);
+
+#endif // BENCHMARK_H
@@ -3,9 +3,24 @@
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "position_storage.h"
 #include "sequence_player.h"
+#include "control_loop.h"
+#include "cmd_ring.h"
+#include "telemetry.h"
+#include "traj_store.h"
+#include "waypoint_codec.h"
+#include "program_xfer.h"
+#include "motion_monitor.h"
+#include "motion_queue.h"
+#include "cartesian.h"
+#include "teach_recorder.h"
+#include "esp_timer.h"
 #include <string.h>
+#include <math.h>
+#include <inttypes.h>
 
 static const char *TAG = "BLE_ARM";
 
@@ -13,16 +28,17 @@ static const char *TAG = "BLE_ARM";
 static uint16_t arm_service_handle;
 static esp_gatt_if_t arm_gatts_if = ESP_GATT_IF_NONE;
 static uint16_t conn_id = 0xFFFF;
+static uint16_t conn_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
 
 // Characteristic handles
 static uint16_t rx_char_handle = 0;
 static uint16_t tx_char_handle = 0;
-static uint16_t joint_char_handle;
-static uint16_t all_joints_char_handle;
-static uint16_t save_char_handle;
-static uint16_t load_char_handle;
-static uint16_t play_char_handle;
-static uint16_t status_char_handle;
+
+// Command ingestion: filled by the GATT callback, drained by the worker task
+static cmd_ring_t cmd_ring;
+static TaskHandle_t cmd_task_handle = NULL;
+static ble_cmd_stats_t cmd_stats = {0};
+static portMUX_TYPE cmd_stats_lock = portMUX_INITIALIZER_UNLOCKED;
 
 // Cache last commanded positions (avoid reading from servos during movement)
 static uint16_t last_positions[ARM_NUM_JOINTS] = {2048, 2048, 2048, 2048, 2048, 2048};
@@ -75,6 +91,92 @@ static esp_ble_adv_params_t adv_params = {
     .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
 };
 
+/**
+ * Fill in the positions a save command asks for
+ *
+ * Measured joints that fail to answer fall back to their setpoint rather
+ * than being stored as zero.
+ */
+static esp_err_t ble_resolve_save_positions(const ble_save_cmd_t *cmd, arm_position_t *pos) {
+    switch (cmd->source) {
+        case SAVE_SOURCE_EXPLICIT:
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                if (cmd->joints[i].position > STS_POSITION_MAX) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                pos->joints[i].position = cmd->joints[i].position;
+            }
+            return ESP_OK;
+
+        case SAVE_SOURCE_MEASURED:
+        case SAVE_SOURCE_COMMANDED: {
+            arm_position_t target;
+            control_loop_get_target(&target);
+            uint8_t target_mask = control_loop_get_target_mask();
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                pos->joints[i].position = (target_mask & (1 << i)) ? target.joints[i].position
+                                                                   : last_positions[i];
+            }
+            if (cmd->source == SAVE_SOURCE_COMMANDED) {
+                return ESP_OK;
+            }
+
+            uint16_t positions[ARM_NUM_JOINTS];
+            uint8_t valid_mask = 0;
+            sts_servo_sync_read_positions(positions, &valid_mask);
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                if (valid_mask & (1 << i)) {
+                    pos->joints[i].position = positions[i];
+                } else {
+                    ESP_LOGW(TAG, "Joint %d not read, saving its setpoint", i);
+                }
+            }
+            return ESP_OK;
+        }
+
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+}
+
+/**
+ * Convert a pose from its wire format
+ */
+static void ble_pose_decode(const ble_pose_t *pose, kin_pose_t *out) {
+    out->x = pose->x / 10.0f;
+    out->y = pose->y / 10.0f;
+    out->z = pose->z / 10.0f;
+    out->pitch = pose->pitch / 1000.0f;
+    out->roll = pose->roll / 1000.0f;
+}
+
+/**
+ * Commands that move the arm, switch torque or remap joints; refused while a
+ * teach-in recording has torque off and the operator is guiding the arm
+ */
+static bool ble_cmd_drives_arm(uint8_t cmd) {
+    switch (cmd) {
+        case CMD_SET_JOINT:
+        case CMD_SET_ALL_JOINTS:
+        case CMD_MOVE_AND_WAIT:
+        case CMD_QUEUE_SEGMENTS:
+        case CMD_CART_MOVE:
+        case CMD_MOVE_L:
+        case CMD_MOVE_C:
+        case CMD_CART_JOG:
+        case CMD_SET_CALIB:
+        case CMD_LOAD_POSITION:
+        case CMD_START_SEQUENCE:
+        case CMD_PLAY_PROGRAM:
+        case CMD_RUN_SCRIPT:
+        case CMD_HOME_POSITION:
+        case CMD_SET_TORQUE:
+            return true;
+        default:
+            return false;
+    }
+}
+
 /**
  * Process received BLE command
  */
@@ -84,21 +186,24 @@ void ble_process_command(uint8_t *data, uint16_t len) {
     uint8_t cmd = data[0];
     ESP_LOGI(TAG, "Received command: 0x%02X, length: %d", cmd, len);
     
+    if (ble_cmd_drives_arm(cmd) && teach_recorder_is_recording()) {
+        ESP_LOGW(TAG, "Command 0x%02X refused while recording", cmd);
+        return;
+    }
+    
     switch (cmd) {
         case CMD_SET_JOINT: {
             if (len >= sizeof(ble_joint_cmd_t)) {
                 ble_joint_cmd_t *joint_cmd = (ble_joint_cmd_t *)data;
                 if (joint_cmd->joint_id < ARM_NUM_JOINTS) {
                     uint8_t servo_id = ARM_SERVO_ID_BASE + joint_cmd->joint_id;
-                    esp_err_t ret = sts_servo_set_position(servo_id, joint_cmd->position, 
-                                                           joint_cmd->time_ms, joint_cmd->speed);
-                    if (ret == ESP_OK) {
-                        // Cache the commanded position
-                        last_positions[joint_cmd->joint_id] = joint_cmd->position;
-                    }
-                    ESP_LOGI(TAG, "Set joint %d (servo %d) to position %d: %s", 
-                            joint_cmd->joint_id, servo_id, joint_cmd->position, 
-                            ret == ESP_OK ? "OK" : "FAIL");
+                    // The control loop puts the new setpoint on the bus at its next tick
+                    control_loop_set_joint(joint_cmd->joint_id, joint_cmd->position,
+                                           joint_cmd->time_ms, joint_cmd->speed);
+                    // Cache the commanded position
+                    last_positions[joint_cmd->joint_id] = joint_cmd->position;
+                    ESP_LOGI(TAG, "Set joint %d (servo %d) to position %d", 
+                            joint_cmd->joint_id, servo_id, joint_cmd->position);
                 } else {
                     ESP_LOGW(TAG, "Invalid joint_id: %d (max is %d)", joint_cmd->joint_id, ARM_NUM_JOINTS - 1);
                 }
@@ -124,32 +229,238 @@ void ble_process_command(uint8_t *data, uint16_t len) {
                     last_positions[i] = all_cmd->positions[i];
                 }
                 
-                esp_err_t ret = sts_servo_set_arm_position(&arm_pos);
-                ESP_LOGI(TAG, "Set all joints: %s", ret == ESP_OK ? "OK" : "FAIL");
+                control_loop_set_target(&arm_pos);
+                ESP_LOGI(TAG, "Set all joints: queued");
+            }
+            break;
+        }
+        
+        case CMD_MOVE_AND_WAIT: {
+            if (len >= sizeof(ble_move_wait_cmd_t)) {
+                ble_move_wait_cmd_t move_cmd;
+                memcpy(&move_cmd, data, sizeof(move_cmd));
+                arm_position_t arm_pos = {0};
+                uint16_t target[ARM_NUM_JOINTS];
+                for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                    target[i] = move_cmd.positions[i];
+                    arm_pos.joints[i].position = move_cmd.positions[i];
+                    arm_pos.joints[i].time_ms = move_cmd.time_ms;
+                    arm_pos.joints[i].speed = move_cmd.speed;
+                    last_positions[i] = move_cmd.positions[i];
+                }
+
+                motion_config_t arrival;
+                motion_monitor_get_config(&arrival);
+                // The control loop stretches time_ms by the feed override
+                uint8_t feed = control_loop_get_feed();
+                uint32_t move_ms = feed > 0 ? (uint32_t)move_cmd.time_ms * 100 / feed : move_cmd.time_ms;
+                uint32_t timeout_ms = move_ms +
+                                      (move_cmd.timeout_ms != 0 ? move_cmd.timeout_ms : arrival.timeout_ms);
+                control_loop_set_target(&arm_pos);
+                motion_monitor_watch(move_cmd.move_id, target, ARM_ALL_JOINTS_MASK, timeout_ms);
+                ESP_LOGI(TAG, "Move %d and wait, up to %" PRIu32 " ms", move_cmd.move_id, timeout_ms);
+            }
+            break;
+        }
+        
+        case CMD_SET_ARRIVAL: {
+            if (len >= sizeof(ble_arrival_cmd_t)) {
+                ble_arrival_cmd_t arrival_cmd;
+                memcpy(&arrival_cmd, data, sizeof(arrival_cmd));
+                motion_config_t arrival = {
+                    .tolerance = arrival_cmd.tolerance,
+                    .timeout_ms = arrival_cmd.timeout_ms,
+                };
+                motion_monitor_set_config(&arrival);
+            }
+            break;
+        }
+        
+        case CMD_QUEUE_SEGMENTS: {
+            if (len >= sizeof(ble_queue_cmd_t)) {
+                ble_queue_cmd_t queue_cmd;
+                memcpy(&queue_cmd, data, sizeof(queue_cmd));
+                uint16_t count = (len - sizeof(queue_cmd)) / sizeof(motion_segment_t);
+                // Copy out; the segments are not aligned in the command buffer
+                motion_segment_t segments[CMD_RING_MAX_PACKET / sizeof(motion_segment_t)];
+                if (queue_cmd.count > count || queue_cmd.count > sizeof(segments) / sizeof(segments[0])) {
+                    ESP_LOGW(TAG, "Queue segments: %d announced, %d sent", queue_cmd.count, count);
+                    break;
+                }
+                memcpy(segments, &data[sizeof(queue_cmd)], queue_cmd.count * sizeof(motion_segment_t));
+                uint8_t accepted = 0;
+                esp_err_t ret = motion_queue_push(segments, queue_cmd.count, queue_cmd.flags, &accepted);
+                if (ret == ESP_ERR_INVALID_STATE) {
+                    ESP_LOGW(TAG, "Queue segments refused while the player runs");
+                } else if (ret != ESP_OK) {
+                    ESP_LOGW(TAG, "Queue full: took %d of %d segments", accepted, queue_cmd.count);
+                }
+            }
+            break;
+        }
+        
+        case CMD_CART_MOVE: {
+            if (len >= sizeof(ble_cart_move_cmd_t)) {
+                ble_cart_move_cmd_t move_cmd;
+                memcpy(&move_cmd, data, sizeof(move_cmd));
+                kin_pose_t pose;
+                ble_pose_decode(&move_cmd.pose, &pose);
+                esp_err_t ret = cart_move(&pose, move_cmd.time_ms, move_cmd.speed);
+                ESP_LOGI(TAG, "Cartesian move to (%.1f, %.1f, %.1f) mm: %s", pose.x, pose.y, pose.z,
+                        ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_MOVE_L: {
+            if (len >= sizeof(ble_move_l_cmd_t)) {
+                ble_move_l_cmd_t move_cmd;
+                memcpy(&move_cmd, data, sizeof(move_cmd));
+                kin_pose_t pose;
+                ble_pose_decode(&move_cmd.pose, &pose);
+                esp_err_t ret = cart_move_linear(&pose, move_cmd.time_ms);
+                ESP_LOGI(TAG, "Line to (%.1f, %.1f, %.1f) mm: %s", pose.x, pose.y, pose.z,
+                        ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_MOVE_C: {
+            if (len >= sizeof(ble_move_c_cmd_t)) {
+                ble_move_c_cmd_t move_cmd;
+                memcpy(&move_cmd, data, sizeof(move_cmd));
+                kin_pose_t pose;
+                ble_pose_decode(&move_cmd.pose, &pose);
+                float via[3] = { move_cmd.via_x / 10.0f, move_cmd.via_y / 10.0f, move_cmd.via_z / 10.0f };
+                esp_err_t ret = cart_move_circular(via, &pose, move_cmd.time_ms);
+                ESP_LOGI(TAG, "Arc via (%.1f, %.1f, %.1f) to (%.1f, %.1f, %.1f) mm: %s",
+                        via[0], via[1], via[2], pose.x, pose.y, pose.z, ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_CART_JOG: {
+            if (len >= sizeof(ble_cart_jog_cmd_t)) {
+                ble_cart_jog_cmd_t jog_cmd;
+                memcpy(&jog_cmd, data, sizeof(jog_cmd));
+                kin_pose_t velocity = {
+                    .x = jog_cmd.vx,
+                    .y = jog_cmd.vy,
+                    .z = jog_cmd.vz,
+                    .pitch = jog_cmd.vpitch / 1000.0f,
+                    .roll = jog_cmd.vroll / 1000.0f,
+                };
+                if (cart_jog(&velocity) != ESP_OK) {
+                    ESP_LOGW(TAG, "Jog refused while the player runs");
+                }
+            }
+            break;
+        }
+        
+        case CMD_GET_POSE: {
+            ble_send_pose(len >= 2 ? data[1] : SAVE_SOURCE_MEASURED);
+            break;
+        }
+        
+        case CMD_SET_CALIB: {
+            if (len >= 2) {
+                joint_calib_t calib;
+                if (len >= sizeof(ble_calib_cmd_t)) {
+                    memcpy(&calib, data + 2, sizeof(calib));
+                } else if (len == 2) {
+                    // Joint id alone resets the joint to the defaults
+                    joint_calib_default(&calib);
+                } else {
+                    ESP_LOGW(TAG, "Calibration payload truncated: %d bytes", len);
+                    break;
+                }
+                if (sequence_player_get_state() != PLAYER_IDLE) {
+                    ESP_LOGW(TAG, "Calibration refused while the player runs");
+                    break;
+                }
+                if (joint_calib_set(data[1], &calib) != ESP_OK) {
+                    ESP_LOGW(TAG, "Calibration for joint %d refused", data[1]);
+                    break;
+                }
+                // Positions are now in the new joint steps; hold where the arm is
+                uint16_t positions[ARM_NUM_JOINTS];
+                uint8_t valid_mask = 0;
+                sts_servo_sync_read_positions(positions, &valid_mask);
+                control_loop_sync_to_measured(positions, valid_mask);
+                ble_send_calib(data[1]);
+            }
+            break;
+        }
+        
+        case CMD_GET_CALIB: {
+            if (len >= 2) {
+                ble_send_calib(data[1]);
+            } else {
+                for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                    ble_send_calib(i);
+                }
+            }
+            break;
+        }
+        
+        case CMD_TEACH_START: {
+            if (len > sizeof(ble_teach_cmd_t) && len - sizeof(ble_teach_cmd_t) < TRAJ_STORE_NAME_LEN) {
+                ble_teach_cmd_t *teach_cmd = (ble_teach_cmd_t *)data;
+                char name[TRAJ_STORE_NAME_LEN] = {0};
+                memcpy(name, &data[sizeof(ble_teach_cmd_t)], len - sizeof(ble_teach_cmd_t));
+                if (sequence_player_get_state() != PLAYER_IDLE) {
+                    ESP_LOGW(TAG, "Recording refused while the player runs");
+                    break;
+                }
+                motion_queue_clear();
+                cart_stop();
+                esp_err_t ret = teach_recorder_start(name, teach_cmd->rate_hz, teach_cmd->tolerance,
+                                                     teach_cmd->flags);
+                ESP_LOGI(TAG, "Start recording '%s': %s", name, ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_TEACH_STOP: {
+            esp_err_t ret = teach_recorder_stop(len < 2 || data[1] != 0);
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "Stop recording: not recording");
+            }
+            break;
+        }
+        
+        case CMD_SET_FEED: {
+            if (len >= 2) {
+                esp_err_t ret = control_loop_set_feed(data[1]);
+                if (ret != ESP_OK) {
+                    ESP_LOGW(TAG, "Feed override %d%% out of range", data[1]);
+                }
             }
             break;
         }
         
         case CMD_SAVE_POSITION: {
             if (len >= sizeof(ble_storage_cmd_t)) {
-                ble_storage_cmd_t *storage_cmd = (ble_storage_cmd_t *)data;
-                
-                // Read current positions from servos
-                arm_position_t current_pos = {0};
-                current_pos.delay_after_ms = storage_cmd->delay_ms;
+                ble_save_cmd_t save_cmd = {0};
+                memcpy(&save_cmd, data, len < sizeof(save_cmd) ? len : sizeof(save_cmd));
+                bool timed = len >= sizeof(ble_save_cmd_t);
                 
+                arm_position_t save_pos = {0};
+                save_pos.delay_after_ms = save_cmd.delay_ms;
+                esp_err_t ret = ESP_ERR_INVALID_ARG;
+                if (timed || save_cmd.source != SAVE_SOURCE_EXPLICIT) {
+                    ret = ble_resolve_save_positions(&save_cmd, &save_pos);
+                }
                 for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-                    uint16_t position;
-                    if (sts_servo_read_position(ARM_SERVO_ID_BASE + i, &position) == ESP_OK) {
-                        current_pos.joints[i].position = position;
-                        current_pos.joints[i].time_ms = 1000;  // Default 1 second
-                        current_pos.joints[i].speed = 1000;    // Default speed
-                    }
+                    save_pos.joints[i].time_ms = timed ? save_cmd.joints[i].time_ms : SAVE_DEFAULT_TIME_MS;
+                    save_pos.joints[i].speed = timed ? save_cmd.joints[i].speed : SAVE_DEFAULT_SPEED;
                 }
                 
-                esp_err_t ret = position_storage_save(storage_cmd->slot_id, &current_pos);
-                ESP_LOGI(TAG, "Save position to slot %d: %s", 
-                        storage_cmd->slot_id, ret == ESP_OK ? "OK" : "FAIL");
+                if (ret == ESP_OK) {
+                    ret = position_storage_save(save_cmd.slot_id, &save_pos);
+                }
+                ESP_LOGI(TAG, "Save position to slot %d (source %d): %s",
+                        save_cmd.slot_id, save_cmd.source, ret == ESP_OK ? "OK" : "FAIL");
             }
             break;
         }
@@ -161,10 +472,13 @@ void ble_process_command(uint8_t *data, uint16_t len) {
                 
                 esp_err_t ret = position_storage_load(storage_cmd->slot_id, &loaded_pos);
                 if (ret == ESP_OK) {
-                    ret = sts_servo_set_arm_position(&loaded_pos);
-                    ESP_LOGI(TAG, "Load position from slot %d: %s", 
-                            storage_cmd->slot_id, ret == ESP_OK ? "OK" : "FAIL");
+                    control_loop_set_target(&loaded_pos);
+                    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                        last_positions[i] = loaded_pos.joints[i].position;
+                    }
                 }
+                ESP_LOGI(TAG, "Load position from slot %d: %s", 
+                        storage_cmd->slot_id, ret == ESP_OK ? "OK" : "FAIL");
             }
             break;
         }
@@ -172,6 +486,11 @@ void ble_process_command(uint8_t *data, uint16_t len) {
         case CMD_START_SEQUENCE: {
             if (len >= sizeof(ble_sequence_cmd_t)) {
                 ble_sequence_cmd_t *seq_cmd = (ble_sequence_cmd_t *)data;
+                // Optional trailing bytes: interpolation profile, blend percent
+                if (len >= sizeof(ble_sequence_cmd_t) + 2) {
+                    sequence_player_set_profile((traj_profile_t)data[sizeof(ble_sequence_cmd_t)],
+                                                data[sizeof(ble_sequence_cmd_t) + 1] / 100.0f);
+                }
                 esp_err_t ret = sequence_player_start(seq_cmd->start_slot, 
                                                      seq_cmd->end_slot, 
                                                      seq_cmd->loop);
@@ -182,8 +501,74 @@ void ble_process_command(uint8_t *data, uint16_t len) {
             break;
         }
         
+        case CMD_PLAY_PROGRAM: {
+            // loop u8, then the program name (not terminated)
+            if (len >= 3 && len - 2 < TRAJ_STORE_NAME_LEN) {
+                char name[TRAJ_STORE_NAME_LEN] = {0};
+                memcpy(name, &data[2], len - 2);
+                esp_err_t ret = sequence_player_start_program(name, data[1] != 0);
+                ESP_LOGI(TAG, "Play program '%s' (loop=%d): %s", name, data[1],
+                        ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_RUN_SCRIPT: {
+            // Script name (not terminated)
+            if (len >= 2 && len - 1 < TRAJ_STORE_NAME_LEN) {
+                char name[TRAJ_STORE_NAME_LEN] = {0};
+                memcpy(name, &data[1], len - 1);
+                esp_err_t ret = sequence_player_start_script(name);
+                ESP_LOGI(TAG, "Run script '%s': %s", name, ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_UPLOAD_SLOTS: {
+            // Consecutive slots from first_slot; all or none are saved
+            if (len >= 2 && data[1] < MAX_STORAGE_SLOTS) {
+                uint8_t first = data[1];
+                arm_position_t points[MAX_STORAGE_SLOTS];
+                int count = waypoint_decode_list(&data[2], len - 2, points, MAX_STORAGE_SLOTS - first);
+                esp_err_t ret = count > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+                // Check every point the way position_storage_save does before
+                // the first save, so a bad one cannot leave earlier slots written
+                uint8_t encoded[WP_ENCODED_MAX_LEN];
+                for (int i = 0; i < count && ret == ESP_OK; i++) {
+                    if (waypoint_encode(NULL, &points[i], encoded) == 0) {
+                        ESP_LOGW(TAG, "Upload point %d out of range", i);
+                        ret = ESP_ERR_INVALID_ARG;
+                    }
+                }
+                for (int i = 0; i < count && ret == ESP_OK; i++) {
+                    ret = position_storage_save(first + i, &points[i]);
+                }
+                ESP_LOGI(TAG, "Upload %d slot(s) from %d in %d bytes: %s", count, first, len - 2,
+                        ret == ESP_OK ? "OK" : "FAIL");
+            }
+            break;
+        }
+        
+        case CMD_XFER_BEGIN:
+            program_xfer_begin(data, len);
+            break;
+        
+        case CMD_XFER_DATA:
+            program_xfer_data(data, len);
+            break;
+        
+        case CMD_XFER_END:
+            program_xfer_end(data, len);
+            break;
+        
+        case CMD_XFER_ACK:
+            program_xfer_next(data, len);
+            break;
+        
         case CMD_STOP_SEQUENCE: {
             sequence_player_stop();
+            motion_queue_clear();
+            cart_stop();
             ESP_LOGI(TAG, "Stop sequence");
             break;
         }
@@ -194,16 +579,21 @@ void ble_process_command(uint8_t *data, uint16_t len) {
             break;
         }
         
+        case CMD_GET_EXT_STATUS: {
+            ble_send_ext_status();
+            break;
+        }
+        
         case CMD_HOME_POSITION: {
-            // Move to center position
+            // Move to the calibrated zero
             arm_position_t home_pos = {0};
             for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-                home_pos.joints[i].position = STS_POSITION_CENTER;
+                home_pos.joints[i].position = joint_calib_home(i);
                 home_pos.joints[i].time_ms = 2000;
                 home_pos.joints[i].speed = 1000;
             }
-            esp_err_t ret = sts_servo_set_arm_position(&home_pos);
-            ESP_LOGI(TAG, "Move to home position: %s", ret == ESP_OK ? "OK" : "FAIL");
+            control_loop_set_target(&home_pos);
+            ESP_LOGI(TAG, "Move to home position");
             break;
         }
         
@@ -230,25 +620,141 @@ void ble_process_command(uint8_t *data, uint16_t len) {
                 if (enable) {
                     vTaskDelay(pdMS_TO_TICKS(100)); // Wait for servos to stabilize
                     ESP_LOGI(TAG, "Reading positions after torque enable...");
+                    uint16_t positions[ARM_NUM_JOINTS];
+                    uint8_t valid_mask = 0;
+                    sts_servo_sync_read_positions(positions, &valid_mask);
                     for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-                        uint16_t position;
-                        if (sts_servo_read_position(ARM_SERVO_ID_BASE + i, &position) == ESP_OK) {
-                            last_positions[i] = position;
-                            ESP_LOGD(TAG, "  Joint %d: %d", i, position);
+                        if (valid_mask & (1 << i)) {
+                            last_positions[i] = positions[i];
+                            ESP_LOGD(TAG, "  Joint %d: %d", i, positions[i]);
                         }
                     }
+                    // Hold where the arm was left instead of snapping back to the old setpoint
+                    control_loop_sync_to_measured(positions, valid_mask);
                     ble_send_status(); // Send updated positions to Flutter
                 }
             }
             break;
         }
         
+        case CMD_SUBSCRIBE_TELEMETRY: {
+            if (len >= sizeof(ble_telemetry_cmd_t)) {
+                ble_telemetry_cmd_t *tel_cmd = (ble_telemetry_cmd_t *)data;
+                if (tel_cmd->rate_hz == 0) {
+                    telemetry_stop();
+                } else {
+                    esp_err_t ret = telemetry_start(tel_cmd->rate_hz, tel_cmd->fields,
+                                                    tel_cmd->samples_per_notify);
+                    ESP_LOGI(TAG, "Subscribe telemetry %d Hz: %s", tel_cmd->rate_hz,
+                            ret == ESP_OK ? "OK" : "FAIL");
+                }
+            }
+            break;
+        }
+        
         default:
             ESP_LOGW(TAG, "Unknown command: 0x%02X", cmd);
             break;
     }
 }
 
+/**
+ * Queue a command for the worker; never blocks (called from the Bluedroid task)
+ */
+static void ble_enqueue_command(const uint8_t *data, uint16_t len) {
+    if (len < 1) {
+        return;
+    }
+
+    bool queued = cmd_ring_push(&cmd_ring, data, len);
+    unsigned depth = cmd_ring_count(&cmd_ring);
+
+    portENTER_CRITICAL(&cmd_stats_lock);
+    cmd_stats.received++;
+    if (!queued) {
+        cmd_stats.dropped++;
+    }
+    if (depth > cmd_stats.max_depth) {
+        cmd_stats.max_depth = depth;
+    }
+    portEXIT_CRITICAL(&cmd_stats_lock);
+
+    if (!queued) {
+        ESP_LOGW(TAG, "Command queue full, dropped 0x%02X", data[0]);
+        return;
+    }
+    xTaskNotifyGive(cmd_task_handle);
+}
+
+/**
+ * Command worker task: executes queued commands in order
+ */
+static void ble_cmd_task(void *pvParameters) {
+    (void)pvParameters;
+    ESP_LOGI(TAG, "Command worker started");
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        cmd_entry_t *entry;
+        while ((entry = cmd_ring_peek(&cmd_ring, 0)) != NULL) {
+            // A full setpoint queued right behind makes this one obsolete
+            cmd_entry_t *next = cmd_ring_peek(&cmd_ring, 1);
+            if (entry->data[0] == CMD_SET_ALL_JOINTS && next != NULL &&
+                next->data[0] == CMD_SET_ALL_JOINTS) {
+                cmd_ring_pop(&cmd_ring);
+                portENTER_CRITICAL(&cmd_stats_lock);
+                cmd_stats.coalesced++;
+                portEXIT_CRITICAL(&cmd_stats_lock);
+                continue;
+            }
+
+            int64_t start = esp_timer_get_time();
+            ble_process_command(entry->data, entry->len);
+            uint32_t exec_us = (uint32_t)(esp_timer_get_time() - start);
+            cmd_ring_pop(&cmd_ring);
+
+            portENTER_CRITICAL(&cmd_stats_lock);
+            cmd_stats.executed++;
+            cmd_stats.exec_us_total += exec_us;
+            if (exec_us > cmd_stats.max_exec_us) {
+                cmd_stats.max_exec_us = exec_us;
+            }
+            portEXIT_CRITICAL(&cmd_stats_lock);
+        }
+    }
+}
+
+/**
+ * Get command queue counters
+ */
+void ble_get_command_stats(ble_cmd_stats_t *stats) {
+    portENTER_CRITICAL(&cmd_stats_lock);
+    *stats = cmd_stats;
+    portEXIT_CRITICAL(&cmd_stats_lock);
+}
+
+/**
+ * Negotiated ATT MTU of the current connection
+ */
+uint16_t ble_get_mtu(void) {
+    return conn_mtu;
+}
+
+/**
+ * Send a notification on the TX characteristic
+ */
+esp_err_t ble_notify(const uint8_t *data, uint16_t len) {
+    if (conn_id == 0xFFFF || arm_gatts_if == ESP_GATT_IF_NONE || tx_char_handle == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len > conn_mtu - 3) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return esp_ble_gatts_send_indicate(arm_gatts_if, conn_id, tx_char_handle,
+                                       len, (uint8_t *)data, false);
+}
+
 /**
  * Send status notification
  */
@@ -260,14 +766,17 @@ void ble_send_status(void) {
     
     ble_status_t status = {0};
     status.is_moving = sequence_player_is_running();
-    status.current_slot = 0;  // Can be extended
+    status.current_slot = sequence_player_get_current_slot();
+    
+    // Read current positions from all servos in one bus transaction
+    uint16_t positions[ARM_NUM_JOINTS];
+    uint8_t valid_mask = 0;
+    sts_servo_sync_read_positions(positions, &valid_mask);
     
-    // Read current positions from all servos
     for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-        uint16_t position = 0xFFFF; // Will be set by read function
-        esp_err_t ret = sts_servo_read_position(ARM_SERVO_ID_BASE + i, &position);
+        uint16_t position = positions[i];
         
-        if (ret == ESP_OK && position != 0xFFFF && position <= 4095) {
+        if ((valid_mask & (1 << i)) && position <= 4095) {
             status.current_positions[i] = position;
             ESP_LOGD(TAG, "Joint %d (servo %d): position %d", i, ARM_SERVO_ID_BASE + i, position);
         } else {
@@ -277,8 +786,7 @@ void ble_send_status(void) {
     }
     
     // Send notification via TX characteristic
-    esp_err_t ret = esp_ble_gatts_send_indicate(arm_gatts_if, conn_id, tx_char_handle,
-                                sizeof(status), (uint8_t *)&status, false);
+    esp_err_t ret = ble_notify((uint8_t *)&status, sizeof(status));
     
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "Status sent successfully");
@@ -287,6 +795,114 @@ void ble_send_status(void) {
     }
 }
 
+/**
+ * Send extended status notification: full feedback, validity and error counters
+ */
+void ble_send_ext_status(void) {
+    if (conn_id == 0xFFFF || arm_gatts_if == ESP_GATT_IF_NONE || tx_char_handle == 0) {
+        ESP_LOGW(TAG, "Cannot send extended status: not connected");
+        return;
+    }
+    if (conn_mtu < sizeof(ble_ext_status_t) + 3) {
+        ESP_LOGW(TAG, "Extended status needs MTU >= %d (have %d)",
+                 (int)sizeof(ble_ext_status_t) + 3, conn_mtu);
+        return;
+    }
+
+    sts_feedback_t feedback[ARM_NUM_JOINTS] = {0};
+    uint8_t valid_mask = 0;
+    sts_servo_sync_read(STS_FB_ALL, feedback, &valid_mask, 0);
+
+    sts_bus_stats_t bus;
+    sts_bus_get_stats(&bus);
+
+    ble_ext_status_t status = {0};
+    status.tag = NOTIFY_TAG_EXT_STATUS;
+    status.version = EXT_STATUS_VERSION;
+    status.valid_mask = valid_mask;
+    status.player_state = sequence_player_get_state();
+    status.current_slot = sequence_player_get_current_slot();
+    status.timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    status.feed_pct = control_loop_get_feed();
+
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        ble_joint_status_t *js = &status.joints[i];
+        if (valid_mask & (1 << i)) {
+            js->position = feedback[i].position;
+            js->speed = feedback[i].speed;
+            js->load = feedback[i].load;
+            js->voltage = feedback[i].voltage;
+            js->temperature = feedback[i].temperature;
+            js->moving = feedback[i].moving;
+            js->error_flags = feedback[i].error;
+        }
+        js->read_errors = bus.read_errors[i] > UINT16_MAX ? UINT16_MAX : bus.read_errors[i];
+    }
+
+    esp_err_t ret = ble_notify((uint8_t *)&status, sizeof(status));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send extended status: %s", esp_err_to_name(ret));
+    }
+}
+
+/**
+ * Clamp a scaled pose coordinate into int16
+ */
+static int16_t ble_pose_field(float value) {
+    float rounded = roundf(value);
+    return rounded >= INT16_MAX ? INT16_MAX : rounded <= INT16_MIN ? INT16_MIN : (int16_t)rounded;
+}
+
+/**
+ * Convert a pose to its wire format
+ */
+static void ble_pose_encode(const kin_pose_t *pose, ble_pose_t *out) {
+    out->x = ble_pose_field(pose->x * 10.0f);
+    out->y = ble_pose_field(pose->y * 10.0f);
+    out->z = ble_pose_field(pose->z * 10.0f);
+    out->pitch = ble_pose_field(pose->pitch * 1000.0f);
+    out->roll = ble_pose_field(pose->roll * 1000.0f);
+}
+
+/**
+ * Send the tool pose of the measured positions or the setpoint
+ */
+void ble_send_pose(uint8_t source) {
+    ble_pose_notify_t notify = {
+        .tag = NOTIFY_TAG_POSE,
+        .source = source == SAVE_SOURCE_COMMANDED ? SAVE_SOURCE_COMMANDED : SAVE_SOURCE_MEASURED,
+    };
+    kin_pose_t pose;
+    if (cart_get_pose(notify.source == SAVE_SOURCE_MEASURED, &pose) == ESP_OK) {
+        notify.valid = 1;
+        ble_pose_encode(&pose, &notify.pose);
+    }
+
+    esp_err_t ret = ble_notify((uint8_t *)&notify, sizeof(notify));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send pose: %s", esp_err_to_name(ret));
+    }
+}
+
+/**
+ * Send one joint's calibration
+ */
+void ble_send_calib(uint8_t joint) {
+    if (joint >= ARM_NUM_JOINTS) {
+        return;
+    }
+    ble_calib_notify_t notify = {
+        .tag = NOTIFY_TAG_CALIB,
+        .joint = joint,
+    };
+    joint_calib_get(joint, &notify.calib);
+
+    esp_err_t ret = ble_notify((uint8_t *)&notify, sizeof(notify));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send calibration: %s", esp_err_to_name(ret));
+    }
+}
+
 /**
  * GATT Server event handler
  */
@@ -374,14 +990,19 @@ void ble_gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
             
         case ESP_GATTS_MTU_EVT:
             ESP_LOGI(TAG, "MTU exchanged: %d, sending initial status...", param->mtu.mtu);
-            // Send status after MTU exchange (connection is stable)
-            vTaskDelay(pdMS_TO_TICKS(100));
-            ble_send_status();
+            conn_mtu = param->mtu.mtu;
+            // Send status after MTU exchange (connection is stable); the worker reads the servos
+            {
+                uint8_t status_cmd = CMD_GET_STATUS;
+                ble_enqueue_command(&status_cmd, 1);
+            }
             break;
             
         case ESP_GATTS_DISCONNECT_EVT:
             ESP_LOGI(TAG, "Client disconnected, reason: 0x%02x", param->disconnect.reason);
             conn_id = 0xFFFF;
+            conn_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+            telemetry_stop();
             
             // Immediately restart advertising for quick reconnection
             esp_err_t ret = esp_ble_gap_start_advertising(&adv_params);
@@ -401,7 +1022,8 @@ void ble_gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
                     param->write.trans_id, ESP_GATT_OK, NULL);
             }
             
-            ble_process_command(param->write.value, param->write.len);
+            // Only copy and ack here: servo I/O must not stall the Bluetooth stack
+            ble_enqueue_command(param->write.value, param->write.len);
             break;
             
         default:
@@ -443,6 +1065,15 @@ esp_err_t ble_arm_init(void) {
     }
     ESP_ERROR_CHECK(ret);
     
+    // Command worker must exist before the first GATT event can queue work
+    cmd_ring_init(&cmd_ring);
+    BaseType_t task_ret = xTaskCreate(ble_cmd_task, "ble_cmd", BLE_CMD_TASK_STACK,
+                                      NULL, BLE_CMD_TASK_PRIORITY, &cmd_task_handle);
+    if (task_ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create command task");
+        return ESP_FAIL;
+    }
+    
     // Release classic BT memory
     ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
     
@@ -485,11 +1116,13 @@ esp_err_t ble_arm_init(void) {
     // Read initial servo positions and initialize cache
     vTaskDelay(pdMS_TO_TICKS(500));
     ESP_LOGI(TAG, "Reading initial servo positions...");
+    uint16_t positions[ARM_NUM_JOINTS];
+    uint8_t valid_mask = 0;
+    sts_servo_sync_read_positions(positions, &valid_mask);
     for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-        uint16_t position;
-        if (sts_servo_read_position(ARM_SERVO_ID_BASE + i, &position) == ESP_OK) {
-            last_positions[i] = position;  // Initialize cache with actual position
-            ESP_LOGI(TAG, "  Joint %d (Servo %d): position %d", i, ARM_SERVO_ID_BASE + i, position);
+        if (valid_mask & (1 << i)) {
+            last_positions[i] = positions[i];  // Initialize cache with actual position
+            ESP_LOGI(TAG, "  Joint %d (Servo %d): position %d", i, ARM_SERVO_ID_BASE + i, positions[i]);
         } else {
             ESP_LOGW(TAG, "  Joint %d (Servo %d): failed to read, using default 2048", i, ARM_SERVO_ID_BASE + i);
             last_positions[i] = 2048;  // Fallback to center
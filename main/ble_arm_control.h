@@ -4,6 +4,7 @@
 #include "esp_gap_ble_api.h"
 #include "esp_gatts_api.h"
 #include "sts_servo.h"
+#include "joint_calib.h"
 
 // BLE Service UUID: Custom ARM Control Service (128-bit UUIDs matching Flutter app)
 // Service UUID: 12345678-1234-1234-1234-123456789abc
@@ -28,6 +29,10 @@ static const uint8_t ARM_CHAR_TX_UUID[16] = {
 #define BLE_DEVICE_NAME           "ARM100_ESP32"
 #define BLE_MAX_MTU               500
 
+// Command worker: GATT writes are queued and executed off the Bluedroid task
+#define BLE_CMD_TASK_STACK        4096
+#define BLE_CMD_TASK_PRIORITY     10
+
 // Command types
 #define CMD_SET_JOINT             0x01
 #define CMD_SET_ALL_JOINTS        0x02
@@ -38,6 +43,48 @@ static const uint8_t ARM_CHAR_TX_UUID[16] = {
 #define CMD_GET_STATUS            0x07
 #define CMD_HOME_POSITION         0x08
 #define CMD_SET_TORQUE            0x09
+#define CMD_SUBSCRIBE_TELEMETRY   0x0A
+#define CMD_GET_EXT_STATUS        0x0B
+#define CMD_PLAY_PROGRAM          0x0C
+#define CMD_UPLOAD_SLOTS          0x0D    // first_slot u8, then waypoint_codec chain
+#define CMD_XFER_BEGIN            0x0E    // Program transfers, see program_xfer.h
+#define CMD_XFER_DATA             0x0F
+#define CMD_XFER_END              0x10
+#define CMD_XFER_ACK              0x11
+#define CMD_MOVE_AND_WAIT         0x12    // Notifies NOTIFY_TAG_MOTION_DONE on arrival
+#define CMD_SET_ARRIVAL           0x13    // Arrival tolerance and timeout, see motion_monitor.h
+#define CMD_RUN_SCRIPT            0x14    // Script name; upload with XFER_FLAG_SCRIPT, see seq_vm.h
+#define CMD_SET_FEED              0x15    // Feed override percent, see control_loop.h
+#define CMD_QUEUE_SEGMENTS        0x16    // Buffered motion, see motion_queue.h
+#define CMD_CART_MOVE             0x17    // Tool pose target, see cartesian.h
+#define CMD_CART_JOG              0x18    // Tool velocity, repeat to keep jogging
+#define CMD_GET_POSE              0x19    // Notifies NOTIFY_TAG_POSE
+#define CMD_MOVE_L                0x1A    // Straight line to a tool pose
+#define CMD_MOVE_C                0x1B    // Arc through a via point to a tool pose
+#define CMD_SET_CALIB             0x1C    // Joint calibration, see joint_calib.h
+#define CMD_GET_CALIB             0x1D    // Notifies NOTIFY_TAG_CALIB
+#define CMD_TEACH_START           0x1E    // Record a program by hand, see teach_recorder.h
+#define CMD_TEACH_STOP            0x1F    // save u8; notifies NOTIFY_TAG_TEACH_DONE
+
+// Notification tags: ble_status_t starts with is_moving (0/1), tagged notifications with >= 0x80
+#define NOTIFY_TAG_TELEMETRY      0x80
+#define NOTIFY_TAG_EXT_STATUS     0x81
+#define NOTIFY_TAG_XFER_ACK       0x82
+#define NOTIFY_TAG_XFER_DATA      0x83
+#define NOTIFY_TAG_MOTION_DONE    0x84
+#define NOTIFY_TAG_POSE           0x85
+#define NOTIFY_TAG_CALIB          0x86
+#define NOTIFY_TAG_TEACH_POINT    0x87
+#define NOTIFY_TAG_TEACH_DONE     0x88
+
+#define EXT_STATUS_VERSION        2       // Bump when ble_ext_status_t changes layout
+
+// Save sources (ble_save_cmd_t.source)
+#define SAVE_SOURCE_MEASURED      0       // One bulk read of the servos
+#define SAVE_SOURCE_COMMANDED     1       // Current setpoint, no bus traffic
+#define SAVE_SOURCE_EXPLICIT      2       // Positions from the payload
+#define SAVE_DEFAULT_TIME_MS      1000
+#define SAVE_DEFAULT_SPEED        1000
 
 // Response codes
 #define RESP_OK                   0x00
@@ -62,6 +109,109 @@ typedef struct __attribute__((packed)) {
     uint16_t speed;        // Common speed for all joints
 } ble_all_joints_cmd_t;
 
+// Move all joints and report arrival, 20 bytes so it fits the default MTU
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_MOVE_AND_WAIT
+    uint8_t move_id;       // Echoed in the completion notification
+    uint16_t positions[ARM_NUM_JOINTS];
+    uint16_t time_ms;      // Common time for all joints
+    uint16_t speed;        // Common speed for all joints
+    uint16_t timeout_ms;   // Allowed past time_ms, 0 = configured default
+} ble_move_wait_cmd_t;
+
+// Arrival detection settings
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_SET_ARRIVAL
+    uint16_t tolerance;    // Steps either side of the target
+    uint16_t timeout_ms;   // Allowed past the planned move time
+} ble_arrival_cmd_t;
+
+// Queue motion segments: this header, then count motion_segment_t (14 bytes each)
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_QUEUE_SEGMENTS
+    uint8_t flags;         // MOTION_QUEUE_FLAG_*
+    uint8_t count;         // 0 with MOTION_QUEUE_FLAG_REPLACE stops and clears the queue
+} ble_queue_cmd_t;
+
+// Tool pose on the wire: point in 0.1 mm, pitch and roll in mrad (kinematics.h)
+typedef struct __attribute__((packed)) {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    int16_t pitch;
+    int16_t roll;
+} ble_pose_t;
+
+// Cartesian target, reached in a joint move
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_CART_MOVE
+    ble_pose_t pose;
+    uint16_t time_ms;      // Common time for all joints
+    uint16_t speed;        // Common speed for all joints
+} ble_cart_move_cmd_t;
+
+// Straight line from the setpoint to a pose
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_MOVE_L
+    ble_pose_t pose;
+    uint16_t time_ms;      // 0 = at CART_PATH_SPEED_*; stretched if a joint would be too fast
+} ble_move_l_cmd_t;
+
+// Arc from the setpoint through a via point to a pose, 19 bytes
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_MOVE_C
+    int16_t via_x;         // 0.1 mm
+    int16_t via_y;
+    int16_t via_z;
+    ble_pose_t pose;
+    uint16_t time_ms;      // As for CMD_MOVE_L
+} ble_move_c_cmd_t;
+
+// Cartesian jog velocity: mm/s and mrad/s, all zero ramps to a stop
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_CART_JOG
+    int16_t vx;
+    int16_t vy;
+    int16_t vz;
+    int16_t vpitch;
+    int16_t vroll;
+} ble_cart_jog_cmd_t;
+
+// Tool pose notification (NOTIFY_TAG_POSE); CMD_GET_POSE takes an optional
+// source byte, SAVE_SOURCE_MEASURED (default) or SAVE_SOURCE_COMMANDED
+typedef struct __attribute__((packed)) {
+    uint8_t tag;           // NOTIFY_TAG_POSE
+    uint8_t source;        // SAVE_SOURCE_*
+    uint8_t valid;         // 0 when a measured joint did not answer
+    ble_pose_t pose;
+} ble_pose_notify_t;
+
+// Joint calibration; with only cmd and joint the joint gets the defaults
+// back. Refused while the player runs; the setpoint is resynced to the
+// measured positions so the arm does not move.
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_SET_CALIB
+    uint8_t joint;
+    joint_calib_t calib;
+} ble_calib_cmd_t;
+
+// Calibration notification (NOTIFY_TAG_CALIB); CMD_GET_CALIB takes an
+// optional joint, without one every joint is sent in turn
+typedef struct __attribute__((packed)) {
+    uint8_t tag;           // NOTIFY_TAG_CALIB
+    uint8_t joint;
+    joint_calib_t calib;
+} ble_calib_notify_t;
+
+// Start a teach-in recording: this header, then the program name (not
+// terminated). Refused while the player runs; torque goes off until stop.
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_TEACH_START
+    uint8_t rate_hz;       // 20-50, 0 = TEACH_DEFAULT_HZ
+    uint8_t tolerance;     // Steps, 0 = TEACH_DEFAULT_TOLERANCE
+    uint8_t flags;         // TEACH_FLAG_*
+} ble_teach_cmd_t;
+
 // Protocol structure for save/load commands
 typedef struct __attribute__((packed)) {
     uint8_t cmd;           // Command type
@@ -69,6 +219,21 @@ typedef struct __attribute__((packed)) {
     uint32_t delay_ms;     // Delay after reaching position (for sequences)
 } ble_storage_cmd_t;
 
+// Extended save: a 6-byte ble_storage_cmd_t saves measured positions with
+// default timing, 7 bytes adds the source, the full struct sets per-joint
+// timing (and positions for SAVE_SOURCE_EXPLICIT)
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // CMD_SAVE_POSITION
+    uint8_t slot_id;       // Storage slot (0-15)
+    uint32_t delay_ms;     // Delay after reaching position (for sequences)
+    uint8_t source;        // SAVE_SOURCE_*
+    struct __attribute__((packed)) {
+        uint16_t position; // Used with SAVE_SOURCE_EXPLICIT only
+        uint16_t time_ms;
+        uint16_t speed;
+    } joints[ARM_NUM_JOINTS];
+} ble_save_cmd_t;
+
 // Protocol structure for sequence playback
 typedef struct __attribute__((packed)) {
     uint8_t cmd;           // Command type
@@ -77,6 +242,14 @@ typedef struct __attribute__((packed)) {
     uint8_t loop;          // Loop playback (0=no, 1=yes)
 } ble_sequence_cmd_t;
 
+// Protocol structure for telemetry subscription
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;                  // Command type
+    uint8_t rate_hz;              // 10-100, 0 = stop
+    uint8_t fields;               // STS_FB_* mask, plus TELEMETRY_FIELD_QUEUE
+    uint8_t samples_per_notify;   // 0 = auto
+} ble_telemetry_cmd_t;
+
 // Status structure
 typedef struct __attribute__((packed)) {
     uint8_t is_moving;
@@ -84,12 +257,53 @@ typedef struct __attribute__((packed)) {
     uint16_t current_positions[ARM_NUM_JOINTS];
 } ble_status_t;
 
+// Extended per-joint status, one multi-register read per servo
+typedef struct __attribute__((packed)) {
+    uint16_t position;     // 0-4095
+    int16_t speed;         // Steps/s, signed
+    int16_t load;          // 0.1% of max torque, signed
+    uint8_t voltage;       // 0.1 V units
+    uint8_t temperature;   // Degrees C
+    uint8_t moving;        // 1 while travelling
+    uint8_t error_flags;   // Servo status byte (STS_ERR_*)
+    uint16_t read_errors;  // Reads this joint has missed since boot (saturates)
+} ble_joint_status_t;
+
+// Extended status notification (NOTIFY_TAG_EXT_STATUS), needs MTU >= 85
+typedef struct __attribute__((packed)) {
+    uint8_t tag;           // NOTIFY_TAG_EXT_STATUS
+    uint8_t version;       // EXT_STATUS_VERSION
+    uint8_t valid_mask;    // Joints that answered this read
+    uint8_t player_state;  // player_state_t
+    uint8_t current_slot;  // Slot being played, 0xFF when idle
+    uint32_t timestamp_ms;
+    ble_joint_status_t joints[ARM_NUM_JOINTS];
+    uint8_t feed_pct;      // Feed override being ramped towards (version 2)
+} ble_ext_status_t;
+
+// Command queue counters
+typedef struct {
+    uint32_t received;
+    uint32_t executed;
+    uint32_t coalesced;           // SET_ALL_JOINTS dropped because a newer one was queued behind it
+    uint32_t dropped;             // Queue full or packet too long
+    uint32_t max_depth;
+    uint64_t exec_us_total;
+    uint32_t max_exec_us;
+} ble_cmd_stats_t;
+
 // Function prototypes
 esp_err_t ble_arm_init(void);
+void ble_get_command_stats(ble_cmd_stats_t *stats);
 void ble_gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
 void ble_gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, 
                              esp_ble_gatts_cb_param_t *param);
 void ble_process_command(uint8_t *data, uint16_t len);
 void ble_send_status(void);
+void ble_send_ext_status(void);
+void ble_send_pose(uint8_t source);
+void ble_send_calib(uint8_t joint);
+esp_err_t ble_notify(const uint8_t *data, uint16_t len);
+uint16_t ble_get_mtu(void);
 
 #endif // BLE_ARM_CONTROL_H
@@ -0,0 +1,446 @@
+#include "cartesian.h"
+#include "control_loop.h"
+#include "joint_calib.h"
+#include "sequence_player.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "CARTESIAN";
+
+#define CART_AXES                 5         // x, y, z, pitch, roll
+#define CART_LINEAR_AXES          3
+#define CART_TWO_PI               6.28318531f
+
+// Latest jog command, written by the command task
+static portMUX_TYPE jog_lock = portMUX_INITIALIZER_UNLOCKED;
+static float jog_command[CART_AXES] = {0};
+static int64_t jog_command_us = 0;
+
+// Owned by the control loop task while the jog source runs
+static kin_pose_t jog_pose;
+static float jog_q[TRAJ_NUM_JOINTS];
+static float jog_velocity[CART_AXES];
+static float jog_last_t = 0.0f;
+
+// A linear or circular path. Two slots: a new path is set up in the one
+// the control loop is not sampling.
+typedef struct {
+    kin_pose_t start;
+    float delta[CART_AXES];       // End minus start; angles the short way round
+    bool circular;
+    float center[3];
+    float u[3];                   // Unit vector from the center to the start
+    float w[3];                   // Unit vector along the arc at the start
+    float radius;
+    float angle;                  // Signed sweep, rad
+    float duration;               // Seconds of trajectory time
+    float q[TRAJ_NUM_JOINTS];     // Last solution, warm start for the next tick
+} cart_path_t;
+
+static cart_path_t paths[2];
+static int path_slot = 0;         // Slot of the latest path
+
+/**
+ * Clamp to -limit..limit
+ */
+static float cart_clamp(float value, float limit) {
+    return value > limit ? limit : value < -limit ? -limit : value;
+}
+
+/**
+ * Current setpoint as joint positions for the solver
+ */
+static void cart_setpoint(float q[TRAJ_NUM_JOINTS]) {
+    arm_position_t setpoint;
+    control_loop_get_target(&setpoint);
+    for (int i = 0; i < TRAJ_NUM_JOINTS; i++) {
+        q[i] = setpoint.joints[i].position;
+    }
+}
+
+/**
+ * Control loop source: ramp the tool velocity and step the pose one tick
+ */
+static bool cart_jog_source(float t, float q[TRAJ_NUM_JOINTS]) {
+    float dt = t - jog_last_t;
+    jog_last_t = t;
+
+    float command[CART_AXES];
+    portENTER_CRITICAL(&jog_lock);
+    memcpy(command, jog_command, sizeof(command));
+    int64_t command_us = jog_command_us;
+    portEXIT_CRITICAL(&jog_lock);
+
+    if (esp_timer_get_time() - command_us > CART_JOG_TIMEOUT_MS * 1000LL) {
+        memset(command, 0, sizeof(command));
+    }
+
+    bool moving = false;
+    for (int a = 0; a < CART_AXES; a++) {
+        float accel = a < CART_LINEAR_AXES ? CART_JOG_ACCEL_MM_S2 : CART_JOG_ACCEL_RAD_S2;
+        jog_velocity[a] += cart_clamp(command[a] - jog_velocity[a], accel * dt);
+        moving |= jog_velocity[a] != 0.0f;
+    }
+    memcpy(q, jog_q, sizeof(jog_q));
+    if (!moving) {
+        return false;
+    }
+
+    kin_pose_t next = {
+        .x = jog_pose.x + jog_velocity[0] * dt,
+        .y = jog_pose.y + jog_velocity[1] * dt,
+        .z = jog_pose.z + jog_velocity[2] * dt,
+        .pitch = jog_pose.pitch + jog_velocity[3] * dt,
+        .roll = jog_pose.roll + jog_velocity[4] * dt,
+    };
+    float solution[TRAJ_NUM_JOINTS];
+    bool reached = kin_inverse(&next, jog_q, solution);
+    for (int i = 0; i < KIN_JOINT_GRIPPER && reached; i++) {
+        // Near a singularity a small step needs a large joint move; treat it like the boundary
+        reached = fabsf(solution[i] - jog_q[i]) <= joint_calib_speed_limit(i, CART_MAX_JOINT_STEPS_S) * dt + 1.0f;
+    }
+
+    if (!reached) {
+        // Hold here; the velocity ramps up again if the command still pushes outwards
+        memset(jog_velocity, 0, sizeof(jog_velocity));
+        return true;
+    }
+    jog_pose = next;
+    memcpy(jog_q, solution, sizeof(jog_q));
+    memcpy(q, jog_q, sizeof(jog_q));
+    return true;
+}
+
+/**
+ * Pose at path parameter s (0..1)
+ */
+static void cart_path_pose(const cart_path_t *path, float s, kin_pose_t *pose) {
+    if (path->circular) {
+        float c = cosf(s * path->angle) * path->radius;
+        float d = sinf(s * path->angle) * path->radius;
+        pose->x = path->center[0] + c * path->u[0] + d * path->w[0];
+        pose->y = path->center[1] + c * path->u[1] + d * path->w[1];
+        pose->z = path->center[2] + c * path->u[2] + d * path->w[2];
+    } else {
+        pose->x = path->start.x + s * path->delta[0];
+        pose->y = path->start.y + s * path->delta[1];
+        pose->z = path->start.z + s * path->delta[2];
+    }
+    pose->pitch = path->start.pitch + s * path->delta[3];
+    pose->roll = path->start.roll + s * path->delta[4];
+}
+
+/**
+ * Path length in mm
+ */
+static float cart_path_length(const cart_path_t *path) {
+    if (path->circular) {
+        return path->radius * fabsf(path->angle);
+    }
+    return sqrtf(path->delta[0] * path->delta[0] + path->delta[1] * path->delta[1] +
+                 path->delta[2] * path->delta[2]);
+}
+
+/**
+ * Check the path is reachable and pick its duration; path->q holds the seed
+ *
+ * time_ms 0 runs at CART_PATH_SPEED_*. Either way the duration is
+ * stretched until no joint exceeds CART_MAX_JOINT_STEPS_S or its vmax.
+ */
+static esp_err_t cart_path_prepare(cart_path_t *path, uint16_t time_ms) {
+    float length = cart_path_length(path);
+    float rotation = fmaxf(fabsf(path->delta[3]), fabsf(path->delta[4]));
+    float checks = ceilf(fmaxf(length / CART_PATH_CHECK_MM, rotation / CART_PATH_CHECK_RAD));
+    int num_checks = checks < 1.0f ? 1 : checks > CART_PATH_MAX_CHECKS ? CART_PATH_MAX_CHECKS : (int)checks;
+
+    // Steepest joint move per unit of path parameter, relative to the joint's limit
+    float q[TRAJ_NUM_JOINTS];
+    float limit[KIN_JOINT_GRIPPER];
+    float max_rate = 0.0f;
+    for (int i = 0; i < KIN_JOINT_GRIPPER; i++) {
+        limit[i] = joint_calib_speed_limit(i, CART_MAX_JOINT_STEPS_S);
+    }
+    memcpy(q, path->q, sizeof(q));
+    for (int k = 1; k <= num_checks; k++) {
+        kin_pose_t pose;
+        float next[TRAJ_NUM_JOINTS];
+        cart_path_pose(path, (float)k / num_checks, &pose);
+        if (!kin_inverse(&pose, q, next)) {
+            ESP_LOGW(TAG, "Path leaves the workspace at (%.1f, %.1f, %.1f) mm", pose.x, pose.y, pose.z);
+            return ESP_ERR_INVALID_ARG;
+        }
+        for (int i = 0; i < KIN_JOINT_GRIPPER; i++) {
+            max_rate = fmaxf(max_rate, fabsf(next[i] - q[i]) * num_checks / limit[i]);
+        }
+        memcpy(q, next, sizeof(q));
+    }
+
+    // The minimum-jerk profile peaks at 1.875 times the mean speed
+    float joint_s = 1.875f * max_rate;
+    float duration = time_ms > 0 ? time_ms / 1000.0f :
+                     1.875f * fmaxf(length / CART_PATH_SPEED_MM_S, rotation / CART_PATH_SPEED_RAD_S);
+    if (duration < joint_s) {
+        ESP_LOGI(TAG, "Path stretched from %.2f to %.2f s for joint speed", duration, joint_s);
+        duration = joint_s;
+    }
+    if (duration > CART_PATH_MAX_S) {
+        ESP_LOGW(TAG, "Path runs through a singularity (%.1f s)", duration);
+        return ESP_ERR_INVALID_ARG;
+    }
+    path->duration = duration;
+    return ESP_OK;
+}
+
+/**
+ * Sample a path one tick: minimum-jerk time scale, IK from the last solution
+ */
+static bool cart_path_sample(cart_path_t *path, float t, float q[TRAJ_NUM_JOINTS]) {
+    float tau = path->duration > 0.0f ? fminf(t / path->duration, 1.0f) : 1.0f;
+    float s = tau * tau * tau * (10.0f + tau * (-15.0f + 6.0f * tau));
+
+    kin_pose_t pose;
+    float next[TRAJ_NUM_JOINTS];
+    cart_path_pose(path, s, &pose);
+    // Checked before starting, so a miss here is rounding at the very edge; stop there
+    bool reached = kin_inverse(&pose, path->q, next);
+    if (reached) {
+        memcpy(path->q, next, sizeof(next));
+    }
+    memcpy(q, path->q, sizeof(path->q));
+    return reached && tau < 1.0f;
+}
+
+/**
+ * Control loop sources, one per path slot
+ */
+static bool cart_path_source_0(float t, float q[TRAJ_NUM_JOINTS]) {
+    return cart_path_sample(&paths[0], t, q);
+}
+
+static bool cart_path_source_1(float t, float q[TRAJ_NUM_JOINTS]) {
+    return cart_path_sample(&paths[1], t, q);
+}
+
+static const control_loop_source_t path_sources[2] = { cart_path_source_0, cart_path_source_1 };
+
+/**
+ * Set up a path from the current setpoint in the free slot
+ */
+static cart_path_t *cart_path_begin(const kin_pose_t *target) {
+    cart_path_t *path = &paths[path_slot ^ 1];
+    memset(path, 0, sizeof(*path));
+    cart_setpoint(path->q);
+    kin_forward(path->q, &path->start);
+    path->delta[0] = target->x - path->start.x;
+    path->delta[1] = target->y - path->start.y;
+    path->delta[2] = target->z - path->start.z;
+    path->delta[3] = kin_wrap_angle(target->pitch - path->start.pitch);
+    path->delta[4] = kin_wrap_angle(target->roll - path->start.roll);
+    return path;
+}
+
+/**
+ * Check a path set up by cart_path_begin() and start streaming it
+ */
+static esp_err_t cart_path_start(cart_path_t *path, uint16_t time_ms) {
+    esp_err_t ret = cart_path_prepare(path, time_ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    path_slot ^= 1;
+    ESP_LOGI(TAG, "%s path, %.1f mm in %.2f s", path->circular ? "Circular" : "Linear",
+             cart_path_length(path), path->duration);
+    return control_loop_follow_source(path_sources[path_slot]);
+}
+
+/**
+ * Move the tool to a pose in a joint-space move; ESP_ERR_INVALID_ARG if unreachable
+ *
+ * time_ms and speed are applied as in CMD_SET_ALL_JOINTS.
+ */
+esp_err_t cart_move(const kin_pose_t *pose, uint16_t time_ms, uint16_t speed) {
+    float seed[TRAJ_NUM_JOINTS];
+    float q[TRAJ_NUM_JOINTS];
+    cart_setpoint(seed);
+    if (!kin_inverse(pose, seed, q)) {
+        ESP_LOGW(TAG, "Pose (%.1f, %.1f, %.1f) mm out of reach", pose->x, pose->y, pose->z);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    arm_position_t target = {0};
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        target.joints[i].position = (uint16_t)(q[i] + 0.5f);
+        target.joints[i].time_ms = time_ms;
+        target.joints[i].speed = speed;
+    }
+    control_loop_set_target(&target);
+    return ESP_OK;
+}
+
+/**
+ * Move the tool along a straight line to a pose; time_ms 0 = at CART_PATH_SPEED_*
+ *
+ * ESP_ERR_INVALID_ARG if the line leaves the workspace or runs through a
+ * singularity.
+ */
+esp_err_t cart_move_linear(const kin_pose_t *target, uint16_t time_ms) {
+    if (sequence_player_get_state() != PLAYER_IDLE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return cart_path_start(cart_path_begin(target), time_ms);
+}
+
+/**
+ * Angle of a point on the arc from the start, counter-clockwise around the normal (0..2 pi)
+ *
+ * Both the point and the center are relative to the start.
+ */
+static float cart_arc_angle(const cart_path_t *path, const float center[3], const float point[3]) {
+    float r[3] = { point[0] - center[0], point[1] - center[1], point[2] - center[2] };
+    float angle = atan2f(r[0] * path->w[0] + r[1] * path->w[1] + r[2] * path->w[2],
+                         r[0] * path->u[0] + r[1] * path->u[1] + r[2] * path->u[2]);
+    return angle < 0.0f ? angle + CART_TWO_PI : angle;
+}
+
+/**
+ * Move the tool along the arc through via (mm) to a pose; time_ms 0 = at CART_PATH_SPEED_*
+ *
+ * ESP_ERR_INVALID_ARG if the three points are on one line or the arc is
+ * not reachable.
+ */
+esp_err_t cart_move_circular(const float via[3], const kin_pose_t *target, uint16_t time_ms) {
+    if (sequence_player_get_state() != PLAYER_IDLE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    cart_path_t *path = cart_path_begin(target);
+    float p1[3] = { path->start.x, path->start.y, path->start.z };
+    float a[3] = { via[0] - p1[0], via[1] - p1[1], via[2] - p1[2] };
+    float b[3] = { target->x - p1[0], target->y - p1[1], target->z - p1[2] };
+    float n[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+    float nn = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+    float aa = a[0] * a[0] + a[1] * a[1] + a[2] * a[2];
+    float bb = b[0] * b[0] + b[1] * b[1] + b[2] * b[2];
+    if (nn < 1e-6f * aa * bb || aa == 0.0f || bb == 0.0f) {
+        ESP_LOGW(TAG, "Arc points are on one line");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Circumcenter relative to the start: (|a|^2 b - |b|^2 a) x n / (2 |n|^2)
+    float m[3] = { aa * b[0] - bb * a[0], aa * b[1] - bb * a[1], aa * b[2] - bb * a[2] };
+    float c[3] = {
+        (m[1] * n[2] - m[2] * n[1]) / (2.0f * nn),
+        (m[2] * n[0] - m[0] * n[2]) / (2.0f * nn),
+        (m[0] * n[1] - m[1] * n[0]) / (2.0f * nn),
+    };
+    float radius = sqrtf(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+    float n_len = sqrtf(nn);
+    for (int i = 0; i < 3; i++) {
+        path->center[i] = p1[i] + c[i];
+        path->u[i] = -c[i] / radius;
+    }
+    // w = n x u, a quarter turn ahead of u around the plane's normal
+    path->w[0] = (n[1] * path->u[2] - n[2] * path->u[1]) / n_len;
+    path->w[1] = (n[2] * path->u[0] - n[0] * path->u[2]) / n_len;
+    path->w[2] = (n[0] * path->u[1] - n[1] * path->u[0]) / n_len;
+    path->radius = radius;
+    path->circular = true;
+
+    // Go the way that passes the via point
+    float angle_via = cart_arc_angle(path, c, a);
+    float angle_end = cart_arc_angle(path, c, b);
+    path->angle = angle_via < angle_end ? angle_end : angle_end - CART_TWO_PI;
+
+    return cart_path_start(path, time_ms);
+}
+
+/**
+ * Jog the tool at a velocity: mm/s for x, y, z and rad/s for pitch and roll
+ *
+ * Starts from the current setpoint if no jog is running. Repeat within
+ * CART_JOG_TIMEOUT_MS to keep going; all zero ramps to a stop.
+ */
+esp_err_t cart_jog(const kin_pose_t *velocity) {
+    if (sequence_player_get_state() != PLAYER_IDLE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    float command[CART_AXES] = {
+        cart_clamp(velocity->x, CART_JOG_MAX_MM_S),
+        cart_clamp(velocity->y, CART_JOG_MAX_MM_S),
+        cart_clamp(velocity->z, CART_JOG_MAX_MM_S),
+        cart_clamp(velocity->pitch, CART_JOG_MAX_RAD_S),
+        cart_clamp(velocity->roll, CART_JOG_MAX_RAD_S),
+    };
+    bool moving = false;
+    for (int a = 0; a < CART_AXES; a++) {
+        moving |= command[a] != 0.0f;
+    }
+
+    portENTER_CRITICAL(&jog_lock);
+    memcpy(jog_command, command, sizeof(jog_command));
+    jog_command_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&jog_lock);
+
+    if (!moving || control_loop_get_source() == cart_jog_source) {
+        return ESP_OK;
+    }
+
+    // Not running, so the source state is ours to set up
+    cart_setpoint(jog_q);
+    kin_forward(jog_q, &jog_pose);
+    memset(jog_velocity, 0, sizeof(jog_velocity));
+    jog_last_t = 0.0f;
+    ESP_LOGI(TAG, "Jog from (%.1f, %.1f, %.1f) mm", jog_pose.x, jog_pose.y, jog_pose.z);
+    return control_loop_follow_source(cart_jog_source);
+}
+
+/**
+ * Stop a path or jog at once, holding the last setpoint
+ */
+void cart_stop(void) {
+    portENTER_CRITICAL(&jog_lock);
+    memset(jog_command, 0, sizeof(jog_command));
+    portEXIT_CRITICAL(&jog_lock);
+
+    if (cart_active()) {
+        control_loop_stop_trajectory();
+    }
+}
+
+/**
+ * Check whether a path or jog is being streamed
+ */
+bool cart_active(void) {
+    control_loop_source_t source = control_loop_get_source();
+    return source == cart_jog_source || source == path_sources[0] || source == path_sources[1];
+}
+
+/**
+ * Tool pose of the measured positions or the setpoint
+ *
+ * ESP_ERR_INVALID_RESPONSE if a measured arm joint did not answer.
+ */
+esp_err_t cart_get_pose(bool measured, kin_pose_t *pose) {
+    float q[TRAJ_NUM_JOINTS];
+    if (measured) {
+        uint16_t positions[ARM_NUM_JOINTS];
+        uint8_t valid_mask = 0;
+        sts_servo_sync_read_positions(positions, &valid_mask);
+        // The gripper does not take part
+        uint8_t needed = ARM_ALL_JOINTS_MASK & ~(1 << KIN_JOINT_GRIPPER);
+        if ((valid_mask & needed) != needed) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        for (int i = 0; i < TRAJ_NUM_JOINTS; i++) {
+            q[i] = positions[i];
+        }
+    } else {
+        cart_setpoint(q);
+    }
+    kin_forward(q, pose);
+    return ESP_OK;
+}
@@ -0,0 +1,58 @@
+#ifndef CARTESIAN_H
+#define CARTESIAN_H
+
+#include "esp_err.h"
+#include "kinematics.h"
+
+// Cartesian moves, paths and jogging on top of kinematics.h.
+//
+// A Cartesian move solves IK once, seeded from the current setpoint, and
+// commands the joints like CMD_SET_ALL_JOINTS: the tool gets there in a
+// joint-space move, not a straight line. The gripper keeps its setpoint.
+//
+// Linear and circular paths (MOVE_L, MOVE_C) keep the tool on the path.
+// They stream through the control loop as a setpoint source: every tick
+// the path is sampled on a minimum-jerk time scale and solved warm-started
+// from the previous tick's solution. Before starting, the whole path is
+// checked every CART_PATH_CHECK_MM; a path leaving the workspace or running
+// through a singularity is refused, and the duration is stretched if a
+// joint would have to move faster than CART_MAX_JOINT_STEPS_S or its
+// calibrated vmax. IK only uses joint positions within the soft limits
+// (joint_calib.h). Orientation
+// is interpolated from start to end, also on arcs.
+//
+// Jogging is a setpoint source too. Every tick the tool velocity is ramped
+// towards the commanded one and the next pose is solved from the last
+// solution. The client repeats the jog command while the button is held;
+// when none arrives for CART_JOG_TIMEOUT_MS the jog ramps to a stop. At
+// the edge of the workspace, a singularity or a joint limit the tool stops
+// where it is.
+//
+// Paths and jogs start from the current setpoint and replace each other.
+// They are refused while the sequence player runs.
+
+#define CART_MAX_JOINT_STEPS_S    3000.0f   // Joint speed limit for paths and jogs
+
+#define CART_JOG_MAX_MM_S         200.0f    // Linear speed limit
+#define CART_JOG_MAX_RAD_S        1.5f      // Angular speed limit
+#define CART_JOG_ACCEL_MM_S2      800.0f
+#define CART_JOG_ACCEL_RAD_S2     6.0f
+#define CART_JOG_TIMEOUT_MS       300       // Deadman: ramp to a stop without a fresh jog command
+
+#define CART_PATH_SPEED_MM_S      100.0f    // Peak speed of a path sent without a duration
+#define CART_PATH_SPEED_RAD_S     1.0f
+#define CART_PATH_CHECK_MM        2.0f      // Spacing of the reachability check
+#define CART_PATH_CHECK_RAD       0.02f
+#define CART_PATH_MAX_CHECKS      512
+#define CART_PATH_MAX_S           60.0f     // Longer means a singularity on the way
+
+// Function prototypes
+esp_err_t cart_move(const kin_pose_t *pose, uint16_t time_ms, uint16_t speed);
+esp_err_t cart_move_linear(const kin_pose_t *target, uint16_t time_ms);
+esp_err_t cart_move_circular(const float via[3], const kin_pose_t *target, uint16_t time_ms);
+esp_err_t cart_jog(const kin_pose_t *velocity);
+void cart_stop(void);
+bool cart_active(void);
+esp_err_t cart_get_pose(bool measured, kin_pose_t *pose);
+
+#endif // CARTESIAN_H
@@ -0,0 +1,62 @@
+#include "cmd_ring.h"
+#include <string.h>
+
+/**
+ * Reset the ring to empty (not safe while either side is active)
+ */
+void cmd_ring_init(cmd_ring_t *ring) {
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_relaxed);
+}
+
+/**
+ * Producer: copy a packet in; false if the ring is full or the packet too long
+ */
+bool cmd_ring_push(cmd_ring_t *ring, const uint8_t *data, uint16_t len) {
+    if (len > CMD_RING_MAX_PACKET) {
+        return false;
+    }
+
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= CMD_RING_LEN) {
+        return false;
+    }
+
+    cmd_entry_t *entry = &ring->entries[head & (CMD_RING_LEN - 1)];
+    memcpy(entry->data, data, len);
+    entry->len = len;
+
+    // Publish the entry only after its contents are written
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Consumer: entry `offset` places behind the oldest, or NULL if not queued
+ */
+cmd_entry_t *cmd_ring_peek(cmd_ring_t *ring, unsigned offset) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head - tail <= offset) {
+        return NULL;
+    }
+    return &ring->entries[(tail + offset) & (CMD_RING_LEN - 1)];
+}
+
+/**
+ * Consumer: release the oldest entry back to the producer
+ */
+void cmd_ring_pop(cmd_ring_t *ring) {
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Number of queued entries (approximate when called from either side concurrently)
+ */
+unsigned cmd_ring_count(cmd_ring_t *ring) {
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,34 @@
+#ifndef CMD_RING_H
+#define CMD_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Lock-free single-producer/single-consumer ring of command packets.
+// The producer (GATT callback) copies a packet in with cmd_ring_push(); the
+// consumer works on entries in place via cmd_ring_peek() and releases them
+// with cmd_ring_pop(). Neither side ever blocks.
+
+#define CMD_RING_LEN              16      // Power of two
+#define CMD_RING_MAX_PACKET       512     // Covers an ATT write at BLE_MAX_MTU
+
+typedef struct {
+    uint16_t len;
+    uint8_t data[CMD_RING_MAX_PACKET];
+} cmd_entry_t;
+
+typedef struct {
+    cmd_entry_t entries[CMD_RING_LEN];
+    atomic_uint head;             // Next slot to fill, written by the producer only
+    atomic_uint tail;             // Next slot to consume, written by the consumer only
+} cmd_ring_t;
+
+// Function prototypes
+void cmd_ring_init(cmd_ring_t *ring);
+bool cmd_ring_push(cmd_ring_t *ring, const uint8_t *data, uint16_t len);
+cmd_entry_t *cmd_ring_peek(cmd_ring_t *ring, unsigned offset);
+void cmd_ring_pop(cmd_ring_t *ring);
+unsigned cmd_ring_count(cmd_ring_t *ring);
+
+#endif // CMD_RING_H
@@ -0,0 +1,815 @@
+#include "control_loop.h"
+#include "joint_calib.h"
+#include "joint_limiter.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "CTRL_LOOP";
+
+static TaskHandle_t loop_task_handle = NULL;
+static esp_timer_handle_t loop_timer = NULL;
+
+// Shared setpoint: written by BLE/player/host, consumed once per tick
+static portMUX_TYPE target_lock = portMUX_INITIALIZER_UNLOCKED;
+static arm_position_t target = {0};
+static uint8_t target_valid_mask = 0;
+static uint32_t target_seq[ARM_NUM_JOINTS] = {0};
+
+// Trajectory being streamed (NULL when idle), protected by target_lock
+static traj_plan_t *active_plan = NULL;
+static traj_plan_t *pending_plan = NULL;   // Starts where active_plan ends
+static control_loop_source_t active_source = NULL;  // Sampled instead when no plan is active
+static uint32_t plan_generation = 0;
+static bool plan_paused = false;
+
+// Trajectory time runs at the feed override, ramped towards feed_target
+// so a change does not jerk the arm. Also protected by target_lock.
+static int64_t plan_time_us = 0;       // Elapsed time in the active plan
+static int64_t clock_us = 0;           // When plan_time_us and feed_rate were last advanced
+static float feed_rate = 1.0f;
+static float feed_target = 1.0f;
+
+// Set whenever a plan or source finishes, chains into the next one or is cancelled
+typedef struct {
+    EventGroupHandle_t group;
+    EventBits_t bits;
+} plan_listener_t;
+static plan_listener_t plan_listeners[CONTROL_LOOP_MAX_PLAN_LISTENERS];
+static uint8_t num_plan_listeners = 0;
+
+// Joints whose limiter restarts from the setpoint without moving, e.g.
+// after a resync to measured positions. Protected by target_lock.
+static uint8_t limiter_reset_mask = 0;
+
+// Owned by the loop task
+static uint32_t written_seq[ARM_NUM_JOINTS] = {0};
+static joint_limiter_t limiters[ARM_NUM_JOINTS];
+static uint8_t limiter_ready = 0;              // Limiter holds the joint's output
+static uint16_t written_pos[ARM_NUM_JOINTS];   // Last output on the bus
+static int64_t last_tick_us = 0;
+
+// Last streamed sample, unrounded, owned by the loop task
+static bool stream_fresh = false;              // Sampled this tick
+static bool stream_prev_valid = false;
+static float stream_q[ARM_NUM_JOINTS];
+static float stream_v[ARM_NUM_JOINTS];
+static uint32_t stream_seq[ARM_NUM_JOINTS];    // target_seq that goes with the sample
+static int64_t stream_prev_us = 0;
+
+// Schedule and statistics
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static control_loop_stats_t stats = {0};
+static uint32_t period_us = 1000000 / CONTROL_LOOP_DEFAULT_HZ;
+static int64_t next_tick_us = 0;
+
+/**
+ * Periodic timer callback: wake the loop task
+ */
+static void control_loop_timer_cb(void *arg) {
+    (void)arg;
+    xTaskNotifyGive(loop_task_handle);
+}
+
+/**
+ * Tell the plan listeners that the active plan changed
+ */
+static void control_loop_plan_changed(void) {
+    for (int i = 0; i < num_plan_listeners; i++) {
+        xEventGroupSetBits(plan_listeners[i].group, plan_listeners[i].bits);
+    }
+}
+
+/**
+ * Ramp the feed rate and advance trajectory time up to now (caller holds target_lock)
+ */
+static void control_loop_advance(int64_t now_us) {
+    float dt_us = (float)(now_us - clock_us);
+    clock_us = now_us;
+    if (dt_us <= 0.0f) {
+        return;
+    }
+
+    float step = CONTROL_LOOP_FEED_RAMP_PCT_S / 100.0f * dt_us / 1e6f;
+    float rate = feed_rate;
+    feed_rate = feed_target > rate ? fminf(rate + step, feed_target) : fmaxf(rate - step, feed_target);
+    if ((active_plan != NULL || active_source != NULL) && !plan_paused) {
+        // Trapezoidal integration over the ramp
+        plan_time_us += (int64_t)(dt_us * 0.5f * (rate + feed_rate));
+    }
+}
+
+/**
+ * Sample the active trajectory or source and load it into the setpoint
+ */
+static void control_loop_stream(int64_t now_us) {
+    traj_plan_t *plan;
+    control_loop_source_t source;
+    uint32_t generation;
+    int64_t elapsed_us;
+
+    portENTER_CRITICAL(&target_lock);
+    control_loop_advance(now_us);
+    plan = active_plan;
+    source = active_source;
+    generation = plan_generation;
+    elapsed_us = plan_time_us;
+    portEXIT_CRITICAL(&target_lock);
+
+    stream_fresh = false;
+    if (plan == NULL && source == NULL) {
+        stream_prev_valid = false;
+        return;
+    }
+
+    float q[TRAJ_NUM_JOINTS];
+    bool running = plan != NULL ? traj_sample(plan, elapsed_us / 1e6f, q, NULL) : source(elapsed_us / 1e6f, q);
+    bool changed = false;
+    bool applied = false;
+
+    portENTER_CRITICAL(&target_lock);
+    // Skip if the plan or source was stopped or replaced while sampling
+    if (active_plan == plan && active_source == source && plan_generation == generation) {
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            float rounded = q[i] + 0.5f;
+            uint16_t pos = rounded <= STS_POSITION_MIN ? STS_POSITION_MIN :
+                           rounded >= STS_POSITION_MAX ? STS_POSITION_MAX : (uint16_t)rounded;
+            // Streamed setpoints go out at full speed; the profile does the shaping
+            if (!(target_valid_mask & (1 << i)) || target.joints[i].position != pos ||
+                target.joints[i].time_ms != 0 || target.joints[i].speed != 0) {
+                target.joints[i].position = pos;
+                target.joints[i].time_ms = 0;
+                target.joints[i].speed = 0;
+                target_seq[i]++;
+            }
+        }
+        target_valid_mask = ARM_ALL_JOINTS_MASK;
+        memcpy(stream_seq, target_seq, sizeof(stream_seq));
+        applied = true;
+        if (!running && plan == NULL) {
+            // The source has finished, hold its last sample
+            changed = true;
+            active_source = NULL;
+        } else if (!running) {
+            // Chain straight into the queued plan on the old plan's time base
+            changed = true;
+            active_plan = pending_plan;
+            pending_plan = NULL;
+            if (active_plan != NULL) {
+                plan_time_us -= (int64_t)(plan->total_s * 1e6f);
+                plan_generation++;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&target_lock);
+
+    if (applied) {
+        // Velocity of the stream in real time, so it includes the feed override
+        float dt = (now_us - stream_prev_us) / 1e6f;
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            stream_v[i] = stream_prev_valid && dt > 0.0f ? (q[i] - stream_q[i]) / dt : 0.0f;
+            stream_q[i] = q[i];
+        }
+        stream_prev_us = now_us;
+        stream_prev_valid = true;
+        stream_fresh = true;
+    } else {
+        stream_prev_valid = false;
+    }
+
+    if (changed) {
+        control_loop_plan_changed();
+    }
+}
+
+/**
+ * Apply the feed override to servo-side interpolation of direct commands
+ *
+ * Streamed setpoints carry time 0 and speed 0 and are left alone; their
+ * timing comes from trajectory time.
+ */
+static void control_loop_scale_timing(arm_position_t *setpoint, uint8_t mask, float rate) {
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (!(mask & (1 << i))) {
+            continue;
+        }
+        if (setpoint->joints[i].time_ms != 0) {
+            float time_ms = setpoint->joints[i].time_ms / rate;
+            setpoint->joints[i].time_ms = time_ms >= UINT16_MAX ? UINT16_MAX : (uint16_t)time_ms;
+        }
+        if (setpoint->joints[i].speed != 0) {
+            float speed = setpoint->joints[i].speed * rate;
+            setpoint->joints[i].speed = speed >= STS_SPEED_MAX ? STS_SPEED_MAX : speed < 1.0f ? 1 : (uint16_t)speed;
+        }
+    }
+}
+
+/**
+ * Limits for each joint: its calibrated vmax/amax or the defaults
+ */
+static void control_loop_limits(joint_limits_t limits[ARM_NUM_JOINTS], joint_calib_t calib[ARM_NUM_JOINTS]) {
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        joint_calib_get(i, &calib[i]);
+        limits[i].vmax = calib[i].vmax != 0 ? calib[i].vmax : CONTROL_LOOP_LIMIT_VMAX;
+        limits[i].amax = calib[i].amax != 0 ? calib[i].amax : CONTROL_LOOP_LIMIT_AMAX;
+        limits[i].jmax = limits[i].amax / CONTROL_LOOP_LIMIT_RAMP_S;
+    }
+}
+
+/**
+ * Speed limit in steps/s for a direct command, from its time and speed at the feed rate; 0 = none
+ */
+static float control_loop_command_cap(const joint_position_t *joint, float distance, float rate) {
+    float cap = 0.0f;
+    if (joint->time_ms != 0) {
+        cap = fabsf(distance) * 1000.0f / joint->time_ms;
+    }
+    if (joint->speed != 0 && (cap == 0.0f || joint->speed < cap)) {
+        cap = joint->speed;
+    }
+    return cap > 0.0f ? fmaxf(cap * rate, 1.0f) : 0.0f;
+}
+
+/**
+ * One control period: run every setpoint through the limiter and push the
+ * joints whose output moved in a single sync write
+ *
+ * Direct commands become the limiter's goal, their time and speed a speed
+ * cap; streamed setpoints become a moving goal. The output goes out with
+ * time 0 and speed 0, so the servo follows it directly.
+ */
+static void control_loop_tick(int64_t now_us) {
+    control_loop_stream(now_us);
+
+    arm_position_t setpoint;
+    uint32_t seq[ARM_NUM_JOINTS];
+    uint8_t valid_mask;
+    uint8_t reset_mask;
+    float rate;
+
+    portENTER_CRITICAL(&target_lock);
+    setpoint = target;
+    valid_mask = target_valid_mask;
+    reset_mask = limiter_reset_mask;
+    limiter_reset_mask = 0;
+    memcpy(seq, target_seq, sizeof(seq));
+    // A single command cannot be ramped, so it gets the target rate. While
+    // ramping down to a feed hold the trajectory still has to be streamed.
+    rate = feed_target > 0.0f ? feed_target : feed_rate;
+    portEXIT_CRITICAL(&target_lock);
+
+    float dt = last_tick_us != 0 ? (now_us - last_tick_us) / 1e6f : 0.0f;
+    dt = fminf(dt, CONTROL_LOOP_LIMIT_MAX_DT_S);
+    last_tick_us = now_us;
+
+    joint_limits_t limits[ARM_NUM_JOINTS];
+    joint_calib_t calib[ARM_NUM_JOINTS];
+    control_loop_limits(limits, calib);
+
+    arm_position_t output = setpoint;
+    uint8_t write_mask = 0;
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (!(valid_mask & (1 << i))) {
+            continue;
+        }
+        uint16_t position = setpoint.joints[i].position;
+        bool streamed = stream_fresh && seq[i] == stream_seq[i];
+
+        if (reset_mask & (1 << i)) {
+            // Resynced: hold here without commanding anything
+            joint_limiter_reset(&limiters[i], position);
+            limiter_ready |= 1 << i;
+            written_pos[i] = position;
+            written_seq[i] = seq[i];
+            continue;
+        }
+        if (!(limiter_ready & (1 << i))) {
+            // Position unknown, e.g. the servo did not answer at boot: the
+            // first command goes out as it is and the limiter starts there
+            if (seq[i] == written_seq[i] || rate <= 0.0f) {
+                continue;
+            }
+            if (rate != 1.0f) {
+                control_loop_scale_timing(&output, 1 << i, rate);
+            }
+            joint_limiter_reset(&limiters[i], position);
+            write_mask |= 1 << i;
+            continue;
+        }
+
+        float lo = calib[i].min;
+        float hi = calib[i].max;
+        if (streamed) {
+            joint_limiter_set_goal(&limiters[i], fminf(fmaxf(stream_q[i], lo), hi), stream_v[i], 0.0f);
+            written_seq[i] = seq[i];
+        } else if (seq[i] != written_seq[i] && rate > 0.0f) {
+            // Once stopped by a feed hold, direct commands wait until the feed is raised again
+            float goal = fminf(fmaxf(position, lo), hi);
+            float cap = control_loop_command_cap(&setpoint.joints[i], goal - limiters[i].p, rate);
+            joint_limiter_set_goal(&limiters[i], goal, 0.0f, cap);
+            written_seq[i] = seq[i];
+        } else if (limiters[i].goal_v != 0.0f) {
+            // The stream stopped, finished or was replaced: brake to a still goal
+            joint_limiter_stop(&limiters[i], &limits[i], lo, hi);
+        }
+
+        joint_limiter_step(&limiters[i], &limits[i], dt);
+        float rounded = limiters[i].p + 0.5f;
+        uint16_t pos = rounded <= STS_POSITION_MIN ? STS_POSITION_MIN :
+                       rounded >= STS_POSITION_MAX ? STS_POSITION_MAX : (uint16_t)rounded;
+        // Unchanged joints are left alone
+        if (pos != written_pos[i]) {
+            output.joints[i].position = pos;
+            output.joints[i].time_ms = 0;
+            output.joints[i].speed = 0;
+            write_mask |= 1 << i;
+        }
+    }
+    if (write_mask == 0) {
+        return;
+    }
+
+    esp_err_t ret = sts_servo_sync_write_joints(&output, write_mask);
+
+    portENTER_CRITICAL(&stats_lock);
+    if (ret == ESP_OK) {
+        stats.writes++;
+    } else {
+        stats.write_errors++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (ret == ESP_OK) {
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            if (write_mask & (1 << i)) {
+                written_pos[i] = output.joints[i].position;
+                if (!(limiter_ready & (1 << i))) {
+                    written_seq[i] = seq[i];
+                    limiter_ready |= 1 << i;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Control loop task: one tick per timer period
+ */
+static void control_loop_task(void *pvParameters) {
+    (void)pvParameters;
+    ESP_LOGI(TAG, "Control loop task started at %d Hz", (int)(1000000 / period_us));
+
+    while (true) {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (pending == 0) {
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        control_loop_tick(start);
+        uint32_t exec_us = (uint32_t)(esp_timer_get_time() - start);
+
+        portENTER_CRITICAL(&stats_lock);
+        // More than one pending notification means whole periods were skipped
+        if (pending > 1) {
+            stats.overruns += pending - 1;
+            next_tick_us += (int64_t)period_us * (pending - 1);
+        }
+        // The timer skips events it could not deliver; restart the schedule from here
+        if (start - next_tick_us >= period_us) {
+            stats.overruns += (start - next_tick_us) / period_us;
+            next_tick_us = start;
+        }
+        int32_t jitter = (int32_t)(start - next_tick_us);
+        int32_t abs_jitter = jitter < 0 ? -jitter : jitter;
+        next_tick_us += period_us;
+
+        stats.ticks++;
+        stats.last_jitter_us = jitter;
+        if (abs_jitter > stats.max_jitter_us) {
+            stats.max_jitter_us = abs_jitter;
+        }
+        stats.last_exec_us = exec_us;
+        if (exec_us > stats.max_exec_us) {
+            stats.max_exec_us = exec_us;
+        }
+        if (exec_us > period_us) {
+            stats.overruns++;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+/**
+ * (Re)start the periodic timer at the current period
+ */
+static esp_err_t control_loop_start_timer(void) {
+    portENTER_CRITICAL(&stats_lock);
+    stats.period_us = period_us;
+    next_tick_us = esp_timer_get_time() + period_us;
+    portEXIT_CRITICAL(&stats_lock);
+
+    return esp_timer_start_periodic(loop_timer, period_us);
+}
+
+/**
+ * Initialize the control loop
+ */
+esp_err_t control_loop_init(void) {
+    // Seed the setpoint from the servos so partial updates don't move other joints
+    uint16_t positions[ARM_NUM_JOINTS];
+    uint8_t valid_mask = 0;
+    sts_servo_sync_read_positions(positions, &valid_mask);
+    control_loop_sync_to_measured(positions, valid_mask);
+
+    BaseType_t ret = xTaskCreatePinnedToCore(control_loop_task, "ctrl_loop",
+                                             CONTROL_LOOP_TASK_STACK, NULL,
+                                             CONTROL_LOOP_TASK_PRIORITY,
+                                             &loop_task_handle, CONTROL_LOOP_CORE);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        return ESP_FAIL;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = control_loop_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ctrl_loop",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &loop_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = control_loop_start_timer();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Control loop initialized (seeded joints 0x%02X)", valid_mask);
+    return ESP_OK;
+}
+
+/**
+ * Change the loop rate (CONTROL_LOOP_MIN_HZ..CONTROL_LOOP_MAX_HZ)
+ */
+esp_err_t control_loop_set_rate(uint16_t rate_hz) {
+    if (rate_hz < CONTROL_LOOP_MIN_HZ || rate_hz > CONTROL_LOOP_MAX_HZ) {
+        ESP_LOGE(TAG, "Invalid rate: %d Hz", rate_hz);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (loop_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(loop_timer);
+    period_us = 1000000 / rate_hz;
+    esp_err_t ret = control_loop_start_timer();
+
+    ESP_LOGI(TAG, "Control loop rate set to %d Hz", rate_hz);
+    return ret;
+}
+
+/**
+ * Replace the setpoint for all joints
+ */
+void control_loop_set_target(const arm_position_t *new_target) {
+    portENTER_CRITICAL(&target_lock);
+    bool cancelled = active_plan != NULL || active_source != NULL;
+    active_plan = NULL;  // Direct commands override streaming
+    pending_plan = NULL;
+    active_source = NULL;
+    target = *new_target;
+    target_valid_mask = ARM_ALL_JOINTS_MASK;
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        target_seq[i]++;
+    }
+    portEXIT_CRITICAL(&target_lock);
+
+    if (cancelled) {
+        control_loop_plan_changed();
+    }
+}
+
+/**
+ * Update the setpoint of a single joint
+ */
+void control_loop_set_joint(uint8_t joint, uint16_t position, uint16_t time_ms, uint16_t speed) {
+    if (joint >= ARM_NUM_JOINTS) {
+        return;
+    }
+
+    portENTER_CRITICAL(&target_lock);
+    bool cancelled = active_plan != NULL || active_source != NULL;
+    active_plan = NULL;
+    pending_plan = NULL;
+    active_source = NULL;
+    target.joints[joint].position = position;
+    target.joints[joint].time_ms = time_ms;
+    target.joints[joint].speed = speed;
+    target_valid_mask |= 1 << joint;
+    target_seq[joint]++;
+    portEXIT_CRITICAL(&target_lock);
+
+    if (cancelled) {
+        control_loop_plan_changed();
+    }
+}
+
+/**
+ * Adopt measured positions as the setpoint without commanding motion
+ */
+void control_loop_sync_to_measured(const uint16_t positions[ARM_NUM_JOINTS], uint8_t valid_mask) {
+    portENTER_CRITICAL(&target_lock);
+    bool cancelled = active_plan != NULL || active_source != NULL;
+    active_plan = NULL;
+    pending_plan = NULL;
+    active_source = NULL;
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (valid_mask & (1 << i)) {
+            target.joints[i].position = positions[i];
+            target.joints[i].time_ms = 0;
+            target.joints[i].speed = 0;
+            target_valid_mask |= 1 << i;
+            limiter_reset_mask |= 1 << i;
+        }
+    }
+    portEXIT_CRITICAL(&target_lock);
+
+    if (cancelled) {
+        control_loop_plan_changed();
+    }
+}
+
+/**
+ * Get a copy of the current setpoint
+ */
+void control_loop_get_target(arm_position_t *out) {
+    portENTER_CRITICAL(&target_lock);
+    *out = target;
+    portEXIT_CRITICAL(&target_lock);
+}
+
+/**
+ * Joints whose setpoint has been commanded or synced since boot
+ */
+uint8_t control_loop_get_target_mask(void) {
+    return target_valid_mask;
+}
+
+/**
+ * Get a snapshot of loop timing statistics
+ */
+void control_loop_get_stats(control_loop_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * Clear timing statistics
+ */
+void control_loop_reset_stats(void) {
+    portENTER_CRITICAL(&stats_lock);
+    uint32_t period = stats.period_us;
+    memset(&stats, 0, sizeof(stats));
+    stats.period_us = period;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * Start streaming a planned trajectory from the next tick
+ */
+esp_err_t control_loop_follow(traj_plan_t *plan) {
+    if (plan == NULL || plan->num_segments == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&target_lock);
+    control_loop_advance(now);
+    bool replaced = active_plan != NULL || active_source != NULL;
+    active_plan = plan;
+    pending_plan = NULL;
+    active_source = NULL;
+    plan_generation++;
+    plan_time_us = 0;
+    plan_paused = false;
+    portEXIT_CRITICAL(&target_lock);
+
+    if (replaced) {
+        control_loop_plan_changed();
+    }
+
+    ESP_LOGI(TAG, "Following trajectory: %d segments, %.2f s", plan->num_segments, plan->total_s);
+    return ESP_OK;
+}
+
+/**
+ * Queue a plan to start the moment the active one finishes
+ *
+ * The next plan should begin at the active plan's last waypoint. With nothing
+ * active this is the same as control_loop_follow().
+ */
+esp_err_t control_loop_follow_next(traj_plan_t *plan) {
+    if (plan == NULL || plan->num_segments == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&target_lock);
+    bool queued = active_plan != NULL && pending_plan == NULL;
+    if (queued) {
+        pending_plan = plan;
+    }
+    bool busy = active_plan != NULL && !queued;
+    portEXIT_CRITICAL(&target_lock);
+
+    if (busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return queued ? ESP_OK : control_loop_follow(plan);
+}
+
+/**
+ * Check whether a queued plan is still waiting for the active one to finish
+ */
+bool control_loop_trajectory_pending(void) {
+    portENTER_CRITICAL(&target_lock);
+    bool pending = pending_plan != NULL;
+    portEXIT_CRITICAL(&target_lock);
+    return pending;
+}
+
+/**
+ * Stop streaming; the arm holds the last streamed setpoint
+ */
+void control_loop_stop_trajectory(void) {
+    portENTER_CRITICAL(&target_lock);
+    bool cancelled = active_plan != NULL || active_source != NULL;
+    active_plan = NULL;
+    pending_plan = NULL;
+    active_source = NULL;
+    portEXIT_CRITICAL(&target_lock);
+
+    if (cancelled) {
+        control_loop_plan_changed();
+    }
+}
+
+/**
+ * Freeze or resume trajectory time
+ */
+void control_loop_pause_trajectory(bool pause) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&target_lock);
+    control_loop_advance(now);
+    plan_paused = pause;
+    portEXIT_CRITICAL(&target_lock);
+}
+
+/**
+ * Check whether a trajectory is still being streamed
+ */
+bool control_loop_trajectory_active(void) {
+    portENTER_CRITICAL(&target_lock);
+    bool active = active_plan != NULL;
+    portEXIT_CRITICAL(&target_lock);
+    return active;
+}
+
+/**
+ * Plan being streamed and its elapsed trajectory time in seconds, NULL when idle
+ *
+ * Trajectory time excludes pauses and runs at the feed override.
+ */
+const traj_plan_t *control_loop_trajectory_plan(float *t) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&target_lock);
+    const traj_plan_t *plan = active_plan;
+    int64_t elapsed_us = plan_time_us;
+    if (!plan_paused) {
+        elapsed_us += (int64_t)((now - clock_us) * feed_rate);
+    }
+    portEXIT_CRITICAL(&target_lock);
+
+    *t = elapsed_us / 1e6f;
+    return plan;
+}
+
+/**
+ * Set the feed override: 100 plays trajectories and direct commands as planned
+ *
+ * Trajectory time runs at pct percent of real time and direct commands get
+ * their time_ms and speed scaled. The rate ramps at
+ * CONTROL_LOOP_FEED_RAMP_PCT_S, so it can change mid-move. 0 is a feed
+ * hold: trajectories ramp to a stop and direct commands wait.
+ */
+esp_err_t control_loop_set_feed(uint8_t pct) {
+    if (pct > CONTROL_LOOP_FEED_MAX_PCT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&target_lock);
+    control_loop_advance(now);
+    feed_target = pct / 100.0f;
+    portEXIT_CRITICAL(&target_lock);
+
+    // Listeners timing their wake-ups from trajectory time need to recompute
+    control_loop_plan_changed();
+    ESP_LOGI(TAG, "Feed override %d%%", pct);
+    return ESP_OK;
+}
+
+/**
+ * Feed override being ramped towards, in percent
+ */
+uint8_t control_loop_get_feed(void) {
+    portENTER_CRITICAL(&target_lock);
+    float target_rate = feed_target;
+    portEXIT_CRITICAL(&target_lock);
+    return (uint8_t)(target_rate * 100.0f + 0.5f);
+}
+
+/**
+ * Fastest rate trajectory time will run at until the feed is changed again
+ *
+ * While ramping this is the rate being ramped towards if that is faster.
+ * Use it to convert trajectory time to wall time without waking up late.
+ */
+float control_loop_feed_rate(void) {
+    portENTER_CRITICAL(&target_lock);
+    float rate = fmaxf(feed_rate, feed_target);
+    portEXIT_CRITICAL(&target_lock);
+    return rate;
+}
+
+/**
+ * Set bits in an event group whenever a plan finishes, chains or is cancelled
+ *
+ * Listeners are registered once at init and never removed.
+ */
+esp_err_t control_loop_add_plan_event(EventGroupHandle_t group, EventBits_t bits) {
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    portENTER_CRITICAL(&target_lock);
+    if (num_plan_listeners < CONTROL_LOOP_MAX_PLAN_LISTENERS) {
+        plan_listeners[num_plan_listeners].group = group;
+        plan_listeners[num_plan_listeners].bits = bits;
+        num_plan_listeners++;
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&target_lock);
+    return ret;
+}
+
+/**
+ * Start streaming from a setpoint source at the next tick, replacing any plan
+ *
+ * The source runs in the control loop task and must not block. It starts
+ * at trajectory time 0 and runs at the feed override like a plan.
+ */
+esp_err_t control_loop_follow_source(control_loop_source_t source) {
+    if (source == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&target_lock);
+    control_loop_advance(now);
+    bool cancelled = active_plan != NULL || active_source != NULL;
+    active_plan = NULL;
+    pending_plan = NULL;
+    active_source = source;
+    plan_generation++;
+    plan_time_us = 0;
+    plan_paused = false;
+    portEXIT_CRITICAL(&target_lock);
+
+    if (cancelled) {
+        control_loop_plan_changed();
+    }
+    return ESP_OK;
+}
+
+/**
+ * Source being streamed, NULL when none
+ */
+control_loop_source_t control_loop_get_source(void) {
+    portENTER_CRITICAL(&target_lock);
+    control_loop_source_t source = active_source;
+    portEXIT_CRITICAL(&target_lock);
+    return source;
+}
@@ -0,0 +1,76 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include "sts_servo.h"
+#include "trajectory.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+// Control loop configuration
+#define CONTROL_LOOP_DEFAULT_HZ   200
+#define CONTROL_LOOP_MIN_HZ       100
+#define CONTROL_LOOP_MAX_HZ       500
+#define CONTROL_LOOP_TASK_STACK   4096
+#define CONTROL_LOOP_TASK_PRIORITY 15
+#define CONTROL_LOOP_CORE         1     // Keep clear of the BT controller on core 0
+#define CONTROL_LOOP_MAX_PLAN_LISTENERS 2   // Sequence player and motion queue
+
+// Setpoint limiter defaults, for joints without a calibrated vmax/amax
+#define CONTROL_LOOP_LIMIT_VMAX       3000.0f   // steps/s
+#define CONTROL_LOOP_LIMIT_AMAX       20000.0f  // steps/s^2
+#define CONTROL_LOOP_LIMIT_RAMP_S     0.05f     // Time to ramp to full acceleration; sets the jerk limit
+#define CONTROL_LOOP_LIMIT_MAX_DT_S   0.02f     // Longest step after a late tick
+
+// Feed override
+#define CONTROL_LOOP_FEED_MAX_PCT     150
+#define CONTROL_LOOP_FEED_RAMP_PCT_S  200   // Change of the rate per second
+
+// Timing statistics
+typedef struct {
+    uint32_t period_us;
+    uint32_t ticks;
+    uint32_t writes;          // Ticks that put a sync write on the bus
+    uint32_t write_errors;
+    uint32_t overruns;        // Ticks that missed a period or ran longer than one
+    int32_t last_jitter_us;   // Actual start minus scheduled start
+    int32_t max_jitter_us;    // Worst absolute jitter since reset
+    uint32_t last_exec_us;
+    uint32_t max_exec_us;
+} control_loop_stats_t;
+
+// Setpoint source sampled every tick at trajectory time t (seconds since it
+// started, at the feed override). Fills all joints in steps; returns false
+// once finished, and the last q is held.
+typedef bool (*control_loop_source_t)(float t, float q[TRAJ_NUM_JOINTS]);
+
+// Function prototypes
+esp_err_t control_loop_init(void);
+esp_err_t control_loop_set_rate(uint16_t rate_hz);
+void control_loop_set_target(const arm_position_t *target);
+void control_loop_set_joint(uint8_t joint, uint16_t position, uint16_t time_ms, uint16_t speed);
+void control_loop_sync_to_measured(const uint16_t positions[ARM_NUM_JOINTS], uint8_t valid_mask);
+void control_loop_get_target(arm_position_t *target);
+uint8_t control_loop_get_target_mask(void);
+void control_loop_get_stats(control_loop_stats_t *stats);
+void control_loop_reset_stats(void);
+
+// Trajectory streaming: the plan is sampled every tick and must stay valid until finished or stopped
+esp_err_t control_loop_follow(traj_plan_t *plan);
+esp_err_t control_loop_follow_next(traj_plan_t *plan);
+bool control_loop_trajectory_pending(void);
+void control_loop_stop_trajectory(void);
+void control_loop_pause_trajectory(bool pause);
+bool control_loop_trajectory_active(void);
+const traj_plan_t *control_loop_trajectory_plan(float *t);
+esp_err_t control_loop_add_plan_event(EventGroupHandle_t group, EventBits_t bits);
+
+// Computed streaming, e.g. Cartesian jogging; plans, direct commands and stop cancel it
+esp_err_t control_loop_follow_source(control_loop_source_t source);
+control_loop_source_t control_loop_get_source(void);
+
+// Feed override: scales trajectory time and direct command timing at runtime
+esp_err_t control_loop_set_feed(uint8_t pct);
+uint8_t control_loop_get_feed(void);
+float control_loop_feed_rate(void);
+
+#endif // CONTROL_LOOP_H
@@ -0,0 +1,287 @@
+#include "joint_calib.h"
+#include "kinematics.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include <string.h>
+#include <math.h>
+
+#define JOINT_CALIB_IDENTITY      { .sign = 1, .min = STS_POSITION_MIN, .max = STS_POSITION_MAX }
+
+static const char *TAG = "JOINT_CALIB";
+
+// RAM copy of the table; NVS is only read at init and written on change.
+// Identity until then, so the driver works before init.
+static portMUX_TYPE calib_lock = portMUX_INITIALIZER_UNLOCKED;
+static joint_calib_t calib_table[ARM_NUM_JOINTS] = {
+    JOINT_CALIB_IDENTITY, JOINT_CALIB_IDENTITY, JOINT_CALIB_IDENTITY,
+    JOINT_CALIB_IDENTITY, JOINT_CALIB_IDENTITY, JOINT_CALIB_IDENTITY,
+};
+
+/**
+ * Check a record for values the conversion cannot use
+ */
+static bool joint_calib_valid(const joint_calib_t *calib) {
+    return (calib->sign == 1 || calib->sign == -1) &&
+           calib->min <= calib->max && calib->max <= STS_POSITION_MAX &&
+           calib->zero_offset > -STS_POSITION_CENTER && calib->zero_offset < STS_POSITION_CENTER;
+}
+
+/**
+ * Hand a joint's limits and angle scale to the kinematics
+ */
+static void joint_calib_push_kinematics(uint8_t joint, const joint_calib_t *calib) {
+    if (joint > KIN_JOINT_WRIST_ROLL) {
+        return;  // The gripper is passed through
+    }
+    uint16_t steps = calib->steps_per_rev ? calib->steps_per_rev : JOINT_CALIB_DEFAULT_STEPS_PER_REV;
+    kin_set_joint(joint, calib->min, calib->max, steps);
+}
+
+/**
+ * Write a joint's acceleration limit to its servo
+ */
+static esp_err_t joint_calib_write_acc(uint8_t joint, uint16_t amax) {
+    // Round up so the servo never ramps slower than asked
+    uint32_t acc = (amax + JOINT_CALIB_ACC_UNIT - 1) / JOINT_CALIB_ACC_UNIT;
+    if (acc > JOINT_CALIB_ACC_MAX) {
+        acc = 0;  // Beyond the register's range, leave the servo unlimited
+    }
+    return sts_servo_set_acceleration(ARM_SERVO_ID_BASE + joint, (uint8_t)acc);
+}
+
+/**
+ * Persist the whole table with one commit
+ */
+static esp_err_t joint_calib_save(const joint_calib_t table[ARM_NUM_JOINTS]) {
+    uint8_t blob[1 + ARM_NUM_JOINTS * JOINT_CALIB_RECORD_LEN];
+    blob[0] = JOINT_CALIB_VERSION;
+    memcpy(&blob[1], table, ARM_NUM_JOINTS * JOINT_CALIB_RECORD_LEN);
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(JOINT_CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = nvs_set_blob(handle, JOINT_CALIB_NVS_KEY, blob, sizeof(blob));
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
+
+/**
+ * Fill a record with the identity calibration
+ */
+void joint_calib_default(joint_calib_t *calib) {
+    memset(calib, 0, sizeof(*calib));
+    calib->sign = 1;
+    calib->min = STS_POSITION_MIN;
+    calib->max = STS_POSITION_MAX;
+}
+
+/**
+ * Load the table from NVS and apply the acceleration limits
+ *
+ * Call after sts_servo_init() and before anything reads positions.
+ */
+esp_err_t joint_calib_init(void) {
+    joint_calib_t table[ARM_NUM_JOINTS];
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        joint_calib_default(&table[i]);
+    }
+
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(JOINT_CALIB_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    uint8_t blob[1 + ARM_NUM_JOINTS * JOINT_CALIB_RECORD_LEN];
+    size_t size = sizeof(blob);
+    ret = nvs_get_blob(handle, JOINT_CALIB_NVS_KEY, blob, &size);
+    nvs_close(handle);
+
+    uint8_t loaded = 0;
+    if (ret == ESP_OK && size == sizeof(blob) && blob[0] == JOINT_CALIB_VERSION) {
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            joint_calib_t calib;
+            memcpy(&calib, &blob[1 + i * JOINT_CALIB_RECORD_LEN], sizeof(calib));
+            if (joint_calib_valid(&calib)) {
+                table[i] = calib;
+                loaded |= 1 << i;
+            } else {
+                ESP_LOGW(TAG, "Ignoring malformed record for joint %d", i);
+            }
+        }
+    } else if (ret == ESP_OK) {
+        ESP_LOGW(TAG, "Ignoring table of version %d, %d bytes", blob[0], (int)size);
+    } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Ignoring unreadable table: %s", esp_err_to_name(ret));
+    }
+
+    portENTER_CRITICAL(&calib_lock);
+    memcpy(calib_table, table, sizeof(calib_table));
+    portEXIT_CRITICAL(&calib_lock);
+
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        joint_calib_push_kinematics(i, &table[i]);
+        // Servos start unlimited, only limited joints need a write
+        if (table[i].amax != 0 && joint_calib_write_acc(i, table[i].amax) != ESP_OK) {
+            ESP_LOGW(TAG, "Joint %d: failed to set acceleration", i);
+        }
+    }
+
+    ESP_LOGI(TAG, "Joint calibration initialized (calibrated joints 0x%02X)", loaded);
+    return ESP_OK;
+}
+
+/**
+ * Replace a joint's calibration, persist it and apply it from the next frame
+ *
+ * The setpoint is in joint steps, so a new offset or sign moves the arm
+ * unless the caller resyncs the setpoint to the measured positions.
+ */
+esp_err_t joint_calib_set(uint8_t joint, const joint_calib_t *calib) {
+    if (joint >= ARM_NUM_JOINTS || !joint_calib_valid(calib)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    joint_calib_t table[ARM_NUM_JOINTS];
+    portENTER_CRITICAL(&calib_lock);
+    uint16_t old_amax = calib_table[joint].amax;
+    calib_table[joint] = *calib;
+    memcpy(table, calib_table, sizeof(table));
+    portEXIT_CRITICAL(&calib_lock);
+
+    joint_calib_push_kinematics(joint, calib);
+    if (calib->amax != old_amax && joint_calib_write_acc(joint, calib->amax) != ESP_OK) {
+        ESP_LOGW(TAG, "Joint %d: failed to set acceleration", joint);
+    }
+
+    esp_err_t ret = joint_calib_save(table);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to persist calibration: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Joint %d: offset %d, sign %d, limits %d..%d, vmax %d, amax %d, %d steps/rev",
+             joint, calib->zero_offset, calib->sign, calib->min, calib->max,
+             calib->vmax, calib->amax, calib->steps_per_rev);
+    return ESP_OK;
+}
+
+/**
+ * Copy a joint's calibration
+ */
+void joint_calib_get(uint8_t joint, joint_calib_t *calib) {
+    if (joint >= ARM_NUM_JOINTS) {
+        joint_calib_default(calib);
+        return;
+    }
+    portENTER_CRITICAL(&calib_lock);
+    *calib = calib_table[joint];
+    portEXIT_CRITICAL(&calib_lock);
+}
+
+/**
+ * Convert setpoints in joint steps to servo steps for the selected joints
+ *
+ * Positions are clamped to the soft limits and speeds to vmax; a speed of
+ * 0 (servo maximum) becomes vmax. `in` and `out` may be the same.
+ */
+void joint_calib_to_servo(const arm_position_t *in, arm_position_t *out, uint8_t joint_mask) {
+    joint_calib_t table[ARM_NUM_JOINTS];
+    portENTER_CRITICAL(&calib_lock);
+    memcpy(table, calib_table, sizeof(table));
+    portEXIT_CRITICAL(&calib_lock);
+
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (!(joint_mask & (1 << i))) {
+            continue;
+        }
+        const joint_calib_t *c = &table[i];
+        int32_t pos = in->joints[i].position;
+        pos = pos < c->min ? c->min : pos > c->max ? c->max : pos;
+        int32_t raw = STS_POSITION_CENTER + c->zero_offset + c->sign * (pos - STS_POSITION_CENTER);
+        uint16_t speed = in->joints[i].speed;
+        if (c->vmax != 0 && (speed == 0 || speed > c->vmax)) {
+            speed = c->vmax;
+        }
+        out->joints[i].position = raw < STS_POSITION_MIN ? STS_POSITION_MIN :
+                                  raw > STS_POSITION_MAX ? STS_POSITION_MAX : (uint16_t)raw;
+        out->joints[i].time_ms = in->joints[i].time_ms;
+        out->joints[i].speed = speed;
+    }
+}
+
+/**
+ * Convert feedback in servo steps to joint steps in place
+ */
+void joint_calib_from_servo(sts_feedback_t feedback[ARM_NUM_JOINTS], uint8_t joint_mask) {
+    joint_calib_t table[ARM_NUM_JOINTS];
+    portENTER_CRITICAL(&calib_lock);
+    memcpy(table, calib_table, sizeof(table));
+    portEXIT_CRITICAL(&calib_lock);
+
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (!(joint_mask & (1 << i))) {
+            continue;
+        }
+        const joint_calib_t *c = &table[i];
+        int32_t pos = STS_POSITION_CENTER + c->sign * (feedback[i].position - STS_POSITION_CENTER - c->zero_offset);
+        feedback[i].position = pos < STS_POSITION_MIN ? STS_POSITION_MIN :
+                               pos > STS_POSITION_MAX ? STS_POSITION_MAX : (uint16_t)pos;
+        feedback[i].speed *= c->sign;
+        feedback[i].load *= c->sign;
+    }
+}
+
+/**
+ * Clamp a position in joint steps to a joint's soft limits
+ */
+uint16_t joint_calib_clamp(uint8_t joint, int32_t position) {
+    joint_calib_t calib;
+    joint_calib_get(joint, &calib);
+    return position < calib.min ? calib.min : position > calib.max ? calib.max : (uint16_t)position;
+}
+
+/**
+ * Home position of a joint: its zero, or the nearest soft limit
+ */
+uint16_t joint_calib_home(uint8_t joint) {
+    return joint_calib_clamp(joint, STS_POSITION_CENTER);
+}
+
+/**
+ * The lower of a speed limit in steps/s and the joint's vmax
+ */
+float joint_calib_speed_limit(uint8_t joint, float limit) {
+    joint_calib_t calib;
+    joint_calib_get(joint, &calib);
+    return calib.vmax != 0 ? fminf(limit, calib.vmax) : limit;
+}
+
+/**
+ * Cap a planner config at the limits of the slowest calibrated joint
+ *
+ * The planner shares one limit across joints, so a plan is timed for the
+ * most restricted joint.
+ */
+void joint_calib_limit_config(traj_config_t *config) {
+    joint_calib_t table[ARM_NUM_JOINTS];
+    portENTER_CRITICAL(&calib_lock);
+    memcpy(table, calib_table, sizeof(table));
+    portEXIT_CRITICAL(&calib_lock);
+
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (table[i].vmax != 0) {
+            config->vmax = fminf(config->vmax, table[i].vmax);
+        }
+        if (table[i].amax != 0) {
+            config->amax = fminf(config->amax, table[i].amax);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef JOINT_CALIB_H
+#define JOINT_CALIB_H
+
+#include "sts_servo.h"
+#include "trajectory.h"
+
+// Per-joint calibration, persisted in NVS and held in RAM.
+//
+// Everything above the servo driver works in joint steps: STS_POSITION_CENTER
+// is the calibrated zero and positive is the calibrated direction. The
+// driver converts once per frame at the bus: setpoints are clamped to the
+// soft limits, their speed to the joint's vmax, and then mapped to servo
+// steps (servo = center + zero_offset + sign * (joint - center)); feedback
+// is mapped back. Every motion path, direct, sequence, queue or Cartesian,
+// goes through that one pass. The joint's amax is written to the servo's
+// acceleration register at boot and when it changes.
+//
+// The defaults (no offset, no limits beyond the servo's) leave joint steps
+// equal to servo steps. steps_per_rev is the tick-to-radian mapping the
+// kinematics use, for joints behind a gear or belt.
+
+#define JOINT_CALIB_NVS_NAMESPACE  "joint_calib"
+#define JOINT_CALIB_NVS_KEY        "table"
+#define JOINT_CALIB_VERSION        1
+#define JOINT_CALIB_RECORD_LEN     13       // Packed joint_calib_t on the wire and in NVS
+
+#define JOINT_CALIB_DEFAULT_STEPS_PER_REV  4096
+#define JOINT_CALIB_ACC_UNIT       100      // steps/s^2 per step of the servo's acceleration register
+#define JOINT_CALIB_ACC_MAX        254
+
+typedef struct __attribute__((packed)) {
+    int16_t zero_offset;          // Servo step of the joint zero minus STS_POSITION_CENTER
+    int8_t sign;                  // 1, or -1 when the servo turns against the joint
+    uint16_t min;                 // Soft limits in joint steps
+    uint16_t max;
+    uint16_t vmax;                // steps/s, 0 = servo maximum
+    uint16_t amax;                // steps/s^2, 0 = servo maximum
+    uint16_t steps_per_rev;       // Steps per joint revolution, 0 = JOINT_CALIB_DEFAULT_STEPS_PER_REV
+} joint_calib_t;
+
+// Function prototypes
+esp_err_t joint_calib_init(void);
+void joint_calib_default(joint_calib_t *calib);
+esp_err_t joint_calib_set(uint8_t joint, const joint_calib_t *calib);
+void joint_calib_get(uint8_t joint, joint_calib_t *calib);
+void joint_calib_to_servo(const arm_position_t *in, arm_position_t *out, uint8_t joint_mask);
+void joint_calib_from_servo(sts_feedback_t feedback[ARM_NUM_JOINTS], uint8_t joint_mask);
+uint16_t joint_calib_clamp(uint8_t joint, int32_t position);
+uint16_t joint_calib_home(uint8_t joint);
+float joint_calib_speed_limit(uint8_t joint, float limit);
+void joint_calib_limit_config(traj_config_t *config);
+
+#endif // JOINT_CALIB_H
@@ -0,0 +1,175 @@
+#include "joint_limiter.h"
+#include <math.h>
+
+#define JOINT_LIMITER_BISECT_STEPS   10
+
+/**
+ * Clamp to -limit..limit
+ */
+static float jl_clamp(float value, float limit) {
+    return value > limit ? limit : value < -limit ? -limit : value;
+}
+
+/**
+ * Signed square root, the shape of every braking curve here
+ */
+static float jl_signed_sqrt(float value) {
+    return value < 0.0f ? -sqrtf(-value) : sqrtf(value);
+}
+
+/**
+ * Start at rest at a position
+ */
+void joint_limiter_reset(joint_limiter_t *jl, float position) {
+    jl->p = position;
+    jl->v = 0.0f;
+    jl->a = 0.0f;
+    jl->goal = position;
+    jl->goal_v = 0.0f;
+    jl->v_cap = 0.0f;
+}
+
+/**
+ * Move the goal; goal_v is its velocity and v_cap (0 = none) limits the output speed
+ */
+void joint_limiter_set_goal(joint_limiter_t *jl, float goal, float goal_v, float v_cap) {
+    jl->goal = goal;
+    jl->goal_v = goal_v;
+    jl->v_cap = v_cap;
+}
+
+/**
+ * Advance a state through a phase of constant jerk
+ */
+static void jl_phase(float *s, float *v, float *a, float jerk, float t) {
+    *s += t * (*v + t * (*a / 2.0f + t * jerk / 6.0f));
+    *v += t * (*a + t * jerk / 2.0f);
+    *a += t * jerk;
+}
+
+/**
+ * Distance covered while braking to rest from velocity v and acceleration a
+ *
+ * The direction of travel is positive. Braking ramps the deceleration up
+ * at jmax to at most amax, holds it and ramps it back down, arriving at
+ * v = 0 and a = 0 together.
+ */
+static float jl_stop_distance(float v, float a, float amax, float jmax) {
+    float s = 0.0f;
+    if (a > 0.0f) {
+        // Still speeding up: ramp the acceleration out first
+        jl_phase(&s, &v, &a, -jmax, a / jmax);
+        a = 0.0f;
+    }
+    float b0 = -a;
+    if (v <= b0 * b0 / (2.0f * jmax)) {
+        // Ramping the deceleration straight out already stops; this overshoots a little
+        jl_phase(&s, &v, &a, jmax, b0 / jmax);
+        return s;
+    }
+
+    float peak = sqrtf((2.0f * jmax * v + b0 * b0) / 2.0f);
+    float hold = 0.0f;
+    if (peak > amax) {
+        peak = amax;
+        hold = (v - (2.0f * amax * amax - b0 * b0) / (2.0f * jmax)) / amax;
+    }
+    jl_phase(&s, &v, &a, -jmax, (peak - b0) / jmax);
+    jl_phase(&s, &v, &a, 0.0f, hold);
+    jl_phase(&s, &v, &a, jmax, peak / jmax);
+    return s;
+}
+
+/**
+ * End a moving goal: hold still no nearer than the output can brake to, within lo..hi
+ *
+ * A goal that just stopped in front of the output is kept, so the end of a
+ * stream still lands exactly; one the output would overrun moves to where
+ * braking ends, so the output does not turn back.
+ */
+void joint_limiter_stop(joint_limiter_t *jl, const joint_limits_t *limits, float lo, float hi) {
+    float dir = jl->v < 0.0f ? -1.0f : 1.0f;
+    float brake = jl->p + dir * jl_stop_distance(dir * jl->v, dir * jl->a, limits->amax, limits->jmax);
+    float goal = dir * jl->goal > dir * brake ? jl->goal : brake;
+    jl->goal = goal < lo ? lo : goal > hi ? hi : goal;
+    jl->goal_v = 0.0f;
+    jl->v_cap = 0.0f;
+}
+
+/**
+ * Check that after one step with the acceleration ramped to a_next the output can still stop at the goal
+ *
+ * Everything is in the goal's frame with the goal ahead.
+ */
+static bool jl_can_stop(float e, float v, float a, float a_next, float dt, float amax, float jmax) {
+    float s = 0.0f;
+    jl_phase(&s, &v, &a, (a_next - a) / dt, dt);
+    return jl_stop_distance(v, a, amax, jmax) <= e - s;
+}
+
+/**
+ * Advance the output by dt seconds; false once it rests on a still goal
+ *
+ * Each step takes the acceleration that heads for full speed, unless the
+ * output could then no longer stop at the goal; in that case it takes the
+ * largest one that still can, found by bisection.
+ */
+bool joint_limiter_step(joint_limiter_t *jl, const joint_limits_t *limits, float dt) {
+    if (dt <= 0.0f) {
+        return jl->p != jl->goal || jl->v != 0.0f;
+    }
+
+    float vmax = jl->v_cap > 0.0f ? fminf(limits->vmax, jl->v_cap) : limits->vmax;
+    float amax = limits->amax;
+    float jmax = limits->jmax;
+
+    if (jl->goal_v == 0.0f && fabsf(jl->goal - jl->p) <= JOINT_LIMITER_SETTLE_STEPS &&
+        fabsf(jl->v) <= JOINT_LIMITER_SETTLE_SPEED && fabsf(jl->a) <= jmax * dt) {
+        jl->p = jl->goal;
+        jl->v = 0.0f;
+        jl->a = 0.0f;
+        return false;
+    }
+
+    // Work with the goal ahead, relative to its motion
+    float e = jl->goal - jl->p;
+    float dir = e < 0.0f ? -1.0f : 1.0f;
+    float e_rel = fabsf(e);
+    float v_rel = dir * (jl->v - jl->goal_v);
+    float a_rel = dir * jl->a;
+
+    // Head for full speed: the acceleration from which ramping out at jmax lands on vmax
+    float v_landing = jl->v + jl->a * fabsf(jl->a) / (2.0f * jmax);
+    float a_cruise = jl_clamp(jl_signed_sqrt(2.0f * jmax * (dir * vmax - v_landing)), amax);
+    float lo = fmaxf(a_rel - jmax * dt, -amax);
+    float hi = fminf(fmaxf(dir * a_cruise, lo), fminf(a_rel + jmax * dt, amax));
+
+    float a_next = hi;
+    if (!jl_can_stop(e_rel, v_rel, a_rel, hi, dt, amax, jmax)) {
+        // Largest acceleration that still stops in time; the hardest braking if none does
+        float ok = lo;
+        float bad = hi;
+        for (int i = 0; i < JOINT_LIMITER_BISECT_STEPS; i++) {
+            float mid = 0.5f * (ok + bad);
+            if (jl_can_stop(e_rel, v_rel, a_rel, mid, dt, amax, jmax)) {
+                ok = mid;
+            } else {
+                bad = mid;
+            }
+        }
+        a_next = ok;
+    }
+
+    // Ramp the acceleration linearly over the step
+    float a = dir * a_next;
+    float jerk = (a - jl->a) / dt;
+    float p = jl->p;
+    float v = jl->v;
+    float a_now = jl->a;
+    jl_phase(&p, &v, &a_now, jerk, dt);
+    jl->p = p;
+    jl->v = jl_clamp(v, vmax);
+    jl->a = a;
+    jl->goal += jl->goal_v * dt;
+    return true;
+}
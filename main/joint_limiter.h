@@ -0,0 +1,43 @@
+#ifndef JOINT_LIMITER_H
+#define JOINT_LIMITER_H
+
+#include <stdbool.h>
+
+// Online velocity, acceleration and jerk limiter for one joint. Plain C
+// with no ESP-IDF dependencies so it builds on the host as well.
+//
+// The control loop runs one per joint at its tick rate. The goal is a
+// position, optionally moving at a velocity (streamed setpoints), and the
+// output moves towards it as fast as the limits allow: the velocity is the
+// fastest from which the output can still stop at the goal, the
+// acceleration the largest from which it can still settle on that
+// velocity, and the acceleration changes by at most jmax per second. A
+// goal that jumps, however far and however often, therefore comes out as
+// a smooth, limited move that lands without overshooting. A goal already
+// moving within the limits is tracked without lag.
+
+#define JOINT_LIMITER_SETTLE_STEPS   0.5f   // Snap to a still goal this close...
+#define JOINT_LIMITER_SETTLE_SPEED   20.0f  // ...when slower than this (steps/s)
+
+typedef struct {
+    float vmax;                   // steps/s
+    float amax;                   // steps/s^2
+    float jmax;                   // steps/s^3
+} joint_limits_t;
+
+typedef struct {
+    float p;                      // Output position (steps)
+    float v;                      // Output velocity (steps/s)
+    float a;                      // Output acceleration (steps/s^2)
+    float goal;
+    float goal_v;                 // Velocity the goal moves at
+    float v_cap;                  // Extra velocity limit for this goal, 0 = none
+} joint_limiter_t;
+
+// Function prototypes
+void joint_limiter_reset(joint_limiter_t *jl, float position);
+void joint_limiter_set_goal(joint_limiter_t *jl, float goal, float goal_v, float v_cap);
+void joint_limiter_stop(joint_limiter_t *jl, const joint_limits_t *limits, float lo, float hi);
+bool joint_limiter_step(joint_limiter_t *jl, const joint_limits_t *limits, float dt);
+
+#endif // JOINT_LIMITER_H
@@ -0,0 +1,163 @@
+#include "kinematics.h"
+#include <math.h>
+#include <string.h>
+
+#define KIN_PI                    3.14159265f
+#define KIN_REACH_EPS             1e-4f     // Rounding slack at full stretch
+#define KIN_JOINT_DEFAULT         { KIN_STEP_MIN, KIN_STEP_MAX, KIN_STEPS_PER_REV, 2.0f * KIN_PI / KIN_STEPS_PER_REV }
+
+static const float joint_sign[TRAJ_NUM_JOINTS - 1] = KIN_JOINT_SIGNS;
+
+// Range and angle scale per joint, set from the calibration
+typedef struct {
+    float min;
+    float max;
+    float steps_per_rev;
+    float rad_per_step;
+} kin_joint_t;
+
+static kin_joint_t joints[TRAJ_NUM_JOINTS - 1] = {
+    KIN_JOINT_DEFAULT, KIN_JOINT_DEFAULT, KIN_JOINT_DEFAULT, KIN_JOINT_DEFAULT, KIN_JOINT_DEFAULT,
+};
+
+/**
+ * Set a joint's usable range in steps and its steps per revolution
+ *
+ * Not synchronised with the solver; change it while no Cartesian motion runs.
+ */
+void kin_set_joint(int joint, float step_min, float step_max, float steps_per_rev) {
+    if (joint < 0 || joint > KIN_JOINT_WRIST_ROLL || steps_per_rev <= 0.0f) {
+        return;
+    }
+    joints[joint].min = step_min;
+    joints[joint].max = step_max;
+    joints[joint].steps_per_rev = steps_per_rev;
+    joints[joint].rad_per_step = 2.0f * KIN_PI / steps_per_rev;
+}
+
+/**
+ * Wrap an angle to -pi..pi
+ */
+float kin_wrap_angle(float angle) {
+    return angle - 2.0f * KIN_PI * floorf((angle + KIN_PI) / (2.0f * KIN_PI));
+}
+
+/**
+ * Joint angle in radians from joint steps
+ */
+static float joint_angle(const float q[TRAJ_NUM_JOINTS], int joint) {
+    return joint_sign[joint] * (q[joint] - KIN_STEP_ZERO) * joints[joint].rad_per_step;
+}
+
+/**
+ * Joint steps for a joint angle, choosing the turn nearest the seed; false if out of range
+ */
+static bool joint_steps(float angle, int joint, float seed, float *out) {
+    const kin_joint_t *range = &joints[joint];
+    float steps = KIN_STEP_ZERO + joint_sign[joint] * angle / range->rad_per_step;
+    // Angles come wrapped to one turn; a full turn either way may sit closer to the seed
+    if (steps - seed > range->steps_per_rev / 2.0f) {
+        steps -= range->steps_per_rev;
+    } else if (seed - steps > range->steps_per_rev / 2.0f) {
+        steps += range->steps_per_rev;
+    }
+    if (steps < range->min || steps > range->max) {
+        return false;
+    }
+    *out = steps;
+    return true;
+}
+
+/**
+ * Tool pose for joint positions in joint steps
+ *
+ * Pitch and roll are taken facing away from the base axis, so a pose
+ * reached over the back reads the same as one reached forward.
+ */
+void kin_forward(const float q[TRAJ_NUM_JOINTS], kin_pose_t *pose) {
+    float yaw = joint_angle(q, KIN_JOINT_BASE);
+    float a1 = KIN_PI / 2.0f - joint_angle(q, KIN_JOINT_SHOULDER);     // Upper arm elevation
+    float a2 = a1 - joint_angle(q, KIN_JOINT_ELBOW);                    // Forearm elevation
+    float a3 = a2 - joint_angle(q, KIN_JOINT_WRIST_PITCH);              // Tool elevation
+
+    float r = KIN_UPPER_ARM_MM * cosf(a1) + KIN_FOREARM_MM * cosf(a2) + KIN_TOOL_MM * cosf(a3);
+    pose->x = r * cosf(yaw);
+    pose->y = r * sinf(yaw);
+    pose->z = KIN_BASE_HEIGHT_MM + KIN_UPPER_ARM_MM * sinf(a1) + KIN_FOREARM_MM * sinf(a2) +
+              KIN_TOOL_MM * sinf(a3);
+    pose->pitch = kin_wrap_angle(a3);
+    pose->roll = kin_wrap_angle(joint_angle(q, KIN_JOINT_WRIST_ROLL));
+    if (r < 0.0f) {
+        // Over the back: mirror the tool into the frame facing the tool point
+        pose->pitch = kin_wrap_angle(KIN_PI - a3);
+        pose->roll = kin_wrap_angle(pose->roll + KIN_PI);
+    }
+}
+
+/**
+ * Joint positions reaching a pose, closest to the seed; false if no solution is in range
+ *
+ * The gripper is copied from the seed. Solutions only count when every
+ * joint lands inside the servo range.
+ */
+bool kin_inverse(const kin_pose_t *pose, const float seed[TRAJ_NUM_JOINTS], float q[TRAJ_NUM_JOINTS]) {
+    float r_axis = sqrtf(pose->x * pose->x + pose->y * pose->y);
+    float yaw = r_axis > KIN_AXIS_EPS_MM ? atan2f(pose->y, pose->x) : joint_angle(seed, KIN_JOINT_BASE);
+
+    // Tool pitch and roll are given, so the wrist axis position follows directly
+    float zw = pose->z - KIN_BASE_HEIGHT_MM - KIN_TOOL_MM * sinf(pose->pitch);
+    float l1 = KIN_UPPER_ARM_MM;
+    float l2 = KIN_FOREARM_MM;
+
+    float best[TRAJ_NUM_JOINTS];
+    float best_cost = INFINITY;
+
+    // Reach forward (r > 0) or turn the base round and reach over the back
+    for (int back = 0; back < 2; back++) {
+        float r = back ? -r_axis : r_axis;
+        float base = back ? yaw + KIN_PI : yaw;
+        base = kin_wrap_angle(base);
+        // Over the back the tool faces the other way in the arm's plane
+        float pitch = back ? KIN_PI - pose->pitch : pose->pitch;
+        float rw = r - KIN_TOOL_MM * cosf(pitch);
+
+        float d = (rw * rw + zw * zw - l1 * l1 - l2 * l2) / (2.0f * l1 * l2);
+        if (d > 1.0f + KIN_REACH_EPS || d < -1.0f - KIN_REACH_EPS) {
+            continue;
+        }
+        d = fminf(fmaxf(d, -1.0f), 1.0f);
+
+        for (int branch = 0; branch < 2; branch++) {
+            float beta = branch ? -acosf(d) : acosf(d);                  // Forearm relative to upper arm
+            float a1 = atan2f(zw, rw) - atan2f(l2 * sinf(beta), l1 + l2 * cosf(beta));
+            float a2 = a1 + beta;
+
+            float angles[TRAJ_NUM_JOINTS - 1] = {
+                base,
+                KIN_PI / 2.0f - a1,
+                -beta,
+                a2 - pitch,
+                back ? pose->roll + KIN_PI : pose->roll,
+            };
+
+            float candidate[TRAJ_NUM_JOINTS];
+            float cost = 0.0f;
+            bool valid = true;
+            for (int j = 0; j < TRAJ_NUM_JOINTS - 1 && valid; j++) {
+                valid = joint_steps(kin_wrap_angle(angles[j]), j, seed[j], &candidate[j]);
+                cost += (candidate[j] - seed[j]) * (candidate[j] - seed[j]);
+            }
+            if (valid && cost < best_cost) {
+                best_cost = cost;
+                memcpy(best, candidate, sizeof(best));
+            }
+        }
+    }
+
+    if (best_cost == INFINITY) {
+        return false;
+    }
+    best[KIN_JOINT_GRIPPER] = seed[KIN_JOINT_GRIPPER];
+    memcpy(q, best, sizeof(best));
+    return true;
+}
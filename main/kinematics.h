@@ -0,0 +1,64 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <stdbool.h>
+#include "trajectory.h"
+
+// Forward and inverse kinematics for the ARM100. Plain C with no ESP-IDF
+// dependencies so it builds on the host as well.
+//
+// The arm is a yawing base, three pitch joints in one vertical plane
+// (shoulder, elbow, wrist) and a wrist roll; joint 5 is the gripper and is
+// passed through. Joint positions are joint steps as in trajectory.h, with
+// the center step as the kinematic zero: the arm stretched straight up.
+// joint_calib.h maps them to servo steps and sets each joint's soft limits
+// and steps per revolution here.
+// Positive angles tilt the pitch joints forward.
+//
+// The base frame has z up from the base plate and x forward at yaw 0.
+// A pose is the tool point in millimetres plus the tool's pitch above the
+// horizontal and its roll, in radians. The solver is closed-form: up to
+// four solutions (elbow up or down, reaching forward or over the back)
+// and it keeps the one closest to a seed, normally the current joint
+// positions, so consecutive solves do not jump between branches.
+
+// Link lengths in millimetres. Nominal values, measure your arm.
+#define KIN_BASE_HEIGHT_MM        95.0f     // Base plate to the shoulder axis
+#define KIN_UPPER_ARM_MM          116.0f    // Shoulder to elbow axis
+#define KIN_FOREARM_MM            135.0f    // Elbow to wrist pitch axis
+#define KIN_TOOL_MM               100.0f    // Wrist pitch axis to the tool point
+
+// Joints
+#define KIN_JOINT_BASE            0
+#define KIN_JOINT_SHOULDER        1
+#define KIN_JOINT_ELBOW           2
+#define KIN_JOINT_WRIST_PITCH     3
+#define KIN_JOINT_WRIST_ROLL      4
+#define KIN_JOINT_GRIPPER         5
+
+// Steps, matching STS_POSITION_MIN/MAX/CENTER; defaults until kin_set_joint()
+#define KIN_STEPS_PER_REV         4096.0f
+#define KIN_STEP_MIN              0.0f
+#define KIN_STEP_MAX              4095.0f
+#define KIN_STEP_ZERO             2048.0f
+
+// Rotation direction per joint, flip an entry when a servo is mounted the other way
+#define KIN_JOINT_SIGNS           { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f }
+
+#define KIN_AXIS_EPS_MM           0.01f     // Closer to the base axis than this, yaw keeps the seed
+
+typedef struct {
+    float x;                      // mm
+    float y;
+    float z;
+    float pitch;                  // Tool above the horizontal, rad
+    float roll;                   // rad
+} kin_pose_t;
+
+// Function prototypes
+void kin_set_joint(int joint, float step_min, float step_max, float steps_per_rev);
+void kin_forward(const float q[TRAJ_NUM_JOINTS], kin_pose_t *pose);
+bool kin_inverse(const kin_pose_t *pose, const float seed[TRAJ_NUM_JOINTS], float q[TRAJ_NUM_JOINTS]);
+float kin_wrap_angle(float angle);
+
+#endif // KINEMATICS_H
@@ -6,9 +6,17 @@
 #include "freertos/task.h"
 
 #include "sts_servo.h"
+#include "joint_calib.h"
 #include "ble_arm_control.h"
 #include "position_storage.h"
 #include "sequence_player.h"
+#include "control_loop.h"
+#include "benchmark.h"
+#include "telemetry.h"
+#include "motion_monitor.h"
+#include "motion_queue.h"
+#include "teach_recorder.h"
+#include "traj_store.h"
 
 static const char *TAG = "ARM100_MAIN";
 
@@ -41,6 +49,22 @@ void app_main(void)
         return;
     }
     
+    // Load joint calibration before anything reads or writes positions
+    ESP_LOGI(TAG, "Loading joint calibration...");
+    ret = joint_calib_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load joint calibration: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    // Initialize fixed-rate control loop (sole writer of servo setpoints)
+    ESP_LOGI(TAG, "Initializing control loop...");
+    ret = control_loop_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize control loop: %s", esp_err_to_name(ret));
+        return;
+    }
+    
     // Initialize position storage (NVS)
     ESP_LOGI(TAG, "Initializing position storage...");
     ret = position_storage_init();
@@ -49,6 +73,13 @@ void app_main(void)
         return;
     }
     
+    // Mount the trajectory store; without it only slot sequences can play
+    ESP_LOGI(TAG, "Mounting trajectory store...");
+    ret = traj_store_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Trajectory store unavailable: %s", esp_err_to_name(ret));
+    }
+    
     // Initialize sequence player
     ESP_LOGI(TAG, "Initializing sequence player...");
     ret = sequence_player_init();
@@ -57,6 +88,38 @@ void app_main(void)
         return;
     }
     
+    // Initialize telemetry sampler (idle until a client subscribes)
+    ESP_LOGI(TAG, "Initializing telemetry...");
+    ret = telemetry_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize telemetry: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    // Initialize arrival detection (idle until a move is watched)
+    ESP_LOGI(TAG, "Initializing motion monitor...");
+    ret = motion_monitor_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize motion monitor: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    // Initialize buffered motion (idle until segments are queued)
+    ESP_LOGI(TAG, "Initializing motion queue...");
+    ret = motion_queue_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize motion queue: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    // Initialize teach-in recording (idle until a recording starts)
+    ESP_LOGI(TAG, "Initializing teach recorder...");
+    ret = teach_recorder_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize teach recorder: %s", esp_err_to_name(ret));
+        return;
+    }
+    
     // Initialize BLE
     ESP_LOGI(TAG, "Initializing BLE...");
     ret = ble_arm_init();
@@ -83,6 +146,11 @@ void app_main(void)
         vTaskDelay(pdMS_TO_TICKS(50));
     }
     
+#if BENCH_RUN_AT_BOOT
+    // Latency/throughput benchmarks, JSON lines on the console
+    benchmark_run_all(BENCH_DEFAULT_ITERATIONS);
+#endif
+    
     // Main loop - monitor system status
     uint32_t counter = 0;
     while (1) {
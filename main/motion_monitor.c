@@ -0,0 +1,220 @@
+#include "motion_monitor.h"
+#include "control_loop.h"
+#include "joint_calib.h"
+#include "ble_arm_control.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "MOTION";
+
+static TaskHandle_t monitor_task_handle = NULL;
+
+// Configuration and the watched move, written by the command worker
+static portMUX_TYPE monitor_lock = portMUX_INITIALIZER_UNLOCKED;
+static motion_config_t config = {
+    .tolerance = MOTION_DEFAULT_TOLERANCE,
+    .timeout_ms = MOTION_DEFAULT_TIMEOUT_MS,
+};
+static bool watching = false;
+static uint32_t watch_generation = 0;
+static uint8_t watch_id = 0;
+static uint8_t watch_mask = 0;
+static uint16_t watch_target[ARM_NUM_JOINTS];
+static int64_t watch_start_us = 0;
+static int64_t watch_deadline_us = 0;
+
+/**
+ * Check which joints have arrived at their target with one bulk read
+ *
+ * Joints outside joint_mask count as arrived. Joints that do not answer have
+ * not arrived, and their position is reported as 0. Targets are clamped to
+ * the soft limits first, as the limiter clamps the setpoint, so a waypoint
+ * beyond a limit arrives at the limit.
+ */
+esp_err_t motion_check_arrival(const uint16_t target[ARM_NUM_JOINTS], uint8_t joint_mask,
+                               uint16_t tolerance, uint8_t *arrived_mask,
+                               uint16_t positions[ARM_NUM_JOINTS]) {
+    sts_feedback_t feedback[ARM_NUM_JOINTS];
+    uint8_t valid_mask = 0;
+    esp_err_t ret = sts_servo_sync_read(STS_FB_POSITION | STS_FB_MOVING, feedback, &valid_mask, 0);
+
+    uint8_t arrived = ~joint_mask & ARM_ALL_JOINTS_MASK;
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        bool valid = valid_mask & (1 << i);
+        if (positions != NULL) {
+            positions[i] = valid ? feedback[i].position : 0;
+        }
+        if (valid && (joint_mask & (1 << i)) && !feedback[i].moving &&
+            abs((int)feedback[i].position - (int)joint_calib_clamp(i, target[i])) <= tolerance) {
+            arrived |= 1 << i;
+        }
+    }
+
+    *arrived_mask = arrived;
+    return ret;
+}
+
+/**
+ * Check whether a direct command moved the setpoint of a watched joint
+ */
+static bool motion_target_replaced(const uint16_t target[ARM_NUM_JOINTS], uint8_t joint_mask) {
+    arm_position_t setpoint;
+    control_loop_get_target(&setpoint);
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if ((joint_mask & (1 << i)) && setpoint.joints[i].position != target[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Report the end of a watched move
+ */
+static void motion_report(uint8_t move_id, uint8_t result, uint8_t arrived_mask, int64_t start_us,
+                          const uint16_t positions[ARM_NUM_JOINTS]) {
+    int64_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+
+    motion_done_notify_t done = {
+        .tag = NOTIFY_TAG_MOTION_DONE,
+        .move_id = move_id,
+        .result = result,
+        .arrived_mask = arrived_mask,
+        .elapsed_ms = elapsed_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)elapsed_ms,
+    };
+    memcpy(done.positions, positions, sizeof(done.positions));
+    ble_notify((uint8_t *)&done, sizeof(done));
+
+    ESP_LOGI(TAG, "Move %d: result %d, arrived 0x%02X after %d ms", move_id, result, arrived_mask,
+             done.elapsed_ms);
+}
+
+/**
+ * Monitor task: poll the watched move until it arrives, times out or is replaced
+ */
+static void motion_monitor_task(void *pvParameters) {
+    (void)pvParameters;
+    uint16_t positions[ARM_NUM_JOINTS] = {0};
+
+    while (true) {
+        portENTER_CRITICAL(&monitor_lock);
+        bool active = watching;
+        uint32_t generation = watch_generation;
+        uint8_t move_id = watch_id;
+        uint8_t mask = watch_mask;
+        uint16_t target[ARM_NUM_JOINTS];
+        memcpy(target, watch_target, sizeof(target));
+        int64_t start_us = watch_start_us;
+        int64_t deadline_us = watch_deadline_us;
+        uint16_t tolerance = config.tolerance;
+        portEXIT_CRITICAL(&monitor_lock);
+
+        if (!active) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        uint8_t arrived = 0;
+        motion_check_arrival(target, mask, tolerance, &arrived, positions);
+
+        uint8_t result = 0xFF;
+        if (arrived == ARM_ALL_JOINTS_MASK) {
+            result = MOTION_RESULT_ARRIVED;
+        } else if (motion_target_replaced(target, mask)) {
+            result = MOTION_RESULT_PREEMPTED;
+        } else if (esp_timer_get_time() >= deadline_us) {
+            result = MOTION_RESULT_TIMEOUT;
+        }
+
+        if (result != 0xFF) {
+            portENTER_CRITICAL(&monitor_lock);
+            // A newer watch reports on its own
+            bool current = watch_generation == generation;
+            if (current) {
+                watching = false;
+            }
+            portEXIT_CRITICAL(&monitor_lock);
+            if (current) {
+                motion_report(move_id, result, arrived, start_us, positions);
+            }
+            continue;
+        }
+
+        // Sleep until the next poll; a new watch wakes us early
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MOTION_POLL_MS));
+    }
+}
+
+/**
+ * Initialize the motion monitor (idle until a move is watched)
+ */
+esp_err_t motion_monitor_init(void) {
+    BaseType_t ret = xTaskCreate(motion_monitor_task, "motion", MOTION_TASK_STACK,
+                                 NULL, MOTION_TASK_PRIORITY, &monitor_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Motion monitor initialized");
+    return ESP_OK;
+}
+
+/**
+ * Set the arrival tolerance and timeout
+ */
+void motion_monitor_set_config(const motion_config_t *new_config) {
+    portENTER_CRITICAL(&monitor_lock);
+    config = *new_config;
+    portEXIT_CRITICAL(&monitor_lock);
+
+    ESP_LOGI(TAG, "Arrival tolerance %d steps, timeout %d ms", new_config->tolerance, new_config->timeout_ms);
+}
+
+/**
+ * Get the arrival tolerance and timeout
+ */
+void motion_monitor_get_config(motion_config_t *out) {
+    portENTER_CRITICAL(&monitor_lock);
+    *out = config;
+    portEXIT_CRITICAL(&monitor_lock);
+}
+
+/**
+ * Watch a commanded move and notify when it arrives or gives up after timeout_ms
+ *
+ * Replaces any move still being watched; that one is reported as preempted.
+ */
+esp_err_t motion_monitor_watch(uint8_t move_id, const uint16_t target[ARM_NUM_JOINTS],
+                               uint8_t joint_mask, uint32_t timeout_ms) {
+    joint_mask &= ARM_ALL_JOINTS_MASK;
+    if (joint_mask == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = esp_timer_get_time();
+    uint16_t positions[ARM_NUM_JOINTS] = {0};
+
+    portENTER_CRITICAL(&monitor_lock);
+    bool replaced = watching;
+    uint8_t old_id = watch_id;
+    int64_t old_start_us = watch_start_us;
+    watching = true;
+    watch_generation++;
+    watch_id = move_id;
+    watch_mask = joint_mask;
+    memcpy(watch_target, target, sizeof(watch_target));
+    watch_start_us = now;
+    watch_deadline_us = now + (int64_t)timeout_ms * 1000;
+    portEXIT_CRITICAL(&monitor_lock);
+
+    if (replaced) {
+        motion_report(old_id, MOTION_RESULT_PREEMPTED, 0, old_start_us, positions);
+    }
+    xTaskNotifyGive(monitor_task_handle);
+    return ESP_OK;
+}
@@ -0,0 +1,55 @@
+#ifndef MOTION_MONITOR_H
+#define MOTION_MONITOR_H
+
+#include "sts_servo.h"
+
+// Arrival detection from servo feedback.
+//
+// A joint has arrived when its present position is within the tolerance of
+// its target and the servo has cleared its moving flag. Both come from one
+// sync read of PRESENT_POSITION..MOVING, so each check is a single bus
+// transaction for the whole arm.
+//
+// The player checks arrival before it dwells at a waypoint and at the end
+// of playback. CMD_MOVE_AND_WAIT sets a target and hands it to the monitor
+// task, which polls until the arm arrives or the timeout runs out, then sends
+// NOTIFY_TAG_MOTION_DONE. A newer move or a direct joint command replaces
+// the watched target; the old move is then reported as preempted.
+
+#define MOTION_DEFAULT_TOLERANCE  8       // Steps
+#define MOTION_DEFAULT_TIMEOUT_MS 2000    // Allowed on top of the planned move time
+#define MOTION_POLL_MS            20
+#define MOTION_TASK_STACK         3072
+#define MOTION_TASK_PRIORITY      7
+
+// Move results (motion_done_notify_t.result)
+#define MOTION_RESULT_ARRIVED     0x00
+#define MOTION_RESULT_TIMEOUT     0x01
+#define MOTION_RESULT_PREEMPTED   0x02    // Target replaced before arrival
+
+typedef struct {
+    uint16_t tolerance;                   // Steps either side of the target
+    uint16_t timeout_ms;
+} motion_config_t;
+
+// NOTIFY_TAG_MOTION_DONE, 18 bytes so it fits the default MTU
+typedef struct __attribute__((packed)) {
+    uint8_t tag;
+    uint8_t move_id;                      // From the move command
+    uint8_t result;                       // MOTION_RESULT_*
+    uint8_t arrived_mask;
+    uint16_t elapsed_ms;                  // Command to arrival (or giving up)
+    uint16_t positions[ARM_NUM_JOINTS];   // Last measured positions, 0 if never read
+} motion_done_notify_t;
+
+// Function prototypes
+esp_err_t motion_monitor_init(void);
+void motion_monitor_set_config(const motion_config_t *config);
+void motion_monitor_get_config(motion_config_t *config);
+esp_err_t motion_check_arrival(const uint16_t target[ARM_NUM_JOINTS], uint8_t joint_mask,
+                               uint16_t tolerance, uint8_t *arrived_mask,
+                               uint16_t positions[ARM_NUM_JOINTS]);
+esp_err_t motion_monitor_watch(uint8_t move_id, const uint16_t target[ARM_NUM_JOINTS],
+                               uint8_t joint_mask, uint32_t timeout_ms);
+
+#endif // MOTION_MONITOR_H
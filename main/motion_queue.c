@@ -0,0 +1,379 @@
+#include "motion_queue.h"
+#include "joint_calib.h"
+#include "control_loop.h"
+#include "sequence_player.h"
+#include "trajectory.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include <string.h>
+
+static const char *TAG = "MOTION_QUEUE";
+
+// Queue task event bits
+#define QUEUE_EVT_PUSH      (1 << 0)   // Segments added or the queue was replaced
+#define QUEUE_EVT_PLAN      (1 << 1)   // Control loop finished, chained or dropped a plan
+
+static TaskHandle_t queue_task_handle = NULL;
+static EventGroupHandle_t queue_events = NULL;
+
+// Segments and counters, protected by queue_lock. Sequence numbers count
+// every segment ever queued; the ring holds those from queue_planned on.
+static portMUX_TYPE queue_lock = portMUX_INITIALIZER_UNLOCKED;
+static motion_segment_t ring[MOTION_QUEUE_DEPTH];    // time_ms already converted to a duration
+static uint32_t queue_planned = 0;        // First segment not yet handed to the control loop
+static uint32_t queue_tail = 0;           // Next sequence number to queue
+static int64_t queue_tail_us = 0;         // When the newest segment arrived
+static bool queue_replace = false;        // Replaced since the task last looked
+static bool has_stamp = false;
+static uint16_t last_stamp = 0;
+static motion_queue_stats_t stats = {0};
+
+// Windows streamed by the control loop. Three buffers, so a replacement can
+// be planned while one window plays and the next waits behind it.
+// plan_first and streaming are shared with readers under queue_lock.
+#define QUEUE_PLANS 3
+static traj_plan_t plans[QUEUE_PLANS];
+static uint32_t plan_first[QUEUE_PLANS];  // Sequence number of each window's first segment
+static bool streaming = false;
+
+static const traj_config_t queue_config = {
+    .profile = TRAJ_PROFILE_CUBIC,
+    .vmax = TRAJ_DEFAULT_VMAX,
+    .amax = TRAJ_DEFAULT_AMAX,
+    .blend = 1.0f,
+};
+
+/**
+ * Buffer index of a plan, -1 if it is not one of ours
+ */
+static int queue_plan_index(const traj_plan_t *plan) {
+    for (int i = 0; i < QUEUE_PLANS; i++) {
+        if (plan == &plans[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Sequence number of the first segment the arm has not reached yet
+ */
+static uint32_t motion_queue_reached(void) {
+    portENTER_CRITICAL(&queue_lock);
+    bool active = streaming;
+    uint32_t planned = queue_planned;
+    uint32_t first[QUEUE_PLANS];
+    memcpy(first, plan_first, sizeof(first));
+    portEXIT_CRITICAL(&queue_lock);
+
+    float t;
+    const traj_plan_t *plan = control_loop_trajectory_plan(&t);
+    int index = queue_plan_index(plan);
+    if (!active || index < 0) {
+        return planned;
+    }
+    return first[index] + traj_waypoint_at(plan, t);
+}
+
+/**
+ * Drop everything not yet handed to the control loop (caller holds queue_lock)
+ */
+static void motion_queue_discard(void) {
+    queue_tail = queue_planned;
+    has_stamp = false;
+}
+
+/**
+ * Plan the next window and hand it to the control loop
+ *
+ * Holds the newest queued segment back as look-ahead unless it is the only
+ * one left. On success start and start_vel move on to the window's end.
+ */
+static bool motion_queue_plan(int buffer, float start[TRAJ_NUM_JOINTS], float start_vel[TRAJ_NUM_JOINTS],
+                              bool chain) {
+    traj_waypoint_t window[MOTION_QUEUE_WINDOW];
+    traj_waypoint_t lookahead;
+    uint8_t count = 0;
+    bool has_lookahead = false;
+
+    portENTER_CRITICAL(&queue_lock);
+    uint32_t first = queue_planned;
+    uint32_t unplanned = queue_tail - queue_planned;
+    uint32_t take = unplanned > 1 ? unplanned - 1 : unplanned;
+    if (take > MOTION_QUEUE_WINDOW) {
+        take = MOTION_QUEUE_WINDOW;
+    }
+    for (uint32_t n = 0; n <= take && n < unplanned; n++) {
+        const motion_segment_t *seg = &ring[(first + n) % MOTION_QUEUE_DEPTH];
+        has_lookahead = n == take;
+        traj_waypoint_t *wp = has_lookahead ? &lookahead : &window[count++];
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            wp->q[i] = seg->positions[i];
+        }
+        wp->duration_s = seg->time_ms / 1000.0f;
+        wp->dwell_s = 0.0f;
+    }
+    queue_planned += count;
+    plan_first[buffer] = first;
+    portEXIT_CRITICAL(&queue_lock);
+
+    traj_config_t config = queue_config;
+    joint_calib_limit_config(&config);
+    traj_plan_t *plan = &plans[buffer];
+    if (!traj_plan_window(plan, &config, start, start_vel, window, count,
+                          has_lookahead ? &lookahead : NULL)) {
+        ESP_LOGE(TAG, "Trajectory planning failed");
+        return false;
+    }
+
+    portENTER_CRITICAL(&queue_lock);
+    streaming = true;
+    stats.windows++;
+    portEXIT_CRITICAL(&queue_lock);
+
+    if (chain) {
+        control_loop_follow_next(plan);
+    } else {
+        control_loop_follow(plan);
+    }
+
+    ESP_LOGD(TAG, "Window of %d segments, %.2f s (%s)", count, plan->total_s,
+             chain ? "chained" : "from current motion");
+    memcpy(start, window[count - 1].q, sizeof(window[count - 1].q));
+    memcpy(start_vel, plan->end_vel, sizeof(plan->end_vel));
+    return true;
+}
+
+/**
+ * Queue task: plan queued segments into windows as late as blending allows
+ */
+static void motion_queue_task(void *pvParameters) {
+    (void)pvParameters;
+    float start[TRAJ_NUM_JOINTS] = {0};      // End of the last planned window
+    float start_vel[TRAJ_NUM_JOINTS] = {0};
+    int last_buffer = -1;                    // Window planned last; may still wait behind the playing one
+
+    ESP_LOGI(TAG, "Motion queue task started");
+
+    while (true) {
+        int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&queue_lock);
+        uint32_t unplanned = queue_tail - queue_planned;
+        int64_t tail_us = queue_tail_us;
+        bool replace = queue_replace;
+        queue_replace = false;
+        bool active = streaming;
+        portEXIT_CRITICAL(&queue_lock);
+
+        float t = 0.0f;
+        const traj_plan_t *plan = control_loop_trajectory_plan(&t);
+        int playing = queue_plan_index(plan);
+        bool restart = false;
+
+        if (active && playing < 0) {
+            // The last window ran out, or a direct command or the player took over
+            arm_position_t setpoint;
+            control_loop_get_target(&setpoint);
+            bool preempted = plan != NULL || control_loop_get_source() != NULL;
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                preempted |= setpoint.joints[i].position != (uint16_t)(start[i] + 0.5f);
+            }
+
+            portENTER_CRITICAL(&queue_lock);
+            streaming = false;
+            if (preempted) {
+                motion_queue_discard();
+            } else if (queue_tail == queue_planned) {
+                stats.underruns++;
+                has_stamp = false;
+            }
+            unplanned = queue_tail - queue_planned;
+            portEXIT_CRITICAL(&queue_lock);
+
+            if (preempted) {
+                ESP_LOGI(TAG, "Queue preempted, dropped the rest");
+            } else if (unplanned != 0) {
+                ESP_LOGW(TAG, "Next window was not planned in time, restarting from rest");
+            }
+            active = false;
+        } else if (active && replace) {
+            // Carry on from where the arm is right now, at its current velocity
+            traj_sample_at(plan, t, start, start_vel);
+            if (unplanned == 0) {
+                control_loop_stop_trajectory();
+                portENTER_CRITICAL(&queue_lock);
+                streaming = false;
+                portEXIT_CRITICAL(&queue_lock);
+                active = false;
+            } else {
+                restart = true;
+            }
+        }
+
+        // Never overwrite the playing window or the one queued behind it
+        int buffer = 0;
+        while (buffer == playing || buffer == last_buffer) {
+            buffer++;
+        }
+
+        TickType_t timeout = portMAX_DELAY;
+        if (unplanned > 0 && (!active || restart)) {
+            if (!active) {
+                arm_position_t setpoint;
+                control_loop_get_target(&setpoint);
+                for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                    start[i] = setpoint.joints[i].position;
+                }
+                memset(start_vel, 0, sizeof(start_vel));
+            }
+
+            // A lone segment gets a moment for its successor to arrive
+            int64_t held_ms = (now - tail_us) / 1000;
+            if (unplanned >= 2 || restart || held_ms >= MOTION_QUEUE_HOLD_MS) {
+                if (!motion_queue_plan(buffer, start, start_vel, false)) {
+                    motion_queue_clear();
+                }
+                last_buffer = buffer;
+                continue;
+            }
+            timeout = pdMS_TO_TICKS(MOTION_QUEUE_HOLD_MS - held_ms) + 1;
+        } else if (unplanned > 0 && active && !control_loop_trajectory_pending()) {
+            // Chain as late as possible so segments still arriving make the blend
+            float rate = control_loop_feed_rate();
+            float remaining_ms = rate > 0.0f ? (plan->total_s - t) * 1000.0f / rate : 0.0f;
+            if (rate > 0.0f && (unplanned > MOTION_QUEUE_WINDOW || remaining_ms <= MOTION_QUEUE_LEAD_MS)) {
+                if (!motion_queue_plan(buffer, start, start_vel, true)) {
+                    motion_queue_clear();
+                }
+                last_buffer = buffer;
+                continue;
+            }
+            if (rate > 0.0f) {
+                timeout = pdMS_TO_TICKS((uint32_t)(remaining_ms - MOTION_QUEUE_LEAD_MS)) + 1;
+            }
+        }
+        // Otherwise a push, a plan change or a feed change wakes us
+
+        xEventGroupWaitBits(queue_events, QUEUE_EVT_PUSH | QUEUE_EVT_PLAN, pdTRUE, pdFALSE, timeout);
+    }
+}
+
+/**
+ * Initialize the motion queue (idle until segments are queued)
+ */
+esp_err_t motion_queue_init(void) {
+    queue_events = xEventGroupCreate();
+    if (queue_events == NULL) {
+        ESP_LOGE(TAG, "Failed to create event group");
+        return ESP_FAIL;
+    }
+    if (control_loop_add_plan_event(queue_events, QUEUE_EVT_PLAN) != ESP_OK) {
+        ESP_LOGE(TAG, "No room for another plan listener");
+        return ESP_FAIL;
+    }
+
+    BaseType_t ret = xTaskCreate(motion_queue_task, "motion_queue", MOTION_QUEUE_TASK_STACK,
+                                 NULL, MOTION_QUEUE_TASK_PRIORITY, &queue_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Motion queue initialized: %d segments", MOTION_QUEUE_DEPTH);
+    return ESP_OK;
+}
+
+/**
+ * Queue segments behind what is already queued
+ *
+ * With MOTION_QUEUE_FLAG_REPLACE the unplayed segments are dropped first and
+ * the new ones blend in from the arm's current motion; with no segments that
+ * stops the queue where it is. Segments that do not fit are refused;
+ * *accepted tells how many were taken. Refused while the player runs.
+ */
+esp_err_t motion_queue_push(const motion_segment_t *segments, uint8_t count, uint8_t flags,
+                            uint8_t *accepted) {
+    if (accepted != NULL) {
+        *accepted = 0;
+    }
+    if (sequence_player_get_state() != PLAYER_IDLE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Reached only moves forward, so an early look is on the safe side
+    uint32_t reached = motion_queue_reached();
+    int64_t now = esp_timer_get_time();
+    uint8_t taken = 0;
+
+    portENTER_CRITICAL(&queue_lock);
+    if (flags & MOTION_QUEUE_FLAG_REPLACE) {
+        motion_queue_discard();
+        queue_replace = true;
+        // Windows already with the control loop are replaced too
+        reached = queue_planned;
+    }
+    for (; taken < count && queue_tail - reached < MOTION_QUEUE_DEPTH; taken++) {
+        motion_segment_t *seg = &ring[queue_tail % MOTION_QUEUE_DEPTH];
+        *seg = segments[taken];
+        if (flags & MOTION_QUEUE_FLAG_TIMESTAMPS) {
+            // The first stamp of a stream has nothing to measure from
+            uint16_t stamp = segments[taken].time_ms;
+            seg->time_ms = has_stamp ? (uint16_t)(stamp - last_stamp) : 0;
+            last_stamp = stamp;
+            has_stamp = true;
+        }
+        queue_tail++;
+    }
+    queue_tail_us = now;
+    stats.pushed += taken;
+    stats.dropped += count - taken;
+    portEXIT_CRITICAL(&queue_lock);
+
+    xEventGroupSetBits(queue_events, QUEUE_EVT_PUSH);
+    if (accepted != NULL) {
+        *accepted = taken;
+    }
+    return taken == count ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+/**
+ * Stop queued motion where it is and drop the rest
+ */
+void motion_queue_clear(void) {
+    portENTER_CRITICAL(&queue_lock);
+    motion_queue_discard();
+    queue_replace = true;
+    portEXIT_CRITICAL(&queue_lock);
+
+    xEventGroupSetBits(queue_events, QUEUE_EVT_PUSH);
+}
+
+/**
+ * Segments not reached yet and room for more
+ */
+void motion_queue_get_level(uint8_t *depth, uint8_t *free_slots) {
+    uint32_t reached = motion_queue_reached();
+
+    portENTER_CRITICAL(&queue_lock);
+    uint32_t queued = queue_tail - reached;
+    portEXIT_CRITICAL(&queue_lock);
+
+    if (queued > MOTION_QUEUE_DEPTH) {
+        queued = MOTION_QUEUE_DEPTH;
+    }
+    *depth = queued;
+    *free_slots = MOTION_QUEUE_DEPTH - queued;
+}
+
+/**
+ * Get queue statistics
+ */
+void motion_queue_get_stats(motion_queue_stats_t *out) {
+    portENTER_CRITICAL(&queue_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&queue_lock);
+}
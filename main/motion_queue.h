@@ -0,0 +1,58 @@
+#ifndef MOTION_QUEUE_H
+#define MOTION_QUEUE_H
+
+#include "sts_servo.h"
+
+// Buffered motion: the client queues segments ahead of time and the queue
+// task streams them through the control loop as one blended path.
+//
+// A segment is a target for all joints and the time to get there, either as
+// a duration or as a timestamp on the client's clock (the queue takes the
+// difference to the previous timestamp). The task plans windows of up to
+// MOTION_QUEUE_WINDOW segments and holds the newest queued segment back as
+// look-ahead, so each window ends moving towards the next instead of
+// stopping. It plans the next window only when enough is queued for a full
+// one or the playing window is about to run out, so late segments still
+// make it into the blend. The path comes to rest only when the queue runs
+// dry.
+//
+// Depth counts segments that have not been reached yet, including those
+// already handed to the control loop; free slots are what a client can send
+// next. Both are reported in telemetry (TELEMETRY_FIELD_QUEUE).
+//
+// A direct joint command, a Cartesian jog or starting the player preempts
+// the queue and drops what is left. Segments are refused while the player runs.
+
+#define MOTION_QUEUE_DEPTH        64
+#define MOTION_QUEUE_WINDOW       8       // Segments per planner window
+#define MOTION_QUEUE_LEAD_MS      30      // Plan the next window this long before the current one ends
+#define MOTION_QUEUE_HOLD_MS      100     // Wait this long for a successor before playing a lone segment
+#define MOTION_QUEUE_TASK_STACK   4096
+#define MOTION_QUEUE_TASK_PRIORITY 11
+
+// Push flags (CMD_QUEUE_SEGMENTS)
+#define MOTION_QUEUE_FLAG_TIMESTAMPS  (1 << 0)    // time_ms is a client timestamp, not a duration
+#define MOTION_QUEUE_FLAG_REPLACE     (1 << 1)    // Drop unplayed segments first
+
+// One queued segment as sent over BLE
+typedef struct __attribute__((packed)) {
+    uint16_t positions[ARM_NUM_JOINTS];
+    uint16_t time_ms;             // Duration, 0 = as fast as limits allow; or timestamp
+} motion_segment_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t dropped;             // Refused because the queue was full
+    uint32_t windows;
+    uint32_t underruns;           // The path ran out of segments and came to rest
+} motion_queue_stats_t;
+
+// Function prototypes
+esp_err_t motion_queue_init(void);
+esp_err_t motion_queue_push(const motion_segment_t *segments, uint8_t count, uint8_t flags,
+                            uint8_t *accepted);
+void motion_queue_clear(void);
+void motion_queue_get_level(uint8_t *depth, uint8_t *free_slots);
+void motion_queue_get_stats(motion_queue_stats_t *stats);
+
+#endif // MOTION_QUEUE_H
@@ -1,10 +1,166 @@
 #include "position_storage.h"
+#include "waypoint_codec.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include <string.h>
+#include <inttypes.h>
 
 static const char *TAG = "POS_STORAGE";
 static nvs_handle_t storage_handle;
 
+// RAM copy of every slot; NVS is only read at init and written by the flush task
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static arm_position_t slot_cache[MAX_STORAGE_SLOTS];
+static uint16_t valid_bitmap = 0;      // Slot holds a position
+static uint16_t dirty_bitmap = 0;      // Slot differs from NVS (written or cleared)
+static uint16_t legacy_bitmap = 0;     // Slot still has a raw arm_position_t blob to remove
+static bool erase_all_pending = false;
+
+static TaskHandle_t flush_task_handle = NULL;
+static SemaphoreHandle_t flush_mutex = NULL;   // Serialises NVS writes between task and callers
+static position_storage_stats_t storage_stats = {0};
+
+/**
+ * NVS key for a slot's encoded waypoint
+ */
+static void slot_key(uint8_t slot_id, char *key, size_t len) {
+    snprintf(key, len, "wp_%d", slot_id);
+}
+
+/**
+ * NVS key used before slots were encoded
+ */
+static void legacy_slot_key(uint8_t slot_id, char *key, size_t len) {
+    snprintf(key, len, "pos_%d", slot_id);
+}
+
+/**
+ * Write every dirty slot to NVS with a single commit
+ */
+static esp_err_t position_storage_write_back(void) {
+    arm_position_t snapshot[MAX_STORAGE_SLOTS];
+    uint16_t dirty;
+    uint16_t valid;
+    uint16_t legacy;
+    bool erase_all;
+
+    xSemaphoreTake(flush_mutex, portMAX_DELAY);
+
+    portENTER_CRITICAL(&cache_lock);
+    dirty = dirty_bitmap;
+    valid = valid_bitmap;
+    legacy = legacy_bitmap;
+    erase_all = erase_all_pending;
+    for (int slot = 0; slot < MAX_STORAGE_SLOTS; slot++) {
+        if (dirty & (1 << slot)) {
+            snapshot[slot] = slot_cache[slot];
+        }
+    }
+    dirty_bitmap = 0;
+    erase_all_pending = false;
+    portEXIT_CRITICAL(&cache_lock);
+
+    if (dirty == 0 && !erase_all) {
+        xSemaphoreGive(flush_mutex);
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (erase_all) {
+        ret = nvs_erase_all(storage_handle);
+    }
+
+    uint32_t written = 0;
+    uint32_t bytes = 0;
+    uint16_t migrated = 0;
+    for (int slot = 0; slot < MAX_STORAGE_SLOTS && ret == ESP_OK; slot++) {
+        if (!(dirty & (1 << slot))) {
+            continue;
+        }
+        char key[16];
+        slot_key(slot, key, sizeof(key));
+        if (valid & (1 << slot)) {
+            uint8_t encoded[WP_ENCODED_MAX_LEN];
+            size_t len = waypoint_encode(NULL, &snapshot[slot], encoded);
+            ret = len > 0 ? nvs_set_blob(storage_handle, key, encoded, len) : ESP_ERR_INVALID_ARG;
+            bytes += len;
+        } else {
+            ret = nvs_erase_key(storage_handle, key);
+            if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                ret = ESP_OK;
+            }
+        }
+        if (ret == ESP_OK && !erase_all && (legacy & (1 << slot))) {
+            legacy_slot_key(slot, key, sizeof(key));
+            ret = nvs_erase_key(storage_handle, key);
+            if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                ret = ESP_OK;
+            }
+            migrated |= 1 << slot;
+        }
+        written++;
+    }
+
+    if (ret == ESP_OK) {
+        ret = nvs_commit(storage_handle);
+    }
+
+    if (ret != ESP_OK) {
+        // Put the slots back so the next flush retries them
+        portENTER_CRITICAL(&cache_lock);
+        dirty_bitmap |= dirty;
+        erase_all_pending |= erase_all;
+        storage_stats.failures++;
+        portEXIT_CRITICAL(&cache_lock);
+        ESP_LOGE(TAG, "Write-back failed: %s", esp_err_to_name(ret));
+    } else {
+        portENTER_CRITICAL(&cache_lock);
+        storage_stats.commits++;
+        storage_stats.slots_written += written;
+        storage_stats.bytes_written += bytes;
+        legacy_bitmap &= erase_all ? 0 : ~migrated;
+        portEXIT_CRITICAL(&cache_lock);
+        ESP_LOGI(TAG, "Persisted %" PRIu32 " slot(s) in one commit", written);
+    }
+
+    xSemaphoreGive(flush_mutex);
+    return ret;
+}
+
+/**
+ * Flush task: wait for a change, let the burst settle, then commit once
+ */
+static void position_storage_flush_task(void *pvParameters) {
+    (void)pvParameters;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Keep extending the window while writes arrive, up to the max delay
+        TickType_t first = xTaskGetTickCount();
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POSITION_FLUSH_DELAY_MS)) != 0) {
+            if (xTaskGetTickCount() - first >= pdMS_TO_TICKS(POSITION_FLUSH_MAX_DELAY_MS)) {
+                break;
+            }
+        }
+
+        if (position_storage_write_back() != ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(POSITION_FLUSH_MAX_DELAY_MS));
+            xTaskNotifyGive(flush_task_handle);
+        }
+    }
+}
+
+/**
+ * Mark the cache changed and wake the flush task
+ */
+static void position_storage_schedule_flush(void) {
+    if (flush_task_handle != NULL) {
+        xTaskNotifyGive(flush_task_handle);
+    }
+}
+
 /**
  * Initialize position storage system
  */
@@ -14,35 +170,87 @@ esp_err_t position_storage_init(void) {
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(ret));
         return ret;
     }
-    
-    ESP_LOGI(TAG, "Position storage initialized");
+
+    // Load every slot once; from here on reads are served from RAM
+    valid_bitmap = 0;
+    dirty_bitmap = 0;
+    legacy_bitmap = 0;
+    for (int slot = 0; slot < MAX_STORAGE_SLOTS; slot++) {
+        char key[16];
+        slot_key(slot, key, sizeof(key));
+        uint8_t encoded[WP_ENCODED_MAX_LEN];
+        size_t required_size = sizeof(encoded);
+        ret = nvs_get_blob(storage_handle, key, encoded, &required_size);
+        if (ret == ESP_OK) {
+            if (waypoint_decode_list(encoded, required_size, &slot_cache[slot], 1) == 1) {
+                valid_bitmap |= 1 << slot;
+            } else {
+                ESP_LOGW(TAG, "Ignoring malformed slot %d", slot);
+            }
+        } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Ignoring unreadable slot %d: %s", slot, esp_err_to_name(ret));
+        }
+
+        // Slots saved as raw structs by older firmware are re-saved encoded
+        legacy_slot_key(slot, key, sizeof(key));
+        arm_position_t legacy;
+        required_size = sizeof(legacy);
+        ret = nvs_get_blob(storage_handle, key, &legacy, &required_size);
+        if (ret == ESP_OK) {
+            legacy_bitmap |= 1 << slot;
+            dirty_bitmap |= 1 << slot;
+            if (!(valid_bitmap & (1 << slot)) && required_size == sizeof(legacy)) {
+                slot_cache[slot] = legacy;
+                valid_bitmap |= 1 << slot;
+            }
+        }
+    }
+
+    flush_mutex = xSemaphoreCreateMutex();
+    if (flush_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_FAIL;
+    }
+
+    BaseType_t task_ret = xTaskCreate(position_storage_flush_task, "pos_flush",
+                                      POSITION_FLUSH_TASK_STACK, NULL,
+                                      POSITION_FLUSH_TASK_PRIORITY, &flush_task_handle);
+    if (task_ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create flush task");
+        return ESP_FAIL;
+    }
+
+    if (dirty_bitmap != 0) {
+        ESP_LOGI(TAG, "Migrating slots 0x%04X to the compact encoding", dirty_bitmap);
+        xTaskNotifyGive(flush_task_handle);
+    }
+    ESP_LOGI(TAG, "Position storage initialized (slots 0x%04X)", valid_bitmap);
     return ESP_OK;
 }
 
 /**
- * Save ARM position to storage slot
+ * Save ARM position to storage slot (persisted by the flush task)
  */
 esp_err_t position_storage_save(uint8_t slot_id, arm_position_t *position) {
     if (slot_id >= MAX_STORAGE_SLOTS) {
         ESP_LOGE(TAG, "Invalid slot ID: %d", slot_id);
         return ESP_ERR_INVALID_ARG;
     }
-    
-    char key[16];
-    snprintf(key, sizeof(key), "pos_%d", slot_id);
-    
-    esp_err_t ret = nvs_set_blob(storage_handle, key, position, sizeof(arm_position_t));
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save to slot %d: %s", slot_id, esp_err_to_name(ret));
-        return ret;
-    }
-    
-    ret = nvs_commit(storage_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit: %s", esp_err_to_name(ret));
-        return ret;
+
+    // Refuse here what the encoder would refuse at write-back
+    uint8_t encoded[WP_ENCODED_MAX_LEN];
+    if (waypoint_encode(NULL, position, encoded) == 0) {
+        ESP_LOGE(TAG, "Position out of range for slot %d", slot_id);
+        return ESP_ERR_INVALID_ARG;
     }
-    
+
+    portENTER_CRITICAL(&cache_lock);
+    slot_cache[slot_id] = *position;
+    valid_bitmap |= 1 << slot_id;
+    dirty_bitmap |= 1 << slot_id;
+    portEXIT_CRITICAL(&cache_lock);
+
+    position_storage_schedule_flush();
     ESP_LOGI(TAG, "Saved position to slot %d", slot_id);
     return ESP_OK;
 }
@@ -55,22 +263,21 @@ esp_err_t position_storage_load(uint8_t slot_id, arm_position_t *position) {
         ESP_LOGE(TAG, "Invalid slot ID: %d", slot_id);
         return ESP_ERR_INVALID_ARG;
     }
-    
-    char key[16];
-    snprintf(key, sizeof(key), "pos_%d", slot_id);
-    
-    size_t required_size = sizeof(arm_position_t);
-    esp_err_t ret = nvs_get_blob(storage_handle, key, position, &required_size);
-    
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+
+    bool exists;
+    portENTER_CRITICAL(&cache_lock);
+    exists = (valid_bitmap & (1 << slot_id)) != 0;
+    if (exists) {
+        *position = slot_cache[slot_id];
+    }
+    portEXIT_CRITICAL(&cache_lock);
+
+    if (!exists) {
         ESP_LOGW(TAG, "Slot %d is empty", slot_id);
-        return ret;
-    } else if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to load from slot %d: %s", slot_id, esp_err_to_name(ret));
-        return ret;
+        return ESP_ERR_NVS_NOT_FOUND;
     }
-    
-    ESP_LOGI(TAG, "Loaded position from slot %d", slot_id);
+
+    ESP_LOGD(TAG, "Loaded position from slot %d", slot_id);
     return ESP_OK;
 }
 
@@ -81,29 +288,38 @@ esp_err_t position_storage_clear(uint8_t slot_id) {
     if (slot_id >= MAX_STORAGE_SLOTS) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    char key[16];
-    snprintf(key, sizeof(key), "pos_%d", slot_id);
-    
-    esp_err_t ret = nvs_erase_key(storage_handle, key);
-    if (ret == ESP_OK) {
-        nvs_commit(storage_handle);
-        ESP_LOGI(TAG, "Cleared slot %d", slot_id);
+
+    bool existed;
+    portENTER_CRITICAL(&cache_lock);
+    existed = (valid_bitmap & (1 << slot_id)) != 0;
+    valid_bitmap &= ~(1 << slot_id);
+    if (existed) {
+        dirty_bitmap |= 1 << slot_id;
     }
-    
-    return ret;
+    portEXIT_CRITICAL(&cache_lock);
+
+    if (!existed) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    position_storage_schedule_flush();
+    ESP_LOGI(TAG, "Cleared slot %d", slot_id);
+    return ESP_OK;
 }
 
 /**
  * Clear all storage slots
  */
 esp_err_t position_storage_clear_all(void) {
-    esp_err_t ret = nvs_erase_all(storage_handle);
-    if (ret == ESP_OK) {
-        nvs_commit(storage_handle);
-        ESP_LOGI(TAG, "Cleared all positions");
-    }
-    return ret;
+    portENTER_CRITICAL(&cache_lock);
+    valid_bitmap = 0;
+    dirty_bitmap = 0;
+    erase_all_pending = true;
+    portEXIT_CRITICAL(&cache_lock);
+
+    position_storage_schedule_flush();
+    ESP_LOGI(TAG, "Cleared all positions");
+    return ESP_OK;
 }
 
 /**
@@ -113,12 +329,29 @@ bool position_storage_slot_exists(uint8_t slot_id) {
     if (slot_id >= MAX_STORAGE_SLOTS) {
         return false;
     }
-    
-    char key[16];
-    snprintf(key, sizeof(key), "pos_%d", slot_id);
-    
-    size_t required_size;
-    esp_err_t ret = nvs_get_blob(storage_handle, key, NULL, &required_size);
-    
-    return (ret == ESP_OK);
+    return (valid_bitmap & (1 << slot_id)) != 0;
+}
+
+/**
+ * Bitmap of occupied slots (bit n = slot n)
+ */
+uint16_t position_storage_get_bitmap(void) {
+    return valid_bitmap;
+}
+
+/**
+ * Persist pending changes now instead of waiting for the flush task
+ */
+esp_err_t position_storage_flush(void) {
+    return position_storage_write_back();
+}
+
+/**
+ * Copy write-behind counters
+ */
+void position_storage_get_stats(position_storage_stats_t *stats) {
+    portENTER_CRITICAL(&cache_lock);
+    *stats = storage_stats;
+    stats->pending = dirty_bitmap;
+    portEXIT_CRITICAL(&cache_lock);
 }
@@ -7,6 +7,21 @@
 #define MAX_STORAGE_SLOTS    16
 #define NVS_NAMESPACE        "arm_storage"
 
+// Write-behind: saves land in RAM and are committed once writes go quiet
+#define POSITION_FLUSH_DELAY_MS        500    // Quiet time before committing
+#define POSITION_FLUSH_MAX_DELAY_MS    2000   // Upper bound while writes keep arriving
+#define POSITION_FLUSH_TASK_STACK      3072
+#define POSITION_FLUSH_TASK_PRIORITY   3
+
+// Write-behind counters
+typedef struct {
+    uint32_t commits;          // nvs_commit calls made by write-back
+    uint32_t slots_written;    // Slots set or erased across those commits
+    uint32_t bytes_written;    // Encoded slot bytes handed to NVS
+    uint32_t failures;
+    uint16_t pending;          // Dirty slot bitmap not yet in NVS
+} position_storage_stats_t;
+
 // Function prototypes
 esp_err_t position_storage_init(void);
 esp_err_t position_storage_save(uint8_t slot_id, arm_position_t *position);
@@ -14,5 +29,8 @@ esp_err_t position_storage_load(uint8_t slot_id, arm_position_t *position);
 esp_err_t position_storage_clear(uint8_t slot_id);
 esp_err_t position_storage_clear_all(void);
 bool position_storage_slot_exists(uint8_t slot_id);
+uint16_t position_storage_get_bitmap(void);
+esp_err_t position_storage_flush(void);
+void position_storage_get_stats(position_storage_stats_t *stats);
 
 #endif // POSITION_STORAGE_H
@@ -0,0 +1,463 @@
+#include "program_xfer.h"
+#include "ble_arm_control.h"
+#include "waypoint_codec.h"
+#include "seq_vm.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "XFER";
+
+// Commands arrive on the BLE worker task only, so no locking is needed here
+
+// Upload: decoded as chunks arrive and appended to an open store writer
+static struct {
+    bool active;
+    bool script;               // Raw script bytes rather than a waypoint chain
+    char name[TRAJ_STORE_NAME_LEN];
+    uint32_t total_len;
+    uint32_t expected_crc;
+    uint32_t crc;              // Over the bytes received so far
+    uint32_t received;
+    uint8_t seq;               // Next expected chunk
+    uint8_t unacked;           // Chunks since the last ack
+    bool resend_sent;          // One RESEND per gap
+    arm_position_t prev;
+    uint8_t carry[WP_ENCODED_MAX_LEN];   // Waypoint split across chunks
+    uint8_t carry_len;
+    traj_store_writer_t writer;
+} upload;
+
+// Download: the chain is generated on the fly from mapped flash
+static struct {
+    bool active;
+    bool script;
+    traj_store_reader_t reader;
+    uint32_t total_len;
+    uint32_t crc;
+    uint32_t acked;            // Next offset the phone needs
+    uint32_t sent;             // Next offset to send
+    uint8_t seq;
+    uint32_t gen_offset;       // Chain offset of gen_buf
+    uint8_t gen_len;
+    uint8_t gen_buf[WP_ENCODED_MAX_LEN];
+    arm_position_t prev;
+    bool has_prev;
+} download;
+
+static uint8_t work_buf[WP_ENCODED_MAX_LEN + BLE_MAX_MTU];
+
+/**
+ * Send a transfer ack notification
+ */
+static void xfer_ack(uint8_t status, uint8_t dir, uint8_t seq, uint32_t offset,
+                     uint32_t total_len, uint32_t crc32) {
+    program_xfer_ack_t ack = {
+        .tag = NOTIFY_TAG_XFER_ACK,
+        .status = status,
+        .dir = dir,
+        .seq = seq,
+        .window = PROGRAM_XFER_WINDOW,
+        .offset = offset,
+        .total_len = total_len,
+        .crc32 = crc32,
+    };
+    ble_notify((uint8_t *)&ack, sizeof(ack));
+}
+
+/**
+ * Ack the upload's current state
+ */
+static void upload_ack(uint8_t status) {
+    xfer_ack(status, XFER_DIR_UPLOAD, upload.seq, upload.received, upload.total_len, upload.crc);
+}
+
+/**
+ * Program point as it travels in the chain
+ */
+static void point_to_waypoint(const traj_store_point_t *point, arm_position_t *wp) {
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        wp->joints[j].position = point->position[j];
+        wp->joints[j].time_ms = point->duration_ms;
+        wp->joints[j].speed = 0;
+    }
+    wp->delay_after_ms = point->dwell_ms;
+}
+
+/**
+ * Chain waypoint back to a program point; the slowest joint sets the travel time
+ */
+static bool waypoint_to_point(const arm_position_t *wp, traj_store_point_t *point) {
+    if (wp->delay_after_ms > UINT16_MAX) {
+        return false;
+    }
+    point->duration_ms = 0;
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        point->position[j] = wp->joints[j].position;
+        if (wp->joints[j].time_ms > point->duration_ms) {
+            point->duration_ms = wp->joints[j].time_ms;
+        }
+    }
+    point->dwell_ms = wp->delay_after_ms;
+    return true;
+}
+
+/**
+ * Drop the open upload and its partial record
+ */
+static void upload_abort(void) {
+    if (upload.active) {
+        traj_store_abort(&upload.writer);
+        upload.active = false;
+    }
+}
+
+/**
+ * Decode whole waypoints from carry + data into the store; keep a split tail
+ */
+static esp_err_t upload_consume(const uint8_t *data, size_t len) {
+    if (upload.script) {
+        return traj_store_write(&upload.writer, data, len);
+    }
+
+    memcpy(work_buf, upload.carry, upload.carry_len);
+    memcpy(&work_buf[upload.carry_len], data, len);
+    size_t total = upload.carry_len + len;
+    size_t pos = 0;
+    upload.carry_len = 0;
+
+    while (pos < total) {
+        arm_position_t next = upload.prev;
+        size_t end = pos;
+        if (!waypoint_decode(work_buf, total, &end, &next)) {
+            if (total - pos >= WP_ENCODED_MAX_LEN) {
+                return ESP_ERR_INVALID_ARG;   // Long enough to be complete, so it is malformed
+            }
+            memcpy(upload.carry, &work_buf[pos], total - pos);
+            upload.carry_len = total - pos;
+            break;
+        }
+
+        traj_store_point_t point;
+        if (!waypoint_to_point(&next, &point)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        esp_err_t ret = traj_store_append(&upload.writer, &point);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        upload.prev = next;
+        pos = end;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Start or resume an upload
+ */
+static void upload_begin(const char *name, bool script, uint32_t total_len, uint32_t crc32) {
+    if (upload.active && upload.script == script && strcmp(upload.name, name) == 0 &&
+        upload.total_len == total_len && upload.expected_crc == crc32) {
+        ESP_LOGI(TAG, "Resuming upload of '%s' at %" PRIu32 "/%" PRIu32, name, upload.received, total_len);
+        upload.unacked = 0;
+        upload.resend_sent = false;
+        upload_ack(XFER_STATUS_OK);
+        return;
+    }
+    if (upload.active) {
+        ESP_LOGW(TAG, "Dropping unfinished upload of '%s'", upload.name);
+        upload_abort();
+    }
+
+    memset(&upload, 0, sizeof(upload));
+    snprintf(upload.name, sizeof(upload.name), "%s", name);
+    upload.script = script;
+    upload.total_len = total_len;
+    upload.expected_crc = crc32;
+
+    if (total_len == 0 || (script && total_len > SEQ_VM_MAX_LEN)) {
+        upload_ack(XFER_STATUS_BAD_DATA);
+        return;
+    }
+    esp_err_t ret = script ? traj_store_begin_script(&upload.writer, name) : traj_store_begin(&upload.writer, name);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot store '%s': %s", name, esp_err_to_name(ret));
+        upload_ack(ret == ESP_ERR_NO_MEM ? XFER_STATUS_NO_SPACE : XFER_STATUS_ERROR);
+        return;
+    }
+
+    upload.active = true;
+    ESP_LOGI(TAG, "Upload of %s '%s' started: %" PRIu32 " bytes", script ? "script" : "program", name, total_len);
+    upload_ack(XFER_STATUS_OK);
+}
+
+/**
+ * Generate up to len chain bytes starting at offset; returns bytes produced
+ */
+static size_t download_fill(uint32_t offset, uint8_t *out, size_t len) {
+    if (download.script) {
+        size_t avail = offset < download.reader.stream_len ? download.reader.stream_len - offset : 0;
+        size_t take = avail < len ? avail : len;
+        memcpy(out, &download.reader.data[offset], take);
+        return take;
+    }
+
+    if (offset < download.gen_offset) {
+        traj_store_seek(&download.reader, 0);
+        download.gen_offset = 0;
+        download.gen_len = 0;
+        download.has_prev = false;
+    }
+
+    size_t produced = 0;
+    while (produced < len) {
+        uint32_t at = offset + produced;
+        if (at >= download.gen_offset + download.gen_len) {
+            traj_store_point_t point;
+            if (!traj_store_read(&download.reader, &point)) {
+                break;
+            }
+            arm_position_t wp;
+            point_to_waypoint(&point, &wp);
+            download.gen_offset += download.gen_len;
+            download.gen_len = waypoint_encode(download.has_prev ? &download.prev : NULL, &wp, download.gen_buf);
+            download.prev = wp;
+            download.has_prev = true;
+            continue;
+        }
+        size_t from = at - download.gen_offset;
+        size_t take = download.gen_len - from;
+        if (take > len - produced) {
+            take = len - produced;
+        }
+        memcpy(&out[produced], &download.gen_buf[from], take);
+        produced += take;
+    }
+    return produced;
+}
+
+/**
+ * Send chunks until the window past the last ack is full
+ */
+static void download_pump(void) {
+    uint16_t mtu = ble_get_mtu();
+    if (mtu < 3 + sizeof(program_xfer_chunk_t) + 1) {
+        return;
+    }
+    size_t chunk = mtu - 3 - sizeof(program_xfer_chunk_t);
+    uint32_t window_end = download.acked + PROGRAM_XFER_WINDOW * chunk;
+
+    while (download.sent < download.total_len && download.sent < window_end) {
+        program_xfer_chunk_t *hdr = (program_xfer_chunk_t *)work_buf;
+        size_t n = download_fill(download.sent, &work_buf[sizeof(*hdr)], chunk);
+        if (n == 0) {
+            break;
+        }
+        hdr->cmd = NOTIFY_TAG_XFER_DATA;
+        hdr->seq = download.seq;
+        hdr->offset = download.sent;
+        if (ble_notify(work_buf, sizeof(*hdr) + n) != ESP_OK) {
+            break;   // Retried on the next ack
+        }
+        download.sent += n;
+        download.seq++;
+    }
+}
+
+/**
+ * Close the open download
+ */
+static void download_close(void) {
+    if (download.active) {
+        traj_store_close(&download.reader);
+        download.active = false;
+    }
+}
+
+/**
+ * Start a download at offset
+ */
+static void download_begin(const char *name, bool script, uint32_t offset) {
+    download_close();
+    memset(&download, 0, sizeof(download));
+
+    esp_err_t ret = script ? traj_store_open_script(name, &download.reader) : traj_store_open(name, &download.reader);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Download of '%s': not found", name);
+        xfer_ack(XFER_STATUS_NOT_FOUND, XFER_DIR_DOWNLOAD, 0, 0, 0, 0);
+        return;
+    }
+    download.active = true;
+    download.script = script;
+
+    // One pass for the length and CRC the phone checks against
+    uint8_t buf[128];
+    size_t n;
+    while ((n = download_fill(download.total_len, buf, sizeof(buf))) > 0) {
+        download.crc = esp_rom_crc32_le(download.crc, buf, n);
+        download.total_len += n;
+    }
+
+    if (offset > download.total_len) {
+        offset = download.total_len;
+    }
+    download.acked = offset;
+    download.sent = offset;
+
+    ESP_LOGI(TAG, "Download of '%s': %" PRIu32 " points, %" PRIu32 " bytes from %" PRIu32,
+             name, download.reader.num_points, download.total_len, offset);
+    xfer_ack(XFER_STATUS_OK, XFER_DIR_DOWNLOAD, 0, offset, download.total_len, download.crc);
+    download_pump();
+}
+
+/**
+ * CMD_XFER_BEGIN
+ */
+void program_xfer_begin(const uint8_t *data, uint16_t len) {
+    const program_xfer_begin_t *cmd = (const program_xfer_begin_t *)data;
+    size_t name_len = len > sizeof(*cmd) ? len - sizeof(*cmd) : 0;
+    uint8_t dir = cmd->dir & ~XFER_FLAG_SCRIPT;
+    bool script = cmd->dir & XFER_FLAG_SCRIPT;
+    if (name_len == 0 || name_len >= TRAJ_STORE_NAME_LEN || dir > XFER_DIR_DOWNLOAD) {
+        xfer_ack(XFER_STATUS_ERROR, len >= 2 ? data[1] & ~XFER_FLAG_SCRIPT : 0, 0, 0, 0, 0);
+        return;
+    }
+
+    char name[TRAJ_STORE_NAME_LEN] = {0};
+    memcpy(name, &data[sizeof(*cmd)], name_len);
+    if (dir == XFER_DIR_UPLOAD) {
+        upload_begin(name, script, cmd->total_len, cmd->crc32);
+    } else {
+        download_begin(name, script, cmd->offset);
+    }
+}
+
+/**
+ * CMD_XFER_DATA
+ */
+void program_xfer_data(const uint8_t *data, uint16_t len) {
+    if (!upload.active) {
+        xfer_ack(XFER_STATUS_IDLE, XFER_DIR_UPLOAD, 0, 0, 0, 0);
+        return;
+    }
+    if (len <= sizeof(program_xfer_chunk_t)) {
+        return;
+    }
+
+    const program_xfer_chunk_t *hdr = (const program_xfer_chunk_t *)data;
+    uint16_t n = len - sizeof(*hdr);
+    if (hdr->offset != upload.received || hdr->seq != upload.seq) {
+        // Lost or repeated chunk: say where to resume, once per gap
+        if (!upload.resend_sent) {
+            upload.resend_sent = true;
+            upload_ack(XFER_STATUS_RESEND);
+        }
+        return;
+    }
+    upload.resend_sent = false;
+
+    if (upload.received + n > upload.total_len) {
+        ESP_LOGE(TAG, "Upload of '%s' overran its length", upload.name);
+        upload_ack(XFER_STATUS_BAD_DATA);
+        upload_abort();
+        return;
+    }
+
+    esp_err_t ret = upload_consume(&data[sizeof(*hdr)], n);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Upload of '%s' failed at %" PRIu32 ": %s", upload.name, upload.received,
+                 esp_err_to_name(ret));
+        upload_ack(ret == ESP_ERR_INVALID_ARG ? XFER_STATUS_BAD_DATA :
+                   ret == ESP_ERR_NO_MEM ? XFER_STATUS_NO_SPACE : XFER_STATUS_ERROR);
+        upload_abort();
+        return;
+    }
+
+    upload.crc = esp_rom_crc32_le(upload.crc, &data[sizeof(*hdr)], n);
+    upload.received += n;
+    upload.seq++;
+    if (++upload.unacked >= PROGRAM_XFER_ACK_EVERY || upload.received == upload.total_len) {
+        upload.unacked = 0;
+        upload_ack(XFER_STATUS_OK);
+    }
+}
+
+/**
+ * CMD_XFER_END: finish an upload or abort either direction
+ */
+void program_xfer_end(const uint8_t *data, uint16_t len) {
+    const program_xfer_end_t *cmd = (const program_xfer_end_t *)data;
+    if (len >= sizeof(*cmd) && cmd->abort) {
+        ESP_LOGI(TAG, "Transfer aborted");
+        upload_abort();
+        download_close();
+        xfer_ack(XFER_STATUS_IDLE, XFER_DIR_UPLOAD, 0, 0, 0, 0);
+        return;
+    }
+    if (!upload.active) {
+        xfer_ack(XFER_STATUS_IDLE, XFER_DIR_UPLOAD, 0, 0, 0, 0);
+        return;
+    }
+    if (upload.received != upload.total_len) {
+        upload_ack(XFER_STATUS_RESEND);
+        return;
+    }
+    if (upload.crc != upload.expected_crc || upload.carry_len != 0) {
+        ESP_LOGE(TAG, "Upload of '%s' rejected: CRC 0x%08" PRIx32 ", expected 0x%08" PRIx32,
+                 upload.name, upload.crc, upload.expected_crc);
+        upload_ack(upload.carry_len != 0 ? XFER_STATUS_BAD_DATA : XFER_STATUS_CRC_ERROR);
+        upload_abort();
+        return;
+    }
+
+    // A script is checked as a whole before anyone can run it
+    const uint8_t *code;
+    uint32_t code_len;
+    if (upload.script && (traj_store_written(&upload.writer, &code, &code_len) != ESP_OK ||
+                          seq_vm_verify(code, code_len) != ESP_OK)) {
+        ESP_LOGE(TAG, "Upload of '%s' rejected: not a valid script", upload.name);
+        upload_ack(XFER_STATUS_BAD_DATA);
+        upload_abort();
+        return;
+    }
+
+    upload.active = false;
+    esp_err_t ret = traj_store_commit(&upload.writer);
+    upload_ack(ret == ESP_OK ? XFER_STATUS_DONE : XFER_STATUS_ERROR);
+    ESP_LOGI(TAG, "Upload of '%s' %s: %" PRIu32 " points in %" PRIu32 " bytes", upload.name,
+             ret == ESP_OK ? "stored" : "failed", upload.writer.num_points, upload.total_len);
+}
+
+/**
+ * CMD_XFER_ACK: the phone's next needed offset for a download
+ */
+void program_xfer_next(const uint8_t *data, uint16_t len) {
+    if (len < sizeof(program_xfer_next_t)) {
+        return;
+    }
+    if (!download.active) {
+        xfer_ack(XFER_STATUS_IDLE, XFER_DIR_DOWNLOAD, 0, 0, 0, 0);
+        return;
+    }
+
+    const program_xfer_next_t *cmd = (const program_xfer_next_t *)data;
+    uint32_t offset = cmd->offset;
+    if (offset >= download.total_len) {
+        ESP_LOGI(TAG, "Download complete: %" PRIu32 " bytes", download.total_len);
+        download_close();
+        return;
+    }
+    if (offset > download.sent) {
+        return;   // Acks data never sent
+    }
+    if (offset > download.acked) {
+        download.acked = offset;
+    }
+    if (cmd->resend) {
+        download.acked = offset;
+        download.sent = offset;   // Go back to the gap
+    }
+    download_pump();
+}
@@ -0,0 +1,103 @@
+#ifndef PROGRAM_XFER_H
+#define PROGRAM_XFER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "traj_store.h"
+
+// Bulk transfer of stored programs over BLE.
+//
+// A program travels as a waypoint_codec chain: per point, the positions,
+// time_ms = travel time, speed = 0 and delay_after_ms = dwell. The chain is
+// split into chunks that fit the MTU. Each chunk carries a sequence number
+// and its byte offset, so either side can tell what is missing.
+//
+// Upload (phone -> arm):
+//   CMD_XFER_BEGIN dir=0 with total length, CRC-32 and name. The arm answers
+//   with an ack giving the offset to start from. That is 0 for a new
+//   transfer, or the bytes already received when the same transfer is
+//   begun again after a dropped connection.
+//   CMD_XFER_DATA chunks in order, at most `window` past the last ack. The
+//   arm acks every PROGRAM_XFER_ACK_EVERY chunks. A chunk at the wrong
+//   offset is dropped and answered once with XFER_STATUS_RESEND.
+//   CMD_XFER_END; the arm checks length and CRC and commits the program.
+//   Points are appended to the trajectory store as they arrive, so a
+//   program never has to fit in RAM.
+//
+// Download (arm -> phone):
+//   CMD_XFER_BEGIN dir=1 with the name and a start offset. The ack carries
+//   the total length and CRC, then NOTIFY_TAG_XFER_DATA chunks follow.
+//   CMD_XFER_ACK reports the next offset the phone needs, which opens the
+//   window for more chunks. With resend = 1 the arm goes back and sends
+//   again from that offset.
+//
+// Sequence scripts (seq_vm.h) use the same exchange with XFER_FLAG_SCRIPT
+// set in dir. Their bytes travel as they are stored, and an upload is
+// checked with seq_vm_verify() before it is committed.
+
+#define PROGRAM_XFER_WINDOW       8       // Chunks in flight before an ack is needed
+#define PROGRAM_XFER_ACK_EVERY    4       // Upload chunks per ack
+
+#define XFER_DIR_UPLOAD           0
+#define XFER_DIR_DOWNLOAD         1
+#define XFER_FLAG_SCRIPT          0x10    // Or'd into dir: a script rather than a path
+
+// Ack status
+#define XFER_STATUS_OK            0x00
+#define XFER_STATUS_RESEND        0x01    // Chunk out of order; resume at offset
+#define XFER_STATUS_DONE          0x02    // Upload committed
+#define XFER_STATUS_CRC_ERROR     0x03
+#define XFER_STATUS_BAD_DATA      0x04    // Not a valid waypoint chain or script
+#define XFER_STATUS_NOT_FOUND     0x05
+#define XFER_STATUS_NO_SPACE      0x06
+#define XFER_STATUS_IDLE          0x07    // No transfer open
+#define XFER_STATUS_ERROR         0x08
+
+// CMD_XFER_BEGIN, followed by the program name (1-15 bytes, not terminated)
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;
+    uint8_t dir;           // XFER_DIR_*, optionally | XFER_FLAG_SCRIPT
+    uint32_t total_len;    // Upload: encoded length
+    uint32_t crc32;        // Upload: CRC-32 of the encoded chain
+    uint32_t offset;       // Download: where to start
+} program_xfer_begin_t;
+
+// CMD_XFER_DATA and NOTIFY_TAG_XFER_DATA, followed by chunk bytes
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;           // Command or notification tag
+    uint8_t seq;           // Wraps at 256
+    uint32_t offset;       // Byte offset of the chunk in the chain
+} program_xfer_chunk_t;
+
+// CMD_XFER_END; abort = 1 drops an upload or stops a download
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;
+    uint8_t abort;
+} program_xfer_end_t;
+
+// CMD_XFER_ACK (download): everything before offset arrived
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;
+    uint8_t resend;        // 1 = the chunk at offset was lost, go back to it
+    uint32_t offset;
+} program_xfer_next_t;
+
+// NOTIFY_TAG_XFER_ACK, 17 bytes so it fits the default MTU
+typedef struct __attribute__((packed)) {
+    uint8_t tag;
+    uint8_t status;        // XFER_STATUS_*
+    uint8_t dir;
+    uint8_t seq;           // Upload: next expected sequence number
+    uint8_t window;        // Chunks the sender may have in flight
+    uint32_t offset;       // Upload: bytes received; download: start offset
+    uint32_t total_len;
+    uint32_t crc32;
+} program_xfer_ack_t;
+
+// Function prototypes
+void program_xfer_begin(const uint8_t *data, uint16_t len);
+void program_xfer_data(const uint8_t *data, uint16_t len);
+void program_xfer_end(const uint8_t *data, uint16_t len);
+void program_xfer_next(const uint8_t *data, uint16_t len);
+
+#endif // PROGRAM_XFER_H
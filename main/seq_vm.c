@@ -0,0 +1,657 @@
+#include "seq_vm.h"
+#include "position_storage.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "SEQ_VM";
+
+#define SEQ_VM_MAX_INSN_LEN       (2 + TRAJ_STORE_NAME_LEN)   // CALL_PROG with the longest name
+#define SEQ_VM_READ_TIMEOUT_MS    500
+
+// Internal step results besides seq_vm_result_t
+#define SEQ_STEP_CONTINUE         0xFF
+
+// Stack frame kinds
+#define SEQ_FRAME_LOOP            0
+#define SEQ_FRAME_CALL            1
+
+// Fixed instruction lengths, 0 for variable (CALL_PROG)
+static const uint8_t op_len[SEQ_OP_COUNT] = {
+    [SEQ_OP_END] = 1,
+    [SEQ_OP_MOVE_SLOT] = 2,
+    [SEQ_OP_MOVE] = 3 + 2 * ARM_NUM_JOINTS,
+    [SEQ_OP_DWELL] = 3,
+    [SEQ_OP_SPEED] = 2,
+    [SEQ_OP_REPEAT] = 3,
+    [SEQ_OP_NEXT] = 1,
+    [SEQ_OP_JUMP] = 3,
+    [SEQ_OP_JCMP] = 7,
+    [SEQ_OP_SET] = 4,
+    [SEQ_OP_ADD] = 4,
+    [SEQ_OP_CALL] = 3,
+    [SEQ_OP_CALL_PROG] = 0,
+    [SEQ_OP_WAIT] = 8,
+    [SEQ_OP_READ] = 3,
+};
+
+// Timing statistics, shared by every VM
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static seq_vm_stats_t stats;
+
+static uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+/**
+ * Length of the instruction at pc, 0 if it is cut short
+ */
+static uint8_t insn_len(const uint8_t *code, uint32_t len, uint32_t pc) {
+    uint8_t op = code[pc];
+    uint8_t n = op == SEQ_OP_CALL_PROG ? (pc + 1 < len ? 2 + code[pc + 1] : 2) : op_len[op];
+    return pc + n <= len ? n : 0;
+}
+
+/**
+ * Check that addr is the start of an instruction
+ */
+static bool insn_boundary(const uint8_t *code, uint32_t len, uint32_t addr) {
+    uint32_t pc = SEQ_VM_HEADER_LEN;
+    while (pc < addr) {
+        pc += insn_len(code, len, pc);
+    }
+    return pc == addr;
+}
+
+/**
+ * Check a script before it is stored or run
+ *
+ * Every opcode and operand must be valid and every jump or call must land
+ * on an instruction inside the script.
+ */
+esp_err_t seq_vm_verify(const uint8_t *code, uint32_t len) {
+    if (len < SEQ_VM_HEADER_LEN || len > SEQ_VM_MAX_LEN || get_u16(code) != SEQ_VM_MAGIC) {
+        ESP_LOGW(TAG, "Not a script");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (code[2] != SEQ_VM_VERSION) {
+        ESP_LOGW(TAG, "Script version %d not supported", code[2]);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t pc = SEQ_VM_HEADER_LEN;
+        while (pc < len) {
+            const uint8_t *p = &code[pc];
+            uint8_t n = p[0] < SEQ_OP_COUNT ? insn_len(code, len, pc) : 0;
+            bool ok = n > 0;
+
+            if (ok && pass == 0) {
+                switch (p[0]) {
+                    case SEQ_OP_MOVE_SLOT:
+                        ok = p[1] < MAX_STORAGE_SLOTS;
+                        break;
+                    case SEQ_OP_MOVE:
+                        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+                            ok &= get_u16(&p[1 + 2 * j]) <= STS_POSITION_MAX;
+                        }
+                        break;
+                    case SEQ_OP_SPEED:
+                        ok = p[1] >= 1 && p[1] <= 100;
+                        break;
+                    case SEQ_OP_JCMP:
+                        ok = p[1] < SEQ_VM_NUM_VARS && p[2] <= SEQ_CMP_GE;
+                        break;
+                    case SEQ_OP_SET:
+                    case SEQ_OP_ADD:
+                        ok = p[1] < SEQ_VM_NUM_VARS;
+                        break;
+                    case SEQ_OP_CALL_PROG:
+                        ok = p[1] > 0 && p[1] < TRAJ_STORE_NAME_LEN && memchr(&p[2], '\0', p[1]) == NULL;
+                        break;
+                    case SEQ_OP_WAIT:
+                        ok = (p[1] >> 4) <= SEQ_SRC_LOAD && (p[1] & 0x0F) < ARM_NUM_JOINTS &&
+                             p[2] <= SEQ_CMP_GE && (p[7] < SEQ_VM_NUM_VARS || p[7] == SEQ_VM_VAR_NONE);
+                        break;
+                    case SEQ_OP_READ:
+                        ok = (p[1] >> 4) <= SEQ_SRC_LOAD && (p[1] & 0x0F) < ARM_NUM_JOINTS &&
+                             p[2] < SEQ_VM_NUM_VARS;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            if (ok && pass == 1) {
+                // Operands are known good, so the walk for each target terminates
+                bool jump = p[0] == SEQ_OP_JUMP || p[0] == SEQ_OP_CALL || p[0] == SEQ_OP_JCMP;
+                uint32_t target = p[0] == SEQ_OP_JCMP ? get_u16(&p[5]) : jump ? get_u16(&p[1]) : 0;
+                if (jump) {
+                    // The header is not code, so 0 is as bad as any other target inside it
+                    ok = target >= SEQ_VM_HEADER_LEN && target < len && insn_boundary(code, len, target);
+                }
+            }
+
+            if (!ok) {
+                ESP_LOGW(TAG, "Bad instruction 0x%02X at %" PRIu32, p[0], pc);
+                return ESP_ERR_INVALID_ARG;
+            }
+            pc += n;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Compile a slot range into a script; returns its length, 0 if out is too small
+ */
+size_t seq_vm_compile_slots(uint8_t start_slot, uint8_t end_slot, bool loop, uint8_t *out, size_t out_len) {
+    size_t need = SEQ_VM_HEADER_LEN + (end_slot - start_slot + 1) * 2 + (loop ? 4 : 0) + 1;
+    if (start_slot > end_slot || need > out_len) {
+        return 0;
+    }
+
+    size_t n = 0;
+    out[n++] = SEQ_VM_MAGIC & 0xFF;
+    out[n++] = SEQ_VM_MAGIC >> 8;
+    out[n++] = SEQ_VM_VERSION;
+    out[n++] = 0;
+    if (loop) {
+        out[n++] = SEQ_OP_REPEAT;
+        out[n++] = 0;
+        out[n++] = 0;
+    }
+    for (int slot = start_slot; slot <= end_slot; slot++) {
+        out[n++] = SEQ_OP_MOVE_SLOT;
+        out[n++] = slot;
+    }
+    if (loop) {
+        out[n++] = SEQ_OP_NEXT;
+    }
+    out[n++] = SEQ_OP_END;
+    return n;
+}
+
+/**
+ * Copy n bytes at addr of the running program through the instruction cache
+ */
+static bool vm_fetch(seq_vm_t *vm, uint32_t addr, uint8_t *out, uint8_t n, uint32_t *hits, uint32_t *misses) {
+    const seq_vm_program_t *prog = &vm->programs[vm->program];
+    if (addr + n > prog->len) {
+        return false;
+    }
+
+    while (n > 0) {
+        uint32_t line_addr = addr & ~(uint32_t)(SEQ_VM_CACHE_LINE_LEN - 1);
+        uint32_t tag = (uint32_t)vm->program << 16 | line_addr;
+        seq_vm_cache_line_t *line = &vm->cache[(line_addr / SEQ_VM_CACHE_LINE_LEN + vm->program) % SEQ_VM_CACHE_LINES];
+        if (line->tag == tag) {
+            (*hits)++;
+        } else {
+            uint32_t fill = prog->len - line_addr;
+            memcpy(line->data, &prog->code[line_addr], fill < SEQ_VM_CACHE_LINE_LEN ? fill : SEQ_VM_CACHE_LINE_LEN);
+            line->tag = tag;
+            (*misses)++;
+        }
+
+        uint32_t offset = addr - line_addr;
+        uint8_t take = SEQ_VM_CACHE_LINE_LEN - offset < n ? SEQ_VM_CACHE_LINE_LEN - offset : n;
+        memcpy(out, &line->data[offset], take);
+        out += take;
+        addr += take;
+        n -= take;
+    }
+    return true;
+}
+
+/**
+ * Add one instruction's time and cache use to the statistics
+ */
+static void vm_record(uint8_t op, int64_t start_us, uint32_t hits, uint32_t misses) {
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    portENTER_CRITICAL(&stats_lock);
+    stats.ops[op].count++;
+    stats.ops[op].total_us += us;
+    if (us > stats.ops[op].max_us) {
+        stats.ops[op].max_us = us;
+    }
+    stats.cache_hits += hits;
+    stats.cache_misses += misses;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static bool vm_compare(int32_t a, uint8_t cmp, int32_t b) {
+    switch (cmp) {
+        case SEQ_CMP_EQ: return a == b;
+        case SEQ_CMP_NE: return a != b;
+        case SEQ_CMP_LT: return a < b;
+        case SEQ_CMP_GT: return a > b;
+        case SEQ_CMP_LE: return a <= b;
+        default:         return a >= b;
+    }
+}
+
+static bool vm_push(seq_vm_t *vm, uint8_t kind, uint16_t pc, uint16_t remaining) {
+    if (vm->depth >= SEQ_VM_STACK_DEPTH) {
+        ESP_LOGE(TAG, "Stack overflow at %d", vm->pc);
+        return false;
+    }
+    vm->stack[vm->depth++] = (seq_vm_frame_t){
+        .kind = kind,
+        .program = vm->program,
+        .pc = pc,
+        .remaining = remaining,
+        .outputs = vm->outputs,
+    };
+    return true;
+}
+
+/**
+ * Apply the SPEED override and remember where the point goes
+ */
+static void vm_point(seq_vm_t *vm, traj_waypoint_t *wp) {
+    if (vm->speed_pct < 100) {
+        float d_max = 0.0f;
+        for (int i = 0; i < TRAJ_NUM_JOINTS; i++) {
+            d_max = fmaxf(d_max, fabsf(wp->q[i] - vm->last_q[i]));
+        }
+        float fastest = traj_min_duration(&vm->config, d_max);
+        wp->duration_s = fmaxf(wp->duration_s, fastest) * 100.0f / vm->speed_pct;
+    }
+    memcpy(vm->last_q, wp->q, sizeof(vm->last_q));
+}
+
+/**
+ * Open a stored script into the program table, or find it already open
+ */
+static int vm_open_program(seq_vm_t *vm, const char *name) {
+    for (int i = 0; i < vm->num_programs; i++) {
+        if (strcmp(vm->programs[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (vm->num_programs >= SEQ_VM_MAX_PROGRAMS) {
+        ESP_LOGE(TAG, "Too many scripts open to call '%s'", name);
+        return -1;
+    }
+
+    seq_vm_program_t *prog = &vm->programs[vm->num_programs];
+    if (traj_store_open_script(name, &prog->reader) != ESP_OK) {
+        ESP_LOGE(TAG, "Script '%s' not found", name);
+        return -1;
+    }
+    if (seq_vm_verify(prog->reader.data, prog->reader.stream_len) != ESP_OK) {
+        traj_store_close(&prog->reader);
+        return -1;
+    }
+    prog->code = prog->reader.data;
+    prog->len = prog->reader.stream_len;
+    snprintf(prog->name, sizeof(prog->name), "%s", name);
+    return vm->num_programs++;
+}
+
+/**
+ * Execute one instruction
+ */
+static uint8_t vm_step(seq_vm_t *vm, traj_waypoint_t *wp, uint8_t *slot) {
+    int64_t start_us = esp_timer_get_time();
+    uint32_t hits = 0, misses = 0;
+    uint8_t insn[SEQ_VM_MAX_INSN_LEN];
+    uint16_t pc = vm->pc;
+
+    // Running off the end is END
+    if (!vm_fetch(vm, pc, insn, 1, &hits, &misses)) {
+        insn[0] = SEQ_OP_END;
+    }
+    uint8_t op = insn[0];
+    if (op >= SEQ_OP_COUNT) {
+        ESP_LOGE(TAG, "Bad opcode 0x%02X at %d", op, pc);
+        return SEQ_VM_ERROR;
+    }
+    uint8_t n = op_len[op];
+    if (op == SEQ_OP_CALL_PROG) {
+        vm_fetch(vm, pc + 1, &insn[1], 1, &hits, &misses);
+        n = 2 + insn[1];
+    }
+    if (n > 1) {
+        vm_fetch(vm, pc + 1, &insn[1], n - 1, &hits, &misses);
+    }
+    vm->pc = pc + n;
+
+    uint8_t result = SEQ_STEP_CONTINUE;
+    switch (op) {
+        case SEQ_OP_END:
+            // Return from the innermost call, dropping loops left open inside it
+            while (vm->depth > 0 && vm->stack[vm->depth - 1].kind != SEQ_FRAME_CALL) {
+                vm->depth--;
+            }
+            if (vm->depth == 0) {
+                vm->pc = pc;
+                result = SEQ_VM_END;
+                break;
+            }
+            vm->depth--;
+            vm->program = vm->stack[vm->depth].program;
+            vm->pc = vm->stack[vm->depth].pc;
+            break;
+
+        case SEQ_OP_MOVE_SLOT: {
+            arm_position_t position;
+            if (!position_storage_slot_exists(insn[1]) || position_storage_load(insn[1], &position) != ESP_OK) {
+                ESP_LOGW(TAG, "Slot %d doesn't exist, skipping", insn[1]);
+                break;
+            }
+            // The slowest joint's time sets the segment duration; all joints arrive together
+            uint16_t max_time = 0;
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                wp->q[i] = position.joints[i].position;
+                if (position.joints[i].time_ms > max_time) {
+                    max_time = position.joints[i].time_ms;
+                }
+            }
+            wp->duration_s = max_time / 1000.0f;
+            wp->dwell_s = position.delay_after_ms / 1000.0f;
+            vm_point(vm, wp);
+            *slot = insn[1];
+            result = SEQ_VM_POINT;
+            break;
+        }
+
+        case SEQ_OP_MOVE:
+            for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                wp->q[i] = get_u16(&insn[1 + 2 * i]);
+            }
+            wp->duration_s = get_u16(&insn[1 + 2 * ARM_NUM_JOINTS]) / 1000.0f;
+            wp->dwell_s = 0.0f;
+            vm_point(vm, wp);
+            *slot = SEQ_VM_NO_SLOT;
+            result = SEQ_VM_POINT;
+            break;
+
+        case SEQ_OP_DWELL:
+            if (vm->has_pending) {
+                vm->pending.dwell_s += get_u16(&insn[1]) / 1000.0f;
+                break;
+            }
+            // Nothing to attach it to (start of the script or after a sync): hold in place
+            memcpy(wp->q, vm->last_q, sizeof(wp->q));
+            wp->duration_s = 0.0f;
+            wp->dwell_s = get_u16(&insn[1]) / 1000.0f;
+            *slot = SEQ_VM_NO_SLOT;
+            result = SEQ_VM_POINT;
+            break;
+
+        case SEQ_OP_SPEED:
+            vm->speed_pct = insn[1];
+            break;
+
+        case SEQ_OP_REPEAT:
+            if (!vm_push(vm, SEQ_FRAME_LOOP, vm->pc, get_u16(&insn[1]))) {
+                result = SEQ_VM_ERROR;
+            }
+            break;
+
+        case SEQ_OP_NEXT: {
+            seq_vm_frame_t *frame = vm->depth > 0 ? &vm->stack[vm->depth - 1] : NULL;
+            if (frame == NULL || frame->kind != SEQ_FRAME_LOOP || frame->program != vm->program) {
+                ESP_LOGE(TAG, "NEXT without REPEAT at %d", pc);
+                result = SEQ_VM_ERROR;
+                break;
+            }
+            if (frame->remaining == 0 && frame->outputs == vm->outputs) {
+                // An endless loop that moves nothing would spin until the step limit
+                ESP_LOGW(TAG, "Loop at %d has nothing to play, leaving it", frame->pc);
+                vm->depth--;
+            } else if (frame->remaining == 0 || --frame->remaining > 0) {
+                frame->outputs = vm->outputs;
+                vm->pc = frame->pc;
+            } else {
+                vm->depth--;
+            }
+            break;
+        }
+
+        case SEQ_OP_JUMP:
+            vm->pc = get_u16(&insn[1]);
+            break;
+
+        case SEQ_OP_JCMP:
+            if (vm_compare(vm->vars[insn[1]], insn[2], (int16_t)get_u16(&insn[3]))) {
+                vm->pc = get_u16(&insn[5]);
+            }
+            break;
+
+        case SEQ_OP_SET:
+            vm->vars[insn[1]] = (int16_t)get_u16(&insn[2]);
+            break;
+
+        case SEQ_OP_ADD:
+            vm->vars[insn[1]] += (int16_t)get_u16(&insn[2]);
+            break;
+
+        case SEQ_OP_CALL:
+            if (!vm_push(vm, SEQ_FRAME_CALL, vm->pc, 0)) {
+                result = SEQ_VM_ERROR;
+                break;
+            }
+            vm->pc = get_u16(&insn[1]);
+            break;
+
+        case SEQ_OP_CALL_PROG: {
+            char name[TRAJ_STORE_NAME_LEN] = {0};
+            memcpy(name, &insn[2], insn[1]);
+            int index = vm_open_program(vm, name);
+            if (index < 0 || !vm_push(vm, SEQ_FRAME_CALL, vm->pc, 0)) {
+                result = SEQ_VM_ERROR;
+                break;
+            }
+            vm->program = index;
+            vm->pc = SEQ_VM_HEADER_LEN;
+            break;
+        }
+
+        case SEQ_OP_WAIT:
+        case SEQ_OP_READ:
+            vm->sync_op = op;
+            vm->sync_src = insn[1];
+            if (op == SEQ_OP_WAIT) {
+                vm->sync_cmp = insn[2];
+                vm->sync_value = (int16_t)get_u16(&insn[3]);
+                vm->sync_timeout_ms = get_u16(&insn[5]);
+                vm->sync_var = insn[7];
+            } else {
+                vm->sync_timeout_ms = SEQ_VM_READ_TIMEOUT_MS;
+                vm->sync_var = insn[2];
+            }
+            vm->sync_deadline_us = 0;   // The clock starts with the first poll
+            result = SEQ_VM_SYNC;
+            break;
+    }
+
+    vm_record(op, start_us, hits, misses);
+    return result;
+}
+
+/**
+ * Start a script held in RAM; code must stay valid until seq_vm_close()
+ */
+esp_err_t seq_vm_start(seq_vm_t *vm, const uint8_t *code, uint32_t len,
+                       const traj_config_t *config, const float start[TRAJ_NUM_JOINTS]) {
+    memset(vm, 0, sizeof(*vm));
+    esp_err_t ret = seq_vm_verify(code, len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    vm->programs[0].code = code;
+    vm->programs[0].len = len;
+    vm->programs[0].reader.program = -1;
+    vm->num_programs = 1;
+    vm->pc = SEQ_VM_HEADER_LEN;
+    vm->config = *config;
+    vm->speed_pct = 100;
+    memcpy(vm->last_q, start, sizeof(vm->last_q));
+    for (int i = 0; i < SEQ_VM_CACHE_LINES; i++) {
+        vm->cache[i].tag = UINT32_MAX;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Start a stored script, run straight from mapped flash
+ */
+esp_err_t seq_vm_start_stored(seq_vm_t *vm, const char *name, const traj_config_t *config,
+                              const float start[TRAJ_NUM_JOINTS]) {
+    traj_store_reader_t reader;
+    esp_err_t ret = traj_store_open_script(name, &reader);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = seq_vm_start(vm, reader.data, reader.stream_len, config, start);
+    if (ret != ESP_OK) {
+        traj_store_close(&reader);
+        return ret;
+    }
+    vm->programs[0].reader = reader;
+    strncpy(vm->programs[0].name, name, sizeof(vm->programs[0].name) - 1);
+    return ESP_OK;
+}
+
+/**
+ * Run the script up to its next output
+ *
+ * Points are held back by one, so a DWELL that follows a move becomes that
+ * move's hold rather than a waypoint of its own. END and ERROR repeat once
+ * reached.
+ */
+seq_vm_result_t seq_vm_next(seq_vm_t *vm, traj_waypoint_t *wp, uint8_t *slot) {
+    if (vm->has_deferred) {
+        seq_vm_result_t result = vm->deferred;
+        vm->has_deferred = result == SEQ_VM_END || result == SEQ_VM_ERROR;
+        return result;
+    }
+
+    uint32_t steps = 0;
+    while (true) {
+        traj_waypoint_t point;
+        uint8_t point_slot = SEQ_VM_NO_SLOT;
+        uint8_t result;
+        if (++steps > SEQ_VM_MAX_STEPS) {
+            ESP_LOGE(TAG, "No motion after %d instructions, stopping at %d", SEQ_VM_MAX_STEPS, vm->pc);
+            result = SEQ_VM_ERROR;
+        } else {
+            result = vm_step(vm, &point, &point_slot);
+        }
+
+        if (result == SEQ_STEP_CONTINUE) {
+            continue;
+        }
+        if (result == SEQ_VM_POINT || result == SEQ_VM_SYNC) {
+            vm->outputs++;
+            steps = 0;
+        }
+        if (result == SEQ_VM_POINT && !vm->has_pending) {
+            vm->pending = point;
+            vm->pending_slot = point_slot;
+            vm->has_pending = true;
+            continue;
+        }
+
+        if (vm->has_pending) {
+            *wp = vm->pending;
+            *slot = vm->pending_slot;
+            if (result == SEQ_VM_POINT) {
+                vm->pending = point;
+                vm->pending_slot = point_slot;
+            } else {
+                vm->has_pending = false;
+                vm->deferred = result;
+                vm->has_deferred = true;
+            }
+            return SEQ_VM_POINT;
+        }
+        vm->deferred = result;
+        vm->has_deferred = result == SEQ_VM_END || result == SEQ_VM_ERROR;
+        return result;
+    }
+}
+
+/**
+ * Read the servos for the WAIT or READ behind a SEQ_VM_SYNC; true once it is done
+ *
+ * Call after the motion before it has played out, and again every poll
+ * interval until it returns true.
+ */
+bool seq_vm_poll(seq_vm_t *vm) {
+    int64_t start_us = esp_timer_get_time();
+    if (vm->sync_deadline_us == 0 && vm->sync_timeout_ms > 0) {
+        vm->sync_deadline_us = start_us + (int64_t)vm->sync_timeout_ms * 1000;
+    }
+
+    uint8_t field = vm->sync_src >> 4;
+    uint8_t joint = vm->sync_src & 0x0F;
+    sts_feedback_t feedback[ARM_NUM_JOINTS];
+    uint8_t valid_mask = 0;
+    sts_servo_sync_read(field == SEQ_SRC_POSITION ? STS_FB_POSITION :
+                        field == SEQ_SRC_SPEED ? STS_FB_SPEED : STS_FB_LOAD,
+                        feedback, &valid_mask, 0);
+
+    bool done = false;
+    if (valid_mask & (1 << joint)) {
+        int32_t value = field == SEQ_SRC_POSITION ? feedback[joint].position :
+                        field == SEQ_SRC_SPEED ? feedback[joint].speed : feedback[joint].load;
+        if (vm->sync_op == SEQ_OP_READ) {
+            vm->vars[vm->sync_var] = value;
+            done = true;
+        } else if (vm_compare(value, vm->sync_cmp, vm->sync_value)) {
+            if (vm->sync_var != SEQ_VM_VAR_NONE) {
+                vm->vars[vm->sync_var] = 1;
+            }
+            done = true;
+        }
+    }
+    if (!done && vm->sync_deadline_us > 0 && start_us >= vm->sync_deadline_us) {
+        if (vm->sync_op == SEQ_OP_READ) {
+            ESP_LOGW(TAG, "Joint %d did not answer, variable %d unchanged", joint, vm->sync_var);
+        } else if (vm->sync_var != SEQ_VM_VAR_NONE) {
+            vm->vars[vm->sync_var] = 0;
+        }
+        done = true;
+    }
+
+    vm_record(vm->sync_op, start_us, 0, 0);
+    return done;
+}
+
+/**
+ * Close every stored script the VM has open
+ */
+void seq_vm_close(seq_vm_t *vm) {
+    for (int i = 0; i < vm->num_programs; i++) {
+        if (vm->programs[i].name[0] != '\0') {
+            traj_store_close(&vm->programs[i].reader);
+        }
+    }
+    vm->num_programs = 0;
+}
+
+/**
+ * Copy the per-instruction timing and cache statistics
+ */
+void seq_vm_get_stats(seq_vm_stats_t *out) {
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+/**
+ * Clear the statistics
+ */
+void seq_vm_reset_stats(void) {
+    portENTER_CRITICAL(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,172 @@
+#ifndef SEQ_VM_H
+#define SEQ_VM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "trajectory.h"
+#include "traj_store.h"
+
+// Sequence scripts: a compact bytecode run by the sequence player.
+//
+// A script starts with a 4-byte header (magic u16, version u8, reserved u8)
+// followed by instructions. Each instruction is an opcode byte and fixed
+// little-endian operands. Jump and call targets are absolute byte offsets
+// into the script. Running off the end is the same as END.
+//
+//   END                              Return from CALL, otherwise stop
+//   MOVE_SLOT  slot u8               Move to a stored slot (its time and delay)
+//   MOVE       pos u16 x6, time u16  Move to explicit positions, time 0 = fastest
+//   DWELL      ms u16                Hold at the last point
+//   SPEED      pct u8                Scale later moves to 1-100% of their speed
+//   REPEAT     count u16             Repeat up to the matching NEXT, 0 = forever
+//   NEXT
+//   JUMP       addr u16
+//   JCMP       var u8, cmp u8, value i16, addr u16   Jump if var <cmp> value
+//   SET        var u8, value i16
+//   ADD        var u8, value i16
+//   CALL       addr u16              Subroutine in this script
+//   CALL_PROG  len u8, name          Run another stored script, then come back
+//   WAIT       src u8, cmp u8, value i16, timeout u16, var u8
+//   READ       src u8, var u8
+//
+// Moves are streamed as one blended path. WAIT and READ synchronise: the
+// motion so far plays out and the arm settles before the servos are read.
+// WAIT polls until <src> <cmp> value holds and sets var to 1, or to 0 when
+// timeout ms (0 = never) run out first; var 0xFF discards the result. READ
+// stores the value itself.
+//
+// src is field << 4 | joint, with joint 0-5 and field SEQ_SRC_POSITION,
+// SEQ_SRC_SPEED or SEQ_SRC_LOAD.
+//
+// Instructions are fetched through a small direct-mapped cache, so loop
+// bodies run from RAM rather than from mapped flash. Execution is bounded by
+// the call/loop stack and by SEQ_VM_MAX_STEPS instructions between two
+// outputs, so a script cannot hang the player.
+
+#define SEQ_VM_MAGIC              0x5153    // "SQ"
+#define SEQ_VM_VERSION            1
+#define SEQ_VM_HEADER_LEN         4
+#define SEQ_VM_MAX_LEN            0xFFFF    // 16-bit addresses
+#define SEQ_VM_NUM_VARS           16
+#define SEQ_VM_STACK_DEPTH        8         // Nested REPEAT and CALL frames
+#define SEQ_VM_MAX_PROGRAMS       4         // The main script plus scripts it calls
+#define SEQ_VM_MAX_STEPS          1024      // Instructions without a point or sync
+#define SEQ_VM_CACHE_LINES        8
+#define SEQ_VM_CACHE_LINE_LEN     32
+#define SEQ_VM_VAR_NONE           0xFF
+#define SEQ_VM_NO_SLOT            0xFF      // Point that is not a stored slot
+
+// Opcodes
+#define SEQ_OP_END                0x00
+#define SEQ_OP_MOVE_SLOT          0x01
+#define SEQ_OP_MOVE               0x02
+#define SEQ_OP_DWELL              0x03
+#define SEQ_OP_SPEED              0x04
+#define SEQ_OP_REPEAT             0x05
+#define SEQ_OP_NEXT               0x06
+#define SEQ_OP_JUMP               0x07
+#define SEQ_OP_JCMP               0x08
+#define SEQ_OP_SET                0x09
+#define SEQ_OP_ADD                0x0A
+#define SEQ_OP_CALL               0x0B
+#define SEQ_OP_CALL_PROG          0x0C
+#define SEQ_OP_WAIT               0x0D
+#define SEQ_OP_READ               0x0E
+#define SEQ_OP_COUNT              0x0F
+
+// Comparisons
+#define SEQ_CMP_EQ                0
+#define SEQ_CMP_NE                1
+#define SEQ_CMP_LT                2
+#define SEQ_CMP_GT                3
+#define SEQ_CMP_LE                4
+#define SEQ_CMP_GE                5
+
+// Sensor fields for WAIT and READ
+#define SEQ_SRC_POSITION          0
+#define SEQ_SRC_SPEED             1
+#define SEQ_SRC_LOAD              2
+
+typedef enum {
+    SEQ_VM_POINT,                 // A waypoint to stream
+    SEQ_VM_SYNC,                  // Play out, settle, then seq_vm_poll() until true
+    SEQ_VM_END,
+    SEQ_VM_ERROR,
+} seq_vm_result_t;
+
+typedef struct {
+    const uint8_t *code;
+    uint32_t len;
+    char name[TRAJ_STORE_NAME_LEN];   // Empty for code in RAM
+    traj_store_reader_t reader;       // Holds a stored script open
+} seq_vm_program_t;
+
+typedef struct {
+    uint8_t kind;                 // Loop or call
+    uint8_t program;
+    uint16_t pc;                  // Loop body start or return address
+    uint16_t remaining;           // Loop passes left, 0 = forever
+    uint32_t outputs;             // Outputs when the pass started
+} seq_vm_frame_t;
+
+typedef struct {
+    uint32_t tag;                 // program << 16 | line address, UINT32_MAX when empty
+    uint8_t data[SEQ_VM_CACHE_LINE_LEN];
+} seq_vm_cache_line_t;
+
+typedef struct {
+    seq_vm_program_t programs[SEQ_VM_MAX_PROGRAMS];
+    uint8_t num_programs;
+    uint8_t program;              // Running program
+    uint16_t pc;
+    seq_vm_frame_t stack[SEQ_VM_STACK_DEPTH];
+    uint8_t depth;
+    int32_t vars[SEQ_VM_NUM_VARS];
+    traj_config_t config;         // Limits behind SPEED scaling
+    uint8_t speed_pct;
+    float last_q[TRAJ_NUM_JOINTS];
+    uint32_t outputs;             // Points and syncs produced
+    // Point held back so a following DWELL can extend it
+    traj_waypoint_t pending;
+    uint8_t pending_slot;
+    bool has_pending;
+    seq_vm_result_t deferred;     // Returned once the pending point is out
+    bool has_deferred;
+    // WAIT or READ in progress
+    uint8_t sync_op;
+    uint8_t sync_src;
+    uint8_t sync_cmp;
+    int16_t sync_value;
+    uint8_t sync_var;
+    uint16_t sync_timeout_ms;     // 0 = wait forever
+    int64_t sync_deadline_us;     // Set by the first poll
+    seq_vm_cache_line_t cache[SEQ_VM_CACHE_LINES];
+} seq_vm_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t total_us;
+    uint32_t max_us;
+} seq_vm_op_stats_t;
+
+typedef struct {
+    seq_vm_op_stats_t ops[SEQ_OP_COUNT];
+    uint32_t cache_hits;
+    uint32_t cache_misses;
+} seq_vm_stats_t;
+
+// Function prototypes
+esp_err_t seq_vm_verify(const uint8_t *code, uint32_t len);
+size_t seq_vm_compile_slots(uint8_t start_slot, uint8_t end_slot, bool loop, uint8_t *out, size_t out_len);
+esp_err_t seq_vm_start(seq_vm_t *vm, const uint8_t *code, uint32_t len,
+                       const traj_config_t *config, const float start[TRAJ_NUM_JOINTS]);
+esp_err_t seq_vm_start_stored(seq_vm_t *vm, const char *name, const traj_config_t *config,
+                              const float start[TRAJ_NUM_JOINTS]);
+seq_vm_result_t seq_vm_next(seq_vm_t *vm, traj_waypoint_t *wp, uint8_t *slot);
+bool seq_vm_poll(seq_vm_t *vm);
+void seq_vm_close(seq_vm_t *vm);
+void seq_vm_get_stats(seq_vm_stats_t *stats);
+void seq_vm_reset_stats(void);
+
+#endif // SEQ_VM_H
@@ -1,97 +1,517 @@
 #include "sequence_player.h"
+#include "joint_calib.h"
 #include "position_storage.h"
+#include "control_loop.h"
+#include "traj_store.h"
+#include "motion_monitor.h"
+#include "seq_vm.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include <inttypes.h>
+#include <string.h>
 
 static const char *TAG = "SEQ_PLAYER";
 
-// Player state variables
+// Player event bits
+#define PLAYER_EVT_COMMAND  (1 << 0)   // Start, stop, pause or resume
+#define PLAYER_EVT_PLAN     (1 << 1)   // Control loop finished, chained or dropped a plan
+
+// Player state variables, protected by player_mutex
 static player_state_t player_state = PLAYER_IDLE;
+static uint32_t play_generation = 0;    // Bumped by every start, so a restart aborts the old playback
 static TaskHandle_t player_task_handle = NULL;
 static SemaphoreHandle_t player_mutex = NULL;
+static EventGroupHandle_t player_events = NULL;
+
+typedef enum {
+    PLAY_SLOTS,                          // Slot range, compiled to a script
+    PLAY_PROGRAM,                        // Stored path
+    PLAY_SCRIPT,                         // Stored script
+} play_kind_t;
 
+static play_kind_t current_kind = PLAY_SLOTS;
 static uint8_t current_start_slot = 0;
 static uint8_t current_end_slot = 0;
 static bool current_loop = false;
+static char current_name[TRAJ_STORE_NAME_LEN];   // Program or script
+
+// What is being played, snapshotted under the mutex when playback starts
+typedef struct {
+    play_kind_t kind;
+    char name[TRAJ_STORE_NAME_LEN];
+    uint8_t start_slot;
+    uint8_t end_slot;
+    bool loop;
+    traj_config_t config;
+    uint32_t generation;
+    traj_store_reader_t reader;          // PLAY_PROGRAM
+    uint32_t pass_points;                // Waypoints produced by the current pass
+    uint32_t settled_window;             // Last dwell checked for arrival
+    uint8_t settled_segment;
+} play_source_t;
+
+// Slots and scripts run on the script interpreter
+static seq_vm_t vm;
+static uint8_t slot_code[SEQ_VM_HEADER_LEN + 2 * MAX_STORAGE_SLOTS + 5];
+
+static traj_config_t play_config = {
+    .profile = TRAJ_PROFILE_QUINTIC,
+    .vmax = TRAJ_DEFAULT_VMAX,
+    .amax = TRAJ_DEFAULT_AMAX,
+    .blend = 1.0f,
+};
+
+// Playback is streamed by the control loop in planner windows, double-buffered
+// so the control loop can chain into the next window while this one plays.
+// Loop passes are chained the same way, so they share one time base.
+static traj_plan_t plans[2];
+static uint8_t plan_slots[2][TRAJ_MAX_WAYPOINTS];        // Slot behind each waypoint
+static uint32_t plan_windows[2];                         // Window number of each buffer
+static traj_waypoint_t last_waypoint;
+static volatile uint8_t current_slot = SEQUENCE_NO_SLOT;
+
+/**
+ * Block until a player command, a plan change or the timeout
+ *
+ * Holds here while paused. Returns false when playback must end: stopped,
+ * or restarted with new parameters.
+ */
+static bool sequence_player_wait(uint32_t generation, TickType_t timeout) {
+    xEventGroupWaitBits(player_events, PLAYER_EVT_COMMAND | PLAYER_EVT_PLAN, pdTRUE, pdFALSE, timeout);
+
+    bool paused = false;
+    while (true) {
+        player_state_t state = PLAYER_IDLE;
+        uint32_t current_generation = 0;
+        if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
+            state = player_state;
+            current_generation = play_generation;
+            xSemaphoreGive(player_mutex);
+        }
+
+        if (current_generation != generation || state == PLAYER_IDLE) {
+            return false;
+        }
+        if (state == PLAYER_RUNNING) {
+            if (paused) {
+                control_loop_pause_trajectory(false);
+            }
+            return true;
+        }
+        if (!paused) {
+            control_loop_pause_trajectory(true);
+            paused = true;
+        }
+        xEventGroupWaitBits(player_events, PLAYER_EVT_COMMAND, pdTRUE, pdFALSE, portMAX_DELAY);
+    }
+}
+
+/**
+ * Check whether the control loop is still streaming one of our windows
+ */
+static bool sequence_player_streaming(void) {
+    float t;
+    const traj_plan_t *plan = control_loop_trajectory_plan(&t);
+    return plan == &plans[0] || plan == &plans[1];
+}
+
+/**
+ * Update current_slot from the streamed plan
+ *
+ * Returns the ticks until the next segment when that matters: a new slot
+ * to report or a dwell to check arrival for. Otherwise only a plan change
+ * can wake the player, and portMAX_DELAY is returned.
+ */
+static TickType_t sequence_player_track(const traj_plan_t **plan_out, uint8_t *seg_out) {
+    float t;
+    const traj_plan_t *plan = control_loop_trajectory_plan(&t);
+    if (plan != &plans[0] && plan != &plans[1]) {
+        // Nothing streaming, or another module's plan took over
+        *plan_out = NULL;
+        return portMAX_DELAY;
+    }
+    *plan_out = plan;
+
+    uint8_t seg = 0;
+    while (seg + 1 < plan->num_segments && t >= plan->segments[seg + 1].t_start) {
+        seg++;
+    }
+    *seg_out = seg;
+
+    uint8_t slot = plan_slots[plan == &plans[1]][plan->segments[seg].waypoint];
+    current_slot = slot;
+
+    if (seg + 1 < plan->num_segments) {
+        const traj_segment_t *next = &plan->segments[seg + 1];
+        if (slot != SEQUENCE_NO_SLOT || next->waypoint == plan->segments[seg].waypoint) {
+            // Trajectory time runs at the feed override; a feed change wakes us to recompute
+            float rate = control_loop_feed_rate();
+            if (rate <= 0.0f) {
+                return portMAX_DELAY;
+            }
+            return pdMS_TO_TICKS((uint32_t)((next->t_start - t) * 1000.0f / rate)) + 1;
+        }
+    }
+    return portMAX_DELAY;
+}
+
+/**
+ * Hold trajectory time until the servos report arrival at q
+ *
+ * Gives up after the configured arrival timeout, or when a direct command
+ * moves the setpoint. Returns false when playback must end.
+ */
+static bool sequence_player_settle(play_source_t *src, const float q[TRAJ_NUM_JOINTS]) {
+    motion_config_t arrival;
+    motion_monitor_get_config(&arrival);
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)arrival.timeout_ms * 1000;
+
+    uint16_t target[ARM_NUM_JOINTS];
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        target[i] = (uint16_t)(q[i] + 0.5f);
+    }
+
+    control_loop_pause_trajectory(true);
+    while (true) {
+        arm_position_t setpoint;
+        control_loop_get_target(&setpoint);
+        bool moved = false;
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            moved |= setpoint.joints[i].position != target[i];
+        }
+        if (moved) {
+            break;
+        }
+
+        uint8_t arrived = 0;
+        motion_check_arrival(target, ARM_ALL_JOINTS_MASK, arrival.tolerance, &arrived, NULL);
+        if (arrived == ARM_ALL_JOINTS_MASK) {
+            break;
+        }
+        if (esp_timer_get_time() >= deadline_us) {
+            ESP_LOGW(TAG, "Joints 0x%02X did not arrive in time, carrying on",
+                     ~arrived & ARM_ALL_JOINTS_MASK);
+            break;
+        }
+
+        if (!sequence_player_wait(src->generation, pdMS_TO_TICKS(MOTION_POLL_MS))) {
+            return false;
+        }
+        // Resuming from a user pause restarts trajectory time; keep holding
+        control_loop_pause_trajectory(true);
+    }
+    control_loop_pause_trajectory(false);
+    return true;
+}
+
+/**
+ * Follow the streamed plan until something changes; false when playback must end
+ *
+ * Dwells start from the arm's actual arrival, not the planned one.
+ */
+static bool sequence_player_step(play_source_t *src) {
+    const traj_plan_t *plan;
+    uint8_t seg = 0;
+    TickType_t timeout = sequence_player_track(&plan, &seg);
+
+    if (plan != NULL && seg > 0 && plan->segments[seg - 1].waypoint == plan->segments[seg].waypoint) {
+        uint32_t window = plan_windows[plan == &plans[1]];
+        if (src->settled_window != window || src->settled_segment != seg) {
+            src->settled_window = window;
+            src->settled_segment = seg;
+
+            float q[TRAJ_NUM_JOINTS];
+            for (int i = 0; i < TRAJ_NUM_JOINTS; i++) {
+                q[i] = plan->segments[seg].c[i][0];
+            }
+            return sequence_player_settle(src, q);
+        }
+    }
+    return sequence_player_wait(src->generation, timeout);
+}
+
+/**
+ * Check whether a direct command moved the setpoint away from the last waypoint
+ */
+static bool sequence_player_preempted(void) {
+    arm_position_t reached;
+    control_loop_get_target(&reached);
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (reached.joints[i].position != (uint16_t)(last_waypoint.q[i] + 0.5f)) {
+            ESP_LOGI(TAG, "Playback preempted by a direct command");
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Convert a stored program point to a planner waypoint
+ */
+static void program_waypoint(const traj_store_point_t *point, traj_waypoint_t *wp) {
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        wp->q[i] = point->position[i];
+    }
+    wp->duration_s = point->duration_ms / 1000.0f;
+    wp->dwell_s = point->dwell_ms / 1000.0f;
+}
+
+/**
+ * Produce the next waypoint to play, or tell the streamer to sync or stop
+ *
+ * Paths are decoded straight from flash, wrapping around when looping. A
+ * pass that yields nothing ends playback, so a loop over a program that
+ * disappeared cannot spin. Slots and scripts come from the interpreter.
+ */
+static seq_vm_result_t play_source_next(play_source_t *src, traj_waypoint_t *wp, uint8_t *slot) {
+    if (src->kind != PLAY_PROGRAM) {
+        seq_vm_result_t result = seq_vm_next(&vm, wp, slot);
+        if (result == SEQ_VM_POINT) {
+            src->pass_points++;
+        }
+        return result;
+    }
+
+    traj_store_point_t point;
+    while (!traj_store_read(&src->reader, &point)) {
+        if (!src->loop || src->pass_points == 0) {
+            return SEQ_VM_END;
+        }
+        traj_store_close(&src->reader);
+        if (traj_store_open(src->name, &src->reader) != ESP_OK) {
+            ESP_LOGW(TAG, "Program '%s' disappeared", src->name);
+            src->pass_points = 0;
+            return SEQ_VM_END;
+        }
+        src->pass_points = 0;
+    }
+    program_waypoint(&point, wp);
+    *slot = SEQUENCE_NO_SLOT;
+    src->pass_points++;
+    return SEQ_VM_POINT;
+}
+
+/**
+ * Play out what has been streamed, let the arm settle, then poll the script's WAIT or READ
+ *
+ * Returns false when playback must end; *preempted tells a direct command
+ * apart from a stop.
+ */
+static bool sequence_player_sync(play_source_t *src, bool *preempted) {
+    while (sequence_player_streaming()) {
+        if (!sequence_player_step(src)) {
+            return false;
+        }
+    }
+    if (sequence_player_preempted()) {
+        *preempted = true;
+        return false;
+    }
+    if (!sequence_player_settle(src, last_waypoint.q)) {
+        return false;
+    }
+
+    while (!seq_vm_poll(&vm)) {
+        if (!sequence_player_wait(src->generation, pdMS_TO_TICKS(MOTION_POLL_MS))) {
+            return false;
+        }
+        if (sequence_player_preempted()) {
+            *preempted = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Stream the source through the control loop window by window
+ *
+ * Returns true when everything was played; false if playback was stopped,
+ * restarted, preempted or had nothing to play.
+ */
+static bool sequence_player_stream(play_source_t *src, const float start_q[TRAJ_NUM_JOINTS]) {
+    float start[TRAJ_NUM_JOINTS];
+    float start_vel[TRAJ_NUM_JOINTS] = {0};
+    memcpy(start, start_q, sizeof(start));
+    memcpy(last_waypoint.q, start_q, sizeof(last_waypoint.q));
+
+    traj_waypoint_t next;
+    uint8_t next_slot = SEQUENCE_NO_SLOT;
+    seq_vm_result_t result = play_source_next(src, &next, &next_slot);
+    if (result != SEQ_VM_POINT && result != SEQ_VM_SYNC) {
+        return false;
+    }
+
+    bool played = true;
+    bool preempted = false;
+    bool streaming = false;
+    int buffer = 0;
+    uint32_t windows = 0;
+    while (result == SEQ_VM_POINT || result == SEQ_VM_SYNC) {
+        if (result == SEQ_VM_SYNC) {
+            // The next move starts from rest once the condition is met
+            if (!sequence_player_sync(src, &preempted)) {
+                played = false;
+                break;
+            }
+            streaming = false;
+            memset(start_vel, 0, sizeof(start_vel));
+            result = play_source_next(src, &next, &next_slot);
+            continue;
+        }
+
+        traj_waypoint_t window[TRAJ_MAX_WAYPOINTS];
+        uint8_t *slots = plan_slots[buffer];
+        uint8_t count = 0;
+        while (result == SEQ_VM_POINT && count < TRAJ_MAX_WAYPOINTS) {
+            slots[count] = next_slot;
+            window[count++] = next;
+            result = play_source_next(src, &next, &next_slot);
+        }
+
+        // The buffer is free once the window queued behind it has taken over
+        while (streaming && control_loop_trajectory_pending() && sequence_player_streaming()) {
+            if (!sequence_player_step(src)) {
+                played = false;
+                break;
+            }
+        }
+        if (!played) {
+            break;
+        }
+
+        bool chained = streaming && sequence_player_streaming();
+        if (streaming && !chained) {
+            if (sequence_player_preempted()) {
+                preempted = true;
+                break;
+            }
+            memset(start_vel, 0, sizeof(start_vel));  // Fell behind; restart from rest
+        }
+
+        traj_plan_t *plan = &plans[buffer];
+        plan_windows[buffer] = ++windows;
+        if (!traj_plan_window(plan, &src->config, start, start_vel, window, count,
+                              result == SEQ_VM_POINT ? &next : NULL)) {
+            ESP_LOGE(TAG, "Trajectory planning failed");
+            played = false;
+            break;
+        }
+        if (chained) {
+            control_loop_follow_next(plan);
+        } else {
+            control_loop_follow(plan);
+        }
+
+        ESP_LOGD(TAG, "Window of %d points, %.2f s (%s)", count, plan->total_s, chained ? "chained" : "from rest");
+        streaming = true;
+        buffer ^= 1;
+        last_waypoint = window[count - 1];
+        memcpy(start, last_waypoint.q, sizeof(start));
+        memcpy(start_vel, plan->end_vel, sizeof(start_vel));
+    }
+
+    // A script error still lets what was streamed play out
+    bool failed = result == SEQ_VM_ERROR;
+
+    // Let the last window play out
+    while (played && !preempted && sequence_player_streaming()) {
+        if (!sequence_player_step(src)) {
+            played = false;
+        }
+    }
+
+    // Playback is complete once the arm is actually there
+    if (played && !preempted && !sequence_player_preempted()) {
+        return sequence_player_settle(src, last_waypoint.q) && !failed;
+    }
+    if (!played && !preempted) {
+        // Hold wherever the arm is right now
+        control_loop_stop_trajectory();
+    }
+    return false;
+}
 
 /**
  * Sequence player task
  */
 static void sequence_player_task(void *pvParameters) {
+    (void)pvParameters;
     ESP_LOGI(TAG, "Sequence player task started");
-    
+
     while (true) {
+        play_source_t source = {0};
+        bool idle = true;
         if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
-            if (player_state != PLAYER_RUNNING) {
-                xSemaphoreGive(player_mutex);
-                vTaskDelay(pdMS_TO_TICKS(100));
-                continue;
-            }
+            idle = player_state == PLAYER_IDLE;
+            source.kind = current_kind;
+            memcpy(source.name, current_name, sizeof(source.name));
+            source.start_slot = current_start_slot;
+            source.end_slot = current_end_slot;
+            source.loop = current_loop;
+            source.config = play_config;
+            joint_calib_limit_config(&source.config);
+            source.generation = play_generation;
             xSemaphoreGive(player_mutex);
         }
-        
-        // Play sequence
-        do {
-            for (uint8_t slot = current_start_slot; slot <= current_end_slot; slot++) {
-                // Check if stopped
-                if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
-                    if (player_state != PLAYER_RUNNING) {
-                        xSemaphoreGive(player_mutex);
-                        goto sequence_end;
-                    }
-                    xSemaphoreGive(player_mutex);
-                }
-                
-                // Check if slot exists
-                if (!position_storage_slot_exists(slot)) {
-                    ESP_LOGW(TAG, "Slot %d doesn't exist, skipping", slot);
-                    continue;
-                }
-                
-                // Load and execute position
-                arm_position_t position;
-                if (position_storage_load(slot, &position) == ESP_OK) {
-                    ESP_LOGI(TAG, "Playing slot %d", slot);
-                    
-                    // Send position to servos
-                    sts_servo_set_arm_position(&position);
-                    
-                    // Calculate total movement time
-                    uint16_t max_time = 0;
-                    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-                        if (position.joints[i].time_ms > max_time) {
-                            max_time = position.joints[i].time_ms;
-                        }
-                    }
-                    
-                    // Wait for movement to complete
-                    vTaskDelay(pdMS_TO_TICKS(max_time));
-                    
-                    // Wait for additional delay if specified
-                    if (position.delay_after_ms > 0) {
-                        ESP_LOGD(TAG, "Delay %" PRIu32 " ms", position.delay_after_ms);
-                        vTaskDelay(pdMS_TO_TICKS(position.delay_after_ms));
-                    }
-                } else {
-                    ESP_LOGE(TAG, "Failed to load slot %d", slot);
-                }
+
+        if (idle) {
+            xEventGroupWaitBits(player_events, PLAYER_EVT_COMMAND, pdTRUE, pdFALSE, portMAX_DELAY);
+            continue;
+        }
+
+        arm_position_t current;
+        float start[TRAJ_NUM_JOINTS];
+        control_loop_get_target(&current);
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            start[i] = current.joints[i].position;
+        }
+
+        bool complete = false;
+        if (source.kind == PLAY_PROGRAM) {
+            if (traj_store_open(source.name, &source.reader) == ESP_OK) {
+                ESP_LOGI(TAG, "Playing program '%s': %" PRIu32 " points", source.name, source.reader.num_points);
+                complete = sequence_player_stream(&source, start);
+                traj_store_close(&source.reader);
+            } else {
+                ESP_LOGW(TAG, "Program '%s' not found", source.name);
             }
-        } while (current_loop && player_state == PLAYER_RUNNING);
-        
-sequence_end:
-        // Sequence finished
+        } else if (source.kind == PLAY_SCRIPT) {
+            if (seq_vm_start_stored(&vm, source.name, &source.config, start) == ESP_OK) {
+                ESP_LOGI(TAG, "Running script '%s': %" PRIu32 " bytes", source.name, vm.programs[0].len);
+                complete = sequence_player_stream(&source, start);
+                seq_vm_close(&vm);
+            } else {
+                ESP_LOGW(TAG, "Script '%s' cannot be run", source.name);
+            }
+        } else {
+            ESP_LOGI(TAG, "Playing slots %d-%d", source.start_slot, source.end_slot);
+            size_t len = seq_vm_compile_slots(source.start_slot, source.end_slot, source.loop,
+                                              slot_code, sizeof(slot_code));
+            if (seq_vm_start(&vm, slot_code, len, &source.config, start) == ESP_OK) {
+                complete = sequence_player_stream(&source, start);
+                seq_vm_close(&vm);
+            }
+            if (source.pass_points == 0 && !complete) {
+                ESP_LOGW(TAG, "No playable slots in %d-%d", source.start_slot, source.end_slot);
+            }
+        }
+        current_slot = SEQUENCE_NO_SLOT;
+
+        // Unless a new start took over, this playback is over
         if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
-            if (player_state == PLAYER_RUNNING && !current_loop) {
+            if (play_generation == source.generation) {
+                if (complete) {
+                    ESP_LOGI(TAG, "Sequence playback complete");
+                }
                 player_state = PLAYER_IDLE;
-                ESP_LOGI(TAG, "Sequence playback complete");
             }
             xSemaphoreGive(player_mutex);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
 
@@ -104,7 +524,14 @@ esp_err_t sequence_player_init(void) {
         ESP_LOGE(TAG, "Failed to create mutex");
         return ESP_FAIL;
     }
-    
+
+    player_events = xEventGroupCreate();
+    if (player_events == NULL) {
+        ESP_LOGE(TAG, "Failed to create event group");
+        return ESP_FAIL;
+    }
+    control_loop_add_plan_event(player_events, PLAYER_EVT_PLAN);
+
     // Create player task
     BaseType_t ret = xTaskCreate(sequence_player_task, "seq_player", 4096, 
                                  NULL, 5, &player_task_handle);
@@ -127,18 +554,75 @@ esp_err_t sequence_player_start(uint8_t start_slot, uint8_t end_slot, bool loop)
     }
     
     if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
+        current_kind = PLAY_SLOTS;
         current_start_slot = start_slot;
         current_end_slot = end_slot;
         current_loop = loop;
         player_state = PLAYER_RUNNING;
+        play_generation++;
         xSemaphoreGive(player_mutex);
     }
+    xEventGroupSetBits(player_events, PLAYER_EVT_COMMAND);
     
     ESP_LOGI(TAG, "Started sequence playback: slots %d-%d, loop=%d", 
              start_slot, end_slot, loop);
     return ESP_OK;
 }
 
+/**
+ * Start playback of a stored program from the trajectory store
+ */
+esp_err_t sequence_player_start_program(const char *name, bool loop) {
+    traj_store_reader_t reader;
+    esp_err_t ret = traj_store_open(name, &reader);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Program '%s' not found", name);
+        return ret;
+    }
+    traj_store_close(&reader);
+
+    if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
+        current_kind = PLAY_PROGRAM;
+        strncpy(current_name, name, sizeof(current_name) - 1);
+        current_name[sizeof(current_name) - 1] = '\0';
+        current_loop = loop;
+        player_state = PLAYER_RUNNING;
+        play_generation++;
+        xSemaphoreGive(player_mutex);
+    }
+    xEventGroupSetBits(player_events, PLAYER_EVT_COMMAND);
+
+    ESP_LOGI(TAG, "Started program playback: '%s', loop=%d", name, loop);
+    return ESP_OK;
+}
+
+/**
+ * Run a stored sequence script
+ */
+esp_err_t sequence_player_start_script(const char *name) {
+    traj_store_reader_t reader;
+    esp_err_t ret = traj_store_open_script(name, &reader);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Script '%s' not found", name);
+        return ret;
+    }
+    traj_store_close(&reader);
+
+    if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
+        current_kind = PLAY_SCRIPT;
+        strncpy(current_name, name, sizeof(current_name) - 1);
+        current_name[sizeof(current_name) - 1] = '\0';
+        current_loop = false;
+        player_state = PLAYER_RUNNING;
+        play_generation++;
+        xSemaphoreGive(player_mutex);
+    }
+    xEventGroupSetBits(player_events, PLAYER_EVT_COMMAND);
+
+    ESP_LOGI(TAG, "Started script '%s'", name);
+    return ESP_OK;
+}
+
 /**
  * Stop sequence playback
  */
@@ -147,6 +631,7 @@ void sequence_player_stop(void) {
         player_state = PLAYER_IDLE;
         xSemaphoreGive(player_mutex);
     }
+    xEventGroupSetBits(player_events, PLAYER_EVT_COMMAND);
     ESP_LOGI(TAG, "Sequence playback stopped");
 }
 
@@ -160,6 +645,7 @@ void sequence_player_pause(void) {
         }
         xSemaphoreGive(player_mutex);
     }
+    xEventGroupSetBits(player_events, PLAYER_EVT_COMMAND);
     ESP_LOGI(TAG, "Sequence playback paused");
 }
 
@@ -173,6 +659,7 @@ void sequence_player_resume(void) {
         }
         xSemaphoreGive(player_mutex);
     }
+    xEventGroupSetBits(player_events, PLAYER_EVT_COMMAND);
     ESP_LOGI(TAG, "Sequence playback resumed");
 }
 
@@ -199,3 +686,28 @@ player_state_t sequence_player_get_state(void) {
     }
     return state;
 }
+
+/**
+ * Select the interpolation profile and blending used for the next playback
+ */
+esp_err_t sequence_player_set_profile(traj_profile_t profile, float blend) {
+    if (profile >= TRAJ_PROFILE_COUNT || blend < 0.0f || blend > 1.0f) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (xSemaphoreTake(player_mutex, portMAX_DELAY)) {
+        play_config.profile = profile;
+        play_config.blend = blend;
+        xSemaphoreGive(player_mutex);
+    }
+
+    ESP_LOGI(TAG, "Profile %d, blend %.2f", profile, blend);
+    return ESP_OK;
+}
+
+/**
+ * Slot the playing trajectory is heading for, SEQUENCE_NO_SLOT when idle
+ */
+uint8_t sequence_player_get_current_slot(void) {
+    return current_slot;
+}
@@ -2,8 +2,11 @@
 #define SEQUENCE_PLAYER_H
 
 #include "sts_servo.h"
+#include "trajectory.h"
 #include <stdbool.h>
 
+#define SEQUENCE_NO_SLOT          0xFF   // Reported when nothing is playing
+
 // Sequence player state
 typedef enum {
     PLAYER_IDLE,
@@ -14,10 +17,14 @@ typedef enum {
 // Function prototypes
 esp_err_t sequence_player_init(void);
 esp_err_t sequence_player_start(uint8_t start_slot, uint8_t end_slot, bool loop);
+esp_err_t sequence_player_start_program(const char *name, bool loop);
+esp_err_t sequence_player_start_script(const char *name);
 void sequence_player_stop(void);
 void sequence_player_pause(void);
 void sequence_player_resume(void);
 bool sequence_player_is_running(void);
 player_state_t sequence_player_get_state(void);
+esp_err_t sequence_player_set_profile(traj_profile_t profile, float blend);
+uint8_t sequence_player_get_current_slot(void);
 
 #endif // SEQUENCE_PLAYER_H
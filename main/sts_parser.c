@@ -0,0 +1,200 @@
+#include "sts_parser.h"
+#include <string.h>
+
+static void parser_step(sts_parser_t *parser, uint8_t byte,
+                        sts_packet_cb_t on_packet, void *ctx);
+
+/**
+ * Checksum over ID..last param, as defined by the STS protocol
+ */
+static uint8_t parser_checksum(const uint8_t *raw, uint8_t len) {
+    uint8_t sum = 0;
+    for (uint8_t i = 2; i < len; i++) {
+        sum += raw[i];
+    }
+    return ~sum;
+}
+
+/**
+ * Reject the current candidate and rescan its bytes after the first header byte
+ */
+static void parser_resync(sts_parser_t *parser, sts_packet_cb_t on_packet, void *ctx) {
+    uint8_t replay[STS_PARSER_MAX_RAW];
+    uint8_t replay_len = parser->raw_len > 0 ? parser->raw_len - 1 : 0;
+
+    memcpy(replay, &parser->raw[1], replay_len);
+    parser->stats.discarded_bytes++;
+    sts_parser_reset(parser);
+
+    for (uint8_t i = 0; i < replay_len; i++) {
+        parser_step(parser, replay[i], on_packet, ctx);
+    }
+}
+
+/**
+ * Advance the state machine by one byte
+ */
+static void parser_step(sts_parser_t *parser, uint8_t byte,
+                        sts_packet_cb_t on_packet, void *ctx) {
+    if (parser->state != STS_PARSE_HEADER1) {
+        parser->raw[parser->raw_len++] = byte;
+    }
+
+    switch (parser->state) {
+        case STS_PARSE_HEADER1:
+            if (byte == 0xFF) {
+                parser->raw[0] = byte;
+                parser->raw_len = 1;
+                parser->state = STS_PARSE_HEADER2;
+            } else {
+                parser->stats.discarded_bytes++;
+            }
+            break;
+
+        case STS_PARSE_HEADER2:
+            if (byte == 0xFF) {
+                parser->state = STS_PARSE_ID;
+            } else {
+                parser_resync(parser, on_packet, ctx);
+            }
+            break;
+
+        case STS_PARSE_ID:
+            if (byte == 0xFF) {
+                // Extra header byte: slide the window by one
+                parser->raw_len--;
+                parser->stats.discarded_bytes++;
+            } else if (byte == 0xFE) {
+                // Broadcast ID never appears in a status packet
+                parser->stats.framing_errors++;
+                parser_resync(parser, on_packet, ctx);
+            } else {
+                parser->packet.id = byte;
+                parser->state = STS_PARSE_LENGTH;
+            }
+            break;
+
+        case STS_PARSE_LENGTH:
+            if (byte < 2 || byte - 2 > STS_MAX_REPLY_PARAMS) {
+                parser->stats.framing_errors++;
+                parser_resync(parser, on_packet, ctx);
+            } else {
+                parser->packet.length = byte - 2;
+                parser->state = STS_PARSE_ERROR;
+            }
+            break;
+
+        case STS_PARSE_ERROR:
+            parser->packet.error = byte;
+            parser->param_len = 0;
+            parser->state = parser->packet.length > 0 ? STS_PARSE_PARAMS : STS_PARSE_CHECKSUM;
+            break;
+
+        case STS_PARSE_PARAMS:
+            parser->packet.params[parser->param_len++] = byte;
+            if (parser->param_len == parser->packet.length) {
+                parser->state = STS_PARSE_CHECKSUM;
+            }
+            break;
+
+        case STS_PARSE_CHECKSUM:
+            if (byte != parser_checksum(parser->raw, parser->raw_len - 1)) {
+                parser->stats.checksum_errors++;
+                parser_resync(parser, on_packet, ctx);
+                break;
+            }
+            parser->stats.packets++;
+            if (parser->packet.error) {
+                parser->stats.servo_errors++;
+            }
+            if (on_packet) {
+                on_packet(&parser->packet, ctx);
+            }
+            sts_parser_reset(parser);
+            break;
+    }
+}
+
+/**
+ * Initialize parser state and counters
+ */
+void sts_parser_init(sts_parser_t *parser) {
+    memset(parser, 0, sizeof(*parser));
+    parser->state = STS_PARSE_HEADER1;
+}
+
+/**
+ * Drop any partially received packet, keeping counters
+ */
+void sts_parser_reset(sts_parser_t *parser) {
+    parser->state = STS_PARSE_HEADER1;
+    parser->raw_len = 0;
+    parser->param_len = 0;
+}
+
+/**
+ * Match one byte against the expected echo; true when it was consumed as echo
+ */
+static bool parser_echo_step(sts_parser_t *parser, uint8_t byte,
+                             sts_packet_cb_t on_packet, void *ctx) {
+    if (parser->echo_len == 0) {
+        return false;
+    }
+    if (byte == parser->echo[parser->echo_pos]) {
+        if (++parser->echo_pos == parser->echo_len) {
+            parser->stats.echo_frames++;
+            parser->stats.echo_bytes += parser->echo_len;
+            parser->echo_len = 0;
+            parser->echo_pos = 0;
+        }
+        return true;
+    }
+    if (parser->echo_pos == 2 && byte == 0xFF) {
+        // Extra header byte ahead of our frame: slide the match by one
+        parser->stats.discarded_bytes++;
+        return true;
+    }
+    if (parser->echo_pos > 0) {
+        // Not our frame after all: the bytes held back are a packet's start
+        uint8_t held = parser->echo_pos;
+        parser->echo_len = 0;
+        parser->echo_pos = 0;
+        for (uint8_t i = 0; i < held; i++) {
+            parser_step(parser, parser->echo[i], on_packet, ctx);
+        }
+    }
+    // A mismatch before the echo started is line noise; keep waiting for it
+    return false;
+}
+
+/**
+ * Consume a chunk of received bytes, calling on_packet for every valid packet
+ */
+void sts_parser_feed(sts_parser_t *parser, const uint8_t *data, size_t len,
+                     sts_packet_cb_t on_packet, void *ctx) {
+    for (size_t i = 0; i < len; i++) {
+        if (!parser_echo_step(parser, data[i], on_packet, ctx)) {
+            parser_step(parser, data[i], on_packet, ctx);
+        }
+    }
+}
+
+/**
+ * Expect `frame` back once as echo of our own transmission; NULL clears it
+ */
+void sts_parser_expect_echo(sts_parser_t *parser, const uint8_t *frame, size_t len) {
+    parser->echo_pos = 0;
+    if (frame == NULL || len == 0 || len > STS_PARSER_MAX_ECHO) {
+        parser->echo_len = 0;
+        return;
+    }
+    memcpy(parser->echo, frame, len);
+    parser->echo_len = len;
+}
+
+/**
+ * True when no packet is partially assembled
+ */
+bool sts_parser_idle(const sts_parser_t *parser) {
+    return parser->state == STS_PARSE_HEADER1;
+}
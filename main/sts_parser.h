@@ -0,0 +1,81 @@
+#ifndef STS_PARSER_H
+#define STS_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Incremental parser for STS status packets:
+//   0xFF 0xFF ID LEN ERROR PARAM... CHECKSUM
+// Bytes can arrive in any split. Garbage, bad lengths and checksum failures
+// are skipped by rescanning from the byte after the rejected header, so a
+// valid packet hiding inside noise is still found.
+//
+// On a half-duplex line every instruction we send is read back first. Given
+// the frame with sts_parser_expect_echo, the parser consumes the first exact
+// copy as echo before packet parsing, so broadcast and sync frames (ID 0xFE,
+// long lengths) are not counted as framing errors. Only the first copy is
+// echo: a PING reply with error 0x01 is byte-for-byte the PING itself.
+
+#define STS_MAX_REPLY_PARAMS      16
+#define STS_PARSER_MAX_RAW        (STS_MAX_REPLY_PARAMS + 6)
+#define STS_PARSER_MAX_ECHO       64        // Longest frame recognised as our own echo
+
+// Servo status (error) byte flags
+#define STS_ERR_VOLTAGE           (1 << 0)
+#define STS_ERR_SENSOR            (1 << 1)
+#define STS_ERR_OVERHEAT          (1 << 2)
+#define STS_ERR_OVERCURRENT       (1 << 3)
+#define STS_ERR_ANGLE             (1 << 4)
+#define STS_ERR_OVERLOAD          (1 << 5)
+
+// Status packet returned by a servo
+typedef struct {
+    uint8_t id;
+    uint8_t error;                          // Servo status/error byte (STS_ERR_*)
+    uint8_t length;                         // Number of valid bytes in params
+    uint8_t params[STS_MAX_REPLY_PARAMS];
+} sts_reply_t;
+
+typedef enum {
+    STS_PARSE_HEADER1,
+    STS_PARSE_HEADER2,
+    STS_PARSE_ID,
+    STS_PARSE_LENGTH,
+    STS_PARSE_ERROR,
+    STS_PARSE_PARAMS,
+    STS_PARSE_CHECKSUM
+} sts_parse_state_t;
+
+typedef struct {
+    uint32_t packets;                       // Validated packets emitted
+    uint32_t checksum_errors;
+    uint32_t framing_errors;                // Impossible ID or length
+    uint32_t discarded_bytes;               // Bytes skipped while hunting for a header
+    uint32_t servo_errors;                  // Valid packets with a non-zero error byte
+    uint32_t echo_frames;                   // Our own frames read back on a half-duplex line
+    uint32_t echo_bytes;
+} sts_parser_stats_t;
+
+typedef void (*sts_packet_cb_t)(const sts_reply_t *packet, void *ctx);
+
+typedef struct {
+    sts_parse_state_t state;
+    sts_reply_t packet;                     // Packet being assembled
+    uint8_t raw[STS_PARSER_MAX_RAW];        // Its raw bytes, replayed on resync
+    uint8_t raw_len;
+    uint8_t param_len;
+    uint8_t echo[STS_PARSER_MAX_ECHO];      // Frame expected back, matched before parsing
+    uint8_t echo_len;                       // 0 when no echo is expected
+    uint8_t echo_pos;                       // Bytes of it matched so far
+    sts_parser_stats_t stats;
+} sts_parser_t;
+
+void sts_parser_init(sts_parser_t *parser);
+void sts_parser_reset(sts_parser_t *parser);
+void sts_parser_feed(sts_parser_t *parser, const uint8_t *data, size_t len,
+                     sts_packet_cb_t on_packet, void *ctx);
+bool sts_parser_idle(const sts_parser_t *parser);
+void sts_parser_expect_echo(sts_parser_t *parser, const uint8_t *frame, size_t len);
+
+#endif // STS_PARSER_H
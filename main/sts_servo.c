@@ -1,11 +1,25 @@
 #include "sts_servo.h"
+#include "joint_calib.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include <string.h>
 
 static const char *TAG = "STS_SERVO";
 
+// Bus owner state
+static QueueHandle_t uart_event_queue = NULL;
+static QueueHandle_t bus_queue = NULL;
+static TaskHandle_t bus_task_handle = NULL;
+static sts_bus_stats_t bus_stats = {0};
+static portMUX_TYPE bus_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile sts_bus_tx_hook_t tx_hook = NULL;
+
+// Reply parser, only touched by the bus task
+static sts_parser_t rx_parser;
+
 /**
  * Calculate checksum for STS servo protocol
  */
@@ -17,6 +31,195 @@ uint8_t sts_calculate_checksum(uint8_t *data, uint8_t length) {
     return ~checksum;
 }
 
+/**
+ * Build an instruction frame, returns its total length
+ */
+uint8_t sts_build_frame(uint8_t *frame, uint8_t servo_id, uint8_t instruction,
+                        const uint8_t *params, uint8_t param_len) {
+    frame[0] = STS_FRAME_HEADER;
+    frame[1] = STS_FRAME_HEADER;
+    frame[2] = servo_id;
+    frame[3] = param_len + 2;  // Length covers instruction + params + checksum
+    frame[4] = instruction;
+    if (param_len > 0) {
+        memcpy(&frame[5], params, param_len);
+    }
+    frame[5 + param_len] = sts_calculate_checksum(frame, 5 + param_len);
+    return 6 + param_len;
+}
+
+/**
+ * True when `servo_id` still owes this transaction a reply
+ */
+static bool bus_expects_reply_from(const sts_transaction_t *txn, uint8_t servo_id) {
+    bool addressed = false;
+    if (txn->frame[4] == STS_CMD_SYNC_READ) {
+        for (int i = 7; i < txn->frame_len - 1; i++) {
+            if (txn->frame[i] == servo_id) {
+                addressed = true;
+                break;
+            }
+        }
+    } else {
+        addressed = (txn->frame[2] == servo_id);
+    }
+    if (!addressed) {
+        return false;
+    }
+    for (int i = 0; i < txn->reply_count; i++) {
+        if (txn->replies[i].id == servo_id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parser callback: file a validated packet against the current transaction
+ */
+static void bus_on_packet(const sts_reply_t *packet, void *ctx) {
+    sts_transaction_t *txn = ctx;
+
+    if (txn == NULL || txn->reply_count >= txn->expected_replies ||
+        !bus_expects_reply_from(txn, packet->id)) {
+        ESP_LOGD(TAG, "Ignoring unexpected packet from servo %d", packet->id);
+        portENTER_CRITICAL(&bus_stats_lock);
+        bus_stats.unexpected_packets++;
+        portEXIT_CRITICAL(&bus_stats_lock);
+        return;
+    }
+
+    if (packet->error) {
+        ESP_LOGW(TAG, "Servo %d reports error flags 0x%02X", packet->id, packet->error);
+    }
+    txn->replies[txn->reply_count++] = *packet;
+}
+
+/**
+ * Feed whatever the UART driver has buffered into the reply parser
+ */
+static void bus_drain_uart(sts_transaction_t *txn) {
+    uint8_t chunk[128];
+    size_t available = 0;
+    uart_get_buffered_data_len(UART_PORT, &available);
+
+    while (available > 0) {
+        size_t want = available < sizeof(chunk) ? available : sizeof(chunk);
+        int len = uart_read_bytes(UART_PORT, chunk, want, 0);
+        if (len <= 0) {
+            break;
+        }
+        portENTER_CRITICAL(&bus_stats_lock);
+        bus_stats.rx_bytes += len;
+        portEXIT_CRITICAL(&bus_stats_lock);
+
+        sts_parser_feed(&rx_parser, chunk, len, bus_on_packet, txn);
+        available -= len;
+    }
+}
+
+/**
+ * Send one frame and collect its replies from UART events
+ */
+static void bus_execute(sts_transaction_t *txn) {
+    txn->reply_count = 0;
+
+    // Late replies from an earlier exchange are parsed and discarded, never
+    // flushed blindly, so a packet already in flight keeps its framing
+    uart_event_t event;
+    while (xQueueReceive(uart_event_queue, &event, 0) == pdTRUE) {
+    }
+    bus_drain_uart(NULL);
+
+    // On a half-duplex line the frame comes back first; the parser drops it
+    sts_parser_expect_echo(&rx_parser, txn->frame, txn->frame_len);
+    int written = uart_write_bytes(UART_PORT, (const char *)txn->frame, txn->frame_len);
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&bus_stats_lock);
+    bus_stats.transactions++;
+    bus_stats.tx_frames++;
+    bus_stats.tx_bytes += txn->frame_len;
+    bus_stats.last_tx_us = now;
+    portEXIT_CRITICAL(&bus_stats_lock);
+
+    sts_bus_tx_hook_t hook = tx_hook;
+    if (hook != NULL) {
+        hook(txn->frame, txn->frame_len, now);
+    }
+
+    if (written != txn->frame_len) {
+        txn->result = ESP_FAIL;
+        return;
+    }
+    if (txn->expected_replies == 0) {
+        txn->result = ESP_OK;
+        return;
+    }
+
+    uint32_t timeout_us = txn->timeout_us ? txn->timeout_us
+                                          : STS_REPLY_TIMEOUT_US * txn->expected_replies;
+    int64_t deadline = now + timeout_us;
+
+    while (txn->reply_count < txn->expected_replies) {
+        int64_t remaining_us = deadline - esp_timer_get_time();
+        if (remaining_us <= 0) {
+            break;
+        }
+        TickType_t ticks = pdMS_TO_TICKS((remaining_us + 999) / 1000);
+        if (ticks == 0) {
+            ticks = 1;
+        }
+        if (xQueueReceive(uart_event_queue, &event, ticks) != pdTRUE) {
+            continue;
+        }
+        if (event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL) {
+            // Bytes were lost; the driver requires a flush to recover
+            ESP_LOGW(TAG, "UART RX overflow, resetting input");
+            uart_flush_input(UART_PORT);
+            xQueueReset(uart_event_queue);
+            sts_parser_reset(&rx_parser);
+            continue;
+        }
+        if (event.type == UART_DATA) {
+            bus_drain_uart(txn);
+        }
+    }
+
+    if (txn->reply_count < txn->expected_replies) {
+        portENTER_CRITICAL(&bus_stats_lock);
+        bus_stats.timeouts++;
+        portEXIT_CRITICAL(&bus_stats_lock);
+        txn->result = ESP_ERR_TIMEOUT;
+    } else {
+        txn->result = ESP_OK;
+    }
+}
+
+/**
+ * Bus owner task: executes queued transactions one at a time
+ */
+static void sts_bus_task(void *pvParameters) {
+    (void)pvParameters;
+    ESP_LOGI(TAG, "Servo bus task started");
+
+    while (true) {
+        sts_transaction_t *txn;
+        if (xQueueReceive(bus_queue, &txn, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        bus_execute(txn);
+
+        if (txn->on_complete) {
+            txn->on_complete(txn);
+        }
+        if (txn->done) {
+            xSemaphoreGive(txn->done);
+        }
+    }
+}
+
 /**
  * Initialize UART for STS servo communication
  */
@@ -30,180 +233,382 @@ esp_err_t sts_servo_init(void) {
     };
 
     ESP_ERROR_CHECK(uart_param_config(UART_PORT, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN, 
+    ESP_ERROR_CHECK(uart_set_pin(UART_PORT, UART_TX_PIN, UART_RX_PIN,
                                   UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-    ESP_ERROR_CHECK(uart_driver_install(UART_PORT, UART_BUF_SIZE, 
-                                        UART_BUF_SIZE, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(UART_PORT, UART_BUF_SIZE,
+                                        UART_BUF_SIZE, UART_EVENT_QUEUE_LEN,
+                                        &uart_event_queue, 0));
+    // Raise UART_DATA as soon as the line goes idle after a reply
+    ESP_ERROR_CHECK(uart_set_rx_timeout(UART_PORT, UART_RX_TOUT_SYMBOLS));
+    sts_parser_init(&rx_parser);
+
+    bus_queue = xQueueCreate(STS_BUS_QUEUE_LEN, sizeof(sts_transaction_t *));
+    if (bus_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create bus queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    BaseType_t ret = xTaskCreate(sts_bus_task, "sts_bus", STS_BUS_TASK_STACK,
+                                 NULL, STS_BUS_TASK_PRIORITY, &bus_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create bus task");
+        return ESP_FAIL;
+    }
 
-    ESP_LOGI(TAG, "UART initialized: TX=%d, RX=%d, Baud=%d", 
+    ESP_LOGI(TAG, "UART initialized: TX=%d, RX=%d, Baud=%d",
              UART_TX_PIN, UART_RX_PIN, UART_BAUD_RATE);
-    
+
+    return ESP_OK;
+}
+
+/**
+ * Queue a transaction for the bus task (completion via callback/semaphore)
+ */
+esp_err_t sts_bus_submit(sts_transaction_t *txn, TickType_t ticks_to_wait) {
+    if (bus_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (txn->expected_replies > ARM_NUM_JOINTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    txn->result = ESP_FAIL;
+    txn->reply_count = 0;
+    if (xQueueSend(bus_queue, &txn, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
     return ESP_OK;
 }
 
+/**
+ * Submit a transaction and block until the bus task completes it
+ */
+esp_err_t sts_bus_transfer(sts_transaction_t *txn) {
+    StaticSemaphore_t done_buf;
+    txn->done = xSemaphoreCreateBinaryStatic(&done_buf);
+
+    esp_err_t ret = sts_bus_submit(txn, portMAX_DELAY);
+    if (ret == ESP_OK) {
+        xSemaphoreTake(txn->done, portMAX_DELAY);
+        ret = txn->result;
+    }
+
+    txn->done = NULL;
+    return ret;
+}
+
+/**
+ * Get a snapshot of bus counters
+ */
+void sts_bus_get_stats(sts_bus_stats_t *stats) {
+    portENTER_CRITICAL(&bus_stats_lock);
+    *stats = bus_stats;
+    stats->parser = rx_parser.stats;
+    stats->echo_frames = rx_parser.stats.echo_frames;
+    stats->echo_bytes = rx_parser.stats.echo_bytes;
+    portEXIT_CRITICAL(&bus_stats_lock);
+}
+
+/**
+ * Install (or clear with NULL) the TX observer
+ */
+void sts_bus_set_tx_hook(sts_bus_tx_hook_t hook) {
+    tx_hook = hook;
+}
+
 /**
  * Send ping command to servo
  */
 esp_err_t sts_servo_ping(uint8_t servo_id) {
-    uint8_t packet[6];
-    packet[0] = STS_FRAME_HEADER;
-    packet[1] = STS_FRAME_HEADER;
-    packet[2] = servo_id;
-    packet[3] = 2;  // Length
-    packet[4] = STS_CMD_PING;
-    packet[5] = sts_calculate_checksum(packet, 5);
-
-    uart_write_bytes(UART_PORT, (const char *)packet, 6);
-    
-    // Wait for response
-    uint8_t response[6];
-    int len = uart_read_bytes(UART_PORT, response, 6, pdMS_TO_TICKS(100));
-    
-    if (len == 6) {
+    sts_transaction_t txn = {0};
+    txn.frame_len = sts_build_frame(txn.frame, servo_id, STS_CMD_PING, NULL, 0);
+    txn.expected_replies = 1;
+
+    if (sts_bus_transfer(&txn) == ESP_OK && txn.replies[0].id == servo_id) {
         ESP_LOGI(TAG, "Servo %d responded to ping", servo_id);
         return ESP_OK;
     }
-    
+
     ESP_LOGW(TAG, "Servo %d no response", servo_id);
     return ESP_FAIL;
 }
 
 /**
- * Set servo position with time and speed
+ * Write registers of one servo and wait for its ACK
+ *
+ * The ACK is consumed here so it can't leak into later reads. It is optional
+ * (servos with a reduced status return level send none), so only a failed
+ * write is an error; a missing ACK is not.
  */
-esp_err_t sts_servo_set_position(uint8_t servo_id, uint16_t position, 
+static esp_err_t sts_servo_write(uint8_t servo_id, const uint8_t *params, uint8_t param_len) {
+    sts_transaction_t txn = {0};
+    txn.frame_len = sts_build_frame(txn.frame, servo_id, STS_CMD_WRITE, params, param_len);
+    txn.expected_replies = 1;
+
+    esp_err_t ret = sts_bus_transfer(&txn);
+    if (ret == ESP_ERR_TIMEOUT) {
+        ESP_LOGD(TAG, "Servo %d: no ACK for write to 0x%02X", servo_id, params[0]);
+        return ESP_OK;
+    }
+    return ret;
+}
+
+/**
+ * Set servo position (joint steps) with time and speed
+ */
+esp_err_t sts_servo_set_position(uint8_t servo_id, uint16_t position,
                                   uint16_t time_ms, uint16_t speed) {
     // Clamp values
     if (position > STS_POSITION_MAX) position = STS_POSITION_MAX;
     if (speed > STS_SPEED_MAX) speed = STS_SPEED_MAX;
 
-    uint8_t packet[13];
-    packet[0] = STS_FRAME_HEADER;
-    packet[1] = STS_FRAME_HEADER;
-    packet[2] = servo_id;
-    packet[3] = 9;  // Length
-    packet[4] = STS_CMD_WRITE;
-    packet[5] = STS_ADDR_GOAL_POSITION_L;
-    packet[6] = position & 0xFF;          // Position Low
-    packet[7] = (position >> 8) & 0xFF;   // Position High
-    packet[8] = time_ms & 0xFF;           // Time Low
-    packet[9] = (time_ms >> 8) & 0xFF;    // Time High
-    packet[10] = speed & 0xFF;            // Speed Low
-    packet[11] = (speed >> 8) & 0xFF;     // Speed High
-    packet[12] = sts_calculate_checksum(packet, 12);
-
-    int written = uart_write_bytes(UART_PORT, (const char *)packet, 13);
-    
-    if (written == 13) {
-        ESP_LOGD(TAG, "Servo %d: pos=%d, time=%dms, speed=%d", 
+    // Arm joints get their soft limits and offset like a sync write
+    int joint = servo_id - ARM_SERVO_ID_BASE;
+    if (joint >= 0 && joint < ARM_NUM_JOINTS) {
+        arm_position_t pos;
+        pos.joints[joint].position = position;
+        pos.joints[joint].time_ms = time_ms;
+        pos.joints[joint].speed = speed;
+        joint_calib_to_servo(&pos, &pos, 1 << joint);
+        position = pos.joints[joint].position;
+        speed = pos.joints[joint].speed;
+    }
+
+    uint8_t params[7];
+    params[0] = STS_ADDR_GOAL_POSITION_L;
+    params[1] = position & 0xFF;          // Position Low
+    params[2] = (position >> 8) & 0xFF;   // Position High
+    params[3] = time_ms & 0xFF;           // Time Low
+    params[4] = (time_ms >> 8) & 0xFF;    // Time High
+    params[5] = speed & 0xFF;             // Speed Low
+    params[6] = (speed >> 8) & 0xFF;      // Speed High
+
+    esp_err_t ret = sts_servo_write(servo_id, params, sizeof(params));
+    if (ret == ESP_OK) {
+        ESP_LOGD(TAG, "Servo %d: pos=%d, time=%dms, speed=%d",
                  servo_id, position, time_ms, speed);
-        return ESP_OK;
     }
-    
-    return ESP_FAIL;
+
+    return ret;
 }
 
 /**
- * Read current servo position
+ * Read current servo position (joint steps)
  */
 esp_err_t sts_servo_read_position(uint8_t servo_id, uint16_t *position) {
     // Initialize to invalid value
     *position = 0xFFFF;
-    
-    uint8_t packet[8];
-    packet[0] = STS_FRAME_HEADER;
-    packet[1] = STS_FRAME_HEADER;
-    packet[2] = servo_id;
-    packet[3] = 4;  // Length
-    packet[4] = STS_CMD_READ;
-    packet[5] = STS_ADDR_PRESENT_POSITION_L;
-    packet[6] = 2;  // Read 2 bytes
-    packet[7] = sts_calculate_checksum(packet, 7);
-
-    uart_write_bytes(UART_PORT, (const char *)packet, 8);
-    
-    // Wait for response
-    uint8_t response[8];
-    int len = uart_read_bytes(UART_PORT, response, 8, pdMS_TO_TICKS(100));
-    
-    if (len >= 8) {
-        *position = response[5] | (response[6] << 8);
-        return ESP_OK;
+
+    uint8_t params[2] = { STS_ADDR_PRESENT_POSITION_L, 2 };  // Read 2 bytes
+
+    sts_transaction_t txn = {0};
+    txn.frame_len = sts_build_frame(txn.frame, servo_id, STS_CMD_READ, params, sizeof(params));
+    txn.expected_replies = 1;
+
+    esp_err_t ret = sts_bus_transfer(&txn);
+    sts_reply_t *reply = &txn.replies[0];
+    if (ret == ESP_OK && (reply->id != servo_id || reply->length < 2)) {
+        ret = ESP_FAIL;
     }
-    
-    return ESP_FAIL;
+    if (ret != ESP_OK) {
+        int joint = servo_id - ARM_SERVO_ID_BASE;
+        if (joint >= 0 && joint < ARM_NUM_JOINTS) {
+            portENTER_CRITICAL(&bus_stats_lock);
+            bus_stats.read_errors[joint]++;
+            portEXIT_CRITICAL(&bus_stats_lock);
+        }
+        return ret;
+    }
+
+    *position = reply->params[0] | (reply->params[1] << 8);
+    int joint = servo_id - ARM_SERVO_ID_BASE;
+    if (joint >= 0 && joint < ARM_NUM_JOINTS) {
+        sts_feedback_t feedback[ARM_NUM_JOINTS];
+        feedback[joint].position = *position;
+        feedback[joint].speed = 0;
+        feedback[joint].load = 0;
+        joint_calib_from_servo(feedback, 1 << joint);
+        *position = feedback[joint].position;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Decode an STS sign-magnitude value (sign in `sign_bit`)
+ */
+static int16_t sts_decode_signed(uint16_t raw, int sign_bit) {
+    int16_t magnitude = raw & ((1 << sign_bit) - 1);
+    return (raw & (1 << sign_bit)) ? -magnitude : magnitude;
+}
+
+/**
+ * Number of bytes to read from PRESENT_POSITION to cover the requested fields
+ */
+static uint8_t sts_feedback_read_len(uint8_t fields) {
+    if (fields & STS_FB_MOVING) return STS_ADDR_MOVING - STS_ADDR_PRESENT_POSITION_L + 1;
+    if (fields & STS_FB_TEMPERATURE) return STS_ADDR_PRESENT_TEMPERATURE - STS_ADDR_PRESENT_POSITION_L + 1;
+    if (fields & STS_FB_VOLTAGE) return STS_ADDR_PRESENT_VOLTAGE - STS_ADDR_PRESENT_POSITION_L + 1;
+    if (fields & STS_FB_LOAD) return STS_ADDR_PRESENT_LOAD_H - STS_ADDR_PRESENT_POSITION_L + 1;
+    if (fields & STS_FB_SPEED) return STS_ADDR_PRESENT_SPEED_H - STS_ADDR_PRESENT_POSITION_L + 1;
+    return 2;
+}
+
+/**
+ * Read present state of all joints with one SYNC READ frame
+ *
+ * Every servo answers in turn; the transaction waits at most
+ * `per_servo_timeout_us` (0 = STS_REPLY_TIMEOUT_US) per joint. Joints that
+ * answered are flagged in `valid_mask`; ESP_ERR_TIMEOUT means some did not.
+ */
+esp_err_t sts_servo_sync_read(uint8_t fields, sts_feedback_t feedback[ARM_NUM_JOINTS],
+                              uint8_t *valid_mask, uint32_t per_servo_timeout_us) {
+    uint8_t read_len = sts_feedback_read_len(fields);
+    uint8_t params[2 + ARM_NUM_JOINTS];
+    int idx = 0;
+
+    params[idx++] = STS_ADDR_PRESENT_POSITION_L;
+    params[idx++] = read_len;
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        params[idx++] = ARM_SERVO_ID_BASE + i;
+    }
+
+    sts_transaction_t txn = {0};
+    txn.frame_len = sts_build_frame(txn.frame, STS_BROADCAST_ID, STS_CMD_SYNC_READ, params, idx);
+    txn.expected_replies = ARM_NUM_JOINTS;
+    txn.timeout_us = (per_servo_timeout_us ? per_servo_timeout_us : STS_REPLY_TIMEOUT_US)
+                     * ARM_NUM_JOINTS;
+
+    esp_err_t ret = sts_bus_transfer(&txn);
+    if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
+        if (valid_mask) *valid_mask = 0;
+        return ret;
+    }
+
+    uint8_t mask = 0;
+    for (int r = 0; r < txn.reply_count; r++) {
+        sts_reply_t *reply = &txn.replies[r];
+        int joint = reply->id - ARM_SERVO_ID_BASE;
+        if (joint < 0 || joint >= ARM_NUM_JOINTS || reply->length < read_len) {
+            continue;
+        }
+
+        const uint8_t *p = reply->params;
+        sts_feedback_t *fb = &feedback[joint];
+        memset(fb, 0, sizeof(*fb));
+        fb->error = reply->error;
+        fb->position = p[0] | (p[1] << 8);
+        if (read_len >= 4) fb->speed = sts_decode_signed(p[2] | (p[3] << 8), 15);
+        if (read_len >= 6) fb->load = sts_decode_signed(p[4] | (p[5] << 8), 10);
+        if (read_len >= 7) fb->voltage = p[6];
+        if (read_len >= 8) fb->temperature = p[7];
+        if (read_len >= 11) fb->moving = p[STS_ADDR_MOVING - STS_ADDR_PRESENT_POSITION_L];
+        mask |= 1 << joint;
+    }
+    joint_calib_from_servo(feedback, mask);
+
+    if (mask != ARM_ALL_JOINTS_MASK) {
+        portENTER_CRITICAL(&bus_stats_lock);
+        for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+            if (!(mask & (1 << i))) {
+                bus_stats.read_errors[i]++;
+            }
+        }
+        portEXIT_CRITICAL(&bus_stats_lock);
+    }
+
+    if (valid_mask) *valid_mask = mask;
+    return (mask == ARM_ALL_JOINTS_MASK) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+/**
+ * Read present position of all joints with one SYNC READ frame
+ */
+esp_err_t sts_servo_sync_read_positions(uint16_t positions[ARM_NUM_JOINTS], uint8_t *valid_mask) {
+    sts_feedback_t feedback[ARM_NUM_JOINTS];
+    uint8_t mask = 0;
+
+    esp_err_t ret = sts_servo_sync_read(STS_FB_POSITION, feedback, &mask, 0);
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (mask & (1 << i)) {
+            positions[i] = feedback[i].position;
+        }
+    }
+
+    if (valid_mask) *valid_mask = mask;
+    return ret;
 }
 
 /**
  * Enable or disable torque for a servo
  */
 esp_err_t sts_servo_set_torque(uint8_t servo_id, uint8_t enable) {
-    // Flush RX buffer before sending
-    uart_flush_input(UART_PORT);
-    
-    uint8_t packet[8];
-    packet[0] = STS_FRAME_HEADER;
-    packet[1] = STS_FRAME_HEADER;
-    packet[2] = servo_id;
-    packet[3] = 4;  // Length
-    packet[4] = STS_CMD_WRITE;
-    packet[5] = STS_ADDR_TORQUE_ENABLE;
-    packet[6] = enable ? 1 : 0;  // 0=disable, 1=enable
-    packet[7] = sts_calculate_checksum(packet, 7);
-
-    int written = uart_write_bytes(UART_PORT, (const char *)packet, 8);
-    if (written != 8) {
-        return ESP_FAIL;
-    }
-    
-    // Wait for transmission to complete
-    uart_wait_tx_done(UART_PORT, pdMS_TO_TICKS(50));
-    
-    // Optional: Read and discard response (some servos send ACK)
-    uint8_t response[8];
-    uart_read_bytes(UART_PORT, response, sizeof(response), pdMS_TO_TICKS(20));
-    
-    return ESP_OK;
+    uint8_t params[2];
+    params[0] = STS_ADDR_TORQUE_ENABLE;
+    params[1] = enable ? 1 : 0;  // 0=disable, 1=enable
+
+    return sts_servo_write(servo_id, params, sizeof(params));
 }
 
 /**
- * Set position for all ARM joints using sync write
+ * Set the acceleration register (100 steps/s^2 per unit, 0 = unlimited)
  */
-esp_err_t sts_servo_sync_write_position(arm_position_t *arm_pos) {
-    // Sync write packet: header + id + length + cmd + addr + param_len + (id + data)*n + checksum
-    uint8_t packet[8 + ARM_NUM_JOINTS * 7];
+esp_err_t sts_servo_set_acceleration(uint8_t servo_id, uint8_t acc) {
+    uint8_t params[2] = { STS_ADDR_ACC, acc };
+
+    return sts_servo_write(servo_id, params, sizeof(params));
+}
+
+/**
+ * Set position (joint steps) for the selected ARM joints using one sync write
+ */
+esp_err_t sts_servo_sync_write_joints(const arm_position_t *arm_pos, uint8_t joint_mask) {
+    // Joint steps to servo steps, within the soft limits, in one pass
+    arm_position_t servo_pos;
+    joint_calib_to_servo(arm_pos, &servo_pos, joint_mask);
+    arm_pos = &servo_pos;
+
+    // Sync write params: addr + param_len + (id + data)*n
+    uint8_t params[2 + ARM_NUM_JOINTS * 7];
     int idx = 0;
-    
-    packet[idx++] = STS_FRAME_HEADER;
-    packet[idx++] = STS_FRAME_HEADER;
-    packet[idx++] = STS_BROADCAST_ID;
-    packet[idx++] = 4 + ARM_NUM_JOINTS * 7;  // Length
-    packet[idx++] = STS_CMD_SYNC_WRITE;
-    packet[idx++] = STS_ADDR_GOAL_POSITION_L;
-    packet[idx++] = 6;  // Parameter length per servo (pos + time + speed)
-    
-    // Add data for each joint
+
+    params[idx++] = STS_ADDR_GOAL_POSITION_L;
+    params[idx++] = 6;  // Parameter length per servo (pos + time + speed)
+
+    // Add data for each selected joint
     for (int i = 0; i < ARM_NUM_JOINTS; i++) {
-        packet[idx++] = ARM_SERVO_ID_BASE + i;
-        packet[idx++] = arm_pos->joints[i].position & 0xFF;
-        packet[idx++] = (arm_pos->joints[i].position >> 8) & 0xFF;
-        packet[idx++] = arm_pos->joints[i].time_ms & 0xFF;
-        packet[idx++] = (arm_pos->joints[i].time_ms >> 8) & 0xFF;
-        packet[idx++] = arm_pos->joints[i].speed & 0xFF;
-        packet[idx++] = (arm_pos->joints[i].speed >> 8) & 0xFF;
-    }
-    
-    int checksum_idx = idx;
-    packet[idx++] = sts_calculate_checksum(packet, checksum_idx);
-    
-    int written = uart_write_bytes(UART_PORT, (const char *)packet, idx);
-    
-    if (written == idx) {
-        ESP_LOGI(TAG, "Sync write complete for all joints");
-        return ESP_OK;
+        if (!(joint_mask & (1 << i))) {
+            continue;
+        }
+        params[idx++] = ARM_SERVO_ID_BASE + i;
+        params[idx++] = arm_pos->joints[i].position & 0xFF;
+        params[idx++] = (arm_pos->joints[i].position >> 8) & 0xFF;
+        params[idx++] = arm_pos->joints[i].time_ms & 0xFF;
+        params[idx++] = (arm_pos->joints[i].time_ms >> 8) & 0xFF;
+        params[idx++] = arm_pos->joints[i].speed & 0xFF;
+        params[idx++] = (arm_pos->joints[i].speed >> 8) & 0xFF;
     }
-    
-    return ESP_FAIL;
+
+    if (idx == 2) {
+        return ESP_OK;  // Nothing selected
+    }
+
+    sts_transaction_t txn = {0};
+    txn.frame_len = sts_build_frame(txn.frame, STS_BROADCAST_ID, STS_CMD_SYNC_WRITE, params, idx);
+    txn.expected_replies = 0;  // Broadcast, servos stay silent
+
+    esp_err_t ret = sts_bus_transfer(&txn);
+
+    if (ret == ESP_OK) {
+        ESP_LOGD(TAG, "Sync write complete for joints 0x%02X", joint_mask);
+    }
+
+    return ret;
+}
+
+/**
+ * Sync write position to all servos
+ */
+esp_err_t sts_servo_sync_write_position(arm_position_t *arm_pos) {
+    return sts_servo_sync_write_joints(arm_pos, ARM_ALL_JOINTS_MASK);
 }
 
 /**
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sts_parser.h"
 
 // STS3214 Servo Protocol Commands
 #define STS_FRAME_HEADER          0xFF
@@ -12,12 +15,14 @@
 #define STS_CMD_WRITE             0x03
 #define STS_CMD_REG_WRITE         0x04
 #define STS_CMD_ACTION            0x05
+#define STS_CMD_SYNC_READ         0x82
 #define STS_CMD_SYNC_WRITE        0x83
 
 // STS3214 Memory Table Addresses
 #define STS_ADDR_ID               0x05
 #define STS_ADDR_BAUD_RATE        0x06
 #define STS_ADDR_TORQUE_ENABLE    0x28
+#define STS_ADDR_ACC              0x29
 #define STS_ADDR_GOAL_POSITION_L  0x2A
 #define STS_ADDR_GOAL_POSITION_H  0x2B
 #define STS_ADDR_GOAL_TIME_L      0x2C
@@ -26,6 +31,14 @@
 #define STS_ADDR_GOAL_SPEED_H     0x2F
 #define STS_ADDR_PRESENT_POSITION_L 0x38
 #define STS_ADDR_PRESENT_POSITION_H 0x39
+#define STS_ADDR_PRESENT_SPEED_L  0x3A
+#define STS_ADDR_PRESENT_SPEED_H  0x3B
+#define STS_ADDR_PRESENT_LOAD_L   0x3C
+#define STS_ADDR_PRESENT_LOAD_H   0x3D
+#define STS_ADDR_PRESENT_VOLTAGE  0x3E
+#define STS_ADDR_PRESENT_TEMPERATURE 0x3F
+#define STS_ADDR_SERVO_STATUS     0x41
+#define STS_ADDR_MOVING           0x42
 
 // ARM Configuration
 #define ARM_NUM_JOINTS            6
@@ -46,6 +59,28 @@
 #define UART_RX_PIN               32
 #define UART_BAUD_RATE            1000000
 #define UART_BUF_SIZE             1024
+#define UART_EVENT_QUEUE_LEN      16
+#define UART_RX_TOUT_SYMBOLS      3     // RX idle time (in symbols) that ends a reply
+
+// Bus owner task: the only code that touches the servo UART
+#define STS_BUS_QUEUE_LEN         8
+#define STS_BUS_TASK_STACK        4096
+#define STS_BUS_TASK_PRIORITY     12
+#define STS_REPLY_TIMEOUT_US      3000  // Per expected reply
+#define STS_MAX_FRAME_LEN         (8 + ARM_NUM_JOINTS * 7)  // Largest frame we send (sync write)
+
+// Feedback fields for sts_servo_sync_read (one contiguous read from 0x38)
+#define STS_FB_POSITION           (1 << 0)
+#define STS_FB_SPEED              (1 << 1)
+#define STS_FB_LOAD               (1 << 2)
+#define STS_FB_VOLTAGE            (1 << 3)
+#define STS_FB_TEMPERATURE        (1 << 4)
+#define STS_FB_MOVING             (1 << 5)
+#define STS_FB_ERROR              (1 << 6)    // Status byte; arrives with every reply, no extra read
+#define STS_FB_ALL                0x7F
+
+// Bitmask with one bit per joint
+#define ARM_ALL_JOINTS_MASK       ((1 << ARM_NUM_JOINTS) - 1)
 
 // Structure for joint position
 typedef struct {
@@ -60,14 +95,76 @@ typedef struct {
     uint32_t delay_after_ms;  // Delay after reaching this position
 } arm_position_t;
 
+typedef struct sts_transaction sts_transaction_t;
+typedef void (*sts_transaction_cb_t)(sts_transaction_t *txn);
+
+// One request frame and the replies it expects. The submitter owns the
+// memory and must keep it alive until the transaction completes.
+struct sts_transaction {
+    uint8_t frame[STS_MAX_FRAME_LEN];
+    uint8_t frame_len;
+    uint8_t expected_replies;               // 0 for broadcast/sync writes
+    uint32_t timeout_us;                    // 0 = STS_REPLY_TIMEOUT_US per expected reply
+
+    // Filled in by the bus task before completion
+    esp_err_t result;                       // ESP_OK, ESP_ERR_TIMEOUT or ESP_FAIL
+    uint8_t reply_count;
+    sts_reply_t replies[ARM_NUM_JOINTS];
+
+    // Completion: callback runs in the bus task, then `done` is given if set
+    sts_transaction_cb_t on_complete;
+    void *user_data;
+    SemaphoreHandle_t done;
+};
+
+// Bus counters
+typedef struct {
+    uint32_t transactions;
+    uint32_t timeouts;
+    uint32_t tx_frames;
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t echo_frames;                   // Our own frames read back on a half-duplex line
+    uint32_t echo_bytes;                    // Their bytes, included in rx_bytes
+    uint32_t unexpected_packets;            // Valid packets nobody was waiting for
+    sts_parser_stats_t parser;              // Checksum/framing errors and servo error flags
+    uint32_t read_errors[ARM_NUM_JOINTS];   // Reads a joint did not answer
+    int64_t last_tx_us;                     // esp_timer time of the last frame handed to the UART
+} sts_bus_stats_t;
+
+// Observer for every frame handed to the UART (runs in the bus task, keep it short)
+typedef void (*sts_bus_tx_hook_t)(const uint8_t *frame, uint8_t len, int64_t tx_us);
+
+// Present state of one servo
+typedef struct {
+    uint16_t position;     // 0-4095
+    int16_t speed;         // Steps/s, negative when moving backwards
+    int16_t load;          // 0.1% of max torque, signed
+    uint8_t voltage;       // 0.1 V units
+    uint8_t temperature;   // Degrees C
+    uint8_t moving;        // 1 while the servo is still travelling
+    uint8_t error;         // Status byte from the servo's reply
+} sts_feedback_t;
+
 // Function prototypes
 esp_err_t sts_servo_init(void);
+uint8_t sts_build_frame(uint8_t *frame, uint8_t servo_id, uint8_t instruction,
+                        const uint8_t *params, uint8_t param_len);
+esp_err_t sts_bus_submit(sts_transaction_t *txn, TickType_t ticks_to_wait);
+esp_err_t sts_bus_transfer(sts_transaction_t *txn);
+void sts_bus_get_stats(sts_bus_stats_t *stats);
+void sts_bus_set_tx_hook(sts_bus_tx_hook_t hook);
 esp_err_t sts_servo_ping(uint8_t servo_id);
 esp_err_t sts_servo_set_position(uint8_t servo_id, uint16_t position, uint16_t time_ms, uint16_t speed);
 esp_err_t sts_servo_read_position(uint8_t servo_id, uint16_t *position);
+esp_err_t sts_servo_sync_read(uint8_t fields, sts_feedback_t feedback[ARM_NUM_JOINTS],
+                              uint8_t *valid_mask, uint32_t per_servo_timeout_us);
+esp_err_t sts_servo_sync_read_positions(uint16_t positions[ARM_NUM_JOINTS], uint8_t *valid_mask);
 esp_err_t sts_servo_sync_write_position(arm_position_t *arm_pos);
+esp_err_t sts_servo_sync_write_joints(const arm_position_t *arm_pos, uint8_t joint_mask);
 esp_err_t sts_servo_set_arm_position(arm_position_t *arm_pos);
 esp_err_t sts_servo_set_torque(uint8_t servo_id, uint8_t enable);
+esp_err_t sts_servo_set_acceleration(uint8_t servo_id, uint8_t acc);
 uint8_t sts_calculate_checksum(uint8_t *data, uint8_t length);
 
 #endif // STS_SERVO_H
@@ -0,0 +1,510 @@
+#include "teach_recorder.h"
+#include "control_loop.h"
+#include "ble_arm_control.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "TEACH";
+
+typedef enum {
+    TEACH_IDLE,
+    TEACH_RECORDING,
+    TEACH_FINISHING,                     // Sampler stopped, writer draining and committing
+} teach_state_t;
+
+// One complete read of the arm
+typedef struct {
+    uint32_t t_ms;                       // Since the recording started
+    uint16_t q[ARM_NUM_JOINTS];
+} teach_sample_t;
+
+static TaskHandle_t sampler_task_handle = NULL;
+static esp_timer_handle_t sample_timer = NULL;       // Paces the sampler at the recording rate
+static TaskHandle_t writer_task_handle = NULL;
+
+// Recording state and the sample ring, shared by the command worker,
+// the sampler and the writer
+static portMUX_TYPE teach_lock = portMUX_INITIALIZER_UNLOCKED;
+static teach_state_t state = TEACH_IDLE;
+static teach_sample_t ring[TEACH_RING_LEN];
+static uint8_t ring_head = 0;
+static uint8_t ring_count = 0;
+static uint16_t sample_tolerance = TEACH_DEFAULT_TOLERANCE;
+static uint8_t record_flags = 0;
+static bool save_on_finish = true;
+static int64_t start_us = 0;
+static uint32_t sample_count = 0;
+static uint32_t last_sample_ms = 0;
+static uint16_t missed_count = 0;
+
+// Owned by the writer task while recording
+static traj_store_writer_t writer;
+static esp_err_t store_error = ESP_OK;
+static teach_sample_t window[TEACH_WINDOW_SAMPLES];   // window[0] is the last emitted sample
+static uint8_t window_len = 0;
+static bool keep[TEACH_WINDOW_SAMPLES];
+static uint8_t split_stack[TEACH_WINDOW_SAMPLES][2];
+static traj_store_point_t held;                       // Last point, open to collect dwell
+static bool held_valid = false;
+static uint32_t last_emit_ms = 0;
+
+/**
+ * Switch torque on all joints
+ */
+static void teach_set_torque(bool enable) {
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        if (sts_servo_set_torque(ARM_SERVO_ID_BASE + i, enable) != ESP_OK) {
+            ESP_LOGW(TAG, "Torque %s for servo %d: FAIL", enable ? "ENABLE" : "DISABLE", ARM_SERVO_ID_BASE + i);
+        }
+    }
+}
+
+/**
+ * Move the setpoint to where the arm is, cancelling any plan
+ */
+static void teach_hold_measured(void) {
+    uint16_t positions[ARM_NUM_JOINTS];
+    uint8_t valid_mask = 0;
+    sts_servo_sync_read_positions(positions, &valid_mask);
+    control_loop_sync_to_measured(positions, valid_mask);
+}
+
+/**
+ * Stop sampling after a store error; the recording is then reported as failed
+ */
+static void teach_fail(esp_err_t err) {
+    store_error = err;
+    portENTER_CRITICAL(&teach_lock);
+    if (state == TEACH_RECORDING) {
+        state = TEACH_FINISHING;
+    }
+    portEXIT_CRITICAL(&teach_lock);
+    esp_timer_stop(sample_timer);
+    ESP_LOGE(TAG, "Store refused point %" PRIu32 ": %s, stopping", writer.num_points, esp_err_to_name(err));
+}
+
+/**
+ * Append a finished point to the program, and to the phone's copy
+ */
+static void teach_store(const traj_store_point_t *point) {
+    if (store_error != ESP_OK) {
+        return;
+    }
+    esp_err_t ret = traj_store_append(&writer, point);
+    if (ret != ESP_OK) {
+        teach_fail(ret);
+        return;
+    }
+
+    if (record_flags & TEACH_FLAG_STREAM) {
+        teach_point_notify_t notify = {
+            .tag = NOTIFY_TAG_TEACH_POINT,
+            .index = writer.num_points - 1,
+            .duration_ms = point->duration_ms,
+            .dwell_ms = point->dwell_ms,
+        };
+        memcpy(notify.position, point->position, sizeof(notify.position));
+        ble_notify((uint8_t *)&notify, sizeof(notify));
+    }
+}
+
+/**
+ * Turn a kept sample into a program point
+ *
+ * The newest point is held back: a sample at exactly the same position
+ * extends its dwell instead of adding a motionless segment.
+ */
+static void teach_emit(const teach_sample_t *sample) {
+    uint32_t elapsed = held_valid ? sample->t_ms - last_emit_ms : 0;
+    last_emit_ms = sample->t_ms;
+
+    if (held_valid && memcmp(held.position, sample->q, sizeof(held.position)) == 0 &&
+        held.dwell_ms + elapsed <= UINT16_MAX) {
+        held.dwell_ms += elapsed;
+        return;
+    }
+    if (held_valid) {
+        teach_store(&held);
+    }
+    memcpy(held.position, sample->q, sizeof(held.position));
+    held.duration_ms = elapsed > UINT16_MAX ? UINT16_MAX : elapsed;
+    held.dwell_ms = 0;
+    held_valid = true;
+}
+
+/**
+ * Largest joint error of a sample against the line from a to b at the sample's time
+ */
+static float teach_deviation(const teach_sample_t *a, const teach_sample_t *b, const teach_sample_t *sample) {
+    uint32_t span = b->t_ms - a->t_ms;
+    float f = span > 0 ? (float)(sample->t_ms - a->t_ms) / span : 0.0f;
+    float worst = 0.0f;
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        float line = a->q[i] + f * ((float)b->q[i] - a->q[i]);
+        float err = fabsf(sample->q[i] - line);
+        if (err > worst) {
+            worst = err;
+        }
+    }
+    return worst;
+}
+
+/**
+ * Ramer-Douglas-Peucker over the window: mark the samples to keep
+ */
+static void teach_rdp(uint8_t len, uint16_t tolerance) {
+    memset(keep, 0, len);
+    keep[0] = true;
+    keep[len - 1] = true;
+
+    int top = 0;
+    split_stack[top][0] = 0;
+    split_stack[top][1] = len - 1;
+    top++;
+    while (top > 0) {
+        top--;
+        uint8_t a = split_stack[top][0];
+        uint8_t b = split_stack[top][1];
+        float worst = tolerance;
+        int split = -1;
+        for (int i = a + 1; i < b; i++) {
+            float err = teach_deviation(&window[a], &window[b], &window[i]);
+            if (err > worst) {
+                worst = err;
+                split = i;
+            }
+        }
+        if (split >= 0) {
+            keep[split] = true;
+            split_stack[top][0] = a;
+            split_stack[top][1] = split;
+            top++;
+            split_stack[top][0] = split;
+            split_stack[top][1] = b;
+            top++;
+        }
+    }
+}
+
+/**
+ * Simplify the window and emit what is settled
+ *
+ * The stretch after the last kept interior sample may still change shape
+ * with the samples to come, so it stays in the window unless this is the
+ * end of the recording. A window with nothing to keep inside is emitted up
+ * to its last sample.
+ */
+static void teach_simplify(bool final) {
+    if (window_len < 2) {
+        return;
+    }
+    teach_rdp(window_len, sample_tolerance);
+
+    uint8_t last = window_len - 1;
+    if (!final) {
+        for (int i = window_len - 2; i > 0; i--) {
+            if (keep[i]) {
+                last = i;
+                break;
+            }
+        }
+    }
+    for (int i = 1; i <= last; i++) {
+        if (keep[i] || i == last) {
+            teach_emit(&window[i]);
+        }
+    }
+    memmove(window, &window[last], (window_len - last) * sizeof(window[0]));
+    window_len -= last;
+}
+
+/**
+ * Take one sample from the ring
+ */
+static void teach_add_sample(const teach_sample_t *sample) {
+    window[window_len++] = *sample;
+    if (window_len == 1 && !held_valid) {
+        teach_emit(sample);   // The first sample starts the program
+    }
+    if (window_len == TEACH_WINDOW_SAMPLES) {
+        teach_simplify(false);
+    }
+}
+
+/**
+ * End the recording: flush, commit or discard, hand the arm back and report
+ */
+static void teach_finish(void) {
+    portENTER_CRITICAL(&teach_lock);
+    bool save = save_on_finish;
+    uint32_t samples = sample_count;
+    uint32_t duration_ms = last_sample_ms;
+    uint16_t missed = missed_count;
+    portEXIT_CRITICAL(&teach_lock);
+
+    if (save && store_error == ESP_OK) {
+        teach_simplify(true);
+        if (held_valid) {
+            teach_store(&held);
+        }
+    }
+
+    uint8_t result;
+    uint32_t points = writer.num_points;
+    if (!save) {
+        traj_store_abort(&writer);
+        result = TEACH_RESULT_DISCARDED;
+    } else if (store_error != ESP_OK || points == 0) {
+        traj_store_abort(&writer);
+        result = TEACH_RESULT_FAILED;
+    } else {
+        esp_err_t ret = traj_store_commit(&writer);
+        result = ret == ESP_OK ? TEACH_RESULT_SAVED : TEACH_RESULT_FAILED;
+    }
+
+    // Hold where the arm was left instead of snapping back to the old setpoint
+    teach_set_torque(true);
+    teach_hold_measured();
+
+    teach_done_notify_t done = {
+        .tag = NOTIFY_TAG_TEACH_DONE,
+        .result = result,
+        .points = points > UINT16_MAX ? UINT16_MAX : points,
+        .samples = samples,
+        .missed = missed,
+        .duration_ms = duration_ms,
+    };
+    ble_notify((uint8_t *)&done, sizeof(done));
+
+    ESP_LOGI(TAG, "Recording '%s': result %d, %" PRIu32 " samples in %" PRIu32 " ms -> %" PRIu32 " points, %d missed",
+             writer.name, result, samples, duration_ms, points, missed);
+
+    portENTER_CRITICAL(&teach_lock);
+    state = TEACH_IDLE;
+    portEXIT_CRITICAL(&teach_lock);
+}
+
+/**
+ * Sample timer callback: wake the sampler
+ */
+static void teach_timer_cb(void *arg) {
+    (void)arg;
+    xTaskNotifyGive(sampler_task_handle);
+}
+
+/**
+ * Sampler task: one sync read of all positions per tick into the ring
+ */
+static void teach_sampler_task(void *pvParameters) {
+    (void)pvParameters;
+    while (true) {
+        portENTER_CRITICAL(&teach_lock);
+        bool active = state == TEACH_RECORDING;
+        portEXIT_CRITICAL(&teach_lock);
+
+        if (!active) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        sts_feedback_t feedback[ARM_NUM_JOINTS];
+        uint8_t valid_mask = 0;
+        int64_t now_us = esp_timer_get_time();
+        sts_servo_sync_read(STS_FB_POSITION, feedback, &valid_mask, 0);
+
+        bool queued = false;
+        portENTER_CRITICAL(&teach_lock);
+        // A stop may have come in during the read; nothing is added after it
+        if (state == TEACH_RECORDING) {
+            if (valid_mask == ARM_ALL_JOINTS_MASK && ring_count < TEACH_RING_LEN) {
+                teach_sample_t *sample = &ring[(ring_head + ring_count) % TEACH_RING_LEN];
+                sample->t_ms = (uint32_t)((now_us - start_us) / 1000);
+                for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+                    sample->q[i] = feedback[i].position;
+                }
+                ring_count++;
+                sample_count++;
+                last_sample_ms = sample->t_ms;
+                queued = true;
+            } else if (missed_count < UINT16_MAX) {
+                missed_count++;
+            }
+        }
+        portEXIT_CRITICAL(&teach_lock);
+
+        if (queued) {
+            xTaskNotifyGive(writer_task_handle);
+        }
+        // Paced by the timer rather than the tick, which cannot divide 1 s
+        // into most rates at CONFIG_FREERTOS_HZ=100. Ticks held up by a
+        // flash erase stay pending and are read back to back afterwards.
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+}
+
+/**
+ * Writer task: drain the ring into the simplifier, finish once stopped
+ */
+static void teach_writer_task(void *pvParameters) {
+    (void)pvParameters;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (true) {
+            teach_sample_t sample;
+            portENTER_CRITICAL(&teach_lock);
+            bool have = ring_count > 0;
+            if (have) {
+                sample = ring[ring_head];
+                ring_head = (ring_head + 1) % TEACH_RING_LEN;
+                ring_count--;
+            }
+            bool finishing = state == TEACH_FINISHING;
+            portEXIT_CRITICAL(&teach_lock);
+
+            if (have) {
+                if (store_error == ESP_OK) {
+                    teach_add_sample(&sample);
+                }
+                continue;
+            }
+            if (finishing) {
+                teach_finish();
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * Initialize the recorder tasks (idle until a recording starts)
+ */
+esp_err_t teach_recorder_init(void) {
+    BaseType_t ret = xTaskCreate(teach_writer_task, "teach_writer", TEACH_WRITER_TASK_STACK,
+                                 NULL, TEACH_WRITER_TASK_PRIORITY, &writer_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_FAIL;
+    }
+    ret = xTaskCreate(teach_sampler_task, "teach_sampler", TEACH_SAMPLER_TASK_STACK,
+                      NULL, TEACH_SAMPLER_TASK_PRIORITY, &sampler_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sampler task");
+        return ESP_FAIL;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = teach_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "teach",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &sample_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Teach recorder initialized");
+    return ESP_OK;
+}
+
+/**
+ * Switch torque off and start recording into a program
+ *
+ * rate_hz and tolerance 0 select the defaults. Any plan is cancelled first.
+ * The program replaces one of the same name when the recording is saved.
+ */
+esp_err_t teach_recorder_start(const char *name, uint8_t rate_hz, uint16_t tolerance, uint8_t flags) {
+    if (rate_hz == 0) {
+        rate_hz = TEACH_DEFAULT_HZ;
+    }
+    if (tolerance == 0) {
+        tolerance = TEACH_DEFAULT_TOLERANCE;
+    }
+    if (rate_hz < TEACH_MIN_HZ || rate_hz > TEACH_MAX_HZ) {
+        ESP_LOGE(TAG, "Invalid rate: %d Hz", rate_hz);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&teach_lock);
+    bool busy = state != TEACH_IDLE;
+    portEXIT_CRITICAL(&teach_lock);
+    if (busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // The writer task is idle until the state changes, so its data is ours here
+    esp_err_t ret = traj_store_begin(&writer, name);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    store_error = ESP_OK;
+    window_len = 0;
+    held_valid = false;
+    last_emit_ms = 0;
+
+    teach_hold_measured();
+    teach_set_torque(false);
+
+    portENTER_CRITICAL(&teach_lock);
+    ring_head = 0;
+    ring_count = 0;
+    sample_tolerance = tolerance;
+    record_flags = flags;
+    save_on_finish = true;
+    sample_count = 0;
+    last_sample_ms = 0;
+    missed_count = 0;
+    start_us = esp_timer_get_time();
+    state = TEACH_RECORDING;
+    portEXIT_CRITICAL(&teach_lock);
+
+    // First sample right away, then one per period
+    esp_timer_stop(sample_timer);
+    ret = esp_timer_start_periodic(sample_timer, 1000000 / rate_hz);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start timer: %s", esp_err_to_name(ret));
+        teach_recorder_stop(false);
+        return ret;
+    }
+    xTaskNotifyGive(sampler_task_handle);
+    ESP_LOGI(TAG, "Recording '%s' at %d Hz, tolerance %d steps, flags 0x%02X", name, rate_hz, tolerance, flags);
+    return ESP_OK;
+}
+
+/**
+ * Stop recording; the writer saves or discards the program and reports
+ */
+esp_err_t teach_recorder_stop(bool save) {
+    portENTER_CRITICAL(&teach_lock);
+    bool recording = state == TEACH_RECORDING;
+    if (recording) {
+        state = TEACH_FINISHING;
+        save_on_finish = save;
+    }
+    portEXIT_CRITICAL(&teach_lock);
+
+    if (!recording) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_timer_stop(sample_timer);
+    xTaskNotifyGive(writer_task_handle);
+    return ESP_OK;
+}
+
+/**
+ * Check whether a recording is running or being saved
+ */
+bool teach_recorder_is_recording(void) {
+    portENTER_CRITICAL(&teach_lock);
+    bool active = state != TEACH_IDLE;
+    portEXIT_CRITICAL(&teach_lock);
+    return active;
+}
@@ -0,0 +1,74 @@
+#ifndef TEACH_RECORDER_H
+#define TEACH_RECORDER_H
+
+#include "sts_servo.h"
+#include "traj_store.h"
+
+// Teach-in recording: the arm is guided by hand with torque off while a
+// sampler task reads all joint positions with one sync read per tick into a
+// ring buffer. A writer task drains the ring, simplifies the samples and
+// appends what is left to a program in the trajectory store, so a
+// demonstration of any length is recorded without holding it in RAM. A
+// flash erase in the writer disables the flash cache on both cores and can
+// hold the sampler up for a few ticks; those are then caught up, and every
+// sample carries its real time, so the recording stays correct.
+//
+// Simplification is Ramer-Douglas-Peucker over windows of up to
+// TEACH_WINDOW_SAMPLES samples, with time as the curve parameter: a sample
+// is dropped when the straight line between the kept points around it,
+// evaluated at the sample's own time, is within the tolerance on every
+// joint. Pauses and changes of pace survive along with the shape. Each kept
+// point's duration is the recorded time since the previous one, and a point
+// the arm rested at collects the rest as dwell, so playback reproduces the
+// demonstration at the speed it was given.
+//
+// With TEACH_FLAG_STREAM every stored point is also sent to the phone as a
+// NOTIFY_TAG_TEACH_POINT notification. Stopping commits the program,
+// switches torque back on holding the arm where it was left, and reports a
+// NOTIFY_TAG_TEACH_DONE summary.
+
+#define TEACH_MIN_HZ              20
+#define TEACH_MAX_HZ              50
+#define TEACH_DEFAULT_HZ          50
+#define TEACH_DEFAULT_TOLERANCE   4       // Steps on any joint
+#define TEACH_RING_LEN            64      // Samples buffered for the writer, over a second at 50 Hz
+#define TEACH_WINDOW_SAMPLES      128     // Samples simplified together
+#define TEACH_SAMPLER_TASK_STACK  3072
+#define TEACH_SAMPLER_TASK_PRIORITY 9
+#define TEACH_WRITER_TASK_STACK   4096
+#define TEACH_WRITER_TASK_PRIORITY 3      // Below everything that moves the arm
+
+// Recording flags
+#define TEACH_FLAG_STREAM         0x01    // Copy stored points to the phone
+
+// Recording results (teach_done_notify_t.result)
+#define TEACH_RESULT_SAVED        0x00
+#define TEACH_RESULT_DISCARDED    0x01    // Stopped without saving
+#define TEACH_RESULT_FAILED       0x02    // Nothing recorded, or the store refused a write
+
+// NOTIFY_TAG_TEACH_POINT, one per stored point, 19 bytes so it fits the default MTU
+typedef struct __attribute__((packed)) {
+    uint8_t tag;
+    uint16_t index;                       // Point number in the program
+    uint16_t position[ARM_NUM_JOINTS];    // Joint steps
+    uint16_t duration_ms;                 // Travel time from the previous point
+    uint16_t dwell_ms;                    // Rest after arriving
+} teach_point_notify_t;
+
+// NOTIFY_TAG_TEACH_DONE
+typedef struct __attribute__((packed)) {
+    uint8_t tag;
+    uint8_t result;                       // TEACH_RESULT_*
+    uint16_t points;                      // Stored in the program
+    uint32_t samples;                     // Read from the servos
+    uint16_t missed;                      // Ticks lost to incomplete reads or a full ring
+    uint32_t duration_ms;                 // Start to the last sample
+} teach_done_notify_t;
+
+// Function prototypes
+esp_err_t teach_recorder_init(void);
+esp_err_t teach_recorder_start(const char *name, uint8_t rate_hz, uint16_t tolerance, uint8_t flags);
+esp_err_t teach_recorder_stop(bool save);
+bool teach_recorder_is_recording(void);
+
+#endif // TEACH_RECORDER_H
@@ -0,0 +1,281 @@
+#include "telemetry.h"
+#include "ble_arm_control.h"
+#include "motion_queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "TELEMETRY";
+
+static TaskHandle_t sampler_task_handle = NULL;
+static esp_timer_handle_t sample_timer = NULL;     // Paces the sampler at the subscribed rate
+
+// Subscription, written by the command worker and read by the sampler
+static portMUX_TYPE config_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool running = false;
+static uint8_t sample_fields = 0;
+static uint8_t batch_limit = 0;           // 0 = as many as fit
+static uint32_t config_generation = 0;
+
+/**
+ * Bytes per joint for the selected fields
+ */
+static uint8_t joint_field_bytes(uint8_t fields) {
+    uint8_t bytes = 0;
+    if (fields & STS_FB_POSITION) {
+        bytes += 2;
+    }
+    if (fields & STS_FB_SPEED) {
+        bytes += 2;
+    }
+    if (fields & STS_FB_LOAD) {
+        bytes += 2;
+    }
+    if (fields & STS_FB_VOLTAGE) {
+        bytes += 1;
+    }
+    if (fields & STS_FB_TEMPERATURE) {
+        bytes += 1;
+    }
+    if (fields & STS_FB_MOVING) {
+        bytes += 1;
+    }
+    if (fields & STS_FB_ERROR) {
+        bytes += 1;
+    }
+    return bytes;
+}
+
+/**
+ * Encoded size of one sample
+ */
+uint16_t telemetry_sample_size(uint8_t fields) {
+    return 5 + (fields & TELEMETRY_FIELD_QUEUE ? 2 : 0) + ARM_NUM_JOINTS * joint_field_bytes(fields);
+}
+
+/**
+ * Append one sample to the notification buffer, returns bytes written
+ */
+static uint16_t encode_sample(uint8_t *out, uint8_t fields, uint32_t timestamp_ms, uint8_t valid_mask,
+                              const sts_feedback_t feedback[ARM_NUM_JOINTS]) {
+    uint8_t *p = out;
+    *p++ = timestamp_ms & 0xFF;
+    *p++ = (timestamp_ms >> 8) & 0xFF;
+    *p++ = (timestamp_ms >> 16) & 0xFF;
+    *p++ = (timestamp_ms >> 24) & 0xFF;
+    *p++ = valid_mask;
+    if (fields & TELEMETRY_FIELD_QUEUE) {
+        uint8_t depth = 0;
+        uint8_t free_slots = 0;
+        motion_queue_get_level(&depth, &free_slots);
+        *p++ = depth;
+        *p++ = free_slots;
+    }
+
+    for (int i = 0; i < ARM_NUM_JOINTS; i++) {
+        const sts_feedback_t *fb = &feedback[i];
+        if (fields & STS_FB_POSITION) {
+            *p++ = fb->position & 0xFF;
+            *p++ = (fb->position >> 8) & 0xFF;
+        }
+        if (fields & STS_FB_SPEED) {
+            *p++ = (uint16_t)fb->speed & 0xFF;
+            *p++ = ((uint16_t)fb->speed >> 8) & 0xFF;
+        }
+        if (fields & STS_FB_LOAD) {
+            *p++ = (uint16_t)fb->load & 0xFF;
+            *p++ = ((uint16_t)fb->load >> 8) & 0xFF;
+        }
+        if (fields & STS_FB_VOLTAGE) {
+            *p++ = fb->voltage;
+        }
+        if (fields & STS_FB_TEMPERATURE) {
+            *p++ = fb->temperature;
+        }
+        if (fields & STS_FB_MOVING) {
+            *p++ = fb->moving;
+        }
+        if (fields & STS_FB_ERROR) {
+            *p++ = fb->error;
+        }
+    }
+    return p - out;
+}
+
+/**
+ * Sample timer callback: wake the sampler
+ */
+static void telemetry_timer_cb(void *arg) {
+    (void)arg;
+    xTaskNotifyGive(sampler_task_handle);
+}
+
+/**
+ * Sampler task: read, encode, and notify once a batch is full
+ */
+static void telemetry_task(void *pvParameters) {
+    (void)pvParameters;
+    static uint8_t packet[BLE_MAX_MTU];
+    uint16_t packet_len = 0;
+    uint8_t packet_samples = 0;
+    uint8_t sequence = 0;
+    uint32_t generation = 0;
+
+    ESP_LOGI(TAG, "Telemetry sampler started");
+
+    while (true) {
+        portENTER_CRITICAL(&config_lock);
+        bool active = running;
+        uint8_t fields = sample_fields;
+        uint8_t limit = batch_limit;
+        uint32_t current_generation = config_generation;
+        portEXIT_CRITICAL(&config_lock);
+
+        if (!active) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (current_generation != generation) {
+            // New subscription: drop a half-built batch in the old format
+            generation = current_generation;
+            packet_len = 0;
+            packet_samples = 0;
+        }
+
+        uint16_t sample_size = telemetry_sample_size(fields);
+        uint16_t payload_max = ble_get_mtu() - 3;
+        if (payload_max > sizeof(packet)) {
+            payload_max = sizeof(packet);
+        }
+        uint8_t fit = payload_max >= TELEMETRY_HEADER_LEN + sample_size ?
+                      (payload_max - TELEMETRY_HEADER_LEN) / sample_size : 0;
+        if (fit == 0) {
+            ESP_LOGE(TAG, "Sample (%d bytes) does not fit MTU %d, stopping", sample_size, ble_get_mtu());
+            telemetry_stop();
+            continue;
+        }
+        uint8_t batch = limit != 0 && limit < fit ? limit : fit;
+
+        sts_feedback_t feedback[ARM_NUM_JOINTS] = {0};   // Joints that did not answer go out as zeros
+        uint8_t valid_mask = 0;
+        int64_t now_us = esp_timer_get_time();
+        if (fields & STS_FB_ALL) {
+            sts_servo_sync_read(fields & STS_FB_ALL, feedback, &valid_mask, 0);
+        }
+
+        if (packet_samples == 0) {
+            packet[0] = NOTIFY_TAG_TELEMETRY;
+            packet[1] = fields;
+            packet[3] = sequence;
+            packet_len = TELEMETRY_HEADER_LEN;
+        }
+        packet_len += encode_sample(&packet[packet_len], fields, (uint32_t)(now_us / 1000),
+                                    valid_mask, feedback);
+        packet_samples++;
+
+        if (packet_samples >= batch) {
+            packet[2] = packet_samples;
+            ble_notify(packet, packet_len);
+            sequence++;
+            packet_samples = 0;
+        }
+
+        // Paced by the timer rather than the tick, which cannot divide
+        // 1 s into most rates at CONFIG_FREERTOS_HZ=100
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+/**
+ * Initialize the telemetry sampler (idle until subscribed)
+ */
+esp_err_t telemetry_init(void) {
+    BaseType_t ret = xTaskCreate(telemetry_task, "telemetry", TELEMETRY_TASK_STACK,
+                                 NULL, TELEMETRY_TASK_PRIORITY, &sampler_task_handle);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        return ESP_FAIL;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = telemetry_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "telemetry",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &sample_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Telemetry initialized");
+    return ESP_OK;
+}
+
+/**
+ * Start or change the telemetry subscription
+ */
+esp_err_t telemetry_start(uint8_t rate_hz, uint8_t fields, uint8_t samples_per_notify) {
+    fields &= TELEMETRY_FIELDS_ALL;
+    if (rate_hz < TELEMETRY_MIN_HZ || rate_hz > TELEMETRY_MAX_HZ || fields == 0) {
+        ESP_LOGE(TAG, "Invalid subscription: %d Hz, fields 0x%02X", rate_hz, fields);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (samples_per_notify == 0) {
+        // Auto: batch as much as latency allows; the MTU may cap it further
+        samples_per_notify = rate_hz / TELEMETRY_AUTO_NOTIFY_HZ;
+        if (samples_per_notify == 0) {
+            samples_per_notify = 1;
+        }
+    }
+
+    portENTER_CRITICAL(&config_lock);
+    sample_fields = fields;
+    batch_limit = samples_per_notify;
+    config_generation++;
+    running = true;
+    portEXIT_CRITICAL(&config_lock);
+
+    // First sample right away, then one per period
+    esp_timer_stop(sample_timer);
+    esp_err_t err = esp_timer_start_periodic(sample_timer, 1000000 / rate_hz);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start timer: %s", esp_err_to_name(err));
+        telemetry_stop();
+        return err;
+    }
+    xTaskNotifyGive(sampler_task_handle);
+    ESP_LOGI(TAG, "Streaming %d Hz, fields 0x%02X, up to %d samples/notification",
+             rate_hz, fields, samples_per_notify);
+    return ESP_OK;
+}
+
+/**
+ * Stop streaming
+ */
+void telemetry_stop(void) {
+    portENTER_CRITICAL(&config_lock);
+    bool was_running = running;
+    running = false;
+    portEXIT_CRITICAL(&config_lock);
+
+    esp_timer_stop(sample_timer);
+    if (was_running) {
+        ESP_LOGI(TAG, "Telemetry stopped");
+    }
+}
+
+/**
+ * Check whether telemetry is streaming
+ */
+bool telemetry_is_running(void) {
+    portENTER_CRITICAL(&config_lock);
+    bool active = running;
+    portEXIT_CRITICAL(&config_lock);
+    return active;
+}
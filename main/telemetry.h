@@ -0,0 +1,34 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "sts_servo.h"
+
+// Streamed telemetry: a sampler task reads the selected feedback fields of
+// all joints at a fixed rate and batches several timestamped samples into
+// each TX notification, up to the negotiated MTU.
+//
+// Notification layout (little-endian):
+//   [0] NOTIFY_TAG_TELEMETRY  [1] fields (STS_FB_*)  [2] sample count  [3] sequence
+//   then per sample: uint32 timestamp_ms, uint8 valid_mask,
+//   with TELEMETRY_FIELD_QUEUE: uint8 queue depth, uint8 free queue slots,
+//   then for each joint the selected fields in bit order:
+//   position u16, speed i16, load i16, voltage u8, temperature u8, moving u8,
+//   error u8
+
+#define TELEMETRY_MIN_HZ          10
+#define TELEMETRY_MAX_HZ          100
+#define TELEMETRY_AUTO_NOTIFY_HZ  20      // Auto batching keeps at least this many notifications/s
+#define TELEMETRY_HEADER_LEN      4
+#define TELEMETRY_FIELD_QUEUE     (1 << 7)    // Motion queue level, not a servo field (motion_queue.h)
+#define TELEMETRY_FIELDS_ALL      (STS_FB_ALL | TELEMETRY_FIELD_QUEUE)
+#define TELEMETRY_TASK_STACK      4096
+#define TELEMETRY_TASK_PRIORITY   8
+
+// Function prototypes
+esp_err_t telemetry_init(void);
+esp_err_t telemetry_start(uint8_t rate_hz, uint8_t fields, uint8_t samples_per_notify);
+void telemetry_stop(void);
+bool telemetry_is_running(void);
+uint16_t telemetry_sample_size(uint8_t fields);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,816 @@
+#include "traj_store.h"
+#include "waypoint_codec.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "TRAJ_STORE";
+
+#define TRAJ_HEADER_LEN           sizeof(traj_record_header_t)
+#define TRAJ_CRC_FIELDS_OFFSET    offsetof(traj_record_header_t, seq)
+#define TRAJ_CRC_FIELDS_LEN       (offsetof(traj_record_header_t, crc32) - TRAJ_CRC_FIELDS_OFFSET)
+#define TRAJ_COMMIT_OFFSET        offsetof(traj_record_header_t, num_points)
+#define TRAJ_UNSET                0xFFFFFFFF
+#define TRAJ_MAX_POINT_LEN        (1 + ARM_NUM_JOINTS * 3 + 2 * 3)
+
+// RAM index of live programs
+typedef struct {
+    bool used;
+    bool deleted;              // Deleted while open; sectors stay reserved until closed
+    uint8_t open_count;
+    uint8_t kind;              // TRAJ_STORE_KIND_*
+    uint32_t hash;
+    uint32_t offset;
+    uint32_t num_points;
+    uint32_t data_len;
+    uint32_t seq;
+    char name[TRAJ_STORE_NAME_LEN];
+} traj_index_entry_t;
+
+static const esp_partition_t *partition = NULL;
+static const uint8_t *flash_base = NULL;        // Whole partition, memory-mapped
+static esp_partition_mmap_handle_t mmap_handle;
+static uint32_t num_sectors = 0;
+
+static SemaphoreHandle_t store_mutex = NULL;
+static traj_index_entry_t programs[TRAJ_STORE_MAX_PROGRAMS];
+static uint32_t next_seq = 1;
+static traj_store_writer_t *active_writer = NULL;
+
+/**
+ * FNV-1a hash of a program name, checked before the string compare
+ */
+static uint32_t name_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < TRAJ_STORE_NAME_LEN && name[i] != '\0'; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * Index slot of a live program of the given kind, -1 if none (caller holds store_mutex)
+ */
+static int find_program(const char *name, uint8_t kind) {
+    uint32_t hash = name_hash(name);
+    for (int i = 0; i < TRAJ_STORE_MAX_PROGRAMS; i++) {
+        if (programs[i].used && !programs[i].deleted && programs[i].hash == hash && programs[i].kind == kind &&
+            strncmp(programs[i].name, name, TRAJ_STORE_NAME_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Sectors a record of `data_len` bytes occupies
+ */
+static uint32_t record_sectors(uint32_t data_len) {
+    return (TRAJ_HEADER_LEN + data_len + TRAJ_STORE_SECTOR_SIZE - 1) / TRAJ_STORE_SECTOR_SIZE;
+}
+
+/**
+ * Clear the live bit of a record in flash
+ */
+static esp_err_t mark_deleted(uint32_t offset) {
+    uint8_t flags = flash_base[offset + offsetof(traj_record_header_t, flags)] & ~TRAJ_REC_FLAG_LIVE;
+    return esp_partition_write(partition, offset + offsetof(traj_record_header_t, flags), &flags, 1);
+}
+
+/**
+ * Encode a point against the previous one, returns bytes written
+ */
+static uint8_t encode_point(uint8_t *out, const traj_store_point_t *prev,
+                            const traj_store_point_t *point, bool key) {
+    uint8_t n = 1;
+    uint8_t ctrl = 0;
+
+    if (key) {
+        ctrl = TRAJ_PT_KEY | TRAJ_PT_TIMING;
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            out[n++] = point->position[j] & 0xFF;
+            out[n++] = point->position[j] >> 8;
+        }
+    } else {
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            int32_t delta = (int32_t)point->position[j] - prev->position[j];
+            if (delta != 0) {
+                ctrl |= 1 << j;
+                n += waypoint_put_varint(&out[n], ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            }
+        }
+        if (point->duration_ms != prev->duration_ms || point->dwell_ms != prev->dwell_ms) {
+            ctrl |= TRAJ_PT_TIMING;
+        }
+    }
+
+    if (ctrl & TRAJ_PT_TIMING) {
+        n += waypoint_put_varint(&out[n], point->duration_ms);
+        n += waypoint_put_varint(&out[n], point->dwell_ms);
+    }
+    out[0] = ctrl;
+    return n;
+}
+
+/**
+ * Decode the next point in place over the previous one
+ */
+static bool decode_point(const uint8_t *data, size_t len, size_t *pos, traj_store_point_t *point) {
+    if (*pos >= len) {
+        return false;
+    }
+    uint8_t ctrl = data[(*pos)++];
+
+    if (ctrl & TRAJ_PT_KEY) {
+        if (*pos + 2 * ARM_NUM_JOINTS > len) {
+            return false;
+        }
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            point->position[j] = data[*pos] | (data[*pos + 1] << 8);
+            *pos += 2;
+            if (point->position[j] > STS_POSITION_MAX) {
+                return false;
+            }
+        }
+    } else {
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            if (ctrl & (1 << j)) {
+                uint32_t zz;
+                if (!waypoint_get_varint(data, len, pos, &zz)) {
+                    return false;
+                }
+                int32_t value = point->position[j] + ((int32_t)(zz >> 1) ^ -(int32_t)(zz & 1));
+                if (value < STS_POSITION_MIN || value > STS_POSITION_MAX) {
+                    return false;
+                }
+                point->position[j] = value;
+            }
+        }
+    }
+
+    if (ctrl & TRAJ_PT_TIMING) {
+        uint32_t duration, dwell;
+        if (!waypoint_get_varint(data, len, pos, &duration) || !waypoint_get_varint(data, len, pos, &dwell)) {
+            return false;
+        }
+        point->duration_ms = duration;
+        point->dwell_ms = dwell;
+    }
+    return true;
+}
+
+/**
+ * Check a committed record's CRC against mapped flash
+ */
+static bool record_valid(uint32_t offset, const traj_record_header_t *hdr) {
+    uint32_t crc = esp_rom_crc32_le(0, flash_base + offset + TRAJ_HEADER_LEN, hdr->data_len);
+    crc = esp_rom_crc32_le(crc, (const uint8_t *)hdr + TRAJ_CRC_FIELDS_OFFSET, TRAJ_CRC_FIELDS_LEN);
+    return crc == hdr->crc32;
+}
+
+/**
+ * Index slot a new record of a name can take: the replaced program's own slot
+ * when nobody has it open, otherwise a free one; -1 when the index is full
+ * (caller holds store_mutex)
+ */
+static int index_slot(int existing) {
+    if (existing >= 0 && programs[existing].open_count == 0) {
+        return existing;
+    }
+    for (int i = 0; i < TRAJ_STORE_MAX_PROGRAMS; i++) {
+        if (!programs[i].used) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Publish a record in `slot`, then retire the program it replaces (caller holds store_mutex)
+ */
+static void index_put(int slot, int existing, uint32_t offset, const traj_record_header_t *hdr) {
+    uint32_t old_offset = existing >= 0 ? programs[existing].offset : 0;
+    if (existing >= 0 && slot != existing) {
+        programs[existing].deleted = true;  // Still open; dropped on the last close
+    }
+
+    traj_index_entry_t *entry = &programs[slot];
+    memset(entry, 0, sizeof(*entry));
+    entry->used = true;
+    entry->kind = hdr->block_points == 0 ? TRAJ_STORE_KIND_SCRIPT : TRAJ_STORE_KIND_PATH;
+    entry->offset = offset;
+    entry->num_points = hdr->num_points;
+    entry->data_len = hdr->data_len;
+    entry->seq = hdr->seq;
+    memcpy(entry->name, hdr->name, sizeof(entry->name));
+    entry->name[TRAJ_STORE_NAME_LEN - 1] = '\0';
+    entry->hash = name_hash(entry->name);
+
+    if (existing >= 0) {
+        mark_deleted(old_offset);
+    }
+}
+
+/**
+ * Add a program to the index, resolving name clashes by write order (caller holds store_mutex)
+ */
+static esp_err_t index_add(uint32_t offset, const traj_record_header_t *hdr) {
+    char name[TRAJ_STORE_NAME_LEN];
+    memcpy(name, hdr->name, sizeof(name));
+    name[TRAJ_STORE_NAME_LEN - 1] = '\0';
+    uint8_t kind = hdr->block_points == 0 ? TRAJ_STORE_KIND_SCRIPT : TRAJ_STORE_KIND_PATH;
+
+    int existing = find_program(name, kind);
+    if (existing >= 0 && programs[existing].seq > hdr->seq) {
+        mark_deleted(offset);
+        return ESP_OK;
+    }
+
+    int slot = index_slot(existing);
+    if (slot < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+    index_put(slot, existing, offset, hdr);
+    return ESP_OK;
+}
+
+/**
+ * Mark the sectors held by indexed programs and the open writer (caller holds store_mutex)
+ */
+static void used_sectors(uint8_t used[TRAJ_STORE_MAX_SECTORS / 8]) {
+    memset(used, 0, TRAJ_STORE_MAX_SECTORS / 8);
+    for (int i = 0; i < TRAJ_STORE_MAX_PROGRAMS; i++) {
+        if (!programs[i].used) {
+            continue;
+        }
+        uint32_t first = programs[i].offset / TRAJ_STORE_SECTOR_SIZE;
+        uint32_t count = record_sectors(programs[i].data_len);
+        for (uint32_t s = first; s < first + count && s < num_sectors; s++) {
+            used[s / 8] |= 1 << (s % 8);
+        }
+    }
+    if (active_writer != NULL) {
+        for (uint32_t s = active_writer->header_offset / TRAJ_STORE_SECTOR_SIZE;
+             s < active_writer->limit / TRAJ_STORE_SECTOR_SIZE; s++) {
+            used[s / 8] |= 1 << (s % 8);
+        }
+    }
+}
+
+/**
+ * Map the partition and index every committed program
+ */
+esp_err_t traj_store_init(void) {
+    const esp_partition_t *found = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                            TRAJ_STORE_PARTITION_SUBTYPE,
+                                                            TRAJ_STORE_PARTITION_LABEL);
+    if (found == NULL) {
+        ESP_LOGE(TAG, "No '%s' partition in the partition table", TRAJ_STORE_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t ret = esp_partition_mmap(found, 0, found->size, ESP_PARTITION_MMAP_DATA,
+                                       (const void **)&flash_base, &mmap_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map partition: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    num_sectors = found->size / TRAJ_STORE_SECTOR_SIZE;
+    if (num_sectors > TRAJ_STORE_MAX_SECTORS) {
+        num_sectors = TRAJ_STORE_MAX_SECTORS;
+    }
+
+    store_mutex = xSemaphoreCreateMutex();
+    if (store_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        esp_partition_munmap(mmap_handle);
+        return ESP_FAIL;
+    }
+    partition = found;
+
+    // Records start on sector boundaries; anything else is free space
+    memset(programs, 0, sizeof(programs));
+    for (uint32_t s = 0; s < num_sectors; ) {
+        uint32_t offset = s * TRAJ_STORE_SECTOR_SIZE;
+        traj_record_header_t hdr;
+        memcpy(&hdr, flash_base + offset, sizeof(hdr));
+
+        bool committed = hdr.magic == TRAJ_STORE_MAGIC && hdr.version == TRAJ_STORE_VERSION &&
+                         hdr.data_len != TRAJ_UNSET && hdr.num_points != TRAJ_UNSET &&
+                         (hdr.block_points == TRAJ_STORE_BLOCK_POINTS || hdr.block_points == 0) &&
+                         offset + TRAJ_HEADER_LEN + hdr.data_len <= partition->size;
+        if (!committed || !record_valid(offset, &hdr)) {
+            s++;
+            continue;
+        }
+
+        if (hdr.seq >= next_seq) {
+            next_seq = hdr.seq + 1;
+        }
+        if (hdr.flags & TRAJ_REC_FLAG_LIVE) {
+            if (index_add(offset, &hdr) != ESP_OK) {
+                ESP_LOGW(TAG, "Index full, ignoring program at 0x%" PRIx32, offset);
+            }
+        }
+        s += record_sectors(hdr.data_len);
+    }
+
+    ESP_LOGI(TAG, "Trajectory store mounted: %d programs, %" PRIu32 " KB free",
+             traj_store_count(), traj_store_free_bytes() / 1024);
+    return ESP_OK;
+}
+
+/**
+ * Make sure [writer->pos, writer->pos + len) is erased and inside the span
+ */
+static esp_err_t writer_reserve(traj_store_writer_t *writer, uint32_t len) {
+    while (writer->erased_to < writer->pos + len) {
+        if (writer->erased_to >= writer->limit) {
+            return ESP_ERR_NO_MEM;
+        }
+        esp_err_t ret = esp_partition_erase_range(partition, writer->erased_to, TRAJ_STORE_SECTOR_SIZE);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        writer->erased_to += TRAJ_STORE_SECTOR_SIZE;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Write out the staging buffer
+ */
+static esp_err_t writer_flush(traj_store_writer_t *writer) {
+    if (writer->stage_len == 0) {
+        return ESP_OK;
+    }
+    esp_err_t ret = writer_reserve(writer, writer->stage_len);
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(partition, writer->pos, writer->stage, writer->stage_len);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    writer->crc = esp_rom_crc32_le(writer->crc, writer->stage, writer->stage_len);
+    writer->pos += writer->stage_len;
+    writer->stage_len = 0;
+    return ESP_OK;
+}
+
+/**
+ * Stage bytes, flushing to flash when the buffer fills
+ */
+static esp_err_t writer_put(traj_store_writer_t *writer, const uint8_t *data, uint16_t len) {
+    if (writer->stage_len + len > TRAJ_STORE_STAGE_LEN) {
+        esp_err_t ret = writer_flush(writer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    memcpy(&writer->stage[writer->stage_len], data, len);
+    writer->stage_len += len;
+    return ESP_OK;
+}
+
+/**
+ * Start a new record in the largest free span; replaces any of the same name and kind on commit
+ */
+static esp_err_t store_begin(traj_store_writer_t *writer, const char *name, uint8_t kind) {
+    size_t name_len = strnlen(name, TRAJ_STORE_NAME_LEN);
+    if (partition == NULL || name_len == 0 || name_len >= TRAJ_STORE_NAME_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    if (active_writer != NULL) {
+        xSemaphoreGive(store_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index_slot(find_program(name, kind)) < 0) {
+        xSemaphoreGive(store_mutex);
+        ESP_LOGE(TAG, "Program index full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t used[TRAJ_STORE_MAX_SECTORS / 8];
+    used_sectors(used);
+    uint32_t best_start = 0, best_len = 0;
+    for (uint32_t s = 0; s < num_sectors; ) {
+        if (used[s / 8] & (1 << (s % 8))) {
+            s++;
+            continue;
+        }
+        uint32_t start = s;
+        while (s < num_sectors && !(used[s / 8] & (1 << (s % 8)))) {
+            s++;
+        }
+        if (s - start > best_len) {
+            best_start = start;
+            best_len = s - start;
+        }
+    }
+    if (best_len == 0) {
+        xSemaphoreGive(store_mutex);
+        ESP_LOGE(TAG, "Trajectory store full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->header_offset = best_start * TRAJ_STORE_SECTOR_SIZE;
+    writer->limit = (best_start + best_len) * TRAJ_STORE_SECTOR_SIZE;
+    writer->erased_to = writer->header_offset;
+    writer->pos = writer->header_offset;
+    writer->seq = next_seq++;
+    writer->kind = kind;
+    memcpy(writer->name, name, name_len);
+    writer->open = true;
+    active_writer = writer;
+    xSemaphoreGive(store_mutex);
+
+    // Header without the commit fields, which stay erased until traj_store_commit
+    traj_record_header_t hdr;
+    memset(&hdr, 0xFF, sizeof(hdr));
+    hdr.magic = TRAJ_STORE_MAGIC;
+    hdr.version = TRAJ_STORE_VERSION;
+    hdr.block_points = kind == TRAJ_STORE_KIND_SCRIPT ? 0 : TRAJ_STORE_BLOCK_POINTS;
+    hdr.seq = writer->seq;
+    memset(hdr.name, 0, sizeof(hdr.name));
+    memcpy(hdr.name, name, name_len);
+
+    esp_err_t ret = writer_reserve(writer, TRAJ_HEADER_LEN);
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(partition, writer->pos, &hdr, TRAJ_COMMIT_OFFSET);
+    }
+    if (ret != ESP_OK) {
+        traj_store_abort(writer);
+        return ret;
+    }
+    writer->pos += TRAJ_HEADER_LEN;
+
+    ESP_LOGI(TAG, "Writing %s '%s' at 0x%" PRIx32 " (%" PRIu32 " KB available)",
+             kind == TRAJ_STORE_KIND_SCRIPT ? "script" : "program", writer->name, writer->header_offset, (writer->limit - writer->header_offset) / 1024);
+    return ESP_OK;
+}
+
+/**
+ * Start a new program; replaces any program of the same name on commit
+ */
+esp_err_t traj_store_begin(traj_store_writer_t *writer, const char *name) {
+    return store_begin(writer, name, TRAJ_STORE_KIND_PATH);
+}
+
+/**
+ * Start a new script; replaces any script of the same name on commit
+ */
+esp_err_t traj_store_begin_script(traj_store_writer_t *writer, const char *name) {
+    return store_begin(writer, name, TRAJ_STORE_KIND_SCRIPT);
+}
+
+/**
+ * Append one point
+ */
+esp_err_t traj_store_append(traj_store_writer_t *writer, const traj_store_point_t *point) {
+    if (!writer->open || writer->kind != TRAJ_STORE_KIND_PATH) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (writer->num_points >= TRAJ_STORE_MAX_POINTS) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        if (point->position[j] > STS_POSITION_MAX) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    uint8_t encoded[TRAJ_MAX_POINT_LEN];
+    bool key = writer->num_points % TRAJ_STORE_BLOCK_POINTS == 0;
+    uint8_t len = encode_point(encoded, &writer->prev, point, key);
+
+    esp_err_t ret = writer_put(writer, encoded, len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    writer->prev = *point;
+    writer->num_points++;
+    return ESP_OK;
+}
+
+/**
+ * Append script bytes
+ */
+esp_err_t traj_store_write(traj_store_writer_t *writer, const uint8_t *data, size_t len) {
+    if (!writer->open || writer->kind != TRAJ_STORE_KIND_SCRIPT) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    while (len > 0) {
+        uint16_t n = len > TRAJ_STORE_STAGE_LEN ? TRAJ_STORE_STAGE_LEN : len;
+        esp_err_t ret = writer_put(writer, data, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Flush and map what has been written so far, for checks before committing
+ */
+esp_err_t traj_store_written(traj_store_writer_t *writer, const uint8_t **data, uint32_t *len) {
+    if (!writer->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = writer_flush(writer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *data = flash_base + writer->header_offset + TRAJ_HEADER_LEN;
+    *len = writer->pos - writer->header_offset - TRAJ_HEADER_LEN;
+    return ESP_OK;
+}
+
+/**
+ * Write the block table and commit fields, then publish the program
+ */
+esp_err_t traj_store_commit(traj_store_writer_t *writer) {
+    if (!writer->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint32_t stream_start = writer->header_offset + TRAJ_HEADER_LEN;
+    bool script = writer->kind == TRAJ_STORE_KIND_SCRIPT;
+    if (script ? writer->pos + writer->stage_len == stream_start : writer->num_points == 0) {
+        traj_store_abort(writer);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t ret = writer_flush(writer);
+
+    // Block table: walk the stream just written through the mapping
+    uint32_t stream_len = writer->pos - stream_start;
+    const uint8_t *stream = flash_base + stream_start;
+    traj_store_point_t point = {0};
+    size_t pos = 0;
+    for (uint32_t i = 0; !script && i < writer->num_points && ret == ESP_OK; i++) {
+        if (i % TRAJ_STORE_BLOCK_POINTS == 0) {
+            uint8_t entry[4] = { pos & 0xFF, (pos >> 8) & 0xFF, (pos >> 16) & 0xFF, pos >> 24 };
+            ret = writer_put(writer, entry, sizeof(entry));
+        }
+        if (ret == ESP_OK && !decode_point(stream, stream_len, &pos, &point)) {
+            ret = ESP_ERR_INVALID_CRC;  // Read-back does not match what was written
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = writer_flush(writer);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write program '%s': %s", writer->name, esp_err_to_name(ret));
+        traj_store_abort(writer);
+        return ret;
+    }
+
+    traj_record_header_t hdr;
+    memcpy(&hdr, flash_base + writer->header_offset, sizeof(hdr));
+    hdr.num_points = writer->num_points;
+    hdr.data_len = writer->pos - stream_start;
+    hdr.crc32 = esp_rom_crc32_le(writer->crc, (const uint8_t *)&hdr + TRAJ_CRC_FIELDS_OFFSET,
+                                 TRAJ_CRC_FIELDS_LEN);
+
+    // Pick the index slot before the record becomes valid on flash, and keep
+    // the mutex so a reader opening the old program cannot take it meanwhile
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    int existing = find_program(writer->name, writer->kind);
+    int slot = index_slot(existing);
+    if (slot < 0) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        ret = esp_partition_write(partition, writer->header_offset + TRAJ_COMMIT_OFFSET,
+                                  (const uint8_t *)&hdr + TRAJ_COMMIT_OFFSET, TRAJ_HEADER_LEN - TRAJ_COMMIT_OFFSET);
+    }
+    if (ret == ESP_OK) {
+        index_put(slot, existing, writer->header_offset, &hdr);
+    }
+    active_writer = NULL;
+    writer->open = false;
+    xSemaphoreGive(store_mutex);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to commit program '%s': %s", writer->name, esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "Stored %s '%s': %" PRIu32 " points, %" PRIu32 " bytes",
+             script ? "script" : "program", writer->name, hdr.num_points, hdr.data_len);
+    return ESP_OK;
+}
+
+/**
+ * Drop an unfinished program; its sectors become free again
+ */
+void traj_store_abort(traj_store_writer_t *writer) {
+    if (!writer->open) {
+        return;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    if (active_writer == writer) {
+        active_writer = NULL;
+    }
+    writer->open = false;
+    xSemaphoreGive(store_mutex);
+}
+
+/**
+ * Open a record of the given kind and hold it until closed
+ */
+static esp_err_t store_open(const char *name, uint8_t kind, traj_store_reader_t *reader) {
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    int index = find_program(name, kind);
+    if (index < 0) {
+        xSemaphoreGive(store_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+    traj_index_entry_t *entry = &programs[index];
+    entry->open_count++;
+
+    // Scripts have no points, so no block table either
+    uint32_t num_blocks = (entry->num_points + TRAJ_STORE_BLOCK_POINTS - 1) / TRAJ_STORE_BLOCK_POINTS;
+    memset(reader, 0, sizeof(*reader));
+    reader->data = flash_base + entry->offset + TRAJ_HEADER_LEN;
+    reader->stream_len = entry->data_len - num_blocks * 4;
+    reader->table = reader->data + reader->stream_len;
+    reader->num_points = entry->num_points;
+    reader->program = index;
+    xSemaphoreGive(store_mutex);
+    return ESP_OK;
+}
+
+/**
+ * Open a program for streaming straight from mapped flash
+ */
+esp_err_t traj_store_open(const char *name, traj_store_reader_t *reader) {
+    return store_open(name, TRAJ_STORE_KIND_PATH, reader);
+}
+
+/**
+ * Open a script; its bytecode is reader->data[0..stream_len) in mapped flash
+ */
+esp_err_t traj_store_open_script(const char *name, traj_store_reader_t *reader) {
+    return store_open(name, TRAJ_STORE_KIND_SCRIPT, reader);
+}
+
+/**
+ * Decode the next point; false at the end of the program
+ */
+bool traj_store_read(traj_store_reader_t *reader, traj_store_point_t *point) {
+    if (reader->program < 0 || reader->index >= reader->num_points) {
+        return false;
+    }
+    if (!decode_point(reader->data, reader->stream_len, &reader->pos, &reader->prev)) {
+        return false;
+    }
+    reader->index++;
+    *point = reader->prev;
+    return true;
+}
+
+/**
+ * Position the reader so the next read returns point `index`
+ */
+esp_err_t traj_store_seek(traj_store_reader_t *reader, uint32_t index) {
+    if (reader->program < 0 || index > reader->num_points) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t block = index / TRAJ_STORE_BLOCK_POINTS;
+    if (index < reader->num_points) {
+        const uint8_t *entry = reader->table + block * 4;
+        reader->pos = entry[0] | (entry[1] << 8) | (entry[2] << 16) | ((uint32_t)entry[3] << 24);
+    } else {
+        reader->pos = reader->stream_len;
+    }
+    reader->index = block * TRAJ_STORE_BLOCK_POINTS;
+
+    traj_store_point_t skipped;
+    while (reader->index < index) {
+        if (!traj_store_read(reader, &skipped)) {
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+    reader->index = index;
+    return ESP_OK;
+}
+
+/**
+ * Release a reader; a program deleted while open is dropped here
+ */
+void traj_store_close(traj_store_reader_t *reader) {
+    if (reader->program < 0) {
+        return;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    traj_index_entry_t *entry = &programs[reader->program];
+    if (entry->open_count > 0 && --entry->open_count == 0 && entry->deleted) {
+        entry->used = false;
+    }
+    xSemaphoreGive(store_mutex);
+    reader->program = -1;
+}
+
+/**
+ * Delete a program or script; readers that have it open keep working until closed
+ */
+esp_err_t traj_store_delete(const char *name, uint8_t kind) {
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    int index = find_program(name, kind);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (index >= 0) {
+        traj_index_entry_t *entry = &programs[index];
+        ret = mark_deleted(entry->offset);
+        if (ret == ESP_OK) {
+            if (entry->open_count > 0) {
+                entry->deleted = true;
+            } else {
+                entry->used = false;
+            }
+        }
+    }
+    xSemaphoreGive(store_mutex);
+
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Deleted program '%s'", name);
+    }
+    return ret;
+}
+
+/**
+ * Number of programs in the index
+ */
+int traj_store_count(void) {
+    int count = 0;
+    for (int i = 0; i < TRAJ_STORE_MAX_PROGRAMS; i++) {
+        if (programs[i].used && !programs[i].deleted) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Summary of the n-th program in index order
+ */
+esp_err_t traj_store_get_info(int index, traj_store_info_t *info) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    for (int i = 0; i < TRAJ_STORE_MAX_PROGRAMS; i++) {
+        if (!programs[i].used || programs[i].deleted) {
+            continue;
+        }
+        if (index-- == 0) {
+            memcpy(info->name, programs[i].name, sizeof(info->name));
+            info->kind = programs[i].kind;
+            info->num_points = programs[i].num_points;
+            info->data_len = programs[i].data_len;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    xSemaphoreGive(store_mutex);
+    return ret;
+}
+
+/**
+ * Bytes in sectors not held by any program
+ */
+uint32_t traj_store_free_bytes(void) {
+    if (partition == NULL) {
+        return 0;
+    }
+
+    uint8_t used[TRAJ_STORE_MAX_SECTORS / 8];
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    used_sectors(used);
+    xSemaphoreGive(store_mutex);
+
+    uint32_t free_sectors = 0;
+    for (uint32_t s = 0; s < num_sectors; s++) {
+        if (!(used[s / 8] & (1 << (s % 8)))) {
+            free_sectors++;
+        }
+    }
+    return free_sectors * TRAJ_STORE_SECTOR_SIZE;
+}
@@ -0,0 +1,133 @@
+#ifndef TRAJ_STORE_H
+#define TRAJ_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sts_servo.h"
+
+// Named motion programs of up to thousands of points on a raw data partition.
+//
+// The partition is memory-mapped once at init. Programs are appended as
+// records that start on a sector boundary:
+//
+//   header (traj_record_header_t, 40 bytes)
+//   point stream, TRAJ_STORE_BLOCK_POINTS points per block
+//   block table: uint32 offset of each block from the start of the stream
+//
+// The first point of every block is a keyframe with absolute values, so a
+// reader can seek to any block without decoding from the start. Other points
+// carry only what changed since the previous point:
+//
+//   ctrl u8: bit0-5 joint j changed, bit6 timing follows, bit7 keyframe
+//   keyframe: 6 x u16 position, varint duration_ms, varint dwell_ms
+//   delta:    zigzag varint per changed joint, then timing if bit6
+//
+// Scripts (sequence bytecode, see seq_vm.h) are stored the same way with
+// block_points = 0. Their data is the bytecode as is, with no block table.
+// Paths and scripts have separate names.
+//
+// The header's length, point count and CRC are left erased (0xFF) while a
+// record is written and programmed last, so a record interrupted by a reset
+// is never indexed. Deleting clears the live bit in place. Sectors of deleted
+// or unfinished records are erased and reused by later writes.
+
+#define TRAJ_STORE_PARTITION_LABEL   "traj"
+#define TRAJ_STORE_PARTITION_SUBTYPE 0x40
+#define TRAJ_STORE_MAGIC             0x4A525442   // "BTRJ"
+#define TRAJ_STORE_VERSION           1
+#define TRAJ_STORE_SECTOR_SIZE       4096
+#define TRAJ_STORE_MAX_SECTORS       1024         // 4 MB partition at most
+#define TRAJ_STORE_MAX_PROGRAMS      64
+#define TRAJ_STORE_NAME_LEN          16           // Including the terminator
+#define TRAJ_STORE_BLOCK_POINTS      32
+#define TRAJ_STORE_MAX_POINTS        65535
+#define TRAJ_STORE_STAGE_LEN         256          // Writer buffer, one flash write each
+
+#define TRAJ_REC_FLAG_LIVE           0x01         // Cleared when deleted
+
+// Record kinds
+#define TRAJ_STORE_KIND_PATH         0            // Point stream
+#define TRAJ_STORE_KIND_SCRIPT       1            // Sequence bytecode
+
+#define TRAJ_PT_TIMING               0x40
+#define TRAJ_PT_KEY                  0x80
+
+// One program point: joint targets plus travel and hold time
+typedef struct {
+    uint16_t position[ARM_NUM_JOINTS];
+    uint16_t duration_ms;      // Travel time from the previous point
+    uint16_t dwell_ms;         // Hold after arriving
+} traj_store_point_t;
+
+// On-flash record header
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;             // TRAJ_REC_FLAG_*, erased = live
+    uint16_t block_points;     // 0 for scripts
+    uint32_t seq;              // Write counter; the newest record wins a name clash
+    char name[TRAJ_STORE_NAME_LEN];
+    uint32_t num_points;       // 0xFFFFFFFF until committed
+    uint32_t data_len;         // Stream plus block table, 0xFFFFFFFF until committed
+    uint32_t crc32;            // Over seq..data_len and the data
+} traj_record_header_t;
+
+// Program summary from the index
+typedef struct {
+    char name[TRAJ_STORE_NAME_LEN];
+    uint8_t kind;              // TRAJ_STORE_KIND_*
+    uint32_t num_points;
+    uint32_t data_len;
+} traj_store_info_t;
+
+// Streaming decoder over mapped flash; holds the program open until closed
+typedef struct {
+    const uint8_t *data;       // Start of the point stream (or script) in mapped flash
+    const uint8_t *table;      // Block table in mapped flash
+    uint32_t stream_len;       // Scripts: bytecode length
+    size_t pos;
+    uint32_t index;            // Next point to decode
+    uint32_t num_points;
+    int8_t program;            // Index slot, -1 when closed
+    traj_store_point_t prev;
+} traj_store_reader_t;
+
+// Appends one program; only one writer may be open at a time
+typedef struct {
+    uint32_t header_offset;    // Partition offset of the record
+    uint32_t pos;              // Next write offset
+    uint32_t limit;            // End of the free span being filled
+    uint32_t erased_to;        // Sectors below this are erased and ours
+    uint32_t num_points;
+    uint32_t crc;
+    uint32_t seq;
+    uint8_t kind;
+    char name[TRAJ_STORE_NAME_LEN];
+    traj_store_point_t prev;
+    uint16_t stage_len;
+    uint8_t stage[TRAJ_STORE_STAGE_LEN];
+    bool open;
+} traj_store_writer_t;
+
+// Function prototypes
+esp_err_t traj_store_init(void);
+esp_err_t traj_store_begin(traj_store_writer_t *writer, const char *name);
+esp_err_t traj_store_begin_script(traj_store_writer_t *writer, const char *name);
+esp_err_t traj_store_append(traj_store_writer_t *writer, const traj_store_point_t *point);
+esp_err_t traj_store_write(traj_store_writer_t *writer, const uint8_t *data, size_t len);
+esp_err_t traj_store_written(traj_store_writer_t *writer, const uint8_t **data, uint32_t *len);
+esp_err_t traj_store_commit(traj_store_writer_t *writer);
+void traj_store_abort(traj_store_writer_t *writer);
+esp_err_t traj_store_open(const char *name, traj_store_reader_t *reader);
+esp_err_t traj_store_open_script(const char *name, traj_store_reader_t *reader);
+bool traj_store_read(traj_store_reader_t *reader, traj_store_point_t *point);
+esp_err_t traj_store_seek(traj_store_reader_t *reader, uint32_t index);
+void traj_store_close(traj_store_reader_t *reader);
+esp_err_t traj_store_delete(const char *name, uint8_t kind);
+int traj_store_count(void);
+esp_err_t traj_store_get_info(int index, traj_store_info_t *info);
+uint32_t traj_store_free_bytes(void);
+
+#endif // TRAJ_STORE_H
@@ -0,0 +1,346 @@
+#include "trajectory.h"
+#include <math.h>
+#include <string.h>
+
+#define TRAJ_LIMIT_PASSES         4
+#define TRAJ_PEAK_SAMPLES         16
+
+/**
+ * Fill a config with the default profile and limits
+ */
+void traj_config_default(traj_config_t *config) {
+    config->profile = TRAJ_PROFILE_QUINTIC;
+    config->vmax = TRAJ_DEFAULT_VMAX;
+    config->amax = TRAJ_DEFAULT_AMAX;
+    config->blend = 1.0f;
+}
+
+/**
+ * Shortest rest-to-rest time over a distance within the velocity/acceleration limits
+ */
+float traj_min_duration(const traj_config_t *config, float distance) {
+    float d = fabsf(distance);
+    if (d <= 0.0f) {
+        return 0.0f;
+    }
+
+    switch (config->profile) {
+        case TRAJ_PROFILE_CUBIC:
+            // Peak velocity 1.5 d/T, peak acceleration 6 d/T^2
+            return fmaxf(1.5f * d / config->vmax, sqrtf(6.0f * d / config->amax));
+        case TRAJ_PROFILE_QUINTIC:
+            // Peak velocity 1.875 d/T, peak acceleration 5.774 d/T^2
+            return fmaxf(1.875f * d / config->vmax, sqrtf(5.774f * d / config->amax));
+        case TRAJ_PROFILE_TRAPEZOID:
+        default:
+            if (d <= config->vmax * config->vmax / config->amax) {
+                return 2.0f * sqrtf(d / config->amax);  // Triangular, never reaches vmax
+            }
+            return d / config->vmax + config->vmax / config->amax;
+    }
+}
+
+/**
+ * Evaluate one joint of a segment at local time t
+ */
+static void segment_eval(const traj_config_t *config, const traj_segment_t *seg, int joint,
+                         float t, float *q, float *v) {
+    const float *c = seg->c[joint];
+
+    if (t < 0.0f) {
+        t = 0.0f;
+    } else if (t > seg->duration) {
+        t = seg->duration;
+    }
+
+    if (config->profile == TRAJ_PROFILE_TRAPEZOID) {
+        float T = seg->duration;
+        float ta = seg->accel_time;
+        if (T <= 0.0f || ta <= 0.0f) {
+            *q = c[0] + c[1];
+            *v = 0.0f;
+            return;
+        }
+        float vc = c[1] / (T - ta);
+        float a = vc / ta;
+        if (t < ta) {
+            *q = c[0] + 0.5f * a * t * t;
+            *v = a * t;
+        } else if (t < T - ta) {
+            *q = c[0] + 0.5f * a * ta * ta + vc * (t - ta);
+            *v = vc;
+        } else {
+            float tr = T - t;
+            *q = c[0] + c[1] - 0.5f * a * tr * tr;
+            *v = a * tr;
+        }
+        return;
+    }
+
+    *q = c[0] + t * (c[1] + t * (c[2] + t * (c[3] + t * (c[4] + t * c[5]))));
+    *v = c[1] + t * (2.0f * c[2] + t * (3.0f * c[3] + t * (4.0f * c[4] + t * 5.0f * c[5])));
+}
+
+/**
+ * Fill a motion segment between two points with boundary velocities
+ */
+static void segment_fill(const traj_config_t *config, traj_segment_t *seg, float T,
+                         const float *q0, const float *q1, const float *v0, const float *v1) {
+    seg->duration = T;
+    seg->accel_time = 0.0f;
+    memset(seg->c, 0, sizeof(seg->c));
+
+    float d_max = 0.0f;
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        float h = q1[j] - q0[j];
+        float *c = seg->c[j];
+        c[0] = q0[j];
+        if (fabsf(h) > d_max) {
+            d_max = fabsf(h);
+        }
+        if (T <= 0.0f) {
+            continue;
+        }
+
+        switch (config->profile) {
+            case TRAJ_PROFILE_CUBIC:
+                c[1] = v0[j];
+                c[2] = (3.0f * h - (2.0f * v0[j] + v1[j]) * T) / (T * T);
+                c[3] = (-2.0f * h + (v0[j] + v1[j]) * T) / (T * T * T);
+                break;
+            case TRAJ_PROFILE_QUINTIC: {
+                // Zero acceleration at both ends
+                float T2 = T * T;
+                float T3 = T2 * T;
+                c[1] = v0[j];
+                c[3] = (20.0f * h - (8.0f * v1[j] + 12.0f * v0[j]) * T) / (2.0f * T3);
+                c[4] = (-30.0f * h + (14.0f * v1[j] + 16.0f * v0[j]) * T) / (2.0f * T3 * T);
+                c[5] = (12.0f * h - 6.0f * (v1[j] + v0[j]) * T) / (2.0f * T3 * T2);
+                break;
+            }
+            case TRAJ_PROFILE_TRAPEZOID:
+            default:
+                c[1] = h;
+                break;
+        }
+    }
+
+    if (config->profile == TRAJ_PROFILE_TRAPEZOID && T > 0.0f) {
+        // Shared ramp time: the furthest joint uses amax, the others scale down with it
+        float disc = T * T - 4.0f * d_max / config->amax;
+        seg->accel_time = d_max > 0.0f ? 0.5f * (T - sqrtf(fmaxf(disc, 0.0f))) : 0.5f * T;
+    }
+}
+
+/**
+ * Largest ratio of peak velocity/acceleration to the limits over a segment (<= 1 is within limits)
+ */
+static float segment_limit_ratio(const traj_config_t *config, const traj_segment_t *seg) {
+    if (seg->duration <= 0.0f || config->profile == TRAJ_PROFILE_TRAPEZOID) {
+        return 0.0f;  // Trapezoid segments are limit-correct by construction
+    }
+
+    float ratio = 0.0f;
+    float dt = seg->duration / TRAJ_PEAK_SAMPLES;
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        const float *c = seg->c[j];
+        for (int k = 0; k <= TRAJ_PEAK_SAMPLES; k++) {
+            float t = k * dt;
+            float q, v;
+            segment_eval(config, seg, j, t, &q, &v);
+            // Exact, not differenced: a cubic peaks at the ends, where a difference reads low
+            float a = 2.0f * c[2] + t * (6.0f * c[3] + t * (12.0f * c[4] + t * 20.0f * c[5]));
+            ratio = fmaxf(ratio, fabsf(v) / config->vmax);
+            // Time stretch scales acceleration by the square of the factor
+            ratio = fmaxf(ratio, sqrtf(fabsf(a) / config->amax));
+        }
+    }
+    return ratio;
+}
+
+/**
+ * Plan a trajectory from start through the given waypoints, starting and ending at rest
+ */
+bool traj_plan(traj_plan_t *plan, const traj_config_t *config, const float start[TRAJ_NUM_JOINTS],
+               const traj_waypoint_t *waypoints, uint8_t count) {
+    return traj_plan_window(plan, config, start, NULL, waypoints, count, NULL);
+}
+
+/**
+ * Plan one window of a longer path
+ *
+ * `start_vel` (NULL = rest) is the velocity the previous window ended with.
+ * `lookahead` (NULL = stop at the end) is the waypoint after this window and
+ * only shapes the end velocity; the plan finishes at the last waypoint.
+ */
+bool traj_plan_window(traj_plan_t *plan, const traj_config_t *config, const float start[TRAJ_NUM_JOINTS],
+                      const float start_vel[TRAJ_NUM_JOINTS], const traj_waypoint_t *waypoints,
+                      uint8_t count, const traj_waypoint_t *lookahead) {
+    if (count == 0 || count > TRAJ_MAX_WAYPOINTS || config->profile >= TRAJ_PROFILE_COUNT ||
+        config->vmax <= 0.0f || config->amax <= 0.0f) {
+        return false;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    plan->config = *config;
+    float blend = fminf(fmaxf(config->blend, 0.0f), 1.0f);
+
+    // Boundary velocities only apply to the blending profiles
+    bool blending = config->profile != TRAJ_PROFILE_TRAPEZOID && blend > 0.0f;
+
+    // Segment k runs from point k to point k+1; point 0 is the start
+    float durations[TRAJ_MAX_WAYPOINTS];
+    float vel[TRAJ_MAX_WAYPOINTS + 1][TRAJ_NUM_JOINTS];
+    const float *points[TRAJ_MAX_WAYPOINTS + 1];
+    points[0] = start;
+    for (int k = 0; k < count; k++) {
+        points[k + 1] = waypoints[k].q;
+
+        float d_max = 0.0f;
+        for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+            d_max = fmaxf(d_max, fabsf(points[k + 1][j] - points[k][j]));
+        }
+        // A timed segment inside a blended path need not come to rest, so only
+        // the velocity bound applies up front; the limit passes below stretch
+        // it if its real acceleration is too high
+        float floor_s = blending && waypoints[k].duration_s > 0.0f ? d_max / config->vmax
+                                                                   : traj_min_duration(config, d_max);
+        durations[k] = fmaxf(waypoints[k].duration_s, floor_s);
+    }
+
+    float lookahead_s = 0.0f;
+    if (lookahead != NULL) {
+        float d_max = 0.0f;
+        for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+            d_max = fmaxf(d_max, fabsf(lookahead->q[j] - points[count][j]));
+        }
+        lookahead_s = fmaxf(lookahead->duration_s, lookahead->duration_s > 0.0f ? d_max / config->vmax
+                                                                                : traj_min_duration(config, d_max));
+    }
+
+    traj_segment_t seg;
+    for (int pass = 0; pass < TRAJ_LIMIT_PASSES; pass++) {
+        // Velocity at each waypoint: mean of the adjacent slopes when they agree in sign
+        memset(vel, 0, sizeof(vel));
+        if (blending && start_vel != NULL && durations[0] > 0.0f) {
+            memcpy(vel[0], start_vel, sizeof(vel[0]));
+        }
+        if (blending && lookahead != NULL && waypoints[count - 1].dwell_s <= 0.0f &&
+            durations[count - 1] > 0.0f && lookahead_s > 0.0f) {
+            for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+                float s_in = (points[count][j] - points[count - 1][j]) / durations[count - 1];
+                float s_out = (lookahead->q[j] - points[count][j]) / lookahead_s;
+                if (s_in * s_out > 0.0f) {
+                    vel[count][j] = 0.5f * (s_in + s_out) * blend;
+                }
+            }
+        }
+        if (blending) {
+            for (int k = 1; k < count; k++) {
+                if (waypoints[k - 1].dwell_s > 0.0f || durations[k - 1] <= 0.0f || durations[k] <= 0.0f) {
+                    continue;
+                }
+                for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+                    float s_in = (points[k][j] - points[k - 1][j]) / durations[k - 1];
+                    float s_out = (points[k + 1][j] - points[k][j]) / durations[k];
+                    if (s_in * s_out > 0.0f) {
+                        vel[k][j] = 0.5f * (s_in + s_out) * blend;
+                    }
+                }
+            }
+        }
+
+        // Stretch any segment the boundary velocities pushed past the limits
+        bool stretched = false;
+        for (int k = 0; k < count; k++) {
+            segment_fill(config, &seg, durations[k], points[k], points[k + 1], vel[k], vel[k + 1]);
+            float ratio = segment_limit_ratio(config, &seg);
+            if (ratio > 1.001f) {
+                durations[k] *= ratio;
+                stretched = true;
+            }
+        }
+        if (!stretched) {
+            break;
+        }
+    }
+
+    float t = 0.0f;
+    for (int k = 0; k < count; k++) {
+        if (durations[k] > 0.0f) {
+            traj_segment_t *motion = &plan->segments[plan->num_segments++];
+            segment_fill(config, motion, durations[k], points[k], points[k + 1], vel[k], vel[k + 1]);
+            motion->t_start = t;
+            motion->waypoint = k;
+            t += durations[k];
+        }
+        if (waypoints[k].dwell_s > 0.0f) {
+            traj_segment_t *hold = &plan->segments[plan->num_segments++];
+            segment_fill(config, hold, waypoints[k].dwell_s, points[k + 1], points[k + 1], vel[k + 1], vel[k + 1]);
+            hold->t_start = t;
+            hold->waypoint = k;
+            t += waypoints[k].dwell_s;
+        }
+    }
+
+    if (plan->num_segments == 0) {
+        // Every waypoint equals the start: hold there
+        segment_fill(config, &plan->segments[0], 0.0f, start, start, vel[0], vel[0]);
+        plan->num_segments = 1;
+    }
+
+    plan->total_s = t;
+    memcpy(plan->end_vel, vel[count], sizeof(plan->end_vel));
+    return true;
+}
+
+/**
+ * Evaluate all joints of one segment of the plan at plan time t
+ */
+static bool segment_sample(const traj_plan_t *plan, uint8_t index, float t,
+                           float q[TRAJ_NUM_JOINTS], float v[TRAJ_NUM_JOINTS]) {
+    const traj_segment_t *seg = &plan->segments[index];
+    for (int j = 0; j < TRAJ_NUM_JOINTS; j++) {
+        float vj;
+        segment_eval(&plan->config, seg, j, t - seg->t_start, &q[j], &vj);
+        if (v != NULL) {
+            v[j] = t < plan->total_s ? vj : 0.0f;
+        }
+    }
+    return t < plan->total_s;
+}
+
+/**
+ * Sample positions (and optionally velocities) at time t; returns false once the plan has finished
+ */
+bool traj_sample(traj_plan_t *plan, float t, float q[TRAJ_NUM_JOINTS], float v[TRAJ_NUM_JOINTS]) {
+    if (plan->cursor >= plan->num_segments || t < plan->segments[plan->cursor].t_start) {
+        plan->cursor = 0;
+    }
+    while (plan->cursor + 1 < plan->num_segments && t >= plan->segments[plan->cursor + 1].t_start) {
+        plan->cursor++;
+    }
+    return segment_sample(plan, plan->cursor, t, q, v);
+}
+
+/**
+ * Sample like traj_sample() without moving the cursor, for readers other than the streaming one
+ */
+bool traj_sample_at(const traj_plan_t *plan, float t, float q[TRAJ_NUM_JOINTS], float v[TRAJ_NUM_JOINTS]) {
+    uint8_t seg = 0;
+    while (seg + 1 < plan->num_segments && t >= plan->segments[seg + 1].t_start) {
+        seg++;
+    }
+    return segment_sample(plan, seg, t, q, v);
+}
+
+/**
+ * Index of the waypoint the plan is heading for (or holding at) at time t
+ */
+uint8_t traj_waypoint_at(const traj_plan_t *plan, float t) {
+    uint8_t seg = 0;
+    while (seg + 1 < plan->num_segments && t >= plan->segments[seg + 1].t_start) {
+        seg++;
+    }
+    return plan->segments[seg].waypoint;
+}
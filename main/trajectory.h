@@ -0,0 +1,78 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Multi-joint trajectory generator. Plain C with no ESP-IDF dependencies so
+// it builds on the host as well.
+//
+// A plan is a chain of segments through waypoints. All joints share each
+// segment's duration, so they start and arrive together. Segment durations
+// come from the waypoint or, if that is too short, from the velocity and
+// acceleration limits of the joint that moves furthest. With blending, the
+// cubic and quintic profiles pass through intermediate waypoints without
+// stopping. The trapezoid profile always stops at each waypoint.
+//
+// Paths longer than TRAJ_MAX_WAYPOINTS are planned in windows: each window
+// starts with the previous one's end velocity and looks one waypoint past its
+// end, so consecutive windows join without stopping.
+
+#define TRAJ_NUM_JOINTS           6
+#define TRAJ_MAX_WAYPOINTS        16
+#define TRAJ_MAX_SEGMENTS         (TRAJ_MAX_WAYPOINTS * 2)   // Motion + optional dwell per waypoint
+
+// Default limits in servo steps (4096 per revolution)
+#define TRAJ_DEFAULT_VMAX         2400.0f   // steps/s
+#define TRAJ_DEFAULT_AMAX         6000.0f   // steps/s^2
+
+typedef enum {
+    TRAJ_PROFILE_CUBIC = 0,       // Continuous velocity
+    TRAJ_PROFILE_QUINTIC,         // Continuous velocity, zero acceleration at waypoints
+    TRAJ_PROFILE_TRAPEZOID,       // Constant acceleration / cruise / deceleration
+    TRAJ_PROFILE_COUNT
+} traj_profile_t;
+
+typedef struct {
+    traj_profile_t profile;
+    float vmax;                   // Per-joint velocity limit (steps/s)
+    float amax;                   // Per-joint acceleration limit (steps/s^2)
+    float blend;                  // 0 = stop at every waypoint, 1 = full blending
+} traj_config_t;
+
+typedef struct {
+    float q[TRAJ_NUM_JOINTS];     // Target position (steps)
+    float duration_s;             // Requested travel time, 0 = as fast as limits allow
+    float dwell_s;                // Hold after arriving; forces a stop here
+} traj_waypoint_t;
+
+typedef struct {
+    float t_start;
+    float duration;
+    float accel_time;             // Trapezoid only: shared ramp time
+    uint8_t waypoint;             // Waypoint this segment moves to (or holds at)
+    float c[TRAJ_NUM_JOINTS][6];  // Polynomial coefficients in local time; trapezoid uses c[0]=q0, c[1]=dq
+} traj_segment_t;
+
+typedef struct {
+    traj_config_t config;
+    uint8_t num_segments;
+    uint8_t cursor;               // Segment of the last sample, speeds up sequential sampling
+    float total_s;
+    float end_vel[TRAJ_NUM_JOINTS];   // Velocity at the last waypoint, non-zero only for windowed plans
+    traj_segment_t segments[TRAJ_MAX_SEGMENTS];
+} traj_plan_t;
+
+// Function prototypes
+void traj_config_default(traj_config_t *config);
+bool traj_plan(traj_plan_t *plan, const traj_config_t *config, const float start[TRAJ_NUM_JOINTS],
+               const traj_waypoint_t *waypoints, uint8_t count);
+bool traj_plan_window(traj_plan_t *plan, const traj_config_t *config, const float start[TRAJ_NUM_JOINTS],
+                      const float start_vel[TRAJ_NUM_JOINTS], const traj_waypoint_t *waypoints,
+                      uint8_t count, const traj_waypoint_t *lookahead);
+bool traj_sample(traj_plan_t *plan, float t, float q[TRAJ_NUM_JOINTS], float v[TRAJ_NUM_JOINTS]);
+bool traj_sample_at(const traj_plan_t *plan, float t, float q[TRAJ_NUM_JOINTS], float v[TRAJ_NUM_JOINTS]);
+float traj_min_duration(const traj_config_t *config, float distance);
+uint8_t traj_waypoint_at(const traj_plan_t *plan, float t);
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,241 @@
+#include "waypoint_codec.h"
+#include <string.h>
+
+/**
+ * Append a varint, returns bytes written (1-5)
+ */
+uint8_t waypoint_put_varint(uint8_t *out, uint32_t value) {
+    uint8_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = value;
+    return n;
+}
+
+/**
+ * Read a varint; false if it runs past the end
+ */
+bool waypoint_get_varint(const uint8_t *data, size_t len, size_t *pos, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*pos >= len) {
+            return false;
+        }
+        uint8_t byte = data[(*pos)++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Check whether every joint shares the first joint's time and speed
+ */
+static bool timing_shared(const arm_position_t *point) {
+    for (int j = 1; j < ARM_NUM_JOINTS; j++) {
+        if (point->joints[j].time_ms != point->joints[0].time_ms ||
+            point->joints[j].speed != point->joints[0].speed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Check whether two waypoints have identical timing fields
+ */
+static bool timing_equal(const arm_position_t *a, const arm_position_t *b) {
+    if (a->delay_after_ms != b->delay_after_ms) {
+        return false;
+    }
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        if (a->joints[j].time_ms != b->joints[j].time_ms || a->joints[j].speed != b->joints[j].speed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Write the timing block, returns bytes written
+ */
+static uint8_t encode_timing(const arm_position_t *point, uint8_t *out) {
+    bool shared = timing_shared(point);
+    uint8_t n = waypoint_put_varint(out, (point->delay_after_ms << 1) | (shared ? 0 : 1));
+    int joints = shared ? 1 : ARM_NUM_JOINTS;
+    for (int j = 0; j < joints; j++) {
+        n += waypoint_put_varint(&out[n], point->joints[j].time_ms);
+        n += waypoint_put_varint(&out[n], point->joints[j].speed);
+    }
+    return n;
+}
+
+/**
+ * Encode a waypoint against the previous one (NULL for a keyframe)
+ *
+ * Returns bytes written to out (at most WP_ENCODED_MAX_LEN), or 0 if a
+ * position or the delay is out of range.
+ */
+size_t waypoint_encode(const arm_position_t *prev, const arm_position_t *point, uint8_t *out) {
+    if (point->delay_after_ms > WP_MAX_DELAY_MS) {
+        return 0;
+    }
+    for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+        if (point->joints[j].position > STS_POSITION_MAX) {
+            return 0;
+        }
+    }
+
+    uint8_t timing[WP_ENCODED_MAX_LEN];
+    uint8_t timing_len = encode_timing(point, timing);
+
+    // Delta form, if there is something to delta against
+    uint8_t delta[2 * ARM_NUM_JOINTS];
+    uint8_t delta_len = 0;
+    uint8_t ctrl = 0;
+    size_t delta_total = SIZE_MAX;
+    if (prev != NULL) {
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            int32_t d = (int32_t)point->joints[j].position - prev->joints[j].position;
+            if (d != 0) {
+                ctrl |= 1 << j;
+                delta_len += waypoint_put_varint(&delta[delta_len], ((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+            }
+        }
+        if (!timing_equal(prev, point)) {
+            ctrl |= WP_CTRL_TIMING;
+        }
+        delta_total = 1 + delta_len + ((ctrl & WP_CTRL_TIMING) ? timing_len : 0);
+    }
+
+    size_t key_total = 1 + WP_KEY_POSITIONS_LEN + timing_len;
+    size_t n = 1;
+    if (delta_total <= key_total) {
+        memcpy(&out[n], delta, delta_len);
+        n += delta_len;
+    } else {
+        ctrl = WP_CTRL_KEY | WP_CTRL_TIMING;
+        for (int j = 0; j < ARM_NUM_JOINTS; j += 2) {
+            uint16_t a = point->joints[j].position;
+            uint16_t b = point->joints[j + 1].position;
+            out[n++] = a & 0xFF;
+            out[n++] = (a >> 8) | ((b & 0x0F) << 4);
+            out[n++] = b >> 4;
+        }
+    }
+
+    if (ctrl & WP_CTRL_TIMING) {
+        memcpy(&out[n], timing, timing_len);
+        n += timing_len;
+    }
+    out[0] = ctrl;
+    return n;
+}
+
+/**
+ * Decode the next waypoint in place over the previous one
+ *
+ * point must hold the previous waypoint (or zeros before the first) and is
+ * left partially updated if the data is malformed.
+ */
+bool waypoint_decode(const uint8_t *data, size_t len, size_t *pos, arm_position_t *point) {
+    if (*pos >= len) {
+        return false;
+    }
+    uint8_t ctrl = data[(*pos)++];
+
+    if (ctrl & WP_CTRL_KEY) {
+        if ((ctrl & ~(WP_CTRL_KEY | WP_CTRL_TIMING)) || *pos + WP_KEY_POSITIONS_LEN > len) {
+            return false;
+        }
+        const uint8_t *p = &data[*pos];
+        for (int j = 0; j < ARM_NUM_JOINTS; j += 2, p += 3) {
+            point->joints[j].position = p[0] | ((p[1] & 0x0F) << 8);
+            point->joints[j + 1].position = (p[1] >> 4) | (p[2] << 4);
+        }
+        *pos += WP_KEY_POSITIONS_LEN;
+    } else {
+        for (int j = 0; j < ARM_NUM_JOINTS; j++) {
+            if (!(ctrl & (1 << j))) {
+                continue;
+            }
+            uint32_t zz;
+            if (!waypoint_get_varint(data, len, pos, &zz)) {
+                return false;
+            }
+            int32_t value = point->joints[j].position + ((int32_t)(zz >> 1) ^ -(int32_t)(zz & 1));
+            if (value < 0 || value > STS_POSITION_MAX) {
+                return false;
+            }
+            point->joints[j].position = value;
+        }
+    }
+
+    if (ctrl & WP_CTRL_TIMING) {
+        uint32_t head;
+        if (!waypoint_get_varint(data, len, pos, &head)) {
+            return false;
+        }
+        point->delay_after_ms = head >> 1;
+        int joints = (head & 1) ? ARM_NUM_JOINTS : 1;
+        for (int j = 0; j < joints; j++) {
+            uint32_t time_ms, speed;
+            if (!waypoint_get_varint(data, len, pos, &time_ms) ||
+                !waypoint_get_varint(data, len, pos, &speed) ||
+                time_ms > UINT16_MAX || speed > UINT16_MAX) {
+                return false;
+            }
+            point->joints[j].time_ms = time_ms;
+            point->joints[j].speed = speed;
+        }
+        for (int j = joints; j < ARM_NUM_JOINTS; j++) {
+            point->joints[j].time_ms = point->joints[0].time_ms;
+            point->joints[j].speed = point->joints[0].speed;
+        }
+    }
+    return true;
+}
+
+/**
+ * Encode a chain of waypoints, each against the one before
+ *
+ * Returns the encoded length, or 0 if a point is out of range or the chain
+ * does not fit in out_len.
+ */
+size_t waypoint_encode_list(const arm_position_t *points, int count, uint8_t *out, size_t out_len) {
+    size_t n = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t buf[WP_ENCODED_MAX_LEN];
+        size_t len = waypoint_encode(i > 0 ? &points[i - 1] : NULL, &points[i], buf);
+        if (len == 0 || n + len > out_len) {
+            return 0;
+        }
+        memcpy(&out[n], buf, len);
+        n += len;
+    }
+    return n;
+}
+
+/**
+ * Decode a chain written by waypoint_encode_list
+ *
+ * Returns the number of points decoded, or -1 if the data is malformed or
+ * holds more than max_points.
+ */
+int waypoint_decode_list(const uint8_t *data, size_t len, arm_position_t *points, int max_points) {
+    arm_position_t point = {0};
+    size_t pos = 0;
+    int count = 0;
+    while (pos < len) {
+        if (count >= max_points || !waypoint_decode(data, len, &pos, &point)) {
+            return -1;
+        }
+        points[count++] = point;
+    }
+    return count;
+}
@@ -0,0 +1,41 @@
+#ifndef WAYPOINT_CODEC_H
+#define WAYPOINT_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sts_servo.h"
+
+// Compact encoding of arm_position_t (40 bytes in RAM).
+//
+// Each waypoint starts with a control byte and is either a keyframe or a
+// delta against the previous waypoint, whichever is shorter:
+//
+//   ctrl u8: bit0-5 joint j changed (delta only), bit6 timing follows,
+//            bit7 keyframe
+//   keyframe: 6 x 12-bit positions packed into 9 bytes
+//   delta:    zigzag varint per changed joint
+//   timing:   varint (delay_after_ms << 1 | per_joint), then either one
+//             shared varint time_ms and speed, or one pair per joint
+//
+// A keyframe always carries timing; a delta only when it differs from the
+// previous waypoint. A single slot with shared timing takes about 16 bytes,
+// consecutive points of a recorded path usually 4-10.
+
+#define WP_CTRL_TIMING            0x40
+#define WP_CTRL_KEY               0x80
+#define WP_KEY_POSITIONS_LEN      9             // 6 x 12 bits
+#define WP_MAX_DELAY_MS           0x7FFFFFFF    // One bit goes to the timing mode
+#define WP_ENCODED_MAX_LEN        54            // Delta of 6 x 2 + per-joint timing
+
+// Varints shared with the other on-flash formats
+uint8_t waypoint_put_varint(uint8_t *out, uint32_t value);
+bool waypoint_get_varint(const uint8_t *data, size_t len, size_t *pos, uint32_t *value);
+
+// Function prototypes
+size_t waypoint_encode(const arm_position_t *prev, const arm_position_t *point, uint8_t *out);
+bool waypoint_decode(const uint8_t *data, size_t len, size_t *pos, arm_position_t *point);
+size_t waypoint_encode_list(const arm_position_t *points, int count, uint8_t *out, size_t out_len);
+int waypoint_decode_list(const uint8_t *data, size_t len, arm_position_t *points, int max_points);
+
+#endif // WAYPOINT_CODEC_H